@@ -0,0 +1,297 @@
+#include "LogBinary.h"
+#include <bit>
+#include <cstring>
+#include <iterator>
+
+namespace LogBinary {
+
+    const char* levelName(uint8_t level)
+    {
+        static const char* names[] = { "DEBUG", "INFO ", "ERROR", "WARN ", "FATAL" };
+        return level < std::size(names) ? names[level] : "?????";
+    }
+
+    std::string originPrefix(int stateMachine, int64_t cycle)
+    {
+        if (stateMachine >= 0 && cycle >= 0)
+            return fmt::format("[sm{} @{}] ", stateMachine, cycle);
+        if (stateMachine >= 0)
+            return fmt::format("[sm{}] ", stateMachine);
+        if (cycle >= 0)
+            return fmt::format("[@{}] ", cycle);
+        return "";
+    }
+
+    void putArg(fmt::memory_buffer& out, ArgType type, uint64_t raw, std::string_view text)
+    {
+        switch (type)
+        {
+        case ArgType::Int:
+            putSigned(out, static_cast<int64_t>(raw));
+            break;
+        case ArgType::Uint:
+        case ArgType::Bool:
+        case ArgType::Char:
+        case ArgType::Pointer:
+            putVarint(out, raw);
+            break;
+        case ArgType::Float:
+            for (int i = 0; i < 4; i++)
+                out.push_back(static_cast<char>(raw >> (i * 8)));
+            break;
+        case ArgType::Double:
+            for (int i = 0; i < 8; i++)
+                out.push_back(static_cast<char>(raw >> (i * 8)));
+            break;
+        case ArgType::String:
+            putString(out, text);
+            break;
+        }
+    }
+
+    void pushArg(fmt::dynamic_format_arg_store<fmt::format_context>& store, ArgType type, uint64_t raw, std::string_view text)
+    {
+        switch (type)
+        {
+        case ArgType::Int:     store.push_back(static_cast<int64_t>(raw)); break;
+        case ArgType::Uint:    store.push_back(raw); break;
+        case ArgType::Float:   store.push_back(std::bit_cast<float>(static_cast<uint32_t>(raw))); break;
+        case ArgType::Double:  store.push_back(std::bit_cast<double>(raw)); break;
+        case ArgType::Bool:    store.push_back(raw != 0); break;
+        case ArgType::Char:    store.push_back(static_cast<char>(raw)); break;
+        case ArgType::String:  store.push_back(text); break;
+        case ArgType::Pointer: store.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(raw))); break;
+        }
+    }
+
+    /* ----- Reader ----- */
+
+    Reader::Reader(std::istream& in) :
+        in_(in)
+    {
+        char magic[sizeof(kMagic)];
+        if (in_.read(magic, sizeof(magic)) && std::memcmp(magic, kMagic, sizeof(kMagic)) == 0)
+            valid_ = true;
+        else
+            error_ = "not a pio_emu binary log";
+    }
+
+    bool Reader::fail(const std::string& message)
+    {
+        error_ = message;
+        valid_ = false;
+        return false;
+    }
+
+    bool Reader::getVarint(uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = in_.get();
+            if (byte == std::char_traits<char>::eof())
+                return false;
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    bool Reader::getString(std::string& text)
+    {
+        uint64_t length;
+        if (!getVarint(length) || length > (1u << 24))
+            return false;
+        text.resize(length);
+        return static_cast<bool>(in_.read(text.data(), static_cast<std::streamsize>(length)));
+    }
+
+    bool Reader::next(Entry& entry)
+    {
+        while (valid_)
+        {
+            int tag = in_.get();
+            if (tag == std::char_traits<char>::eof())
+                return false; // clean end
+
+            uint64_t value;
+            switch (tag)
+            {
+            case kTagSite:
+            {
+                Site site;
+                uint64_t id, line;
+                int level;
+                if (!getVarint(id) || (level = in_.get()) == std::char_traits<char>::eof() || !getVarint(line)
+                    || !getString(site.file) || !getString(site.format))
+                    return fail("truncated call site");
+                // The writer numbers call sites 0, 1, 2... in order, anything else is damage
+                if (id != sites_.size())
+                    return fail("bad call site id");
+                site.level = static_cast<uint8_t>(level);
+                site.line = static_cast<int>(line);
+                sites_.push_back(std::move(site));
+                continue;
+            }
+            case kTagRecord:
+            {
+                uint64_t site_id;
+                if (!getVarint(site_id) || site_id >= sites_.size())
+                    return fail("record for an unknown call site");
+
+                int flags = in_.get();
+                if (flags == std::char_traits<char>::eof())
+                    return fail("truncated record");
+                entry = Entry();
+                entry.site = &sites_[site_id];
+                if (flags & kHasCycle)
+                {
+                    if (!getVarint(value))
+                        return fail("truncated record");
+                    entry.cycle = static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1)); // zigzag
+                }
+                if (flags & kHasStateMachine)
+                {
+                    if (!getVarint(value))
+                        return fail("truncated record");
+                    entry.stateMachine = static_cast<int>(value);
+                }
+
+                int argc = in_.get();
+                if (argc == std::char_traits<char>::eof())
+                    return fail("truncated record");
+                entry.args.resize(argc);
+                for (Arg& arg : entry.args)
+                {
+                    arg.type = static_cast<ArgType>(in_.get());
+                    arg.raw = 0;
+                    bool ok = true;
+                    switch (arg.type)
+                    {
+                    case ArgType::Int:
+                        ok = getVarint(value);
+                        arg.raw = (value >> 1) ^ (~(value & 1) + 1);
+                        break;
+                    case ArgType::Uint:
+                    case ArgType::Bool:
+                    case ArgType::Char:
+                    case ArgType::Pointer:
+                        ok = getVarint(arg.raw);
+                        break;
+                    case ArgType::Float:
+                    case ArgType::Double:
+                    {
+                        int size = arg.type == ArgType::Float ? 4 : 8;
+                        unsigned char bytes[8];
+                        ok = static_cast<bool>(in_.read(reinterpret_cast<char*>(bytes), size));
+                        for (int i = 0; i < size; i++)
+                            arg.raw |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+                        break;
+                    }
+                    case ArgType::String:
+                        ok = getString(arg.text);
+                        break;
+                    default:
+                        ok = false;
+                    }
+                    if (!ok)
+                        return fail("truncated or corrupt argument");
+                }
+                return true;
+            }
+            case kTagDropped:
+                if (!getVarint(value))
+                    return fail("truncated dropped entry");
+                entry = Entry();
+                entry.kind = Entry::Kind::Dropped;
+                entry.dropped = value;
+                return true;
+            default:
+                return fail(fmt::format("unknown entry tag {:#04x}", tag));
+            }
+        }
+        return false;
+    }
+
+    /* ----- Output ----- */
+
+    std::string formatMessage(const Entry& entry)
+    {
+        if (entry.kind == Entry::Kind::Dropped)
+            return fmt::format("{} log records dropped (queue full)", entry.dropped);
+
+        fmt::dynamic_format_arg_store<fmt::format_context> store;
+        for (const Arg& arg : entry.args)
+            pushArg(store, arg.type, arg.raw, arg.text);
+
+        try
+        {
+            return fmt::vformat(entry.site->format, store);
+        }
+        catch (const fmt::format_error& e)
+        {
+            return fmt::format("<format error: {}> {}", e.what(), entry.site->format);
+        }
+    }
+
+    std::string toText(const Entry& entry)
+    {
+        if (entry.kind == Entry::Kind::Dropped)
+            return fmt::format("[WARN ] {}", formatMessage(entry));
+
+        return fmt::format("[{}] {}{} (at file:{} line:{})", levelName(entry.site->level),
+            originPrefix(entry.stateMachine, entry.cycle), formatMessage(entry),
+            entry.site->file, entry.site->line);
+    }
+
+    namespace {
+        void appendJsonString(std::string& out, std::string_view text)
+        {
+            out += '"';
+            for (char c : text)
+            {
+                switch (c)
+                {
+                case '"':  out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20)
+                        out += fmt::format("\\u{:04x}", static_cast<int>(c));
+                    else
+                        out += c;
+                }
+            }
+            out += '"';
+        }
+    }
+
+    std::string toJson(const Entry& entry)
+    {
+        std::string out;
+        if (entry.kind == Entry::Kind::Dropped)
+            return fmt::format("{{\"dropped\":{}}}", entry.dropped);
+
+        std::string level = levelName(entry.site->level);
+        while (!level.empty() && level.back() == ' ')
+            level.pop_back();
+
+        out += "{\"level\":";
+        appendJsonString(out, level);
+        if (entry.stateMachine >= 0)
+            out += fmt::format(",\"sm\":{}", entry.stateMachine);
+        if (entry.cycle >= 0)
+            out += fmt::format(",\"cycle\":{}", entry.cycle);
+        out += ",\"file\":";
+        appendJsonString(out, entry.site->file);
+        out += fmt::format(",\"line\":{}", entry.site->line);
+        out += ",\"message\":";
+        appendJsonString(out, formatMessage(entry));
+        out += '}';
+        return out;
+    }
+
+} // namespace LogBinary
@@ -0,0 +1,138 @@
+#pragma once
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <string_view>
+#include <deque>
+#include <vector>
+#include <fmt/format.h>
+#include <fmt/args.h>
+
+// Compact binary log format, written by the Logger's binary sink and read back by pio_emu_logdump.
+//
+// File: 8 byte magic, then a stream of entries, each starting with a tag byte.
+//   site:    tag, id, level (u8), line, file, format      - once per call site, before its first record
+//   record:  tag, site id, flags (u8), [cycle], [sm number], argc (u8), argc * (type (u8), payload)
+//   dropped: tag, count                                   - records lost to a full queue
+// Integers are LEB128 varints (signed ones zigzag encoded), strings are a varint length + bytes,
+// floats/doubles are their raw little endian bits.
+namespace LogBinary {
+
+    inline constexpr char kMagic[8] = { 'P', 'I', 'O', 'B', 'L', 'O', 'G', '1' };
+
+    enum Tag : uint8_t
+    {
+        kTagSite = 1,
+        kTagRecord = 2,
+        kTagDropped = 3,
+    };
+
+    enum RecordFlags : uint8_t
+    {
+        kHasCycle = 1 << 0,
+        kHasStateMachine = 1 << 1,
+    };
+
+    enum class ArgType : uint8_t
+    {
+        Int,
+        Uint,
+        Float,
+        Double,
+        Bool,
+        Char,
+        String,
+        Pointer
+    };
+
+    // Same order as Logger::LogLevel
+    const char* levelName(uint8_t level);
+
+    // "[sm1 @1234] " style prefix for the parts that are known, "" for none
+    std::string originPrefix(int stateMachine, int64_t cycle);
+
+    /* ----- Encoding ----- */
+
+    inline void putVarint(fmt::memory_buffer& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    inline void putSigned(fmt::memory_buffer& out, int64_t value)
+    {
+        putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    inline void putString(fmt::memory_buffer& out, std::string_view text)
+    {
+        putVarint(out, text.size());
+        out.append(text.data(), text.data() + text.size());
+    }
+
+    // One argument's payload (type byte not included), 'text' is only used for strings
+    void putArg(fmt::memory_buffer& out, ArgType type, uint64_t raw, std::string_view text);
+
+    /* ----- Decoding ----- */
+
+    struct Arg
+    {
+        ArgType type;
+        uint64_t raw;     // everything but strings
+        std::string text; // strings
+    };
+
+    struct Site
+    {
+        uint8_t level = 0;
+        int line = 0;
+        std::string file;
+        std::string format;
+    };
+
+    struct Entry
+    {
+        enum class Kind
+        {
+            Record,
+            Dropped
+        } kind = Kind::Record;
+
+        const Site* site = nullptr; // owned by the Reader, stays valid while it lives
+        int64_t cycle = -1;      // -1: not known
+        int stateMachine = -1;   // -1: not known
+        std::vector<Arg> args;
+        uint64_t dropped = 0;
+    };
+
+    // Push one decoded argument to a fmt argument store
+    void pushArg(fmt::dynamic_format_arg_store<fmt::format_context>& store, ArgType type, uint64_t raw, std::string_view text);
+
+    class Reader
+    {
+    public:
+        explicit Reader(std::istream& in); // checks the magic, see valid()
+        bool valid() const { return valid_; }
+        bool next(Entry& entry); // false at the end of the stream or on a corrupt entry (then error() is set)
+        const std::string& error() const { return error_; }
+
+    private:
+        bool getVarint(uint64_t& value);
+        bool getString(std::string& text);
+        bool fail(const std::string& message);
+
+        std::istream& in_;
+        bool valid_ = false;
+        std::string error_;
+        std::deque<Site> sites_; // by id, a deque keeps Entry::site valid as it grows
+    };
+
+    std::string formatMessage(const Entry& entry);
+    std::string toText(const Entry& entry); // same layout as the text log
+    std::string toJson(const Entry& entry); // one JSON object, no trailing newline
+
+} // namespace LogBinary
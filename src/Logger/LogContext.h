@@ -0,0 +1,46 @@
+#pragma once
+#include <atomic>
+#include "Logger.h"
+
+// Logging context owned by one emulated instance: which Logger its records go to and what is
+// let through. The owner adds its state machine number and clock to every record (see
+// PioStateMachine::emitLog). Filters are atomics, so any thread can silence an instance
+// while it runs without touching the shared Logger.
+class LogContext
+{
+public:
+    LogContext() = default;
+    LogContext(const LogContext& other) { *this = other; }
+    LogContext& operator=(const LogContext& other)
+    {
+        sink_.store(other.sink_.load());
+        level_.store(other.level_.load());
+        enabled_.store(other.enabled_.load());
+        return *this;
+    }
+
+    void setSink(Logger* sink) { sink_.store(sink != nullptr ? sink : &logger); } // nullptr: the global logger
+    Logger* sink() const { return sink_.load(std::memory_order_relaxed); }
+    void setLevel(Logger::LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+    Logger::LogLevel level() const { return level_.load(std::memory_order_relaxed); }
+    void setEnabled(bool enable) { enabled_.store(enable, std::memory_order_relaxed); }
+    bool enabled() const { return enabled_.load(std::memory_order_relaxed); }
+
+    bool accepts(Logger::LogLevel level) const
+    {
+        return enabled_.load(std::memory_order_relaxed) && level >= level_.load(std::memory_order_relaxed);
+    }
+
+    template <typename... Args>
+    void logFormat(Logger::Origin origin, Logger::LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args) const
+    {
+        if (!accepts(level))
+            return;
+        sink()->logFormat(origin, level, lineNumber, fileName, format, std::forward<Args>(args)...);
+    }
+
+private:
+    std::atomic<Logger*> sink_{ &logger };
+    std::atomic<Logger::LogLevel> level_{ Logger::LogLevel::LEVEL_DEBUG }; // on top of the sink's own level
+    std::atomic<bool> enabled_{ true };
+};
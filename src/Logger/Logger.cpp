@@ -1,104 +1,182 @@
 #include "Logger.h"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
 #include <fmt/core.h>
+#include <fmt/args.h>
 #include <fmt/color.h>
 
-// TODO: Maybe rewrite in Singleton? and add locks?
+namespace {
+    constexpr size_t kDefaultCapacity = 4096;
+    constexpr size_t kBatchSize = 256;
+    constexpr auto kIdleWait = std::chrono::milliseconds(10);
+
+    fmt::color levelColor(Logger::LogLevel level)
+    {
+        switch (level)
+        {
+        case Logger::LogLevel::LEVEL_DEBUG:   return fmt::color::light_blue;
+        case Logger::LogLevel::LEVEL_INFO:    return fmt::color::light_green;
+        case Logger::LogLevel::LEVEL_WARNING: return fmt::color::green_yellow;
+        case Logger::LogLevel::LEVEL_ERROR:   return fmt::color::red;
+        case Logger::LogLevel::LEVEL_FATAL:   return fmt::color::magenta;
+        }
+        return fmt::color::white;
+    }
+}
 
 Logger::Logger() :
     currentLevel_(LogLevel::LEVEL_INFO),
+    async_(true),
+    overflowPolicy_(OverflowPolicy::Block),
+    flushPolicy_(FlushPolicy::EveryBatch),
+    flushIntervalMs_(100),
     consoleOutput_(true),
-    fileOutput_(false)
+    fileOutput_(false),
+    capacity_(kDefaultCapacity),
+    mask_(kDefaultCapacity - 1),
+    enqueuePos_(0),
+    dequeuePos_(0),
+    written_(0),
+    dropped_(0),
+    droppedReported_(0),
+    started_(false),
+    stop_(false),
+    writerSleeping_(false),
+    lastFlush_(std::chrono::steady_clock::now()),
+    fileDirty_(false)
 {
 }
 
 Logger::~Logger()
 {
+    if (writer_.joinable())
+    {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex_);
+            stop_.store(true);
+        }
+        wakeCv_.notify_one();
+        writer_.join(); // drains the queue before returning
+    }
+    stop_.store(true);
+
+    std::lock_guard<std::mutex> lock(outputMutex_);
     if (logFile_.is_open())
     {
         logFile_.close();
     }
+    if (binaryFile_.is_open())
+    {
+        binaryFile_.close();
+    }
 }
 
 void Logger::setLevel(LogLevel level)
 {
-    currentLevel_ = level;
+    currentLevel_.store(level);
 }
 
 void Logger::enableConsoleOutput(bool enable)
 {
+    std::lock_guard<std::mutex> lock(outputMutex_);
     consoleOutput_ = enable;
 }
 
 void Logger::setLogFile(const std::string& filename)
 {
+    flush(); // lines logged before the switch go to the old file
+
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    if (logFile_.is_open())
+    {
+        logFile_.close();
+    }
     if (!filename.empty())
     {
-        if (logFile_.is_open())
-        {
-            logFile_.close();
-        }
         logFile_.open(filename, std::ios::app);
         fileOutput_ = true;
     }
     else
     {
-        if (logFile_.is_open())
-        {
-            logFile_.close();
-        }
         fileOutput_ = false;
     }
 }
 
-// Update log signature to accept file name
-void Logger::log(LogLevel level, const std::string& message, int lineNumber, const char* fileName)
+void Logger::setBinaryLogFile(const std::string& filename)
 {
-    if (level < currentLevel_)
-        return;
+    flush();
 
-    std::string levelStr;
-    fmt::color textColor = fmt::color::white;
-    
-    switch (level)
-    {
-    case LogLevel::LEVEL_DEBUG:
-        levelStr = "DEBUG";
-        textColor = fmt::color::light_blue;
-        break;
-    case LogLevel::LEVEL_INFO:
-        levelStr = "INFO ";
-        textColor = fmt::color::light_green;
-        break;
-    case LogLevel::LEVEL_WARNING:
-        levelStr = "WARN ";
-        textColor = fmt::color::green_yellow;
-        break;
-    case LogLevel::LEVEL_ERROR:
-        levelStr = "ERROR";
-        textColor = fmt::color::red;
-        break;
-    case LogLevel::LEVEL_FATAL:
-        levelStr = "FATAL";
-        textColor = fmt::color::magenta;
-        break;
-    }
-
-    std::string plainMessage = fmt::format("[{}] {} (at file:{} line:{})\n", levelStr, message, fileName, lineNumber);
-    
-    if (consoleOutput_)
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    if (binaryFile_.is_open())
     {
-        fmt::print(fg(textColor), "[{}] {} ", levelStr, message);
-        fmt::print(fg(fmt::color::gray), "(at file:{} line:{})\n", fileName, lineNumber);
+        binaryFile_.close();
     }
+    siteIds_.clear(); // a new file needs its own call site table
+    if (!filename.empty())
+    {
+        binaryFile_.open(filename, std::ios::binary | std::ios::trunc);
+        if (binaryFile_.is_open())
+            binaryFile_.write(LogBinary::kMagic, sizeof(LogBinary::kMagic));
+    }
+}
 
-    if (fileOutput_ && logFile_.is_open())
+void Logger::setAsync(bool enable)
+{
+    if (!enable)
+        flush(); // keep the order of what is already queued
+    async_.store(enable);
+}
+
+void Logger::setOverflowPolicy(OverflowPolicy policy)
+{
+    overflowPolicy_.store(policy);
+}
+
+void Logger::setFlushPolicy(FlushPolicy policy, std::chrono::milliseconds interval)
+{
+    flushPolicy_.store(policy);
+    flushIntervalMs_.store(interval.count());
+}
+
+void Logger::setQueueCapacity(size_t records)
+{
+    if (started_.load())
+        return; // the queue is already in use
+
+    capacity_ = std::bit_ceil(std::max<size_t>(records, 2));
+    mask_ = capacity_ - 1;
+}
+
+void Logger::flush()
+{
+    if (started_.load(std::memory_order_acquire))
     {
-        logFile_ << plainMessage;
-        logFile_.flush();
+        size_t target = enqueuePos_.load(std::memory_order_acquire);
+        wakeCv_.notify_one();
+
+        std::unique_lock<std::mutex> lock(flushMutex_);
+        flushCv_.wait(lock, [&] { return written_.load(std::memory_order_acquire) >= target || stop_.load(); });
     }
+
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    if (logFile_.is_open())
+        logFile_.flush();
+    if (binaryFile_.is_open())
+        binaryFile_.flush();
+    std::fflush(stdout);
+    fileDirty_ = false;
+    lastFlush_ = std::chrono::steady_clock::now();
+}
+
+void Logger::log(LogLevel level, const std::string& message, int lineNumber, const char* fileName)
+{
+    if (level < currentLevel_.load(std::memory_order_relaxed))
+        return;
+
+    submit(Origin{}, level, lineNumber, fileName, "{}", [&](Record& record) { encodeArg(record, message); });
 }
 
-// Update helper methods to accept line/file
 void Logger::debug(const std::string& message, int lineNumber, const char* fileName)
 {
     log(LogLevel::LEVEL_DEBUG, message, lineNumber, fileName);
@@ -122,4 +200,290 @@ void Logger::error(const std::string& message, int lineNumber, const char* fileN
 void Logger::fatal(const std::string& message, int lineNumber, const char* fileName)
 {
     log(LogLevel::LEVEL_FATAL, message, lineNumber, fileName);
-}
\ No newline at end of file
+}
+
+void Logger::copyText(Record& record, int index, std::string_view text)
+{
+    size_t space = Record::kTextSize - record.textUsed;
+    size_t length = std::min(text.size(), space);
+    std::memcpy(record.text + record.textUsed, text.data(), length);
+    if (length < text.size() && length >= 3)
+        std::memcpy(record.text + record.textUsed + length - 3, "...", 3); // truncated
+
+    record.types[index] = ArgType::String;
+    record.values[index] = (static_cast<uint64_t>(record.textUsed) << 16) | length;
+    record.textUsed += static_cast<uint16_t>(length);
+}
+
+std::string_view Logger::stringArg(const Record& record, int index)
+{
+    if (record.types[index] != ArgType::String)
+        return {};
+    uint64_t raw = record.values[index];
+    return std::string_view(record.text + (raw >> 16), raw & 0xffff);
+}
+
+/* ----- Queue ----- */
+
+size_t Logger::claim()
+{
+    if (!started_.load(std::memory_order_acquire))
+        startWriter();
+
+    size_t position = enqueuePos_.load(std::memory_order_relaxed);
+    while (true)
+    {
+        Cell& cell = cells_[position & mask_];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+        if (diff == 0)
+        {
+            // Our turn for this cell, take it if nobody was faster
+            if (enqueuePos_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                return position;
+        }
+        else if (diff < 0)
+        {
+            // Full: the writer hasn't released this cell from the previous lap yet
+            if (overflowPolicy_.load(std::memory_order_relaxed) == OverflowPolicy::Drop)
+            {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return SIZE_MAX;
+            }
+            wakeCv_.notify_one();
+            std::this_thread::yield();
+            position = enqueuePos_.load(std::memory_order_relaxed);
+        }
+        else
+        {
+            position = enqueuePos_.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+void Logger::publish(size_t position)
+{
+    cells_[position & mask_].sequence.store(position + 1, std::memory_order_release);
+    if (writerSleeping_.load(std::memory_order_relaxed))
+        wakeCv_.notify_one(); // a wakeup lost to this race costs at most kIdleWait
+}
+
+bool Logger::hasPending() const
+{
+    return cells_[dequeuePos_ & mask_].sequence.load(std::memory_order_acquire) == dequeuePos_ + 1;
+}
+
+void Logger::startWriter()
+{
+    std::call_once(startOnce_, [this] {
+        cells_ = std::make_unique<Cell[]>(capacity_);
+        for (size_t i = 0; i < capacity_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        writer_ = std::thread(&Logger::writerLoop, this);
+        started_.store(true, std::memory_order_release);
+    });
+}
+
+void Logger::writerLoop()
+{
+    while (true)
+    {
+        if (drainBatch() > 0)
+            continue;
+
+        if (stop_.load())
+        {
+            if (!hasPending() && dequeuePos_ == enqueuePos_.load())
+                break;
+            std::this_thread::yield(); // a producer claimed a cell but hasn't published it yet
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wakeMutex_);
+        writerSleeping_.store(true);
+        auto interval = std::chrono::milliseconds(flushIntervalMs_.load(std::memory_order_relaxed));
+        wakeCv_.wait_for(lock, std::min<std::chrono::milliseconds>(kIdleWait, interval), [&] { return stop_.load() || hasPending(); });
+        writerSleeping_.store(false);
+        lock.unlock();
+
+        if (flushPolicy_.load(std::memory_order_relaxed) == FlushPolicy::Periodic)
+        {
+            std::lock_guard<std::mutex> outputLock(outputMutex_);
+            writeBuffers(false);
+        }
+    }
+
+    // Let anybody still waiting in flush() go
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+    }
+    flushCv_.notify_all();
+}
+
+size_t Logger::drainBatch()
+{
+    std::lock_guard<std::mutex> outputLock(outputMutex_);
+
+    size_t count = 0;
+    while (count < kBatchSize && hasPending())
+    {
+        Cell& cell = cells_[dequeuePos_ & mask_];
+        formatRecord(cell.record);
+        cell.sequence.store(dequeuePos_ + capacity_, std::memory_order_release); // free for the next lap
+        dequeuePos_++;
+        count++;
+
+        if (flushPolicy_.load(std::memory_order_relaxed) == FlushPolicy::EveryRecord)
+            writeBuffers(true);
+    }
+
+    uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+    if (dropped != droppedReported_)
+    {
+        fmt::format_to(std::back_inserter(fileBuffer_), "[WARN ] {} log records dropped (queue full)\n", dropped - droppedReported_);
+        if (consoleOutput_)
+            fmt::format_to(std::back_inserter(consoleBuffer_), fg(fmt::color::green_yellow), "[WARN ] {} log records dropped (queue full)\n", dropped - droppedReported_);
+        if (binaryFile_.is_open())
+        {
+            binaryBuffer_.push_back(static_cast<char>(LogBinary::kTagDropped));
+            LogBinary::putVarint(binaryBuffer_, dropped - droppedReported_);
+        }
+        droppedReported_ = dropped;
+    }
+
+    if (count == 0 && consoleBuffer_.size() == 0 && fileBuffer_.size() == 0 && binaryBuffer_.size() == 0)
+        return 0;
+
+    writeBuffers(flushPolicy_.load(std::memory_order_relaxed) != FlushPolicy::Periodic);
+    written_.store(dequeuePos_, std::memory_order_release);
+
+    {
+        std::lock_guard<std::mutex> lock(flushMutex_);
+    }
+    flushCv_.notify_all();
+    return count;
+}
+
+/* ----- Output ----- */
+
+void Logger::writeDirect(const Record& record)
+{
+    std::lock_guard<std::mutex> lock(outputMutex_);
+    formatRecord(record);
+    writeBuffers(flushPolicy_.load(std::memory_order_relaxed) != FlushPolicy::Periodic || record.level == LogLevel::LEVEL_FATAL);
+}
+
+void Logger::formatRecord(const Record& record)
+{
+    if (binaryFile_.is_open())
+        encodeRecord(record);
+
+    if (!consoleOutput_ && !(fileOutput_ && logFile_.is_open()))
+        return; // binary only, skip formatting
+
+    fmt::dynamic_format_arg_store<fmt::format_context> store;
+    for (int i = 0; i < record.argCount; i++)
+    {
+        LogBinary::pushArg(store, record.types[i], record.values[i], stringArg(record, i));
+    }
+
+    // Format the message once, both outputs reuse it
+    message_.clear();
+    try
+    {
+        fmt::vformat_to(std::back_inserter(message_), fmt::string_view(record.format, record.formatSize), store);
+    }
+    catch (const fmt::format_error& e)
+    {
+        fmt::format_to(std::back_inserter(message_), "<format error: {}> {}", e.what(), std::string_view(record.format, record.formatSize));
+    }
+
+    std::string_view message(message_.data(), message_.size());
+    const char* levelStr = LogBinary::levelName(static_cast<uint8_t>(record.level));
+    std::string origin = LogBinary::originPrefix(record.stateMachine, record.cycle);
+
+    if (consoleOutput_)
+    {
+        fmt::format_to(std::back_inserter(consoleBuffer_), fg(levelColor(record.level)), "[{}] {}{} ", levelStr, origin, message);
+        fmt::format_to(std::back_inserter(consoleBuffer_), fg(fmt::color::gray), "(at file:{} line:{})\n", record.fileName, record.lineNumber);
+    }
+
+    if (fileOutput_ && logFile_.is_open())
+    {
+        fmt::format_to(std::back_inserter(fileBuffer_), "[{}] {}{} (at file:{} line:{})\n", levelStr, origin, message, record.fileName, record.lineNumber);
+    }
+}
+
+void Logger::writeBuffers(bool flushFile)
+{
+    if (consoleBuffer_.size() > 0)
+    {
+        std::fwrite(consoleBuffer_.data(), 1, consoleBuffer_.size(), stdout);
+        std::fflush(stdout);
+        consoleBuffer_.clear();
+    }
+
+    if (fileBuffer_.size() > 0)
+    {
+        if (logFile_.is_open())
+            logFile_.write(fileBuffer_.data(), static_cast<std::streamsize>(fileBuffer_.size()));
+        fileBuffer_.clear();
+        fileDirty_ = true;
+    }
+
+    if (binaryBuffer_.size() > 0)
+    {
+        if (binaryFile_.is_open())
+            binaryFile_.write(binaryBuffer_.data(), static_cast<std::streamsize>(binaryBuffer_.size()));
+        binaryBuffer_.clear();
+        fileDirty_ = true;
+    }
+
+    if (!fileDirty_)
+        return;
+
+    auto now = std::chrono::steady_clock::now();
+    auto interval = std::chrono::milliseconds(flushIntervalMs_.load(std::memory_order_relaxed));
+    if (flushFile || now - lastFlush_ >= interval)
+    {
+        if (logFile_.is_open())
+            logFile_.flush();
+        if (binaryFile_.is_open())
+            binaryFile_.flush();
+        fileDirty_ = false;
+        lastFlush_ = now;
+    }
+}
+
+void Logger::encodeRecord(const Record& record)
+{
+    // First record from a call site: describe it once, later records only carry its id
+    SiteKey key{ record.format, record.fileName, record.lineNumber, record.level };
+    auto [site, inserted] = siteIds_.try_emplace(key, static_cast<uint32_t>(siteIds_.size()));
+    if (inserted)
+    {
+        binaryBuffer_.push_back(static_cast<char>(LogBinary::kTagSite));
+        LogBinary::putVarint(binaryBuffer_, site->second);
+        binaryBuffer_.push_back(static_cast<char>(record.level));
+        LogBinary::putVarint(binaryBuffer_, static_cast<uint64_t>(record.lineNumber));
+        LogBinary::putString(binaryBuffer_, record.fileName);
+        LogBinary::putString(binaryBuffer_, std::string_view(record.format, record.formatSize));
+    }
+
+    binaryBuffer_.push_back(static_cast<char>(LogBinary::kTagRecord));
+    LogBinary::putVarint(binaryBuffer_, site->second);
+    uint8_t flags = (record.cycle >= 0 ? LogBinary::kHasCycle : 0) | (record.stateMachine >= 0 ? LogBinary::kHasStateMachine : 0);
+    binaryBuffer_.push_back(static_cast<char>(flags));
+    if (record.cycle >= 0)
+        LogBinary::putSigned(binaryBuffer_, record.cycle);
+    if (record.stateMachine >= 0)
+        LogBinary::putVarint(binaryBuffer_, static_cast<uint64_t>(record.stateMachine));
+
+    binaryBuffer_.push_back(static_cast<char>(record.argCount));
+    for (int i = 0; i < record.argCount; i++)
+    {
+        binaryBuffer_.push_back(static_cast<char>(record.types[i]));
+        LogBinary::putArg(binaryBuffer_, record.types[i], record.values[i], stringArg(record, i));
+    }
+}
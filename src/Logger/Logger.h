@@ -1,8 +1,26 @@
 #pragma once
-#include <string>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <fmt/core.h>
+#include <fmt/format.h>
+#include "LogBinary.h"
 
+// Asynchronous logger: callers only encode a compact record (level, format string pointer, raw
+// arguments, file/line) into a lock-free queue, a background writer thread formats and writes
+// them in batches. Safe to call from any number of threads.
 class Logger
 {
 public:
@@ -16,12 +34,45 @@ public:
         LEVEL_FATAL
     };
 
+    // What a caller does when the queue is full
+    enum class OverflowPolicy
+    {
+        Block, // wait for the writer (backpressure, nothing is lost)
+        Drop   // drop the record and count it, the writer reports the count
+    };
+
+    // When the log file is flushed to the OS
+    enum class FlushPolicy
+    {
+        EveryRecord, // after every line (slow, old behaviour)
+        EveryBatch,  // after every batch the writer drains
+        Periodic     // at most once per flush interval, and on flush()/fatal
+    };
+
+    // Who a record comes from, -1 when unknown (see LogContext)
+    struct Origin
+    {
+        int stateMachine = -1;
+        int64_t cycle = -1;
+    };
+
     Logger();
     ~Logger();
 
+    Logger(const Logger&) = delete;
+    Logger& operator=(const Logger&) = delete;
+
     void setLevel(LogLevel level);
     void enableConsoleOutput(bool enable);
     void setLogFile(const std::string& filename);
+    void setBinaryLogFile(const std::string& filename); // compact binary log, decode with pio_emu_logdump; "" closes it
+
+    void setAsync(bool enable); // false: format and write on the calling thread (serialized by a lock)
+    void setOverflowPolicy(OverflowPolicy policy);
+    void setFlushPolicy(FlushPolicy policy, std::chrono::milliseconds interval = std::chrono::milliseconds(100));
+    void setQueueCapacity(size_t records); // rounded up to a power of two, only before the first async record
+    void flush(); // block until everything logged before the call is written and flushed
+    uint64_t droppedCount() const { return dropped_.load(std::memory_order_relaxed); }
 
     void log(LogLevel level, const std::string& message, int lineNumber, const char* fileName);
     void debug(const std::string& message, int lineNumber, const char* fileName);
@@ -30,25 +81,254 @@ public:
     void error(const std::string& message, int lineNumber, const char* fileName);
     void fatal(const std::string& message, int lineNumber, const char* fileName);
 
+    // Formatting is deferred to the writer thread, 'format' must be a string literal.
+    // Arguments other than numbers, strings and pointers are formatted on the calling thread.
+    template <typename... Args>
+    void logFormat(LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args)
+    {
+        logFormat(Origin{}, level, lineNumber, fileName, format, std::forward<Args>(args)...);
+    }
+    template <typename... Args>
+    void logFormat(Origin origin, LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args);
+
 private:
-    LogLevel currentLevel_;
+    using ArgType = LogBinary::ArgType;
+
+    struct Record
+    {
+        static constexpr int kMaxArgs = 8;
+        static constexpr size_t kTextSize = 384;
+
+        const char* format;
+        const char* fileName;
+        int64_t cycle;        // -1: not known
+        int16_t stateMachine; // -1: not known
+        std::array<uint64_t, kMaxArgs> values; // raw bits, strings are (offset << 16 | length) into text
+        uint32_t formatSize;
+        int lineNumber;
+        LogLevel level;
+        uint16_t textUsed;
+        uint8_t argCount;
+        std::array<ArgType, kMaxArgs> types;
+        char text[kTextSize]; // copies of string arguments, truncated when they don't fit
+    };
+    static_assert(sizeof(Record) <= 512);
+
+    // Bounded MPSC queue (Vyukov): a cell's sequence tells whose turn it is
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    template <typename T>
+    static constexpr bool isDeferrable()
+    {
+        using U = std::decay_t<T>;
+        return std::is_same_v<U, float> || std::is_same_v<U, double> || std::is_integral_v<U>
+            || std::is_convertible_v<const U&, std::string_view> || std::is_same_v<U, const void*> || std::is_same_v<U, void*>;
+    }
+
+    template <typename T>
+    static void encodeArg(Record& record, const T& value);
+    static void copyText(Record& record, int index, std::string_view text);
+    static std::string_view stringArg(const Record& record, int index);
+
+    template <typename Fill>
+    void submit(Origin origin, LogLevel level, int lineNumber, const char* fileName, fmt::string_view format, Fill&& fill);
+
+    size_t claim();                  // queue position to fill, SIZE_MAX when dropped
+    void publish(size_t position);
+    void startWriter();
+    void writerLoop();
+    size_t drainBatch();             // write out what's queued, returns records written
+    bool hasPending() const;
+    void writeDirect(const Record& record);
+    void formatRecord(const Record& record);   // into the output buffers, caller holds outputMutex_
+    void encodeRecord(const Record& record);   // into the binary buffer, caller holds outputMutex_
+    void writeBuffers(bool flushFile);         // caller holds outputMutex_
+
+    // Configuration
+    std::atomic<LogLevel> currentLevel_;
+    std::atomic<bool> async_;
+    std::atomic<OverflowPolicy> overflowPolicy_;
+    std::atomic<FlushPolicy> flushPolicy_;
+    std::atomic<int64_t> flushIntervalMs_;
     bool consoleOutput_;
     bool fileOutput_;
     std::ofstream logFile_;
+    std::ofstream binaryFile_;
+
+    // Queue, producers only touch enqueuePos_ and their cell
+    std::unique_ptr<Cell[]> cells_;
+    size_t capacity_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> enqueuePos_;
+    alignas(64) size_t dequeuePos_;
+    std::atomic<size_t> written_;
+    std::atomic<uint64_t> dropped_;
+    uint64_t droppedReported_;
+
+    // Writer thread
+    std::once_flag startOnce_;
+    std::atomic<bool> started_;
+    std::atomic<bool> stop_;
+    std::atomic<bool> writerSleeping_;
+    std::thread writer_;
+    std::mutex wakeMutex_;
+    std::condition_variable wakeCv_;
+    std::mutex flushMutex_;
+    std::condition_variable flushCv_;
+    std::chrono::steady_clock::time_point lastFlush_;
+
+    // Output, guarded by outputMutex_ (writer thread, sync mode and configuration changes)
+    std::mutex outputMutex_;
+    fmt::memory_buffer message_;
+    fmt::memory_buffer consoleBuffer_;
+    fmt::memory_buffer fileBuffer_;
+    fmt::memory_buffer binaryBuffer_;
+    bool fileDirty_;
+
+    // Binary call site ids, only touched with outputMutex_ held
+    struct SiteKey
+    {
+        const char* format;
+        const char* fileName;
+        int lineNumber;
+        LogLevel level;
+        bool operator==(const SiteKey&) const = default;
+    };
+    struct SiteKeyHash
+    {
+        size_t operator()(const SiteKey& key) const
+        {
+            size_t hash = std::hash<const void*>()(key.format);
+            hash = hash * 31 + std::hash<const void*>()(key.fileName);
+            return hash * 31 + static_cast<size_t>(key.lineNumber) * 8 + static_cast<size_t>(key.level);
+        }
+    };
+    std::unordered_map<SiteKey, uint32_t, SiteKeyHash> siteIds_;
 };
 
-static inline Logger logger;
-
-// Macros for logging
-#define LOG_DEBUG(message) logger.debug(message, __LINE__, __FILE__)
-#define LOG_INFO(message) logger.info(message, __LINE__, __FILE__)
-#define LOG_WARNING(message) logger.warning(message, __LINE__, __FILE__)
-#define LOG_ERROR(message) logger.error(message, __LINE__, __FILE__)
-#define LOG_FATAL(message) logger.fatal(message, __LINE__, __FILE__)
-
-// With formatting using fmt
-#define LOG_DEBUG_FMT(fmt_str, ...) logger.debug(::fmt::format(fmt_str, __VA_ARGS__), __LINE__, __FILE__)
-#define LOG_INFO_FMT(fmt_str, ...) logger.info(::fmt::format(fmt_str, __VA_ARGS__), __LINE__, __FILE__)
-#define LOG_WARNING_FMT(fmt_str, ...) logger.warning(::fmt::format(fmt_str, __VA_ARGS__), __LINE__, __FILE__)
-#define LOG_ERROR_FMT(fmt_str, ...) logger.error(::fmt::format(fmt_str, __VA_ARGS__), __LINE__, __FILE__)
-#define LOG_FATAL_FMT(fmt_str, ...) logger.fatal(::fmt::format(fmt_str, __VA_ARGS__), __LINE__, __FILE__)
+template <typename T>
+void Logger::encodeArg(Record& record, const T& value)
+{
+    using U = std::decay_t<T>;
+    int index = record.argCount++;
+    uint64_t& raw = record.values[index];
+    ArgType& type = record.types[index];
+
+    if constexpr (std::is_same_v<U, bool>)
+    {
+        type = ArgType::Bool;
+        raw = value ? 1 : 0;
+    }
+    else if constexpr (std::is_same_v<U, char>)
+    {
+        type = ArgType::Char;
+        raw = static_cast<unsigned char>(value);
+    }
+    else if constexpr (std::is_same_v<U, float>)
+    {
+        type = ArgType::Float;
+        raw = std::bit_cast<uint32_t>(value);
+    }
+    else if constexpr (std::is_same_v<U, double>)
+    {
+        type = ArgType::Double;
+        raw = std::bit_cast<uint64_t>(value);
+    }
+    else if constexpr (std::is_integral_v<U> && std::is_signed_v<U>)
+    {
+        type = ArgType::Int;
+        raw = static_cast<uint64_t>(static_cast<int64_t>(value));
+    }
+    else if constexpr (std::is_integral_v<U>)
+    {
+        type = ArgType::Uint;
+        raw = static_cast<uint64_t>(value);
+    }
+    else if constexpr (std::is_convertible_v<const U&, std::string_view>)
+    {
+        copyText(record, index, std::string_view(value));
+    }
+    else
+    {
+        type = ArgType::Pointer;
+        raw = reinterpret_cast<uintptr_t>(static_cast<const void*>(value));
+    }
+}
+
+template <typename Fill>
+void Logger::submit(Origin origin, LogLevel level, int lineNumber, const char* fileName, fmt::string_view format, Fill&& fill)
+{
+    auto build = [&](Record& record) {
+        record.format = format.data();
+        record.formatSize = static_cast<uint32_t>(format.size());
+        record.fileName = fileName;
+        record.cycle = origin.cycle;
+        record.stateMachine = static_cast<int16_t>(origin.stateMachine);
+        record.lineNumber = lineNumber;
+        record.level = level;
+        record.textUsed = 0;
+        record.argCount = 0;
+        fill(record);
+    };
+
+    if (async_.load(std::memory_order_relaxed) && !stop_.load(std::memory_order_relaxed))
+    {
+        size_t position = claim();
+        if (position != SIZE_MAX)
+        {
+            build(cells_[position & mask_].record);
+            publish(position);
+        }
+        if (level == LogLevel::LEVEL_FATAL)
+            flush(); // make sure it is on disk before whatever comes next
+        return;
+    }
+
+    Record record;
+    build(record);
+    writeDirect(record);
+}
+
+template <typename... Args>
+void Logger::logFormat(Origin origin, LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args)
+{
+    if (level < currentLevel_.load(std::memory_order_relaxed))
+        return;
+
+    if constexpr (sizeof...(Args) <= Record::kMaxArgs && (isDeferrable<Args>() && ...))
+    {
+        submit(origin, level, lineNumber, fileName, format, [&](Record& record) { (encodeArg(record, args), ...); });
+    }
+    else
+    {
+        std::string message = fmt::format(format, std::forward<Args>(args)...);
+        submit(origin, level, lineNumber, fileName, "{}", [&](Record& record) { encodeArg(record, message); });
+    }
+}
+
+inline Logger logger; // one instance for the whole program
+
+// Target of the LOG_* macros outside of classes with their own context (see LogContext)
+template <typename... Args>
+void emitLog(Logger::LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args)
+{
+    logger.logFormat(level, lineNumber, fileName, format, std::forward<Args>(args)...);
+}
+
+// Macros for logging, they call 'emitLog' unqualified so a class can route its own messages
+#define LOG_DEBUG(message) emitLog(Logger::LogLevel::LEVEL_DEBUG, __LINE__, __FILE__, "{}", message)
+#define LOG_INFO(message) emitLog(Logger::LogLevel::LEVEL_INFO, __LINE__, __FILE__, "{}", message)
+#define LOG_WARNING(message) emitLog(Logger::LogLevel::LEVEL_WARNING, __LINE__, __FILE__, "{}", message)
+#define LOG_ERROR(message) emitLog(Logger::LogLevel::LEVEL_ERROR, __LINE__, __FILE__, "{}", message)
+#define LOG_FATAL(message) emitLog(Logger::LogLevel::LEVEL_FATAL, __LINE__, __FILE__, "{}", message)
+
+// With formatting using fmt, formatted on the writer thread
+#define LOG_DEBUG_FMT(fmt_str, ...) emitLog(Logger::LogLevel::LEVEL_DEBUG, __LINE__, __FILE__, fmt_str, __VA_ARGS__)
+#define LOG_INFO_FMT(fmt_str, ...) emitLog(Logger::LogLevel::LEVEL_INFO, __LINE__, __FILE__, fmt_str, __VA_ARGS__)
+#define LOG_WARNING_FMT(fmt_str, ...) emitLog(Logger::LogLevel::LEVEL_WARNING, __LINE__, __FILE__, fmt_str, __VA_ARGS__)
+#define LOG_ERROR_FMT(fmt_str, ...) emitLog(Logger::LogLevel::LEVEL_ERROR, __LINE__, __FILE__, fmt_str, __VA_ARGS__)
+#define LOG_FATAL_FMT(fmt_str, ...) emitLog(Logger::LogLevel::LEVEL_FATAL, __LINE__, __FILE__, fmt_str, __VA_ARGS__)
@@ -0,0 +1,177 @@
+#pragma once
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <cstring>
+
+// BMI2 (pext/pdep) is used when the compiler targets it, otherwise the multiply tricks below
+#if defined(__BMI2__) || (defined(_MSC_VER) && defined(__AVX2__))
+#include <immintrin.h>
+#define PIO_BITOPS_HAS_BMI2 1
+#endif
+
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_bitreverse32)
+#define PIO_BITOPS_HAS_BITREVERSE 1
+#endif
+#endif
+
+namespace PioBitOps {
+
+    namespace detail {
+        constexpr std::array<uint32_t, 33> makeLowMasks()
+        {
+            std::array<uint32_t, 33> masks{};
+            for (uint32_t count = 0; count < 32; count++)
+                masks[count] = (1u << count) - 1;
+            masks[32] = 0xff'ff'ff'ff;
+            return masks;
+        }
+
+        constexpr std::array<uint8_t, 256> makeReversedBytes()
+        {
+            std::array<uint8_t, 256> table{};
+            for (uint32_t value = 0; value < 256; value++)
+            {
+                uint32_t reversed = 0;
+                for (int bit = 0; bit < 8; bit++)
+                    reversed |= ((value >> bit) & 1) << (7 - bit);
+                table[value] = static_cast<uint8_t>(reversed);
+            }
+            return table;
+        }
+    } // namespace detail
+
+    inline constexpr std::array<uint32_t, 33> kLowMasks = detail::makeLowMasks();
+    inline constexpr std::array<uint8_t, 256> kReversedBytes = detail::makeReversedBytes();
+
+    // Mask with the 'count' low bits set, count >= 32 gives all ones
+    constexpr uint32_t lowMask(uint32_t count)
+    {
+        return kLowMasks[count < 32 ? count : 32];
+    }
+
+    // Shifts that are defined for a count of 32 (plain '<<'/'>>' by 32 is UB on a 32-bit value)
+    constexpr uint32_t shiftLeft(uint32_t value, uint32_t count)
+    {
+        return count >= 32 ? 0 : value << count;
+    }
+
+    constexpr uint32_t shiftRight(uint32_t value, uint32_t count)
+    {
+        return count >= 32 ? 0 : value >> count;
+    }
+
+    // Reverse the bit order of a 32-bit word (bit 0 <-> bit 31)
+    constexpr uint32_t bitReverse(uint32_t value)
+    {
+#ifdef PIO_BITOPS_HAS_BITREVERSE
+        return __builtin_bitreverse32(value);
+#else
+        return (static_cast<uint32_t>(kReversedBytes[value & 0xff]) << 24)
+            | (static_cast<uint32_t>(kReversedBytes[(value >> 8) & 0xff]) << 16)
+            | (static_cast<uint32_t>(kReversedBytes[(value >> 16) & 0xff]) << 8)
+            | static_cast<uint32_t>(kReversedBytes[value >> 24]);
+#endif
+    }
+
+    // Shift 'count' (1..32) low bits of 'data' into a shift register, ISR style:
+    // shifting left puts the new bits at the lsb end, shifting right at the msb end
+    constexpr uint32_t shiftIn(uint32_t reg, uint32_t data, uint32_t count, bool right)
+    {
+        data &= lowMask(count);
+        if (right)
+            return shiftRight(reg, count) | shiftLeft(data, 32 - count);
+        return shiftLeft(reg, count) | data;
+    }
+
+    // Take 'count' (0..32) bits out of a shift register, OSR style, returned in the low bits:
+    // shifting right takes them from the lsb end, shifting left from the msb end
+    constexpr uint32_t shiftOut(uint32_t& reg, uint32_t count, bool right)
+    {
+        uint32_t data;
+        if (right)
+        {
+            data = reg & lowMask(count);
+            reg = shiftRight(reg, count);
+        }
+        else
+        {
+            data = shiftRight(reg, 32 - count) & lowMask(count);
+            reg = shiftLeft(reg, count);
+        }
+        return data;
+    }
+
+    // Pack bit 0 of 8 pin bytes (little endian in 'bytes') into the low 8 bits
+    inline uint32_t packByteLanes(uint64_t bytes)
+    {
+#ifdef PIO_BITOPS_HAS_BMI2
+        return static_cast<uint32_t>(_pext_u64(bytes, 0x01'01'01'01'01'01'01'01ull));
+#else
+        // Every lane's bit 0 is moved to the top byte by the multiply, lane k ends up at bit 56 + k
+        return static_cast<uint32_t>(((bytes & 0x01'01'01'01'01'01'01'01ull) * 0x01'02'04'08'10'20'40'80ull) >> 56);
+#endif
+    }
+
+    // Spread the low 8 bits of 'bits' into 8 pin bytes of 0/1 (little endian)
+    inline uint64_t spreadByteLanes(uint32_t bits)
+    {
+#ifdef PIO_BITOPS_HAS_BMI2
+        return _pdep_u64(bits, 0x01'01'01'01'01'01'01'01ull);
+#else
+        // Broadcast to every lane, keep bit k in lane k, then turn "lane != 0" into 1
+        uint64_t lanes = ((bits & 0xffull) * 0x01'01'01'01'01'01'01'01ull) & 0x80'40'20'10'08'04'02'01ull;
+        return ((lanes + 0x7f'7f'7f'7f'7f'7f'7f'7full) >> 7) & 0x01'01'01'01'01'01'01'01ull;
+#endif
+    }
+
+    // Pin array (one int8_t per pin, 0/1) to a 32-bit word, pin N is bit N
+    inline uint32_t gatherPins(const std::array<int8_t, 32>& pins)
+    {
+        uint32_t word = 0;
+        if constexpr (std::endian::native == std::endian::little)
+        {
+            for (int lane = 0; lane < 4; lane++)
+            {
+                uint64_t bytes;
+                std::memcpy(&bytes, pins.data() + lane * 8, sizeof(bytes));
+                word |= packByteLanes(bytes) << (lane * 8);
+            }
+        }
+        else
+        {
+            for (int i = 0; i < 32; i++)
+                word |= static_cast<uint32_t>(pins[i] & 1) << i;
+        }
+        return word;
+    }
+
+    // Write bit N of 'values' to pins[N] for every bit N set in 'mask', other pins are left untouched
+    inline void scatterPins(std::array<int8_t, 32>& pins, uint32_t mask, uint32_t values)
+    {
+        for (int lane = 0; lane < 4; lane++)
+        {
+            uint32_t laneMask = (mask >> (lane * 8)) & 0xff;
+            if (laneMask == 0)
+                continue;
+
+            uint32_t laneValues = (values >> (lane * 8)) & 0xff;
+            if (laneMask == 0xff && std::endian::native == std::endian::little)
+            {
+                // Whole lane written, one 64-bit store
+                uint64_t bytes = spreadByteLanes(laneValues);
+                std::memcpy(pins.data() + lane * 8, &bytes, sizeof(bytes));
+                continue;
+            }
+
+            while (laneMask)
+            {
+                int bit = std::countr_zero(laneMask);
+                pins[lane * 8 + bit] = static_cast<int8_t>((laneValues >> bit) & 1);
+                laneMask &= laneMask - 1;
+            }
+        }
+    }
+
+} // namespace PioBitOps
@@ -0,0 +1,138 @@
+#include "PioBlock.h"
+#include <algorithm>
+#include <bit>
+#include "PioBreakpoints.h"
+
+namespace {
+    bool hasBreakpoints(const PioStateMachine& machine)
+    {
+        return machine.breakpoints != nullptr && !machine.breakpoints->empty();
+    }
+
+    // System clocks until just before the divider fires for the (ticks + 1)th time
+    uint64_t systemCyclesBefore(const PioStateMachine& machine, uint64_t ticks)
+    {
+        uint64_t fires_at = (ticks + 1) * machine.clkdivDivisor() - machine.clkdiv_accumulator; // in 1/256ths
+        return (fires_at + 255) / 256 - 1;
+    }
+
+    // Up to sm_cycles of the machine's own clocks through run(), returns how many it ran
+    uint64_t runMachine(PioStateMachine& machine, uint64_t sm_cycles)
+    {
+        uint64_t done = 0;
+        while (done < sm_cycles)
+        {
+            int chunk = static_cast<int>(std::min<uint64_t>(sm_cycles - done, 1u << 30));
+            int ran = machine.run(chunk);
+            done += static_cast<uint64_t>(ran);
+            if (ran < chunk)
+                break;
+        }
+        return done;
+    }
+}
+
+PioBlock::PioBlock()
+{
+    for (int i = 0; i < 4; i++)
+        sm[i].stateMachineNumber = static_cast<uint16_t>(i);
+}
+
+void PioBlock::setEnabled(int sm_number, bool enable)
+{
+    if (sm_number < 0 || sm_number >= 4)
+    {
+        LOG_ERROR_FMT("Invalid state machine number {}", sm_number);
+        return;
+    }
+
+    if (enable)
+        enabled_mask |= 1u << sm_number;
+    else
+        enabled_mask &= ~(1u << sm_number);
+}
+
+bool PioBlock::isEnabled(int sm_number) const
+{
+    return sm_number >= 0 && sm_number < 4 && ((enabled_mask >> sm_number) & 1);
+}
+
+double PioBlock::elapsedSeconds() const
+{
+    return static_cast<double>(system_clock) / system_clock_hz;
+}
+
+bool PioBlock::tick()
+{
+    // Only visit enabled state machines, disabled ones cost nothing. Breakpoints before the cycle
+    // are all checked before any state machine moves, so a stop keeps them at one system clock.
+    for (uint32_t mask = enabled_mask; mask; mask &= mask - 1)
+    {
+        PioStateMachine& machine = sm[std::countr_zero(mask)];
+        if (hasBreakpoints(machine) && systemCyclesBefore(machine, 0) == 0 && machine.breakpoints->beforeCycle(machine))
+            return false;
+    }
+
+    bool hit = false;
+    for (uint32_t mask = enabled_mask; mask; mask &= mask - 1)
+    {
+        PioStateMachine& machine = sm[std::countr_zero(mask)];
+        if (machine.systemTick() && hasBreakpoints(machine) && machine.breakpoints->afterCycle(machine))
+            hit = true;
+    }
+    system_clock++;
+    return !hit;
+}
+
+uint64_t PioBlock::run(uint64_t system_cycles)
+{
+    // The state machines don't share any state (each has its own GPIO and IRQ copy), so each one
+    // can be forwarded by however many of its own clocks fit into system_cycles in one go. The
+    // clock limit is known up front. A breakpoint isn't: a state machine with some runs first and
+    // the others only go as far as it got. Several of them can only be kept together by tick().
+    PioStateMachine* stoppable = nullptr;
+    int with_breakpoints = 0;
+    for (uint32_t mask = enabled_mask; mask; mask &= mask - 1)
+    {
+        PioStateMachine& machine = sm[std::countr_zero(mask)];
+        uint64_t clocks_left = static_cast<uint64_t>(PioStateMachine::kMaxClock - machine.clock);
+        system_cycles = std::min(system_cycles, systemCyclesBefore(machine, clocks_left));
+        if (hasBreakpoints(machine))
+        {
+            stoppable = &machine;
+            with_breakpoints++;
+        }
+    }
+
+    if (with_breakpoints > 1)
+    {
+        const uint64_t start_clock = system_clock;
+        while (system_clock - start_clock < system_cycles && tick())
+        {
+        }
+        return system_clock - start_clock;
+    }
+
+    if (stoppable)
+    {
+        const uint32_t accumulator = stoppable->clkdiv_accumulator;
+        uint64_t sm_cycles = stoppable->systemTicksToSmTicks(system_cycles);
+        uint64_t ran = runMachine(*stoppable, sm_cycles);
+        if (ran < sm_cycles)
+        {
+            // Stopped: the block ends just before the system clock its next cycle would start at
+            stoppable->clkdiv_accumulator = accumulator;
+            system_cycles = systemCyclesBefore(*stoppable, ran);
+            stoppable->systemTicksToSmTicks(system_cycles);
+        }
+    }
+
+    for (uint32_t mask = enabled_mask; mask; mask &= mask - 1)
+    {
+        PioStateMachine& machine = sm[std::countr_zero(mask)];
+        if (&machine != stoppable)
+            runMachine(machine, machine.systemTicksToSmTicks(system_cycles));
+    }
+    system_clock += system_cycles;
+    return system_cycles;
+}
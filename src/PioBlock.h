@@ -0,0 +1,32 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "PioStateMachine.h"
+
+// A PIO block: four state machines driven by one system clock, each through its own
+// clock divider (settings.clkdiv_int / clkdiv_frac). Each state machine still has its own GPIO
+// and IRQ copy, so state machines of one block can't see each other's pins or IRQ flags.
+class PioBlock
+{
+public:
+    PioBlock();
+    PioBlock(const PioBlock&) = delete;
+    PioBlock& operator=(const PioBlock&) = delete;
+
+    // Forward one system clock, false when a breakpoint stopped it. A stop before the cycle leaves
+    // every state machine and system_clock where they were.
+    bool tick();
+    // Forward system clocks, state machines use their run() fast path. Returns the system clocks
+    // run: fewer when a breakpoint or the clock limit (PioStateMachine::kMaxClock) stopped a state
+    // machine, the others are stopped at the same system clock.
+    uint64_t run(uint64_t system_cycles);
+
+    void setEnabled(int sm_number, bool enable);
+    bool isEnabled(int sm_number) const;
+    double elapsedSeconds() const; // system_clock in wall-clock time at system_clock_hz
+
+    std::array<PioStateMachine, 4> sm;
+    uint8_t enabled_mask = 0;        // CTRL.SM_ENABLE, bit n enables sm[n]
+    uint64_t system_clock = 0;
+    double system_clock_hz = 125'000'000.0;
+};
@@ -0,0 +1,121 @@
+#include "PioBreakpoints.h"
+#include <fmt/format.h>
+
+void PioBreakpoints::setPc(int address, bool enabled)
+{
+    uint32_t bit = 1u << (address & 31);
+    pc_mask_ = enabled ? (pc_mask_ | bit) : (pc_mask_ & ~bit);
+}
+
+int PioBreakpoints::addCondition(const PioStateMachine& pio, const std::string& text)
+{
+    conditions_.push_back(Condition{ next_id_, PioExpression::compile(pio, text) });
+    return next_id_++;
+}
+
+int PioBreakpoints::addWatch(const PioStateMachine& pio, const std::string& expression)
+{
+    watches_.push_back(Watch{ next_id_, PioExpression::compile(pio, expression) });
+    return next_id_++;
+}
+
+bool PioBreakpoints::remove(int id)
+{
+    auto has_id = [id](const auto& entry) { return entry.id == id; };
+    return std::erase_if(conditions_, has_id) + std::erase_if(watches_, has_id) > 0;
+}
+
+void PioBreakpoints::clear()
+{
+    pc_mask_ = 0;
+    conditions_.clear();
+    watches_.clear();
+    hit_ = Hit();
+}
+
+std::vector<PioBreakpoints::Entry> PioBreakpoints::entries() const
+{
+    std::vector<Entry> list;
+    for (const Condition& condition : conditions_)
+        list.push_back({ condition.id, Kind::Condition, condition.expression.text() });
+    for (const Watch& watch : watches_)
+        list.push_back({ watch.id, Kind::Watch, watch.expression.text() });
+    return list;
+}
+
+bool PioBreakpoints::beforeCycle(const PioStateMachine& pio)
+{
+    // Watches read once per clock: after a cycle, or here when they haven't been yet
+    for (Watch& watch : watches_)
+    {
+        if (watch.clock != pio.clock)
+        {
+            watch.value = watch.expression.evaluate(pio);
+            watch.clock = pio.clock;
+        }
+    }
+
+    // Every condition is evaluated, so the edges and counters of all of them see every cycle
+    Hit found;
+    for (Condition& condition : conditions_)
+    {
+        if (condition.expression.test(pio) && found.kind == Kind::None)
+            found = Hit{ Kind::Condition, condition.id, pio.clock };
+    }
+
+    // s3.4.2: an instruction is fetched once the previous one's delay is over and nothing stalls
+    bool fetches = !pio.delay_delay && pio.regs.delay == 0 && !pio.exec_command;
+    if (fetches && hasPc(pio.regs.pc))
+        found = Hit{ Kind::Pc, static_cast<int>(pio.regs.pc), pio.clock };
+
+    if (found.kind == Kind::None || pio.clock == skip_clock_)
+        return false;
+
+    hit_ = found;
+    skip_clock_ = pio.clock; // continuing from here runs this cycle
+    return true;
+}
+
+bool PioBreakpoints::afterCycle(const PioStateMachine& pio)
+{
+    bool stop = false;
+    for (Watch& watch : watches_)
+    {
+        uint32_t value = watch.expression.evaluate(pio);
+        if (value != watch.value && !stop)
+        {
+            hit_ = Hit{ Kind::Watch, watch.id, pio.clock, watch.value, value };
+            stop = true;
+        }
+        watch.value = value;
+        watch.clock = pio.clock;
+    }
+    return stop;
+}
+
+const std::string* PioBreakpoints::textOf(int id) const
+{
+    for (const Condition& condition : conditions_)
+        if (condition.id == id)
+            return &condition.expression.text();
+    for (const Watch& watch : watches_)
+        if (watch.id == id)
+            return &watch.expression.text();
+    return nullptr;
+}
+
+std::string PioBreakpoints::describe(const Hit& hit) const
+{
+    const std::string* text = textOf(hit.id);
+    switch (hit.kind)
+    {
+    case Kind::Pc:
+        return fmt::format("pc {}", hit.id);
+    case Kind::Condition:
+        return text ? *text : fmt::format("condition {}", hit.id);
+    case Kind::Watch:
+        return fmt::format("{}: {} -> {}", text ? *text : fmt::format("watch {}", hit.id), hit.old_value, hit.new_value);
+    default:
+        return "";
+    }
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioExpression.h"
+#include "PioStateMachine.h"
+
+// Breakpoint engine for PioStateMachine::run() / step(), attach with pio.breakpoints = &engine.
+//
+// - PC breakpoints: a 32-bit mask, hit before a cycle that fetches the instruction at one of the
+//   addresses (delay and stall cycles don't fetch). PC-only engines keep run()'s fast paths.
+// - Conditions: a PioExpression ("x == 0 && rise(gpio22)"), hit before the cycle it is true at.
+// - Watchpoints: a PioExpression, usually a single variable (register, FIFO count, IRQ flag,
+//   gpioN...), hit after a cycle that changed its value.
+// Conditions and watchpoints need every cycle, run() goes through tick() while there are any.
+// A stop before a cycle is not repeated when running again from the same clock.
+class PioBreakpoints
+{
+public:
+    enum class Kind
+    {
+        None,
+        Pc,
+        Condition,
+        Watch
+    };
+
+    struct Hit
+    {
+        Kind kind = Kind::None;
+        int id = -1;            // the address for Pc, the id from addCondition()/addWatch() otherwise
+        int clock = 0;
+        uint32_t old_value = 0; // Watch
+        uint32_t new_value = 0;
+    };
+
+    void setPc(int address, bool enabled = true);
+    bool hasPc(int address) const { return (pc_mask_ >> (address & 31)) & 1; }
+    uint32_t pcMask() const { return pc_mask_; }
+    void clearPc() { pc_mask_ = 0; }
+
+    // Both compile through PioExpression (throwing its std::runtime_error), return the new id
+    int addCondition(const PioStateMachine& pio, const std::string& text);
+    int addWatch(const PioStateMachine& pio, const std::string& expression);
+    bool remove(int id);
+    void clear();
+
+    bool empty() const { return pc_mask_ == 0 && conditions_.empty() && watches_.empty(); }
+    bool needsEveryCycle() const { return !conditions_.empty() || !watches_.empty(); }
+
+    struct Entry
+    {
+        int id;
+        Kind kind;
+        std::string text;
+    };
+    std::vector<Entry> entries() const; // conditions and watchpoints, for listing
+
+    // Called around every cycle by PioStateMachine::step() and PioBlock::tick(), true to stop
+    bool beforeCycle(const PioStateMachine& pio);
+    bool afterCycle(const PioStateMachine& pio);
+
+    void skipAt(int clock) { skip_clock_ = clock; } // don't stop before the cycle at this clock
+    const Hit& hit() const { return hit_; }
+    void clearHit() { hit_ = Hit(); }
+    std::string describe(const Hit& hit) const; // "pc 3", "x == 0", "x: 5 -> 4"
+
+private:
+    struct Condition
+    {
+        int id;
+        PioExpression expression;
+    };
+
+    struct Watch
+    {
+        int id;
+        PioExpression expression;
+        uint32_t value = 0;
+        int clock = -1; // clock 'value' was read at
+    };
+
+    const std::string* textOf(int id) const;
+
+    uint32_t pc_mask_ = 0;
+    std::vector<Condition> conditions_;
+    std::vector<Watch> watches_;
+    int next_id_ = 1;
+
+    int skip_clock_ = -1;
+    Hit hit_;
+};
@@ -0,0 +1,611 @@
+#include "PioDebugger.h"
+#include <fmt/format.h>
+#include <algorithm>
+#include <charconv>
+#include <stdexcept>
+#include "PioBitOps.h"
+#include "PioDisassembler.h"
+#include "PioExpression.h"
+#include "PioProfiler.h"
+#include "PioText.h"
+
+namespace {
+
+    uint64_t parseCount(std::string_view text)
+    {
+        int64_t count = PioText::parseNumber(text);
+        if (count <= 0)
+            throw std::invalid_argument(fmt::format("not a cycle count: {}", text));
+        return static_cast<uint64_t>(count);
+    }
+
+    std::string bits(const std::array<int8_t, 32>& values, char unset = '-')
+    {
+        // gpio31 first, in groups of 4
+        std::string text;
+        for (int pin = 31; pin >= 0; pin--)
+        {
+            text += values[pin] < 0 ? unset : static_cast<char>('0' + values[pin]);
+            if (pin % 4 == 0 && pin > 0)
+                text += ' ';
+        }
+        return text;
+    }
+
+} // namespace
+
+// Looked up by execute() in order, a name or its alias
+const PioDebugger::Command PioDebugger::kCommands[] = {
+    { "step", "s", &PioDebugger::cmdStep, "step [N]", "run N clocks (1)" },
+    { "next", "n", &PioDebugger::cmdNext, "next", "run to the next instruction fetch, over delay and stall cycles" },
+    { "continue", "c", &PioDebugger::cmdContinue, "continue [N]", "run until a breakpoint, N clocks or Ctrl-C" },
+    { "break", "b", &PioDebugger::cmdBreak, "break [PC]", "stop before fetching from PC; no PC: list the breakpoints" },
+    { "when", nullptr, &PioDebugger::cmdWhen, "when EXPR", "stop before a clock EXPR is true at, e.g. when x == 0 && rise(gpio3)" },
+    { "watch", "w", &PioDebugger::cmdWatch, "watch EXPR", "stop after a clock that changes EXPR, e.g. watch rx_fifo_count" },
+    { "delete", "d", &PioDebugger::cmdDelete, "delete ID | pc PC | all", "remove a condition or watch, a PC breakpoint, or everything" },
+    { "info", "i", &PioDebugger::cmdInfo, "info", "where the machine is, breakpoints and checkpoints" },
+    { "regs", "r", &PioDebugger::cmdRegs, "regs", "registers, shift counts, IRQ flags" },
+    { "fifo", "f", &PioDebugger::cmdFifo, "fifo", "TX and RX FIFO contents, oldest first" },
+    { "pins", nullptr, &PioDebugger::cmdPins, "pins", "levels, directions and external drive of every pin" },
+    { "wave", nullptr, &PioDebugger::cmdWave, "wave [PINS [N]]", "the last N clocks (64) of PINS (\"0-3,22\", default the outputs)" },
+    { "disas", "x", &PioDebugger::cmdDisas, "disas [FROM [COUNT]]", "instruction memory, => marks pc, * a breakpoint" },
+    { "print", "p", &PioDebugger::cmdPrint, "print EXPR", "evaluate an expression (see PioExpression)" },
+    { "set", nullptr, &PioDebugger::cmdSet, "set NAME VALUE", "write a variable (pc, x, gpio3...) or an .ini setting (out_base...)" },
+    { "drive", nullptr, &PioDebugger::cmdDrive, "drive PIN 0|1|z", "drive a pin from outside, z releases it" },
+    { "push", nullptr, &PioDebugger::cmdPush, "push WORD", "put a word in the TX FIFO" },
+    { "pop", nullptr, &PioDebugger::cmdPop, "pop", "take a word from the RX FIFO" },
+    { "checkpoint", "cp", &PioDebugger::cmdCheckpoint, "checkpoint [NAME]", "save the machine under NAME" },
+    { "rewind", "rw", &PioDebugger::cmdRewind, "rewind [NAME]", "back to a checkpoint; no NAME: undo the last run or reset" },
+    { "reset", nullptr, &PioDebugger::cmdReset, "reset", "back to the machine as it was loaded" },
+    { "help", "h", &PioDebugger::cmdHelp, "help", "this list" },
+    { "quit", "q", nullptr, "quit", "leave" },
+};
+
+PioDebugger::PioDebugger(PioStateMachine& pio) :
+    pio_(pio),
+    worker_(pio)
+{
+    initial_.capture(pio_);
+    worker_.record_pins = false; // the pin listener sees every change, run() keeps its fast paths
+    pio_.pin_listeners.push_back(&pins_);
+    restartPinHistory();
+}
+
+PioDebugger::~PioDebugger()
+{
+    worker_.cancel();
+    std::erase(pio_.pin_listeners, &pins_);
+}
+
+bool PioDebugger::execute(std::string_view line, std::string& out)
+{
+    if (worker_.busy())
+    {
+        out += "running, interrupt it first\n";
+        return true;
+    }
+    finish(out); // a run nobody reported
+
+    std::string text(line);
+    if (text.find_first_not_of(" \t\r\n") == std::string::npos)
+        text = last_run_line_;
+
+    Line parsed;
+    size_t pos = 0;
+    while ((pos = text.find_first_not_of(" \t\r\n", pos)) != std::string::npos)
+    {
+        size_t end = text.find_first_of(" \t\r\n", pos);
+        if (end == std::string::npos)
+            end = text.size();
+        parsed.args.emplace_back(text.data() + pos, end - pos);
+        if (parsed.args.size() == 1)
+        {
+            size_t rest = text.find_first_not_of(" \t\r\n", end);
+            if (rest != std::string::npos)
+                parsed.rest = std::string_view(text).substr(rest, text.find_last_not_of(" \t\r\n") + 1 - rest);
+        }
+        pos = end;
+    }
+    if (parsed.args.empty())
+        return true;
+
+    const std::string_view name = parsed.args[0];
+    const Command* command = std::find_if(std::begin(kCommands), std::end(kCommands), [name](const Command& c) {
+        return name == c.name || (c.alias && name == c.alias);
+    });
+    if (command == std::end(kCommands))
+    {
+        out += fmt::format("unknown command '{}', try help\n", name);
+        return true;
+    }
+    if (!command->handler)
+        return false; // quit
+
+    try
+    {
+        (this->*command->handler)(parsed, out);
+    }
+    catch (const std::exception& e)
+    {
+        out += fmt::format("error: {}\n", e.what());
+    }
+    if (run_kind_ != RunKind::None)
+        last_run_line_ = text;
+    return true;
+}
+
+void PioDebugger::finish(std::string& out)
+{
+    if (run_kind_ == RunKind::None || worker_.busy())
+        return;
+    const RunKind kind = run_kind_;
+    run_kind_ = RunKind::None;
+    worker_.wait(); // Idle shows before the last frame is out
+
+    const PioWorker::Frame& frame = worker_.latest();
+    switch (frame.stop_reason)
+    {
+    case PioWorker::StopReason::Breakpoint:
+        // next stops on a PC breakpoint at every address, only the user's count
+        if (kind != RunKind::Next || breakpoints_.hasPc(pio_.regs.pc))
+            out += fmt::format("breakpoint {} after {} clocks\n", frame.stop_detail, frame.job_cycles);
+        break;
+    case PioWorker::StopReason::Condition:
+        out += fmt::format("condition {} after {} clocks\n", frame.stop_detail, frame.job_cycles);
+        break;
+    case PioWorker::StopReason::Watchpoint:
+        out += fmt::format("watch {} after {} clocks\n", frame.stop_detail, frame.job_cycles);
+        break;
+    case PioWorker::StopReason::Cancelled:
+        out += fmt::format("interrupted after {} clocks\n", frame.job_cycles);
+        break;
+    case PioWorker::StopReason::ClockLimit:
+        out += fmt::format("the clock can't count past {}, stopped after {} clocks (rewind or reset to go on)\n",
+            PioStateMachine::kMaxClock, frame.job_cycles);
+        break;
+    case PioWorker::StopReason::Completed:
+        if (kind == RunKind::Continue)
+            out += fmt::format("ran {} clocks\n", frame.job_cycles);
+        break;
+    default:
+        break;
+    }
+    out += location() + "\n";
+}
+
+/* ----- Running ----- */
+
+void PioDebugger::cmdStep(const Line& line, std::string&)
+{
+    PioWorker::Job job;
+    job.max_cycles = line.args.size() > 1 ? parseCount(line.args[1]) : 1;
+    job.breakpoints = breakpoints_;
+    startRun(RunKind::Step, std::move(job));
+}
+
+void PioDebugger::cmdNext(const Line&, std::string&)
+{
+    // A PC breakpoint on every address: the first clock that fetches anything (the worker
+    // doesn't stop before its first clock, so the current instruction runs to its end first)
+    PioWorker::Job job;
+    job.max_cycles = PioWorker::kForever;
+    job.breakpoints = breakpoints_;
+    for (int address = 0; address < 32; address++)
+        job.breakpoints.setPc(address);
+    startRun(RunKind::Next, std::move(job));
+}
+
+void PioDebugger::cmdContinue(const Line& line, std::string&)
+{
+    PioWorker::Job job;
+    job.max_cycles = line.args.size() > 1 ? parseCount(line.args[1]) : PioWorker::kForever;
+    job.breakpoints = breakpoints_;
+    startRun(RunKind::Continue, std::move(job));
+}
+
+void PioDebugger::startRun(RunKind kind, PioWorker::Job job)
+{
+    saveUndo();
+    if (!worker_.start(job))
+        throw std::runtime_error("the machine is busy");
+    run_kind_ = kind;
+}
+
+void PioDebugger::saveUndo()
+{
+    if (undo_.size() >= kUndoDepth)
+        undo_.pop_front();
+    undo_.emplace_back().capture(pio_);
+}
+
+/* ----- Breakpoints ----- */
+
+void PioDebugger::cmdBreak(const Line& line, std::string& out)
+{
+    if (line.args.size() < 2)
+    {
+        cmdInfo(line, out);
+        return;
+    }
+    int64_t address = PioText::parseNumber(line.args[1]);
+    if (address < 0 || address > 31)
+        throw std::invalid_argument(fmt::format("no such address: {}", address));
+    breakpoints_.setPc(static_cast<int>(address));
+    out += fmt::format("breakpoint at pc {}: {}\n", address, instructionText(static_cast<int>(address)));
+}
+
+void PioDebugger::cmdWhen(const Line& line, std::string& out)
+{
+    if (line.rest.empty())
+        throw std::invalid_argument("when EXPR");
+    int id = breakpoints_.addCondition(pio_, std::string(line.rest));
+    out += fmt::format("{}: when {}\n", id, line.rest);
+}
+
+void PioDebugger::cmdWatch(const Line& line, std::string& out)
+{
+    if (line.rest.empty())
+        throw std::invalid_argument("watch EXPR");
+    int id = breakpoints_.addWatch(pio_, std::string(line.rest));
+    out += fmt::format("{}: watch {}\n", id, line.rest);
+}
+
+void PioDebugger::cmdDelete(const Line& line, std::string&)
+{
+    if (line.args.size() < 2)
+        throw std::invalid_argument("delete ID | pc PC | all");
+    if (line.args[1] == "all")
+    {
+        breakpoints_.clear();
+        breakpoints_.clearPc();
+        return;
+    }
+    if (line.args[1] == "pc")
+    {
+        if (line.args.size() < 3)
+            throw std::invalid_argument("delete pc PC");
+        int64_t address = PioText::parseNumber(line.args[2]);
+        if (address < 0 || address > 31 || !breakpoints_.hasPc(static_cast<int>(address)))
+            throw std::invalid_argument(fmt::format("no breakpoint at pc {}", line.args[2]));
+        breakpoints_.setPc(static_cast<int>(address), false);
+        return;
+    }
+    int64_t id = PioText::parseNumber(line.args[1]);
+    if (!breakpoints_.remove(static_cast<int>(id)))
+        throw std::invalid_argument(fmt::format("no condition or watch {}", id));
+}
+
+void PioDebugger::cmdInfo(const Line&, std::string& out)
+{
+    out += location() + "\n";
+
+    std::string pcs;
+    for (int address = 0; address < 32; address++)
+    {
+        if (breakpoints_.hasPc(address))
+            pcs += fmt::format("{}{}", pcs.empty() ? "" : ", ", address);
+    }
+    if (!pcs.empty())
+        out += fmt::format("break at pc {}\n", pcs);
+    for (const PioBreakpoints::Entry& entry : breakpoints_.entries())
+        out += fmt::format("{}: {} {}\n", entry.id, entry.kind == PioBreakpoints::Kind::Watch ? "watch" : "when", entry.text);
+    for (const auto& [name, snapshot] : checkpoints_)
+        out += fmt::format("checkpoint {} at clock {}\n", name, snapshot.clock);
+    if (!undo_.empty())
+        out += fmt::format("{} run{} to rewind\n", undo_.size(), undo_.size() == 1 ? "" : "s");
+}
+
+/* ----- State ----- */
+
+void PioDebugger::cmdRegs(const Line&, std::string& out)
+{
+    const auto& regs = pio_.regs;
+    out += location() + "\n";
+    out += fmt::format("x   0x{:08x}  y   0x{:08x}\n", regs.x, regs.y);
+    out += fmt::format("isr 0x{:08x}  {} bits shifted in\n", regs.isr, regs.isr_shift_count);
+    out += fmt::format("osr 0x{:08x}  {} bits shifted out\n", regs.osr, regs.osr_shift_count);
+    std::string irqs;
+    for (int irq = 7; irq >= 0; irq--)
+        irqs += pio_.irq_flags[irq] ? '1' : '0';
+    out += fmt::format("irq {} (7..0)  delay {}\n", irqs, regs.delay);
+}
+
+void PioDebugger::cmdFifo(const Line&, std::string& out)
+{
+    const auto& fifo = pio_.fifo;
+    out += fmt::format("tx {}/4:", fifo.tx_fifo_count);
+    for (int i = 0; i < fifo.tx_fifo_count; i++)
+        out += fmt::format(" 0x{:08x}", fifo.tx_fifo[i]);
+    out += fmt::format("\nrx {}/4:", fifo.rx_fifo_count);
+    for (int i = 0; i < fifo.rx_fifo_count; i++)
+        out += fmt::format(" 0x{:08x}", fifo.rx_fifo[i]);
+    out += "\n";
+    if (pio_.delay_delay && (fifo.pull_is_stalling || fifo.push_is_stalling))
+        out += stateText() + "\n";
+}
+
+void PioDebugger::cmdPins(const Line&, std::string& out)
+{
+    std::array<int8_t, 32> outputs;
+    for (int pin = 0; pin < 32; pin++)
+        outputs[pin] = pio_.gpio.pindirs[pin] == 0 ? 1 : 0; // pindirs: 0 is an output
+    out += fmt::format("gpio     {}\n", "31   27   23   19   15   11   7    3");
+    out += fmt::format("level    {}\n", bits(pio_.gpio.raw_data));
+    out += fmt::format("output   {}\n", bits(outputs));
+    out += fmt::format("external {}\n", bits(pio_.gpio.external_data));
+}
+
+void PioDebugger::cmdWave(const Line& line, std::string& out)
+{
+    std::vector<int> pins;
+    if (line.args.size() > 1)
+    {
+        pins = PioText::parsePins(line.args[1]);
+    }
+    else
+    {
+        for (int pin = 0; pin < 32 && pins.size() < 8; pin++)
+        {
+            if (pio_.gpio.pindirs[pin] == 0)
+                pins.push_back(pin);
+        }
+        if (pins.empty())
+            throw std::invalid_argument("no output pins, wave PINS");
+    }
+    const int64_t clocks = line.args.size() > 2 ? static_cast<int64_t>(parseCount(line.args[2])) : kWaveColumns;
+    const int64_t per_column = (clocks + kWaveColumns - 1) / kWaveColumns;
+    const int64_t to = pio_.clock;
+    if (to <= pins_.waveform.firstClock())
+    {
+        out += "nothing ran yet\n";
+        return;
+    }
+    // Not further back than the history goes
+    const int columns = static_cast<int>((std::min(clocks, to - pins_.waveform.firstClock()) + per_column - 1) / per_column);
+    const int64_t from = to - per_column * columns;
+
+    // Per column, the AND and OR of the pin words in effect during it (like the buckets)
+    PioWaveform::View view = pins_.waveform.view(std::max(from, pins_.waveform.firstClock()), to, static_cast<size_t>(columns) * 8);
+    std::vector<uint32_t> lows(columns, 0xffffffffu), highs(columns, 0);
+    std::vector<bool> known(columns, false);
+    size_t bucket = 0;
+    for (int column = 0; column < columns; column++)
+    {
+        int64_t start = from + column * per_column;
+        int64_t end = start + per_column;
+        while (bucket + 1 < view.buckets.size() && view.buckets[bucket + 1].clock <= start)
+            bucket++;
+        for (size_t b = bucket; b < view.buckets.size() && view.buckets[b].clock < end; b++)
+        {
+            int64_t bucket_end = b + 1 < view.buckets.size() ? view.buckets[b + 1].clock : to;
+            if (bucket_end <= start)
+                continue;
+            lows[column] &= view.buckets[b].min;
+            highs[column] |= view.buckets[b].max;
+            known[column] = true;
+        }
+    }
+
+    out += fmt::format("clock {} .. {}, {} clock{} a column\n", from, to, per_column, per_column == 1 ? "" : "s");
+    for (int pin : pins)
+    {
+        // Two rows of stairs: '_' on top is high, at the bottom low, '|' an edge, '#' a column
+        // it toggled in
+        std::string top(columns, ' '), bottom(columns, ' ');
+        char previous = 0; // 'H', 'L', or 0 when unknown or toggling
+        for (int column = 0; column < columns; column++)
+        {
+            if (!known[column])
+            {
+                previous = 0;
+                continue;
+            }
+            bool low = !((lows[column] >> pin) & 1);
+            bool high = (highs[column] >> pin) & 1;
+            char level = low && high ? 0 : high ? 'H' : 'L';
+            if (level == 0)
+            {
+                top[column] = bottom[column] = '#';
+            }
+            else
+            {
+                (level == 'H' ? top : bottom)[column] = '_';
+                if (previous != 0 && previous != level)
+                    bottom[column] = '|';
+            }
+            previous = level;
+        }
+        out += fmt::format("{:<8}{}\n{:<8}{}\n", "", top, fmt::format("gpio{}", pin), bottom);
+    }
+}
+
+void PioDebugger::cmdDisas(const Line& line, std::string& out)
+{
+    int from = 0;
+    int count = 0;
+    if (line.args.size() > 1)
+    {
+        from = static_cast<int>(std::clamp<int64_t>(PioText::parseNumber(line.args[1]), 0, 31));
+        count = line.args.size() > 2 ? static_cast<int>(parseCount(line.args[2])) : 8;
+    }
+    else
+    {
+        // Up to the last address with anything in it
+        int last = std::max({ static_cast<int>(pio_.regs.pc & 31), static_cast<int>(pio_.settings.wrap_end), 0 });
+        for (int address = 31; address > last; address--)
+        {
+            if (!pio_.instruction_text[address].empty() || pio_.instructionMemory[address] != 0xa042)
+            {
+                last = address;
+                break;
+            }
+        }
+        count = last + 1;
+    }
+
+    const int pc = static_cast<int>(pio_.regs.pc & 31);
+    for (int address = from; address < std::min(from + count, 32); address++)
+    {
+        if (address == static_cast<int>(pio_.settings.wrap_start))
+            out += "            .wrap_target\n";
+        out += fmt::format("{}{} {:2}: {:04x}  {}\n", address == pc ? "=>" : "  ", breakpoints_.hasPc(address) ? '*' : ' ',
+            address, pio_.instructionMemory[address], instructionText(address));
+        if (address == static_cast<int>(pio_.settings.wrap_end))
+            out += "            .wrap\n";
+    }
+}
+
+void PioDebugger::cmdPrint(const Line& line, std::string& out)
+{
+    if (line.rest.empty())
+        throw std::invalid_argument("print EXPR");
+    PioExpression expression = PioExpression::compile(pio_, std::string(line.rest));
+    uint32_t value = expression.evaluate(pio_);
+    out += fmt::format("{} = {} (0x{:x})\n", line.rest, value, value);
+}
+
+/* ----- Changing it ----- */
+
+void PioDebugger::cmdSet(const Line& line, std::string& out)
+{
+    if (line.args.size() < 3)
+        throw std::invalid_argument("set NAME VALUE");
+    std::string name(line.args[1]);
+    if (pio_.var_setters.contains(name))
+    {
+        pio_.set_var(name, static_cast<uint32_t>(PioText::parseNumber(line.args[2])));
+        out += fmt::format("{} = 0x{:x}\n", name, pio_.get_var(name));
+    }
+    else if (!pio_.applySetting(name, std::string(line.args[2])))
+    {
+        throw std::invalid_argument(fmt::format("no variable or setting named {}", name));
+    }
+}
+
+void PioDebugger::cmdDrive(const Line& line, std::string&)
+{
+    if (line.args.size() < 3)
+        throw std::invalid_argument("drive PIN 0|1|z");
+    int pin = PioText::parsePin(line.args[1]);
+    std::string_view level = line.args[2];
+    if (level == "z" || level == "Z")
+        pio_.gpio.external_data[pin] = -1;
+    else if (level == "0" || level == "1")
+        pio_.gpio.external_data[pin] = static_cast<int8_t>(level[0] - '0');
+    else
+        throw std::invalid_argument(fmt::format("not 0, 1 or z: {}", level));
+}
+
+void PioDebugger::cmdPush(const Line& line, std::string&)
+{
+    if (line.args.size() < 2)
+        throw std::invalid_argument("push WORD");
+    uint32_t word = static_cast<uint32_t>(PioText::parseNumber(line.args[1]));
+    if (pio_.fifo.tx_fifo_count >= 4)
+        throw std::runtime_error("the TX FIFO is full");
+    pio_.fifo.tx_fifo[pio_.fifo.tx_fifo_count++] = word;
+}
+
+void PioDebugger::cmdPop(const Line&, std::string& out)
+{
+    auto& fifo = pio_.fifo;
+    if (fifo.rx_fifo_count == 0)
+        throw std::runtime_error("the RX FIFO is empty");
+    uint32_t word = fifo.rx_fifo[0];
+    for (int i = 0; i < fifo.rx_fifo_count - 1; i++)
+        fifo.rx_fifo[i] = fifo.rx_fifo[i + 1];
+    fifo.rx_fifo[--fifo.rx_fifo_count] = 0;
+    out += fmt::format("0x{:08x}\n", word);
+}
+
+/* ----- Checkpoints ----- */
+
+void PioDebugger::cmdCheckpoint(const Line& line, std::string& out)
+{
+    std::string name = line.args.size() > 1 ? std::string(line.args[1]) : fmt::format("cp{}", next_checkpoint_++);
+    checkpoints_[name].capture(pio_);
+    out += fmt::format("checkpoint {} at clock {}\n", name, pio_.clock);
+}
+
+void PioDebugger::cmdRewind(const Line& line, std::string& out)
+{
+    if (line.args.size() > 1)
+    {
+        auto checkpoint = checkpoints_.find(std::string(line.args[1]));
+        if (checkpoint == checkpoints_.end())
+            throw std::invalid_argument(fmt::format("no checkpoint named {}", line.args[1]));
+        restore(checkpoint->second);
+    }
+    else
+    {
+        if (undo_.empty())
+            throw std::runtime_error("nothing to rewind");
+        restore(undo_.back());
+        undo_.pop_back();
+    }
+    out += location() + "\n";
+}
+
+void PioDebugger::cmdReset(const Line&, std::string& out)
+{
+    saveUndo();
+    restore(initial_);
+    out += location() + "\n";
+}
+
+void PioDebugger::restore(const PioSnapshot& snapshot)
+{
+    snapshot.restore(pio_);
+    restartPinHistory();
+}
+
+void PioDebugger::restartPinHistory()
+{
+    pio_.listened_pins = PioBitOps::gatherPins(pio_.gpio.raw_data);
+    pins_.waveform.clear();
+    pins_.waveform.add(pio_.clock, pio_.listened_pins);
+}
+
+void PioDebugger::cmdHelp(const Line&, std::string& out)
+{
+    for (const Command& command : kCommands)
+    {
+        std::string names = command.alias ? fmt::format("{}, {}", command.usage, command.alias) : command.usage;
+        out += fmt::format("{:<27} {}\n", names, command.help);
+    }
+    out += "an empty line repeats the last step, next or continue\n";
+}
+
+/* ----- Formatting ----- */
+
+std::string PioDebugger::location() const
+{
+    std::string text = pio_.exec_command
+        ? fmt::format("clock {}  exec: {}", pio_.clock, PioDisassembler::disassemble(pio_.currentInstruction, pio_.settings))
+        : fmt::format("clock {}  pc {}: {}", pio_.clock, pio_.regs.pc, instructionText(static_cast<int>(pio_.regs.pc & 31)));
+    std::string state = stateText();
+    return state.empty() ? text : fmt::format("{}  [{}]", text, state);
+}
+
+std::string PioDebugger::instructionText(int address) const
+{
+    const std::string& text = pio_.instruction_text[address];
+    return text.empty() ? PioDisassembler::disassemble(pio_.instructionMemory[address], pio_.settings) : text;
+}
+
+std::string PioDebugger::stateText() const
+{
+    if (pio_.delay_delay)
+    {
+        switch (PioProfiler::stallCause(pio_))
+        {
+        case PioProfiler::StallIrq:  return "waiting for an irq";
+        case PioProfiler::StallPull: return "stalled on pull";
+        case PioProfiler::StallPush: return "stalled on push";
+        default:                     return "waiting";
+        }
+    }
+    if (pio_.regs.delay > 0)
+        return fmt::format("delay {}", pio_.regs.delay);
+    return "";
+}
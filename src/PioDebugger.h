@@ -0,0 +1,122 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "PioBreakpoints.h"
+#include "PioSnapshot.h"
+#include "PioStateMachine.h"
+#include "PioWaveform.h"
+#include "PioWorker.h"
+
+// Command interpreter of the terminal debugger (pio_emu_dbg), no terminal code so it can be tested
+// anywhere. Commands that run the machine (step, next, continue) hand it to a PioWorker and return
+// at once: the front end waits with waitFor(), may interrupt() (Ctrl-C) and prints finish(). All
+// other commands answer on the caller's thread from the idle machine, a table lookup and a few
+// formats, no rescans of the program or the history.
+//
+// Pin changes are kept in a PioWaveform for 'wave' (fed as a PioPinListener, so run() keeps its
+// fast paths). The machine is checkpointed before every run and reset, 'rewind' undoes them.
+class PioDebugger
+{
+public:
+    // Attach to a loaded machine, 'reset' goes back to it as it is now
+    explicit PioDebugger(PioStateMachine& pio);
+    ~PioDebugger();
+    PioDebugger(const PioDebugger&) = delete;
+    PioDebugger& operator=(const PioDebugger&) = delete;
+
+    // One command line, the reply is appended to 'out'. False once the session should end ('quit').
+    // An empty line repeats the last step/next/continue. Errors are replies, not exceptions.
+    bool execute(std::string_view line, std::string& out);
+
+    bool running() const { return run_kind_ != RunKind::None; } // a run started that finish() hasn't reported
+    bool waitFor(std::chrono::milliseconds timeout) { return worker_.waitFor(timeout); } // true once the run is over
+    void interrupt() { worker_.cancel(); } // returns once the machine is stopped
+    void finish(std::string& out);         // after a run: why and where it stopped
+
+    const PioBreakpoints& breakpoints() const { return breakpoints_; }
+    const PioWaveform& waveform() const { return pins_.waveform; }
+
+    static constexpr size_t kUndoDepth = 256; // runs and resets 'rewind' can undo
+    static constexpr int kWaveColumns = 64;
+
+private:
+    struct Line
+    {
+        std::vector<std::string_view> args; // args[0] is the command
+        std::string_view rest;              // everything after the command, for expressions
+    };
+
+    struct Command
+    {
+        const char* name;
+        const char* alias;
+        void (PioDebugger::*handler)(const Line& line, std::string& out);
+        const char* usage;
+        const char* help;
+    };
+    static const Command kCommands[];
+
+    // Every pin change, for 'wave'
+    struct PinHistory : PioPinListener
+    {
+        PioWaveform waveform{ size_t{ 1 } << 20 };
+        uint32_t pinMask() const override { return 0xffffffffu; }
+        void onPinChange(int clock, uint32_t pins) override { waveform.add(clock, pins); }
+    };
+
+    enum class RunKind
+    {
+        None,
+        Step,
+        Next,
+        Continue
+    };
+
+    void cmdHelp(const Line& line, std::string& out);
+    void cmdStep(const Line& line, std::string& out);
+    void cmdNext(const Line& line, std::string& out);
+    void cmdContinue(const Line& line, std::string& out);
+    void cmdBreak(const Line& line, std::string& out);
+    void cmdWhen(const Line& line, std::string& out);
+    void cmdWatch(const Line& line, std::string& out);
+    void cmdDelete(const Line& line, std::string& out);
+    void cmdInfo(const Line& line, std::string& out);
+    void cmdRegs(const Line& line, std::string& out);
+    void cmdFifo(const Line& line, std::string& out);
+    void cmdPins(const Line& line, std::string& out);
+    void cmdWave(const Line& line, std::string& out);
+    void cmdDisas(const Line& line, std::string& out);
+    void cmdPrint(const Line& line, std::string& out);
+    void cmdSet(const Line& line, std::string& out);
+    void cmdDrive(const Line& line, std::string& out);
+    void cmdPush(const Line& line, std::string& out);
+    void cmdPop(const Line& line, std::string& out);
+    void cmdCheckpoint(const Line& line, std::string& out);
+    void cmdRewind(const Line& line, std::string& out);
+    void cmdReset(const Line& line, std::string& out);
+
+    void startRun(RunKind kind, PioWorker::Job job);
+    void saveUndo();
+    void restore(const PioSnapshot& snapshot); // and start the pin history over
+    void restartPinHistory();
+
+    std::string location() const;           // "clock 1234  pc 3: jmp x--, 1  [delay 2]"
+    std::string instructionText(int address) const;
+    std::string stateText() const;           // "stalled on pull", "delay 2", "" when about to fetch
+
+    PioStateMachine& pio_;
+    PioSnapshot initial_;
+    PinHistory pins_;
+    PioBreakpoints breakpoints_;
+    std::deque<PioSnapshot> undo_;                // before each run and reset, newest last
+    std::map<std::string, PioSnapshot> checkpoints_;
+    int next_checkpoint_ = 1;
+    std::string last_run_line_;                   // repeated by an empty line
+    RunKind run_kind_ = RunKind::None;            // of the run finish() hasn't reported yet
+    PioWorker worker_;                            // last, so it is destroyed (stopped) first
+};
@@ -0,0 +1,336 @@
+#include "PioDecoders.h"
+#include <bit>
+#include <fmt/format.h>
+
+/* ----- WS2812 ----- */
+
+PioWs2812Decoder::PioWs2812Decoder(int pin, int one_clocks, int reset_clocks, int bits_per_pixel)
+    : pin(pin), one_clocks(one_clocks), reset_clocks(reset_clocks), bits_per_pixel(bits_per_pixel)
+{
+}
+
+void PioWs2812Decoder::onPinChange(int clock, uint32_t pins)
+{
+    bool high = level(pins, pin);
+    if (high == high_)
+        return;
+    high_ = high;
+
+    if (high)
+    {
+        if (in_frame_ && clock - fall_clock_ >= reset_clocks)
+            latch();
+        if (!in_frame_)
+        {
+            in_frame_ = true;
+            current_ = Frame();
+            current_.start_clock = clock;
+        }
+        rise_clock_ = clock;
+    }
+    else if (in_frame_)
+    {
+        shift_ = (shift_ << 1) | (clock - rise_clock_ >= one_clocks ? 1 : 0);
+        if (++shift_bits_ == bits_per_pixel)
+        {
+            current_.pixels.push_back(bits_per_pixel < 32 ? shift_ & ((1u << bits_per_pixel) - 1) : shift_);
+            shift_ = 0;
+            shift_bits_ = 0;
+        }
+        current_.end_clock = clock;
+        fall_clock_ = clock;
+    }
+}
+
+void PioWs2812Decoder::finish(int clock)
+{
+    if (in_frame_ && !high_ && clock - fall_clock_ >= reset_clocks)
+        latch();
+}
+
+void PioWs2812Decoder::latch()
+{
+    current_.trailing_bits = shift_bits_;
+    framebuffer = current_.pixels;
+    frames.push_back(std::move(current_));
+    current_ = Frame();
+    in_frame_ = false;
+    shift_ = 0;
+    shift_bits_ = 0;
+}
+
+void PioWs2812Decoder::reset()
+{
+    *this = PioWs2812Decoder(pin, one_clocks, reset_clocks, bits_per_pixel);
+}
+
+std::string PioWs2812Decoder::toJson() const
+{
+    std::string out = "{\"frames\":[";
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        const Frame& frame = frames[i];
+        out += fmt::format("{}{{\"start_clock\":{},\"end_clock\":{},\"pixels\":[{}],\"trailing_bits\":{}}}",
+            i ? "," : "", frame.start_clock, frame.end_clock, fmt::join(frame.pixels, ","), frame.trailing_bits);
+    }
+    out += "]}";
+    return out;
+}
+
+/* ----- UART ----- */
+
+PioUartDecoder::PioUartDecoder(int pin, int clocks_per_bit, int data_bits, Parity parity, int stop_bits)
+    : pin(pin), clocks_per_bit(clocks_per_bit), data_bits(data_bits), parity(parity), stop_bits(stop_bits)
+{
+}
+
+void PioUartDecoder::onPinChange(int clock, uint32_t pins)
+{
+    sampleUntil(clock);
+
+    bool line = level(pins, pin) != inverted;
+    if (line == line_)
+        return;
+    line_ = line;
+
+    if (!in_frame_ && !line)
+    {
+        in_frame_ = true;
+        start_clock_ = clock;
+        bit_index_ = 0;
+        current_ = Byte();
+        current_.start_clock = clock;
+    }
+}
+
+void PioUartDecoder::finish(int clock)
+{
+    sampleUntil(clock);
+}
+
+void PioUartDecoder::sampleUntil(int clock)
+{
+    // The line held line_ since the last edge, so every sample point before 'clock' reads it
+    while (in_frame_)
+    {
+        int at = start_clock_ + bit_index_ * clocks_per_bit + clocks_per_bit / 2;
+        if (at >= clock)
+            return;
+
+        int parity_index = parity != Parity::None ? data_bits + 1 : -1;
+        if (bit_index_ == 0)
+        {
+            if (line_)
+            {
+                in_frame_ = false; // glitch, the start bit did not last
+                return;
+            }
+        }
+        else if (bit_index_ <= data_bits)
+        {
+            current_.value |= static_cast<uint16_t>(line_ ? 1 : 0) << (bit_index_ - 1);
+        }
+        else if (bit_index_ == parity_index)
+        {
+            bool odd = (std::popcount(static_cast<unsigned>(current_.value)) + (line_ ? 1 : 0)) & 1;
+            current_.parity_error = odd != (parity == Parity::Odd);
+        }
+        else if (!line_)
+        {
+            current_.framing_error = true;
+        }
+
+        if (++bit_index_ == frameBits())
+        {
+            current_.end_clock = start_clock_ + frameBits() * clocks_per_bit;
+            bytes.push_back(current_);
+            in_frame_ = false;
+        }
+    }
+}
+
+std::string PioUartDecoder::text() const
+{
+    std::string out;
+    for (const Byte& byte : bytes)
+        out += static_cast<char>(byte.value);
+    return out;
+}
+
+void PioUartDecoder::reset()
+{
+    bool keep_inverted = inverted;
+    *this = PioUartDecoder(pin, clocks_per_bit, data_bits, parity, stop_bits);
+    inverted = keep_inverted;
+}
+
+std::string PioUartDecoder::toJson() const
+{
+    std::string out = "{\"bytes\":[";
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        const Byte& byte = bytes[i];
+        out += fmt::format("{}{{\"start_clock\":{},\"end_clock\":{},\"value\":{},\"framing_error\":{},\"parity_error\":{}}}",
+            i ? "," : "", byte.start_clock, byte.end_clock, byte.value, byte.framing_error, byte.parity_error);
+    }
+    out += "]}";
+    return out;
+}
+
+/* ----- SPI ----- */
+
+PioSpiDecoder::PioSpiDecoder(int sck, int mosi, int miso, int cs, bool cpol, bool cpha, int bits_per_word)
+    : sck(sck), mosi(mosi), miso(miso), cs(cs), cpol(cpol), cpha(cpha), bits_per_word(bits_per_word)
+{
+    last_pins_ = (cpol ? bit(sck) : 0) | bit(cs); // idle clock, deselected
+}
+
+void PioSpiDecoder::onPinChange(int clock, uint32_t pins)
+{
+    bool selected = cs < 0 || !level(pins, cs);
+    bool was_selected = cs < 0 || !level(last_pins_, cs);
+    if (selected != was_selected)
+        bits_ = 0; // a new transfer, or a partial word dropped at its end
+
+    bool sck_level = level(pins, sck);
+    if (selected && sck_level != level(last_pins_, sck))
+    {
+        bool leading = sck_level != cpol; // leaving the idle level
+        if (leading != cpha)
+        {
+            if (bits_ == 0)
+            {
+                current_ = Word();
+                current_.start_clock = clock;
+            }
+            uint32_t mosi_bit = mosi >= 0 && level(pins, mosi) ? 1 : 0;
+            uint32_t miso_bit = miso >= 0 && level(pins, miso) ? 1 : 0;
+            if (msb_first)
+            {
+                current_.mosi = (current_.mosi << 1) | mosi_bit;
+                current_.miso = (current_.miso << 1) | miso_bit;
+            }
+            else
+            {
+                current_.mosi |= mosi_bit << bits_;
+                current_.miso |= miso_bit << bits_;
+            }
+            current_.end_clock = clock;
+            if (++bits_ == bits_per_word)
+            {
+                words.push_back(current_);
+                bits_ = 0;
+            }
+        }
+    }
+    last_pins_ = pins;
+}
+
+void PioSpiDecoder::reset()
+{
+    bool keep_msb_first = msb_first;
+    *this = PioSpiDecoder(sck, mosi, miso, cs, cpol, cpha, bits_per_word);
+    msb_first = keep_msb_first;
+}
+
+std::string PioSpiDecoder::toJson() const
+{
+    std::string out = "{\"words\":[";
+    for (size_t i = 0; i < words.size(); i++)
+    {
+        const Word& word = words[i];
+        out += fmt::format("{}{{\"start_clock\":{},\"end_clock\":{},\"mosi\":{},\"miso\":{}}}",
+            i ? "," : "", word.start_clock, word.end_clock, word.mosi, word.miso);
+    }
+    out += "]}";
+    return out;
+}
+
+/* ----- I2C ----- */
+
+const char* PioI2cDecoder::kindName(Kind kind)
+{
+    switch (kind)
+    {
+    case Kind::Start:         return "start";
+    case Kind::RepeatedStart: return "repeated_start";
+    case Kind::Stop:          return "stop";
+    case Kind::Address:       return "address";
+    case Kind::Data:          return "data";
+    default:                  return "?";
+    }
+}
+
+PioI2cDecoder::PioI2cDecoder(int sda, int scl)
+    : sda(sda), scl(scl)
+{
+    last_pins_ = bit(sda) | bit(scl); // idle bus, both pulled up
+}
+
+void PioI2cDecoder::onPinChange(int clock, uint32_t pins)
+{
+    bool sda_level = level(pins, sda);
+    bool scl_level = level(pins, scl);
+    bool sda_before = level(last_pins_, sda);
+    bool scl_before = level(last_pins_, scl);
+    last_pins_ = pins;
+
+    if (scl_level && scl_before && sda_level != sda_before)
+    {
+        // SDA moving while SCL is high: a condition, never data
+        if (!sda_level)
+        {
+            events.push_back({ in_transfer_ ? Kind::RepeatedStart : Kind::Start, clock, clock });
+            in_transfer_ = true;
+            expect_address_ = true;
+        }
+        else
+        {
+            events.push_back({ Kind::Stop, clock, clock });
+            in_transfer_ = false;
+        }
+        bits_ = 0;
+        shift_ = 0;
+    }
+    else if (in_transfer_ && scl_level && !scl_before)
+    {
+        if (bits_ == 0)
+            byte_start_ = clock;
+        if (bits_ < 8)
+        {
+            shift_ = static_cast<uint16_t>((shift_ << 1) | (sda_level ? 1 : 0));
+            bits_++;
+            return;
+        }
+
+        // 9th bit: the receiver's ACK
+        Event event{ expect_address_ ? Kind::Address : Kind::Data, byte_start_, clock };
+        event.value = static_cast<uint8_t>(expect_address_ ? shift_ >> 1 : shift_);
+        event.read = expect_address_ && (shift_ & 1);
+        event.ack = !sda_level;
+        events.push_back(event);
+        expect_address_ = false;
+        bits_ = 0;
+        shift_ = 0;
+    }
+}
+
+void PioI2cDecoder::reset()
+{
+    *this = PioI2cDecoder(sda, scl);
+}
+
+std::string PioI2cDecoder::toJson() const
+{
+    std::string out = "{\"events\":[";
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const Event& event = events[i];
+        out += fmt::format("{}{{\"kind\":\"{}\",\"start_clock\":{},\"end_clock\":{}", i ? "," : "", kindName(event.kind), event.start_clock, event.end_clock);
+        if (event.kind == Kind::Address || event.kind == Kind::Data)
+            out += fmt::format(",\"value\":{},\"read\":{},\"ack\":{}", event.value, event.read, event.ack);
+        out += "}";
+    }
+    out += "]}";
+    return out;
+}
@@ -0,0 +1,188 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioStateMachine.h"
+
+// Protocol decoders on the GPIO levels, attach with pio.pin_listeners.push_back(&decoder).
+//
+// They run in the same pass as the emulation but only on clocks where one of their pins changed
+// (see PioPinListener), every decoded item carries the clocks it started and ended on. A level
+// that is held until the end of the capture is only known once the caller says so: finish(clock)
+// closes what the time elapsed since the last edge completes (a UART stop bit, a WS2812 reset).
+class PioDecoder : public PioPinListener
+{
+public:
+    virtual void finish(int clock) { (void)clock; }
+    virtual void reset() = 0;            // drops everything decoded, keeps the configuration
+    virtual std::string toJson() const = 0;
+
+protected:
+    static bool level(uint32_t pins, int pin) { return (pins >> (pin & 31)) & 1; }
+    static uint32_t bit(int pin) { return pin >= 0 ? 1u << (pin & 31) : 0; }
+};
+
+// WS2812 / NeoPixel: a high pulse at least one_clocks wide is a 1, a shorter one a 0, MSB first.
+// A low gap of reset_clocks or more latches the frame; pixels are 0xGGRRBB (0xGGRRBBWW at 32 bits).
+class PioWs2812Decoder : public PioDecoder
+{
+public:
+    struct Frame
+    {
+        int start_clock = 0;         // first rising edge
+        int end_clock = 0;           // falling edge of the last bit
+        std::vector<uint32_t> pixels;
+        int trailing_bits = 0;       // bits after the last complete pixel (not in pixels)
+    };
+
+    PioWs2812Decoder(int pin, int one_clocks, int reset_clocks, int bits_per_pixel = 24);
+
+    int pin;
+    int one_clocks;
+    int reset_clocks;
+    int bits_per_pixel;
+
+    std::vector<Frame> frames;       // latched frames, oldest first
+    std::vector<uint32_t> framebuffer; // pixels of the last latched frame
+
+    uint32_t pinMask() const override { return bit(pin); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void finish(int clock) override;
+    void reset() override;
+    std::string toJson() const override;
+
+private:
+    void latch();
+
+    Frame current_;
+    bool in_frame_ = false;
+    bool high_ = false;
+    int rise_clock_ = -1;
+    int fall_clock_ = -1;
+    uint32_t shift_ = 0;
+    int shift_bits_ = 0;
+};
+
+// Asynchronous serial, LSB first: a falling edge on an idle line starts a frame, every bit is
+// sampled in its middle. clocks_per_bit is the baud rate in SM clocks (clock / baud).
+class PioUartDecoder : public PioDecoder
+{
+public:
+    enum class Parity { None, Even, Odd };
+
+    struct Byte
+    {
+        int start_clock = 0;         // falling edge of the start bit
+        int end_clock = 0;           // end of the (last) stop bit
+        uint16_t value = 0;
+        bool framing_error = false;  // a stop bit read low
+        bool parity_error = false;
+    };
+
+    PioUartDecoder(int pin, int clocks_per_bit, int data_bits = 8, Parity parity = Parity::None, int stop_bits = 1);
+
+    int pin;
+    int clocks_per_bit;
+    int data_bits;
+    Parity parity;
+    int stop_bits;
+    bool inverted = false;           // idle low
+
+    std::vector<Byte> bytes;
+    std::string text() const;        // the values as characters, errors included
+
+    uint32_t pinMask() const override { return bit(pin); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void finish(int clock) override;
+    void reset() override;
+    std::string toJson() const override;
+
+private:
+    void sampleUntil(int clock);     // takes every sample due before 'clock' at the held level
+    int frameBits() const { return 1 + data_bits + (parity != Parity::None ? 1 : 0) + stop_bits; }
+
+    bool line_ = true;               // logical level, true = idle
+    bool in_frame_ = false;
+    int start_clock_ = 0;
+    int bit_index_ = 0;              // next bit to sample, 0 = start bit
+    Byte current_;
+};
+
+// SPI in any of the four modes: CPOL is the idle clock level, CPHA = 0 samples on the leading
+// edge, 1 on the trailing one. With a chip select (active low) it starts a word and drops a
+// partial one; without, every bits_per_word samples make a word.
+class PioSpiDecoder : public PioDecoder
+{
+public:
+    struct Word
+    {
+        int start_clock = 0;         // first sampling edge
+        int end_clock = 0;           // last sampling edge
+        uint32_t mosi = 0;
+        uint32_t miso = 0;
+    };
+
+    PioSpiDecoder(int sck, int mosi, int miso = -1, int cs = -1, bool cpol = false, bool cpha = false, int bits_per_word = 8);
+
+    int sck;
+    int mosi;                        // -1: not decoded
+    int miso;
+    int cs;                          // -1: always selected
+    bool cpol;
+    bool cpha;
+    int bits_per_word;
+    bool msb_first = true;
+
+    std::vector<Word> words;
+
+    uint32_t pinMask() const override { return bit(sck) | bit(cs); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void reset() override;
+    std::string toJson() const override;
+
+private:
+    uint32_t last_pins_ = 0;
+    bool started_ = false;
+    int bits_ = 0;
+    Word current_;
+};
+
+// I2C: START / repeated START / STOP conditions, then 8 bits and the ACK per byte, sampled on
+// SCL rising. The first byte after a START is the address (7 bits plus R/W).
+class PioI2cDecoder : public PioDecoder
+{
+public:
+    enum class Kind { Start, RepeatedStart, Stop, Address, Data };
+
+    struct Event
+    {
+        Kind kind;
+        int start_clock = 0;
+        int end_clock = 0;           // = start_clock for the conditions, the ACK bit otherwise
+        uint8_t value = 0;           // the 7-bit address for Address
+        bool read = false;           // Address: the R/W bit
+        bool ack = false;            // SDA low in the 9th bit
+    };
+    static const char* kindName(Kind kind);
+
+    PioI2cDecoder(int sda, int scl);
+
+    int sda;
+    int scl;
+
+    std::vector<Event> events;
+
+    uint32_t pinMask() const override { return bit(sda) | bit(scl); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void reset() override;
+    std::string toJson() const override;
+
+private:
+    uint32_t last_pins_ = 0;
+    bool started_ = false;           // first sample seen
+    bool in_transfer_ = false;       // between START and STOP
+    bool expect_address_ = false;
+    int bits_ = 0;
+    uint16_t shift_ = 0;
+    int byte_start_ = 0;
+};
@@ -0,0 +1,436 @@
+#include "PioDevices.h"
+#include <algorithm>
+
+/* ----- PioDevice ----- */
+
+void PioDevice::attach(PioStateMachine& pio)
+{
+    pio.input_sources.push_back(this);
+    pio.pin_listeners.push_back(this);
+}
+
+void PioDevice::detach(PioStateMachine& pio)
+{
+    std::erase(pio.input_sources, static_cast<PioInputSource*>(this));
+    std::erase(pio.pin_listeners, static_cast<PioPinListener*>(this));
+}
+
+int PioDevice::nextEventClock() const
+{
+    return queue_.empty() ? -1 : queue_.front().clock;
+}
+
+void PioDevice::apply(PioStateMachine& pio)
+{
+    // onWake() may schedule more for the same clock, those are applied in this pass too
+    while (!queue_.empty() && queue_.front().clock <= pio.clock)
+    {
+        Action action = queue_.front();
+        queue_.pop_front();
+        if (action.pin >= 0)
+            pio.gpio.external_data[action.pin] = action.value;
+        else
+            onWake(action.clock);
+    }
+}
+
+void PioDevice::drive(int clock, int pin, int8_t value)
+{
+    if (pin < 0)
+        return;
+    auto it = std::upper_bound(queue_.begin(), queue_.end(), clock, [](int c, const Action& action) { return c < action.clock; });
+    queue_.insert(it, { clock, pin & 31, value });
+}
+
+void PioDevice::wakeAt(int clock)
+{
+    auto it = std::upper_bound(queue_.begin(), queue_.end(), clock, [](int c, const Action& action) { return c < action.clock; });
+    queue_.insert(it, { clock, -1, 0 });
+}
+
+/* ----- SPI flash ----- */
+
+PioSpiFlashDevice::PioSpiFlashDevice(int sck, int mosi, int miso, int cs, size_t size)
+    : sck(sck), mosi(mosi), miso(miso), cs(cs), memory(size, 0xff)
+{
+    last_pins_ = 0; // SCK idle low, selected_ decides whether CS fell
+}
+
+void PioSpiFlashDevice::reset()
+{
+    PioDevice::reset();
+    std::fill(memory.begin(), memory.end(), 0xff);
+    write_enabled = false;
+    last_pins_ = 0;
+    selected_ = false;
+}
+
+void PioSpiFlashDevice::onPinChange(int clock, uint32_t pins)
+{
+    bool cs_low = cs < 0 || !level(pins, cs);
+    bool cs_edge = cs >= 0 && level(pins, cs) != level(last_pins_, cs);
+    bool sck_level = level(pins, sck);
+    bool sck_before = level(last_pins_, sck);
+    last_pins_ = pins;
+
+    if (cs_low && !selected_)
+    {
+        selected_ = true;
+        bits_in_ = 0;
+        bits_out_ = 0;
+        byte_index_ = 0;
+        out_ = 0xff;
+        next_out_ = 0xff;
+        output(clock); // mode 0: the first bit is out before the first rising edge
+    }
+    else if (!cs_low && selected_)
+    {
+        selected_ = false;
+        if (opcode_ == 0x02 || opcode_ == 0x20)
+            write_enabled = false;
+        drive(clock + response_clocks, miso, -1);
+    }
+
+    // A CS held low from the start selects on the first SCK edge, which still counts
+    if (!selected_ || cs_edge || sck_level == sck_before)
+        return;
+
+    if (sck_level)
+    {
+        in_ = static_cast<uint8_t>((in_ << 1) | (level(pins, mosi) ? 1 : 0));
+        if (++bits_in_ == 8)
+        {
+            next_out_ = command(in_);
+            bits_in_ = 0;
+        }
+    }
+    else
+    {
+        output(clock);
+    }
+}
+
+void PioSpiFlashDevice::output(int clock)
+{
+    if (bits_out_ == 8)
+    {
+        out_ = next_out_;
+        next_out_ = 0xff;
+        bits_out_ = 0;
+    }
+    drive(clock + response_clocks, miso, (out_ >> (7 - bits_out_)) & 1);
+    bits_out_++;
+}
+
+uint8_t PioSpiFlashDevice::command(uint8_t byte)
+{
+    const int index = byte_index_++;
+    const uint8_t status = write_enabled ? 0x02 : 0x00;
+    if (index == 0)
+    {
+        opcode_ = byte;
+        address_ = 0;
+        switch (opcode_)
+        {
+        case 0x06: write_enabled = true; break;
+        case 0x04: write_enabled = false; break;
+        case 0x05: return status;
+        case 0x9f: return jedec_id[0];
+        }
+        return 0xff;
+    }
+
+    switch (opcode_)
+    {
+    case 0x05:
+        return status;
+    case 0x9f:
+        return index < 3 ? jedec_id[index] : 0xff;
+    case 0x03:
+        if (index <= 3)
+        {
+            address_ = (address_ << 8) | byte;
+            if (index < 3)
+                return 0xff;
+        }
+        else
+        {
+            address_++;
+        }
+        return memory[address_ % memory.size()];
+    case 0x02:
+        if (index <= 3)
+        {
+            address_ = (address_ << 8) | byte;
+        }
+        else if (write_enabled)
+        {
+            // Programming only clears bits and wraps inside the 256-byte page
+            uint32_t target = (address_ & ~0xffu) | ((address_ + index - 4) & 0xff);
+            memory[target % memory.size()] &= byte;
+        }
+        return 0xff;
+    case 0x20:
+        if (index <= 3)
+            address_ = (address_ << 8) | byte;
+        if (index == 3 && write_enabled)
+        {
+            size_t sector = (address_ & ~0xfffu) % memory.size();
+            std::fill_n(memory.begin() + sector, std::min<size_t>(0x1000, memory.size() - sector), 0xff);
+        }
+        return 0xff;
+    default:
+        return 0xff;
+    }
+}
+
+/* ----- I2C EEPROM ----- */
+
+PioI2cEepromDevice::PioI2cEepromDevice(int sda, int scl, uint8_t address, size_t size, int address_bytes, int page_size)
+    : sda(sda), scl(scl), address(address), address_bytes(address_bytes), page_size(page_size), memory(size, 0xff)
+{
+    last_pins_ = bit(sda) | bit(scl); // idle bus
+}
+
+void PioI2cEepromDevice::reset()
+{
+    PioDevice::reset();
+    std::fill(memory.begin(), memory.end(), 0xff);
+    last_pins_ = bit(sda) | bit(scl);
+    phase_ = Phase::Idle;
+    sending_ = false;
+    pointer_ = 0;
+}
+
+void PioI2cEepromDevice::onPinChange(int clock, uint32_t pins)
+{
+    bool sda_level = level(pins, sda);
+    bool scl_level = level(pins, scl);
+    bool sda_before = level(last_pins_, sda);
+    bool scl_before = level(last_pins_, scl);
+    last_pins_ = pins;
+    const int at = clock + response_clocks;
+
+    if (scl_level && scl_before && sda_level != sda_before)
+    {
+        // START (SDA falls) or STOP (SDA rises) while SCL is high
+        if (sending_ || ack_pending_)
+            drive(at, sda, -1);
+        phase_ = sda_level ? Phase::Idle : Phase::Address;
+        bit_ = -1; // the SCL fall after START is not a bit
+        shift_ = 0;
+        sending_ = false;
+        ack_pending_ = false;
+        return;
+    }
+    if (phase_ == Phase::Idle || phase_ == Phase::Ignored || scl_level == scl_before)
+        return;
+
+    if (scl_level)
+    {
+        // Rising SCL: sample
+        if (bit_ < 8 && !sending_)
+            shift_ = static_cast<uint8_t>((shift_ << 1) | (sda_level ? 1 : 0));
+        else if (bit_ == 8 && sending_)
+            master_ack_ = !sda_level;
+        return;
+    }
+
+    // Falling SCL: the next bit goes out
+    if (bit_ < 0)
+    {
+        bit_ = 0;
+        return;
+    }
+    if (bit_ < 7)
+    {
+        bit_++;
+        if (sending_)
+            drive(at, sda, (shift_ >> (7 - bit_)) & 1 ? -1 : 0);
+        return;
+    }
+    if (bit_ == 7)
+    {
+        bit_ = 8;
+        if (sending_)
+        {
+            drive(at, sda, -1); // the master ACKs
+            return;
+        }
+        byteReceived(shift_);
+        if (ack_pending_)
+            drive(at, sda, 0);
+        return;
+    }
+
+    // End of the ACK bit
+    bit_ = 0;
+    ack_pending_ = false;
+    if (phase_ == Phase::Read && (!sending_ || master_ack_))
+    {
+        shift_ = memory[pointer_];
+        pointer_ = static_cast<uint32_t>((pointer_ + 1) % memory.size());
+        sending_ = true;
+        drive(at, sda, shift_ & 0x80 ? -1 : 0);
+        return;
+    }
+    if (sending_)
+        phase_ = Phase::Ignored; // NACK ends the read, wait for STOP
+    sending_ = false;
+    shift_ = 0;
+    drive(at, sda, -1);
+}
+
+void PioI2cEepromDevice::byteReceived(uint8_t byte)
+{
+    switch (phase_)
+    {
+    case Phase::Address:
+        if ((byte >> 1) != address)
+        {
+            phase_ = Phase::Ignored;
+            return;
+        }
+        phase_ = (byte & 1) ? Phase::Read : Phase::Write;
+        word_bytes_ = 0;
+        ack_pending_ = true;
+        break;
+    case Phase::Write:
+        if (word_bytes_ < address_bytes)
+        {
+            pointer_ = word_bytes_ == 0 ? byte : (pointer_ << 8) | byte;
+            if (++word_bytes_ == address_bytes)
+                pointer_ %= memory.size();
+        }
+        else
+        {
+            memory[pointer_] = byte;
+            uint32_t page = pointer_ - pointer_ % page_size;
+            pointer_ = page + (pointer_ + 1) % page_size;
+        }
+        ack_pending_ = true;
+        break;
+    default:
+        break;
+    }
+}
+
+/* ----- UART ----- */
+
+PioUartDevice::PioUartDevice(int sm_tx_pin, int sm_rx_pin, int clocks_per_bit)
+    : sm_tx_pin(sm_tx_pin), sm_rx_pin(sm_rx_pin), decoder_(sm_tx_pin, clocks_per_bit)
+{
+    drive(0, sm_rx_pin, 1); // idle line
+}
+
+void PioUartDevice::reset()
+{
+    PioDevice::reset();
+    decoder_.reset();
+    echoed_ = 0;
+    idle_clock_ = 0;
+    drive(0, sm_rx_pin, 1);
+}
+
+void PioUartDevice::send(const std::string& bytes, int start_clock)
+{
+    for (char c : bytes)
+        transmit(static_cast<uint8_t>(c), start_clock);
+}
+
+void PioUartDevice::onPinChange(int clock, uint32_t pins)
+{
+    decoder_.onPinChange(clock, pins);
+    collect(clock);
+    // The stop bit of a frame started on this edge is only sampled by time, come back for it
+    wakeAt(clock + 10 * decoder_.clocks_per_bit);
+}
+
+void PioUartDevice::onWake(int clock)
+{
+    decoder_.finish(clock);
+    collect(clock);
+}
+
+void PioUartDevice::collect(int clock)
+{
+    if (!echo)
+    {
+        echoed_ = decoder_.bytes.size();
+        return;
+    }
+    for (; echoed_ < decoder_.bytes.size(); echoed_++)
+    {
+        const auto& byte = decoder_.bytes[echoed_];
+        transmit(static_cast<uint8_t>(byte.value), std::max(clock, byte.end_clock) + turnaround_clocks);
+    }
+}
+
+void PioUartDevice::transmit(uint8_t byte, int clock)
+{
+    const int bit_clocks = decoder_.clocks_per_bit;
+    const int start = std::max(clock, idle_clock_);
+    drive(start, sm_rx_pin, 0);
+    for (int i = 0; i < 8; i++)
+        drive(start + (1 + i) * bit_clocks, sm_rx_pin, (byte >> i) & 1);
+    drive(start + 9 * bit_clocks, sm_rx_pin, 1);
+    idle_clock_ = start + 10 * bit_clocks;
+}
+
+/* ----- Quadrature encoder ----- */
+
+PioQuadratureEncoderDevice::PioQuadratureEncoderDevice(int pin_a, int pin_b)
+    : pin_a(pin_a), pin_b(pin_b)
+{
+    drive(0, pin_a, 0);
+    drive(0, pin_b, 0);
+}
+
+void PioQuadratureEncoderDevice::reset()
+{
+    PioDevice::reset();
+    moves_.clear();
+    position = 0;
+    phase_ = 0;
+    free_clock_ = 0;
+    waiting_ = false;
+    drive(0, pin_a, 0);
+    drive(0, pin_b, 0);
+}
+
+void PioQuadratureEncoderDevice::move(int64_t steps, int clocks_per_step, int start_clock)
+{
+    if (steps == 0 || clocks_per_step <= 0)
+        return;
+    int begin = std::max(start_clock, free_clock_);
+    moves_.push_back({ steps, clocks_per_step, begin });
+    free_clock_ = begin + static_cast<int>((steps < 0 ? -steps : steps) * clocks_per_step);
+    if (!waiting_)
+        schedule(begin);
+}
+
+void PioQuadratureEncoderDevice::schedule(int after_clock)
+{
+    Move& next = moves_.front();
+    next.start_clock = std::max(next.start_clock, after_clock);
+    waiting_ = true;
+    wakeAt(next.start_clock + next.clocks_per_step);
+}
+
+void PioQuadratureEncoderDevice::onWake(int clock)
+{
+    Move& current = moves_.front();
+    int direction = current.steps > 0 ? 1 : -1;
+    phase_ = (phase_ + direction) & 3;
+    position += direction;
+    drive(clock, pin_a, phase_ == 1 || phase_ == 2);
+    drive(clock, pin_b, phase_ == 2 || phase_ == 3);
+
+    current.steps -= direction;
+    current.start_clock = clock;
+    waiting_ = false;
+    if (current.steps == 0)
+        moves_.pop_front();
+    if (!moves_.empty())
+        schedule(clock);
+}
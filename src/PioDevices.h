@@ -0,0 +1,181 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+#include "PioDecoders.h"
+#include "PioStateMachine.h"
+
+// External device models on the GPIO pins, attach with device.attach(pio).
+//
+// A device is both an input source and a pin listener: it wakes on edges of the pins in pinMask()
+// and on the clocks it asked for with wakeAt(), and answers by scheduling external_data changes
+// with drive(). Nothing runs on the clocks in between, so run()'s fast paths stay on.
+// Open-drain lines are driven 0 to pull low and -1 to release, the level then falls back to what
+// the state machine drives (or holds).
+class PioDevice : public PioInputSource, public PioPinListener
+{
+public:
+    void attach(PioStateMachine& pio);
+    void detach(PioStateMachine& pio);
+
+    int nextEventClock() const override;
+    void apply(PioStateMachine& pio) override;
+
+    uint32_t pinMask() const override { return 0; }
+    void onPinChange(int clock, uint32_t pins) override { (void)clock; (void)pins; }
+
+    virtual void reset() { queue_.clear(); }
+
+protected:
+    void drive(int clock, int pin, int8_t value); // external_data[pin] = value at 'clock'
+    void wakeAt(int clock);                       // onWake(clock) at the start of that clock
+    virtual void onWake(int clock) { (void)clock; }
+
+    static bool level(uint32_t pins, int pin) { return pin >= 0 && ((pins >> (pin & 31)) & 1); }
+    static uint32_t bit(int pin) { return pin >= 0 ? 1u << (pin & 31) : 0; }
+
+private:
+    struct Action
+    {
+        int clock;
+        int pin;      // -1: wake up
+        int8_t value;
+    };
+    std::deque<Action> queue_; // by clock, same clock in scheduling order
+};
+
+// 25-series SPI NOR flash, mode 0, MSB first. Commands: 03 read, 02 page program, 20 sector
+// erase (4 KiB), 06 write enable, 04 write disable, 05 read status, 9F JEDEC id. Writes and
+// erases complete at once (status WIP never set). MISO changes response_clocks after SCK falls.
+class PioSpiFlashDevice : public PioDevice
+{
+public:
+    PioSpiFlashDevice(int sck, int mosi, int miso, int cs, size_t size = 1 << 20);
+
+    int sck, mosi, miso, cs;
+    int response_clocks = 1;
+    std::array<uint8_t, 3> jedec_id = { 0xef, 0x40, 0x14 }; // W25Q80
+    std::vector<uint8_t> memory;                           // erased: 0xff
+    bool write_enabled = false;
+
+    uint32_t pinMask() const override { return bit(sck) | bit(cs); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void reset() override;
+
+private:
+    uint8_t command(uint8_t byte); // next output byte
+    void output(int clock);
+
+    uint32_t last_pins_;
+    bool selected_ = false;
+    int bits_in_ = 0;
+    uint8_t in_ = 0;
+    int bits_out_ = 0;
+    uint8_t out_ = 0xff;
+    uint8_t next_out_ = 0xff;
+    int byte_index_ = 0;           // bytes since CS fell
+    uint8_t opcode_ = 0;
+    uint32_t address_ = 0;
+};
+
+// 24-series I2C EEPROM with address_bytes word address bytes (1: 24C02, 2: 24C256). Writes wrap
+// inside a page, reads run over the whole array. ACK and data go out response_clocks after SCL
+// falls, SDA is released otherwise.
+class PioI2cEepromDevice : public PioDevice
+{
+public:
+    PioI2cEepromDevice(int sda, int scl, uint8_t address = 0x50, size_t size = 256, int address_bytes = 1, int page_size = 8);
+
+    int sda, scl;
+    uint8_t address;
+    int address_bytes;
+    int page_size;
+    int response_clocks = 1;
+    std::vector<uint8_t> memory;   // erased: 0xff
+
+    uint32_t pinMask() const override { return bit(sda) | bit(scl); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void reset() override;
+
+private:
+    enum class Phase { Idle, Address, Ignored, Write, Read };
+    void byteReceived(uint8_t byte);
+
+    uint32_t last_pins_;
+    Phase phase_ = Phase::Idle;
+    int bit_ = 0;                  // 0..7 data, 8 the ACK, -1 right after START
+    uint8_t shift_ = 0;
+    bool ack_pending_ = false;     // pull SDA low for the next ACK bit
+    bool sending_ = false;         // Read: the data bits are ours
+    bool master_ack_ = false;
+    int word_bytes_ = 0;           // word address bytes received in this Write
+    uint32_t pointer_ = 0;
+};
+
+// Serial port on the other end of the state machine's TX / RX pins: decodes what the program
+// sends (received), and transmits the queued bytes plus, with echo, everything it received.
+class PioUartDevice : public PioDevice
+{
+public:
+    PioUartDevice(int sm_tx_pin, int sm_rx_pin, int clocks_per_bit);
+
+    int sm_tx_pin;                 // the device listens here
+    int sm_rx_pin;                 // and drives this one
+    bool echo = false;
+    int turnaround_clocks = 0;     // gap before an echoed byte
+
+    std::vector<PioUartDecoder::Byte> received() const { return decoder_.bytes; }
+    std::string receivedText() const { return decoder_.text(); }
+    void send(const std::string& bytes, int start_clock = 0); // after anything already queued
+
+    uint32_t pinMask() const override { return bit(sm_tx_pin); }
+    void onPinChange(int clock, uint32_t pins) override;
+    void reset() override;
+
+protected:
+    void onWake(int clock) override;
+
+private:
+    void transmit(uint8_t byte, int clock);
+    void collect(int clock);
+
+    PioUartDecoder decoder_;
+    size_t echoed_ = 0;
+    int idle_clock_ = 0;           // first clock the device's TX line is free
+};
+
+// Quadrature encoder: A leads B for positive steps. move() queues constant-speed runs, the
+// device wakes once per step.
+class PioQuadratureEncoderDevice : public PioDevice
+{
+public:
+    PioQuadratureEncoderDevice(int pin_a, int pin_b);
+
+    int pin_a, pin_b;
+    int64_t position = 0;          // steps output so far
+
+    // 'steps' (negative: backwards), one every clocks_per_step, starting when the previous move
+    // ends or at start_clock, whichever is later
+    void move(int64_t steps, int clocks_per_step, int start_clock = 0);
+    bool idle() const { return moves_.empty(); }
+    void reset() override;
+
+protected:
+    void onWake(int clock) override;
+
+private:
+    struct Move
+    {
+        int64_t steps;
+        int clocks_per_step;
+        int start_clock;
+    };
+    void schedule(int after_clock);
+
+    std::deque<Move> moves_;
+    int phase_ = 0;                // 0..3, Gray code 00 10 11 01 (A B)
+    int free_clock_ = 0;
+    bool waiting_ = false;
+};
@@ -0,0 +1,103 @@
+#include "PioDisassembler.h"
+#include <fmt/format.h>
+
+namespace {
+
+    constexpr const char* kJmpConditions[] = { "", "!x, ", "x--, ", "!y, ", "y--, ", "x!=y, ", "pin, ", "!osre, " };
+    constexpr const char* kWaitSources[] = { "gpio", "pin", "irq", "jmppin" };
+    constexpr const char* kInSources[] = { "pins", "x", "y", "null", "reserved", "reserved", "isr", "osr" };
+    constexpr const char* kOutDestinations[] = { "pins", "x", "y", "null", "pindirs", "pc", "isr", "exec" };
+    constexpr const char* kMovDestinations[] = { "pins", "x", "y", "pindirs", "exec", "pc", "isr", "osr" };
+    constexpr const char* kMovOps[] = { "", "!", "::", "reserved " };
+    constexpr const char* kMovSources[] = { "pins", "x", "y", "null", "reserved", "status", "isr", "osr" };
+    constexpr const char* kSetDestinations[] = { "pins", "x", "y", "reserved", "pindirs", "reserved", "reserved", "reserved" };
+
+    int bitCount(uint16_t instruction)
+    {
+        int count = instruction & 0x1f;
+        return count == 0 ? 32 : count;
+    }
+
+    std::string irqIndex(uint16_t instruction)
+    {
+        // bit 4: relative to the state machine number
+        return (instruction & 0x10) ? fmt::format("{} rel", instruction & 0x7) : fmt::format("{}", instruction & 0x7);
+    }
+
+} // namespace
+
+namespace PioDisassembler {
+
+    std::string disassemble(uint16_t instruction, int sideset_count, bool sideset_opt)
+    {
+        const int operation = (instruction >> 13) & 0x7;
+        std::string text;
+        switch (operation)
+        {
+        case 0: // JMP
+            text = fmt::format("jmp    {}{}", kJmpConditions[(instruction >> 5) & 0x7], instruction & 0x1f);
+            break;
+        case 1: // WAIT
+        {
+            int source = (instruction >> 5) & 0x3;
+            std::string index = source == 2 ? irqIndex(instruction) : fmt::format("{}", instruction & 0x1f);
+            text = fmt::format("wait   {} {}, {}", (instruction >> 7) & 1, kWaitSources[source], index);
+            break;
+        }
+        case 2: // IN
+            text = fmt::format("in     {}, {}", kInSources[(instruction >> 5) & 0x7], bitCount(instruction));
+            break;
+        case 3: // OUT
+            text = fmt::format("out    {}, {}", kOutDestinations[(instruction >> 5) & 0x7], bitCount(instruction));
+            break;
+        case 4: // PUSH / PULL
+        {
+            bool pull = instruction & 0x80;
+            bool if_flag = instruction & 0x40;
+            bool block = instruction & 0x20;
+            text = fmt::format("{}   {}{}", pull ? "pull" : "push", if_flag ? (pull ? "ifempty " : "iffull ") : "", block ? "block" : "noblock");
+            break;
+        }
+        case 5: // MOV
+        {
+            int destination = (instruction >> 5) & 0x7;
+            int op = (instruction >> 3) & 0x3;
+            int source = instruction & 0x7;
+            if (destination == 2 && op == 0 && source == 2)
+                text = "nop"; // mov y, y
+            else
+                text = fmt::format("mov    {}, {}{}", kMovDestinations[destination], kMovOps[op], kMovSources[source]);
+            break;
+        }
+        case 6: // IRQ
+        {
+            bool clear = instruction & 0x40;
+            bool wait = instruction & 0x20;
+            text = fmt::format("irq    {} {}", clear ? "clear" : wait ? "wait" : "nowait", irqIndex(instruction));
+            break;
+        }
+        default: // SET
+            text = fmt::format("set    {}, {}", kSetDestinations[(instruction >> 5) & 0x7], instruction & 0x1f);
+            break;
+        }
+
+        // Delay/side-set field: side-set bits on top (the enable bit first when optional), delay below
+        const int field = (instruction >> 8) & 0x1f;
+        const int sideset_bits = sideset_count + (sideset_opt ? 1 : 0);
+        const int delay_bits = 5 - sideset_bits;
+        const int delay = delay_bits > 0 ? field & ((1 << delay_bits) - 1) : 0;
+        bool has_sideset = sideset_count > 0 && (!sideset_opt || (field & 0x10));
+        int sideset = has_sideset ? (field >> delay_bits) & ((1 << sideset_count) - 1) : 0;
+
+        if (has_sideset || delay > 0)
+        {
+            text.resize(std::max<size_t>(text.size() + 1, 23), ' ');
+            if (has_sideset)
+                text += fmt::format("side {}", sideset);
+            if (delay > 0)
+                text += fmt::format("{}[{}]", has_sideset ? " " : "", delay);
+        }
+        return text;
+    }
+
+} // namespace PioDisassembler
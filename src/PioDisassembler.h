@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include "PioStateMachine.h"
+
+// pioasm-style text for an instruction word, e.g. "out    x, 1            side 0 [2]", decoded with
+// the side-set layout of the settings (the same word reads differently with another .side_set).
+// For what has no source text: exec'd instructions, memory written at run time.
+namespace PioDisassembler {
+
+    std::string disassemble(uint16_t instruction, int sideset_count, bool sideset_opt);
+    inline std::string disassemble(uint16_t instruction, const pioStateMachineSettings& settings)
+    {
+        return disassemble(instruction, settings.sideset_count, settings.sideset_opt);
+    }
+
+} // namespace PioDisassembler
@@ -0,0 +1,374 @@
+#include "PioExpression.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <stdexcept>
+#include <string_view>
+#include <fmt/format.h>
+
+// Recursive descent, one function per precedence level, emitting bytecode as it goes
+class PioExpressionParser
+{
+public:
+    using Op = PioExpression::Op;
+
+    PioExpressionParser(const PioStateMachine& pio, PioExpression& out) :
+        pio_(pio), out_(out), text_(out.text_)
+    {
+    }
+
+    void parse()
+    {
+        tokenize();
+        parseBinary(0);
+        if (pos_ < tokens_.size())
+            fail("Unexpected '" + tokens_[pos_].text + "'");
+        out_.stack_.resize(max_depth_);
+    }
+
+private:
+    struct Token
+    {
+        std::string text;
+        size_t column;
+    };
+
+    // Binary operators by precedence level, loosest first
+    struct Binary
+    {
+        const char* token;
+        Op op;
+    };
+    static constexpr int kLevels = 10;
+    static const std::vector<Binary>& level(int n)
+    {
+        static const std::vector<Binary> levels[kLevels] = {
+            { { "||", Op::Or } },
+            { { "&&", Op::And } },
+            { { "|", Op::BitOr } },
+            { { "^", Op::BitXor } },
+            { { "&", Op::BitAnd } },
+            { { "==", Op::Eq }, { "!=", Op::Ne } },
+            { { "<", Op::Lt }, { "<=", Op::Le }, { ">", Op::Gt }, { ">=", Op::Ge } },
+            { { "<<", Op::Shl }, { ">>", Op::Shr } },
+            { { "+", Op::Add }, { "-", Op::Sub } },
+            { { "*", Op::Mul }, { "/", Op::Div }, { "%", Op::Mod } },
+        };
+        return levels[n];
+    }
+
+    [[noreturn]] void fail(const std::string& message, size_t column) const
+    {
+        throw std::runtime_error(fmt::format("{} at column {} in expression: {}", message, column + 1, text_));
+    }
+
+    [[noreturn]] void fail(const std::string& message) const
+    {
+        fail(message, pos_ < tokens_.size() ? tokens_[pos_].column : text_.size());
+    }
+
+    void tokenize()
+    {
+        static const char* two_char[] = { "&&", "||", "==", "!=", "<=", ">=", "<<", ">>" };
+        size_t i = 0;
+        while (i < text_.size())
+        {
+            unsigned char c = text_[i];
+            if (std::isspace(c))
+            {
+                i++;
+                continue;
+            }
+
+            size_t start = i;
+            if (std::isalnum(c) || c == '_')
+            {
+                while (i < text_.size() && (std::isalnum(static_cast<unsigned char>(text_[i])) || text_[i] == '_'))
+                    i++;
+            }
+            else
+            {
+                bool matched = false;
+                for (const char* op : two_char)
+                {
+                    if (text_.compare(i, 2, op) == 0)
+                    {
+                        i += 2;
+                        matched = true;
+                        break;
+                    }
+                }
+                if (!matched)
+                {
+                    if (std::string_view("!~-*/%+<>&^|()").find(static_cast<char>(c)) == std::string_view::npos)
+                        fail(fmt::format("Unexpected '{}'", static_cast<char>(c)), start);
+                    i++;
+                }
+            }
+            tokens_.push_back({ text_.substr(start, i - start), start });
+        }
+    }
+
+    bool accept(const char* token)
+    {
+        if (pos_ < tokens_.size() && tokens_[pos_].text == token)
+        {
+            pos_++;
+            return true;
+        }
+        return false;
+    }
+
+    void emit(Op op, uint32_t arg = 0)
+    {
+        out_.code_.push_back({ op, arg });
+        switch (op)
+        {
+        case Op::Const:
+        case Op::Load:
+            depth_++;
+            break;
+        case Op::Not:
+        case Op::Complement:
+        case Op::Negate:
+        case Op::Rise:
+        case Op::Fall:
+        case Op::Changed:
+        case Op::Count:
+            break;
+        default: // binary
+            depth_--;
+        }
+        max_depth_ = std::max(max_depth_, depth_);
+    }
+
+    void emitStateful(Op op)
+    {
+        emit(op, static_cast<uint32_t>(out_.slots_.size()));
+        out_.slots_.push_back(0);
+    }
+
+    void parseBinary(int n)
+    {
+        if (n == kLevels)
+        {
+            parseUnary();
+            return;
+        }
+
+        parseBinary(n + 1);
+        while (true)
+        {
+            const Binary* found = nullptr;
+            for (const Binary& binary : level(n))
+            {
+                if (accept(binary.token))
+                {
+                    found = &binary;
+                    break;
+                }
+            }
+            if (!found)
+                return;
+            parseBinary(n + 1);
+            emit(found->op);
+        }
+    }
+
+    void parseUnary()
+    {
+        if (accept("!"))
+        {
+            parseUnary();
+            emit(Op::Not);
+        }
+        else if (accept("~"))
+        {
+            parseUnary();
+            emit(Op::Complement);
+        }
+        else if (accept("-"))
+        {
+            parseUnary();
+            emit(Op::Negate);
+        }
+        else
+        {
+            parsePostfix();
+        }
+    }
+
+    void parsePostfix()
+    {
+        parsePrimary();
+        while (true)
+        {
+            if (accept("rising"))
+                emitStateful(Op::Rise);
+            else if (accept("falling"))
+                emitStateful(Op::Fall);
+            else if (accept("changed"))
+                emitStateful(Op::Changed);
+            else
+                return;
+        }
+    }
+
+    void parsePrimary()
+    {
+        if (pos_ >= tokens_.size())
+            fail("Missing value");
+
+        if (accept("("))
+        {
+            parseBinary(0);
+            if (!accept(")"))
+                fail("Expected ')'");
+            return;
+        }
+
+        const std::string& token = tokens_[pos_].text;
+        unsigned char first = token[0];
+        if (std::isdigit(first))
+        {
+            emit(Op::Const, parseNumber(token));
+            pos_++;
+            return;
+        }
+        if (!std::isalpha(first) && first != '_')
+            fail("Unexpected '" + token + "'");
+
+        static const std::pair<const char*, Op> functions[] = {
+            { "rise", Op::Rise }, { "fall", Op::Fall }, { "changed", Op::Changed }, { "count", Op::Count }
+        };
+        if (pos_ + 1 < tokens_.size() && tokens_[pos_ + 1].text == "(")
+        {
+            for (const auto& [name, op] : functions)
+            {
+                if (token == name)
+                {
+                    pos_ += 2;
+                    parseBinary(0);
+                    if (!accept(")"))
+                        fail("Expected ')'");
+                    emitStateful(op);
+                    return;
+                }
+            }
+            fail("Unknown function '" + token + "'");
+        }
+
+        const PioVarRef* ref = pio_.find_var_ref(token);
+        if (!ref)
+            fail("Unknown variable '" + token + "'");
+        emit(Op::Load, static_cast<uint32_t>(out_.refs_.size()));
+        out_.refs_.push_back(*ref);
+        pos_++;
+    }
+
+    uint32_t parseNumber(const std::string& token) const
+    {
+        // Decimal, 0x hex or 0b binary: a leading 0 is still decimal, not C's octal
+        std::string_view digits = token;
+        int base = 10;
+        if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X'))
+            base = 16;
+        else if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'b' || digits[1] == 'B'))
+            base = 2;
+        if (base != 10)
+            digits.remove_prefix(2);
+
+        uint32_t value = 0;
+        auto [end, error] = std::from_chars(digits.data(), digits.data() + digits.size(), value, base);
+        if (digits.empty() || error != std::errc() || end != digits.data() + digits.size())
+            fail("Invalid number '" + token + "'");
+        return value;
+    }
+
+    const PioStateMachine& pio_;
+    PioExpression& out_;
+    const std::string& text_;
+    std::vector<Token> tokens_;
+    size_t pos_ = 0;
+    size_t depth_ = 0;
+    size_t max_depth_ = 0;
+};
+
+PioExpression PioExpression::compile(const PioStateMachine& pio, const std::string& text)
+{
+    PioExpression expression;
+    expression.text_ = text;
+    PioExpressionParser(pio, expression).parse();
+    return expression;
+}
+
+void PioExpression::reset()
+{
+    std::fill(slots_.begin(), slots_.end(), 0);
+    last_clock_ = -2;
+}
+
+uint32_t PioExpression::evaluate(const PioStateMachine& pio)
+{
+    if (code_.empty())
+        return 0;
+
+    const bool edges_valid = pio.clock == last_clock_ + 1;
+    const bool new_clock = pio.clock != last_clock_;
+    last_clock_ = pio.clock;
+
+    uint32_t* top = stack_.data(); // one past the top of the stack
+    for (const Instruction& instruction : code_)
+    {
+        switch (instruction.op)
+        {
+        case Op::Const:      *top++ = instruction.arg; break;
+        case Op::Load:       *top++ = refs_[instruction.arg].read(pio); break;
+        case Op::Not:        top[-1] = !top[-1]; break;
+        case Op::Complement: top[-1] = ~top[-1]; break;
+        case Op::Negate:     top[-1] = 0u - top[-1]; break;
+        case Op::Mul:        top--; top[-1] = top[-1] * top[0]; break;
+        case Op::Div:        top--; top[-1] = top[0] ? top[-1] / top[0] : 0; break;
+        case Op::Mod:        top--; top[-1] = top[0] ? top[-1] % top[0] : 0; break;
+        case Op::Add:        top--; top[-1] = top[-1] + top[0]; break;
+        case Op::Sub:        top--; top[-1] = top[-1] - top[0]; break;
+        case Op::Shl:        top--; top[-1] = top[0] < 32 ? top[-1] << top[0] : 0; break;
+        case Op::Shr:        top--; top[-1] = top[0] < 32 ? top[-1] >> top[0] : 0; break;
+        case Op::Lt:         top--; top[-1] = top[-1] < top[0]; break;
+        case Op::Le:         top--; top[-1] = top[-1] <= top[0]; break;
+        case Op::Gt:         top--; top[-1] = top[-1] > top[0]; break;
+        case Op::Ge:         top--; top[-1] = top[-1] >= top[0]; break;
+        case Op::Eq:         top--; top[-1] = top[-1] == top[0]; break;
+        case Op::Ne:         top--; top[-1] = top[-1] != top[0]; break;
+        case Op::BitAnd:     top--; top[-1] = top[-1] & top[0]; break;
+        case Op::BitXor:     top--; top[-1] = top[-1] ^ top[0]; break;
+        case Op::BitOr:      top--; top[-1] = top[-1] | top[0]; break;
+        case Op::And:        top--; top[-1] = top[-1] && top[0]; break;
+        case Op::Or:         top--; top[-1] = top[-1] || top[0]; break;
+        case Op::Rise:
+        case Op::Fall:
+        case Op::Changed:
+        {
+            uint32_t& previous = slots_[instruction.arg];
+            uint32_t value = top[-1];
+            if (instruction.op == Op::Rise)
+                top[-1] = edges_valid && previous == 0 && value != 0;
+            else if (instruction.op == Op::Fall)
+                top[-1] = edges_valid && previous != 0 && value == 0;
+            else
+                top[-1] = edges_valid && previous != value;
+            previous = value;
+            break;
+        }
+        case Op::Count:
+        {
+            uint32_t& count = slots_[instruction.arg];
+            if (new_clock && top[-1])
+                count++;
+            top[-1] = count;
+            break;
+        }
+        }
+    }
+    return top[-1];
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioStateMachine.h"
+
+// Small expression language over the reflected variables (clock, pc, x, gpioN, tx_fifo_count,
+// irqN, ... see setup_var_access), compiled once into stack bytecode that reads the fields through
+// PioVarRef, so evaluating it every cycle costs no name lookups.
+//
+//   values:    decimal, 0x hex, 0b binary numbers and variable names, all uint32_t
+//   operators: C's, with C precedence: ! ~ - (unary), * / %, + -, << >>, < <= > >=, == !=, &, ^, |, &&, ||
+//              (x / 0 and x % 0 are 0, && and || always evaluate both sides)
+//   edges:     rise(e), fall(e), changed(e), or the postfix forms 'e rising', 'e falling', 'e changed':
+//              true for one cycle when e went from 0 to non-zero (and so on) since the previous cycle
+//   counters:  count(e), the number of cycles e has been true for since the last reset()
+//
+// Edges and counters keep their state in the expression: evaluate it once per cycle. Edges are
+// only reported between consecutive clocks, counters only count a clock once.
+class PioExpression
+{
+public:
+    PioExpression() = default;
+
+    // Throws std::runtime_error for unknown variables and syntax errors
+    static PioExpression compile(const PioStateMachine& pio, const std::string& text);
+
+    uint32_t evaluate(const PioStateMachine& pio);
+    bool test(const PioStateMachine& pio) { return evaluate(pio) != 0; }
+    void reset(); // forget the edge history and zero the counters
+
+    const std::string& text() const { return text_; }
+    bool empty() const { return code_.empty(); }
+
+private:
+    friend class PioExpressionParser;
+
+    enum class Op : uint8_t
+    {
+        Const,      // push arg
+        Load,       // push refs[arg]
+        Not,
+        Complement,
+        Negate,
+        Mul,
+        Div,
+        Mod,
+        Add,
+        Sub,
+        Shl,
+        Shr,
+        Lt,
+        Le,
+        Gt,
+        Ge,
+        Eq,
+        Ne,
+        BitAnd,
+        BitXor,
+        BitOr,
+        And,
+        Or,
+        Rise,       // edges and counters keep their state in slots[arg]
+        Fall,
+        Changed,
+        Count
+    };
+
+    struct Instruction
+    {
+        Op op;
+        uint32_t arg = 0;
+    };
+
+    std::string text_;
+    std::vector<Instruction> code_;
+    std::vector<PioVarRef> refs_;
+    std::vector<uint32_t> slots_;
+    std::vector<uint32_t> stack_; // sized to the deepest point of code_ at compile time
+    int last_clock_ = -2;
+};
@@ -0,0 +1,61 @@
+#include "PioFifoStats.h"
+#include <fmt/format.h>
+
+uint64_t PioFifoStats::Histogram::total() const
+{
+    uint64_t sum = 0;
+    for (uint64_t count : cycles)
+        sum += count;
+    return sum;
+}
+
+double PioFifoStats::Histogram::mean() const
+{
+    uint64_t clocks = total();
+    if (clocks == 0)
+        return 0.0;
+
+    double weighted = 0.0;
+    for (int level = 0; level <= kMaxLevel; level++)
+        weighted += static_cast<double>(level) * cycles[level];
+    return weighted / clocks;
+}
+
+const char* PioFifoStats::eventName(EventKind kind)
+{
+    switch (kind)
+    {
+    case EventKind::TxStall:     return "tx_stall";
+    case EventKind::RxStall:     return "rx_stall";
+    case EventKind::RxDropped:   return "rx_dropped";
+    case EventKind::TxEmptyPull: return "tx_empty_pull";
+    default:                     return "?";
+    }
+}
+
+void PioFifoStats::reset()
+{
+    size_t keep_max_events = max_events;
+    *this = PioFifoStats();
+    max_events = keep_max_events;
+}
+
+namespace {
+    std::string histogramJson(const PioFifoStats::Histogram& histogram, uint64_t stall_cycles)
+    {
+        return fmt::format("{{\"histogram\":[{}],\"min\":{},\"max\":{},\"mean\":{:.4f},\"stall_cycles\":{}}}",
+            fmt::join(histogram.cycles, ","), histogram.min, histogram.max, histogram.mean(), stall_cycles);
+    }
+}
+
+std::string PioFifoStats::toJson() const
+{
+    std::string out = fmt::format("{{\"tx\":{},\"rx\":{},\"counts\":{{", histogramJson(tx, tx_stall_cycles), histogramJson(rx, rx_stall_cycles));
+    for (int kind = 0; kind < static_cast<int>(event_counts.size()); kind++)
+        out += fmt::format("{}\"{}\":{}", kind ? "," : "", eventName(static_cast<EventKind>(kind)), event_counts[kind]);
+    out += "},\"events\":[";
+    for (size_t i = 0; i < events.size(); i++)
+        out += fmt::format("{}{{\"kind\":\"{}\",\"clock\":{},\"pc\":{}}}", i ? "," : "", eventName(events[i].kind), events[i].clock, events[i].pc);
+    out += "]}";
+    return out;
+}
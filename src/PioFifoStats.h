@@ -0,0 +1,111 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioStateMachine.h"
+
+// FIFO occupancy and starvation statistics, attach with pio.fifo_stats = &stats.
+//
+// Every clock adds to an occupancy histogram per FIFO (count at the start of the clock) and, while
+// the state machine waits on an empty TX FIFO (pull / autopull) or a full RX FIFO (push / autopush),
+// to the stall counters. The first max_events stall starts, RX_STALL data losses and pulls from an
+// empty TX FIFO are kept with their clock. O(1) per clock, run()'s fast paths add whole spans.
+class PioFifoStats
+{
+public:
+    static constexpr int kMaxLevel = 8; // counts run 0..8 (a joined FIFO is 8 deep)
+
+    struct Histogram
+    {
+        std::array<uint64_t, kMaxLevel + 1> cycles{}; // clocks spent at each level
+        int min = -1;                                 // -1: no clocks seen yet
+        int max = -1;
+
+        void add(int level, uint64_t clocks)
+        {
+            level = level > kMaxLevel ? kMaxLevel : level;
+            cycles[level] += clocks;
+            if (min < 0 || level < min)
+                min = level;
+            if (level > max)
+                max = level;
+        }
+        uint64_t total() const;
+        double mean() const;
+    };
+
+    enum class EventKind
+    {
+        TxStall,     // started waiting on an empty TX FIFO
+        RxStall,     // started waiting on a full RX FIFO
+        RxDropped,   // non-blocking push into a full RX FIFO, the ISR was lost (RX_STALL)
+        TxEmptyPull  // non-blocking pull from an empty TX FIFO, OSR = X
+    };
+    static const char* eventName(EventKind kind);
+
+    struct Event
+    {
+        EventKind kind;
+        int clock;
+        uint32_t pc;
+    };
+
+    Histogram tx;
+    Histogram rx;
+    uint64_t tx_stall_cycles = 0;
+    uint64_t rx_stall_cycles = 0;
+    std::array<uint64_t, 4> event_counts{}; // by EventKind, all of them
+    size_t max_events = 64;
+    std::vector<Event> events;              // the first max_events
+
+    void reset();
+
+    // Called at the start of tick(), 'clocks' > 1 from run()'s fast paths (nothing changes in between)
+    void recordCycles(const PioStateMachine& pio, uint64_t clocks = 1)
+    {
+        tx.add(pio.fifo.tx_fifo_count, clocks);
+        rx.add(pio.fifo.rx_fifo_count, clocks);
+
+        bool tx_starved = txStarved(pio);
+        bool rx_full = pio.delay_delay && pio.fifo.push_is_stalling && pio.fifo.rx_fifo_count >= 4;
+        if (tx_starved)
+        {
+            tx_stall_cycles += clocks;
+            if (!was_tx_starved_)
+                recordEvent(EventKind::TxStall, pio);
+        }
+        if (rx_full)
+        {
+            rx_stall_cycles += clocks;
+            if (!was_rx_full_)
+                recordEvent(EventKind::RxStall, pio);
+        }
+        was_tx_starved_ = tx_starved;
+        was_rx_full_ = rx_full;
+    }
+
+    void recordEvent(EventKind kind, const PioStateMachine& pio)
+    {
+        event_counts[static_cast<int>(kind)]++;
+        if (events.size() < max_events)
+            events.push_back({ kind, pio.clock, pio.regs.pc });
+    }
+
+    uint64_t count(EventKind kind) const { return event_counts[static_cast<int>(kind)]; }
+
+    // {"tx":{"histogram":[...],"min":..,"max":..,"mean":..,"stall_cycles":..},"rx":{...},
+    //  "counts":{"tx_stall":..,...},"events":[{"kind":"rx_dropped","clock":..,"pc":..},...]}
+    std::string toJson() const;
+
+private:
+    static bool txStarved(const PioStateMachine& pio)
+    {
+        // An autopull stall that already refilled the OSR is the one clock s3.5.4 always costs, not starvation
+        return pio.delay_delay && pio.fifo.pull_is_stalling && pio.fifo.tx_fifo_count == 0
+            && (!pio.settings.autopull_enable || pio.regs.osr_shift_count >= pio.settings.pull_threshold);
+    }
+
+    bool was_tx_starved_ = false;
+    bool was_rx_full_ = false;
+};
@@ -0,0 +1,31 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <fmt/format.h>
+
+// Minimal helpers for the JSON reports (profiler, statistics, CLI summaries)
+namespace PioJson {
+
+    inline void appendString(std::string& out, std::string_view text)
+    {
+        out += '"';
+        for (char c : text)
+        {
+            switch (c)
+            {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                    out += fmt::format("\\u{:04x}", static_cast<int>(c));
+                else
+                    out += c;
+            }
+        }
+        out += '"';
+    }
+
+} // namespace PioJson
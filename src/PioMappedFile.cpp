@@ -0,0 +1,74 @@
+#include "PioMappedFile.h"
+#include <stdexcept>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+PioMappedFile::PioMappedFile(const std::string& filepath)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        throw std::runtime_error("Cannot open file: " + filepath);
+    file_handle_ = file;
+    LARGE_INTEGER size{};
+    GetFileSizeEx(file, &size);
+    size_ = static_cast<size_t>(size.QuadPart);
+    if (size_ == 0)
+        return;
+    mapping_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_ != nullptr)
+        data_ = static_cast<const uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+    if (data_ == nullptr)
+    {
+        close();
+        throw std::runtime_error("Cannot map file: " + filepath);
+    }
+#else
+    int fd = ::open(filepath.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error("Cannot open file: " + filepath);
+    struct stat info{};
+    if (::fstat(fd, &info) == 0 && info.st_size > 0)
+    {
+        size_ = static_cast<size_t>(info.st_size);
+        void* map = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED)
+            data_ = static_cast<const uint8_t*>(map);
+    }
+    ::close(fd); // the mapping stays valid
+    if (data_ == nullptr && size_ > 0)
+        throw std::runtime_error("Cannot map file: " + filepath);
+#endif
+}
+
+PioMappedFile::~PioMappedFile()
+{
+    close();
+}
+
+void PioMappedFile::close()
+{
+#ifdef _WIN32
+    if (data_)
+        UnmapViewOfFile(data_);
+    if (mapping_)
+        CloseHandle(mapping_);
+    if (file_handle_)
+        CloseHandle(file_handle_);
+    mapping_ = nullptr;
+    file_handle_ = nullptr;
+#else
+    if (data_)
+        ::munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    data_ = nullptr;
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// A whole file mapped read-only (mmap, MapViewOfFile). Pages are read as they are touched, so a
+// multi-GB trace or capture costs address space rather than memory.
+class PioMappedFile
+{
+public:
+    PioMappedFile() = default;
+    explicit PioMappedFile(const std::string& filepath); // throws std::runtime_error
+    ~PioMappedFile();
+    PioMappedFile(const PioMappedFile&) = delete;
+    PioMappedFile& operator=(const PioMappedFile&) = delete;
+
+    const uint8_t* data() const { return data_; } // nullptr for an empty file
+    size_t size() const { return size_; }
+
+private:
+    void close();
+
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_ = nullptr;
+#endif
+};
@@ -0,0 +1,115 @@
+#include "PioPinStats.h"
+#include <algorithm>
+#include <fmt/format.h>
+
+uint64_t PioPinStats::WidthHistogram::count(int64_t width) const
+{
+    if (width < 0)
+        return 0;
+    return counts[width < kWidthBins - 1 ? width : kWidthBins - 1];
+}
+
+double PioPinStats::Channel::dutyCycle() const
+{
+    uint64_t clocks = high.clocks + low.clocks;
+    return clocks ? static_cast<double>(high.clocks) / clocks : 0.0;
+}
+
+double PioPinStats::Channel::frequency(double clock_hz) const
+{
+    double period_clocks = period.mean();
+    return period_clocks > 0 ? clock_hz / period_clocks : 0.0;
+}
+
+void PioPinStats::watch(int pin)
+{
+    if (pin < 0 || pin >= 32)
+    {
+        LOG_WARNING_FMT("Pin statistics for invalid pin {} ignored", pin);
+        return;
+    }
+    if (find(pin))
+        return;
+    Channel channel;
+    channel.pin = pin;
+    channels.push_back(channel);
+}
+
+PioPinStats::Channel* PioPinStats::find(int pin)
+{
+    if (pin < 0 || pin >= 32)
+        return nullptr;
+    auto it = std::find_if(channels.begin(), channels.end(), [pin](const Channel& channel) { return channel.pin == pin; });
+    return it == channels.end() ? nullptr : &*it;
+}
+
+const PioPinStats::Channel* PioPinStats::find(int pin) const
+{
+    return const_cast<PioPinStats*>(this)->find(pin);
+}
+
+void PioPinStats::reset()
+{
+    for (Channel& channel : channels)
+    {
+        Channel empty;
+        empty.pin = channel.pin;
+        channel = empty;
+    }
+}
+
+void PioPinStats::edge(Channel& channel, int level, int64_t clock)
+{
+    if (channel.level >= 0)
+    {
+        // The pulse that just ended, complete only when it started on an edge we saw
+        if (channel.last_edge >= 0)
+            (channel.level ? channel.high : channel.low).add(clock - channel.last_edge);
+
+        if (level)
+        {
+            channel.rising++;
+            if (channel.last_rise >= 0)
+                channel.period.add(clock - channel.last_rise);
+            channel.last_rise = clock;
+        }
+        else
+        {
+            channel.falling++;
+        }
+        channel.last_edge = clock;
+    }
+    channel.level = level;
+}
+
+namespace {
+    std::string widthsJson(const PioPinStats::WidthHistogram& histogram)
+    {
+        std::string out = fmt::format("{{\"pulses\":{},\"min\":{},\"max\":{},\"mean\":{:.4f},\"histogram\":{{",
+            histogram.pulses, histogram.min, histogram.max, histogram.mean());
+        bool first = true;
+        for (int width = 0; width < PioPinStats::kWidthBins; width++)
+        {
+            if (histogram.counts[width] == 0)
+                continue;
+            out += fmt::format("{}\"{}{}\":{}", first ? "" : ",", width, width == PioPinStats::kWidthBins - 1 ? "+" : "", histogram.counts[width]);
+            first = false;
+        }
+        out += "}}";
+        return out;
+    }
+}
+
+std::string PioPinStats::toJson() const
+{
+    std::string out = "{\"channels\":[";
+    for (size_t i = 0; i < channels.size(); i++)
+    {
+        const Channel& channel = channels[i];
+        out += fmt::format("{}{{\"pin\":{},\"rising\":{},\"falling\":{},\"duty_cycle\":{:.4f},\"high\":{},\"low\":{},\"period\":{}}}",
+            i ? "," : "", channel.pin, channel.rising, channel.falling, channel.dutyCycle(),
+            widthsJson(channel.high), widthsJson(channel.low), widthsJson(channel.period));
+    }
+    out += "]}";
+    return out;
+}
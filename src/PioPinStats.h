@@ -0,0 +1,86 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioStateMachine.h"
+
+// Streaming edge statistics for selected GPIOs, attach with pio.pin_stats = &stats.
+//
+// Only edges are looked at: the level of every watched pin is compared after each clock's pin
+// update, a change closes the pulse before it. Complete high and low pulses and rising-to-rising
+// periods go into fixed-size width histograms (clocks), so millions of bits take the same memory
+// as ten. The partial pulses at the start and end of a run are not counted. run()'s fast paths
+// sample on the clocks that can move a pin and skip the rest, nothing is lost.
+class PioPinStats
+{
+public:
+    static constexpr int kWidthBins = 256; // widths 0..254 exact, longer ones share the last bin
+
+    struct WidthHistogram
+    {
+        std::array<uint64_t, kWidthBins> counts{};
+        uint64_t pulses = 0;
+        uint64_t clocks = 0; // sum of all widths
+        int64_t min = -1;    // -1: nothing seen yet
+        int64_t max = -1;
+
+        void add(int64_t width)
+        {
+            counts[width < kWidthBins - 1 ? width : kWidthBins - 1]++;
+            pulses++;
+            clocks += width;
+            if (min < 0 || width < min)
+                min = width;
+            if (width > max)
+                max = width;
+        }
+        double mean() const { return pulses ? static_cast<double>(clocks) / pulses : 0.0; }
+        uint64_t count(int64_t width) const; // pulses exactly 'width' clocks wide (the last bin: at least)
+    };
+
+    struct Channel
+    {
+        int pin = 0;
+        uint64_t rising = 0;
+        uint64_t falling = 0;
+        WidthHistogram high;   // complete high pulses
+        WidthHistogram low;    // complete low pulses
+        WidthHistogram period; // rising edge to rising edge
+
+        // high time / (high + low time) over the complete pulses, 0 before there are any
+        double dutyCycle() const;
+        // Hz at 'clock_hz' SM clocks per second, from the mean period, 0 before two rising edges
+        double frequency(double clock_hz) const;
+
+        int level = -1;        // -1 until the first sample
+        int64_t last_edge = -1;
+        int64_t last_rise = -1;
+    };
+
+    std::vector<Channel> channels;
+
+    void watch(int pin);               // no-op when already watched, pins outside 0..31 are ignored
+    Channel* find(int pin);            // null when not watched
+    const Channel* find(int pin) const;
+    void reset();                      // clears the counts, keeps the watched pins
+
+    // Called after the pins were updated for clock 'pio.clock' (tick() and executeBlock())
+    void sample(const PioStateMachine& pio)
+    {
+        for (Channel& channel : channels)
+        {
+            int level = pio.gpio.raw_data[channel.pin] == 1 ? 1 : 0;
+            if (level != channel.level)
+                edge(channel, level, pio.clock);
+        }
+    }
+
+    // {"channels":[{"pin":22,"rising":..,"falling":..,"duty_cycle":..,
+    //   "high":{"pulses":..,"min":..,"max":..,"mean":..,"histogram":{"6":..,"3":..}},"low":{...},"period":{...}},...]}
+    // Histograms list only the non-empty widths, the last bin as "255+"
+    std::string toJson() const;
+
+private:
+    static void edge(Channel& channel, int level, int64_t clock);
+};
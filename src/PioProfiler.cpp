@@ -0,0 +1,59 @@
+#include "PioProfiler.h"
+#include <fmt/format.h>
+#include "PioJson.h"
+
+const char* PioProfiler::counterName(Counter counter)
+{
+    static const char* names[kCounters] = { "executing", "delay", "stall_wait", "stall_push", "stall_pull", "stall_irq" };
+    return counter < kCounters ? names[counter] : "?";
+}
+
+uint64_t PioProfiler::total(Counter counter) const
+{
+    uint64_t sum = 0;
+    for (const auto& address : cycles)
+        sum += address[counter];
+    return sum;
+}
+
+uint64_t PioProfiler::total(int address) const
+{
+    uint64_t sum = 0;
+    for (uint64_t count : cycles[address & 31])
+        sum += count;
+    return sum;
+}
+
+uint64_t PioProfiler::total() const
+{
+    uint64_t sum = 0;
+    for (int address = 0; address < 32; address++)
+        sum += total(address);
+    return sum;
+}
+
+std::string PioProfiler::toJson(const PioStateMachine* pio) const
+{
+    std::string out = fmt::format("{{\"total_cycles\":{},\"addresses\":[", total());
+    bool first = true;
+    for (int address = 0; address < 32; address++)
+    {
+        uint64_t address_total = total(address);
+        if (address_total == 0)
+            continue;
+
+        out += first ? "{" : ",{";
+        first = false;
+        out += fmt::format("\"address\":{}", address);
+        if (pio)
+        {
+            out += ",\"instruction\":";
+            PioJson::appendString(out, pio->instruction_text[address]);
+        }
+        for (int counter = 0; counter < kCounters; counter++)
+            out += fmt::format(",\"{}\":{}", counterName(static_cast<Counter>(counter)), cycles[address][counter]);
+        out += fmt::format(",\"total\":{}}}", address_total);
+    }
+    out += "]}";
+    return out;
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include "PioStateMachine.h"
+
+// Per instruction address cycle counters, attach with pio.profiler = &profiler.
+//
+// Every clock lands in exactly one counter of one address: executing (the cycle an instruction is
+// fetched, or an 'exec'd one runs), delay (its [n] delay cycles) or stalled, split by the flag
+// that holds it (wait, push, pull, irq wait). Delay and stall cycles belong to the instruction
+// that caused them. tick() pays one increment per clock, run()'s fast paths add whole spans at
+// once; a machine without a profiler pays a null check.
+class PioProfiler
+{
+public:
+    enum Counter
+    {
+        Executing,
+        Delay,
+        StallWait,
+        StallPush,
+        StallPull,
+        StallIrq,
+        kCounters
+    };
+
+    static const char* counterName(Counter counter); // "executing", "delay", "stall_wait", ...
+
+    std::array<std::array<uint64_t, kCounters>, 32> cycles{}; // [address][counter]
+    uint32_t last_pc = 0; // address of the instruction the delay/stall cycles belong to
+
+    void reset() { *this = PioProfiler(); }
+    uint64_t total(Counter counter) const;
+    uint64_t total(int address) const;
+    uint64_t total() const;
+
+    // Which counter the clock pio is about to run falls in, called at the start of tick()
+    void recordCycle(const PioStateMachine& pio)
+    {
+        if (pio.delay_delay)
+        {
+            cycles[last_pc][stallCause(pio)]++;
+        }
+        else if (pio.regs.delay > 0)
+        {
+            cycles[last_pc][Delay]++;
+        }
+        else
+        {
+            if (!pio.exec_command)
+                last_pc = pio.regs.pc & 31;
+            cycles[last_pc][Executing]++;
+        }
+    }
+
+    // Bulk forms for run()'s fast paths
+    void addExecuted(uint32_t pc, uint64_t delay_cycles)
+    {
+        last_pc = pc & 31;
+        cycles[last_pc][Executing]++;
+        cycles[last_pc][Delay] += delay_cycles;
+    }
+    void addStalled(const PioStateMachine& pio, uint64_t clocks) { cycles[last_pc][stallCause(pio)] += clocks; }
+
+    static Counter stallCause(const PioStateMachine& pio)
+    {
+        if (pio.irq_is_waiting)
+            return StallIrq;
+        if (pio.fifo.pull_is_stalling)
+            return StallPull;
+        if (pio.fifo.push_is_stalling)
+            return StallPush;
+        return StallWait;
+    }
+
+    // {"total_cycles":..., "addresses":[{"address":0,"instruction":"...","executing":...,...,"total":...},...]}
+    // Addresses that never ran are left out, instruction text comes from 'pio' when given
+    std::string toJson(const PioStateMachine* pio = nullptr) const;
+};
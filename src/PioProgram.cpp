@@ -0,0 +1,171 @@
+#include "PioProgram.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <regex>
+#include <stdexcept>
+#include <fmt/format.h>
+#include "PioText.h"
+
+namespace {
+
+    std::string shellQuoted(const std::string& text)
+    {
+#ifdef _WIN32
+        return "\"" + text + "\"";
+#else
+        std::string out = "'";
+        for (char c : text)
+            out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+        return out + "'";
+#endif
+    }
+
+} // namespace
+
+namespace PioProgram {
+
+    void load(PioStateMachine& pio, const std::string& filepath)
+    {
+        if (!std::filesystem::exists(filepath))
+            throw std::runtime_error(fmt::format("Cannot open file: {}", filepath));
+
+        std::string extension = PioText::extensionOf(filepath);
+        if (extension == ".h")
+        {
+            loadPioasmHeader(pio, filepath);
+        }
+        else if (extension == ".pio")
+        {
+            auto header = std::filesystem::temp_directory_path() / fmt::format("pio_emu_{:016x}.h", std::random_device{}() * 0x9e3779b97f4a7c15ull);
+            try
+            {
+                assemble(filepath, header.string());
+                loadPioasmHeader(pio, header.string());
+            }
+            catch (...)
+            {
+                std::error_code ignored;
+                std::filesystem::remove(header, ignored);
+                throw;
+            }
+            std::error_code ignored;
+            std::filesystem::remove(header, ignored);
+        }
+        else
+        {
+            pio.reset(filepath);
+        }
+    }
+
+    void loadPioasmHeader(PioStateMachine& pio, const std::string& filepath, const std::string& program)
+    {
+        std::ifstream file(filepath);
+        if (!file.is_open())
+            throw std::runtime_error(fmt::format("Cannot open file: {}", filepath));
+
+        static const std::regex array_start(R"(^\s*static\s+const\s+uint16_t\s+(\w+)_program_instructions\[\]\s*=\s*\{)");
+        static const std::regex instruction(R"(^\s*(0x[0-9a-fA-F]+)\s*,?\s*(?://\s*(\d+)\s*:\s*(.*))?$)");
+        static const std::regex define(R"(^\s*#define\s+(\w+)_(wrap_target|wrap)\s+(\d+))");
+        static const std::regex config(R"((\w+)_program_get_default_config\s*\()");
+        static const std::regex sideset(R"(sm_config_set_sideset\s*\(\s*&?\w+\s*,\s*(\d+)\s*,\s*(\w+)\s*,\s*(\w+)\s*\))");
+
+        std::string selected = program;
+        std::string config_of;
+        bool in_array = false;
+        bool found = false;
+        int count = 0;
+        int wrap_target = -1, wrap = -1;
+        int sideset_bits = 0;
+        bool sideset_opt = false, sideset_pindirs = false;
+
+        pio.setDefault();
+        pio.instruction_text.fill("");
+        pio.gpio.pindirs.fill(1); // all inputs, as tools/pio_settings_ini_gen.py writes it
+
+        std::string line;
+        std::smatch match;
+        while (std::getline(file, line))
+        {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+
+            if (in_array)
+            {
+                if (line.find("};") != std::string::npos)
+                {
+                    in_array = false;
+                }
+                else if (std::regex_match(line, match, instruction))
+                {
+                    if (count >= 32)
+                        throw std::runtime_error(fmt::format("{}: program '{}' is longer than 32 instructions", filepath, selected));
+                    pio.instructionMemory[count] = static_cast<uint16_t>(std::stoul(match[1].str(), nullptr, 16));
+                    std::string text = match[3].str();
+                    text.erase(text.find_last_not_of(" \t") + 1);
+                    pio.instruction_text[count] = text;
+                    count++;
+                }
+                continue;
+            }
+
+            if (std::regex_search(line, match, array_start))
+            {
+                if (selected.empty())
+                    selected = match[1].str();
+                if (match[1].str() == selected && !found)
+                {
+                    in_array = true;
+                    found = true;
+                }
+            }
+            else if (std::regex_search(line, match, define))
+            {
+                if (selected.empty() || match[1].str() == selected)
+                    (match[2].str() == "wrap" ? wrap : wrap_target) = std::stoi(match[3].str());
+            }
+            else if (std::regex_search(line, match, config))
+            {
+                config_of = match[1].str();
+            }
+            else if (std::regex_search(line, match, sideset) && config_of == selected)
+            {
+                sideset_bits = std::stoi(match[1].str());
+                sideset_opt = match[2].str() == "true" || match[2].str() == "1";
+                sideset_pindirs = match[3].str() == "true" || match[3].str() == "1";
+            }
+        }
+
+        if (!found)
+            throw std::runtime_error(program.empty() ? fmt::format("{}: no pioasm program found", filepath)
+                                                     : fmt::format("{}: no program '{}'", filepath, program));
+        if (count == 0)
+            throw std::runtime_error(fmt::format("{}: program '{}' is empty", filepath, selected));
+
+        pio.settings.wrap_start = static_cast<uint32_t>(wrap_target >= 0 ? wrap_target : 0);
+        pio.settings.wrap_end = static_cast<uint32_t>(wrap >= 0 ? wrap : count - 1);
+        pio.settings.sideset_opt = sideset_opt;
+        pio.settings.sideset_count = sideset_bits - (sideset_opt ? 1 : 0); // the SDK counts the opt bit
+        pio.settings.sideset_to_pindirs = sideset_pindirs;
+    }
+
+    void assemble(const std::string& pio_file, const std::string& header_file, const std::string& pioasm)
+    {
+        std::string tool = pioasm;
+        if (tool.empty())
+        {
+            const char* env = std::getenv("PIOASM");
+            tool = env && *env ? env : "pioasm";
+        }
+
+        std::string command = fmt::format("{} -o c-sdk {} {}", shellQuoted(tool), shellQuoted(pio_file), shellQuoted(header_file));
+#ifdef _WIN32
+        command = "\"" + command + "\""; // cmd.exe strips the outer quotes
+#endif
+        int status = std::system(command.c_str());
+        if (status != 0)
+            throw std::runtime_error(fmt::format("pioasm failed on {} (status {}), set PIOASM to the assembler", pio_file, status));
+    }
+
+} // namespace PioProgram
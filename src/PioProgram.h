@@ -0,0 +1,27 @@
+#pragma once
+#include <string>
+#include "PioStateMachine.h"
+
+// Program files for a PioStateMachine, picked by extension:
+//
+//   .ini  the settings/instructions file the GUI loads (tools/pio_settings_ini_gen.py output)
+//   .h    pioasm's C SDK output (pioasm -o c-sdk): the instruction words and their disassembly
+//         comments, the wrap from the #defines and the side-set from get_default_config()
+//   .pio  a source file, assembled to a temporary .h with pioasm first
+//
+// The program always lands at address 0: jmp targets in pioasm's output are relative to the
+// program start, the SDK relocates them when loading at another offset. Pins, shifts and
+// thresholds live in the C code around a header, apply them with pio.applySetting().
+namespace PioProgram {
+
+    // Everything is reset first; throws std::runtime_error for a missing or unreadable file
+    void load(PioStateMachine& pio, const std::string& filepath);
+
+    // 'program' picks one when the header has several, empty: the first one
+    void loadPioasmHeader(PioStateMachine& pio, const std::string& filepath, const std::string& program = "");
+
+    // Runs pioasm (the 'pioasm' argument, else $PIOASM, else pioasm from the PATH) on a .pio
+    // file; throws std::runtime_error when it fails
+    void assemble(const std::string& pio_file, const std::string& header_file, const std::string& pioasm = "");
+
+} // namespace PioProgram
@@ -0,0 +1,251 @@
+#include "PioRecorder.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+namespace {
+
+    constexpr char kMagic[8] = { 'P', 'I', 'O', 'R', 'E', 'C', '0', '1' };
+
+    // Patches closer than this are merged, a varint pair costs about as much as the gap
+    constexpr size_t kMergeGap = 4;
+
+    void putVarint(std::vector<uint8_t>& out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>((value & 0x7f) | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putSigned(std::vector<uint8_t>& out, int64_t value)
+    {
+        putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    // Reads from 'data' at 'pos', throws on a truncated buffer
+    uint64_t getVarint(const std::vector<uint8_t>& data, size_t& pos)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (pos >= data.size())
+                throw std::runtime_error("Truncated recording");
+            uint8_t byte = data[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return value;
+        }
+        throw std::runtime_error("Corrupt recording");
+    }
+
+    int64_t getSigned(const std::vector<uint8_t>& data, size_t& pos)
+    {
+        uint64_t raw = getVarint(data, pos);
+        return static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    }
+
+    uint8_t* bytesOf(PioSnapshot& snapshot) { return reinterpret_cast<uint8_t*>(&snapshot); }
+    const uint8_t* bytesOf(const PioSnapshot& snapshot) { return reinterpret_cast<const uint8_t*>(&snapshot); }
+
+    uint64_t stateHash(const PioStateMachine& pio)
+    {
+        PioSnapshot snapshot{};
+        snapshot.capture(pio);
+        return snapshot.hash();
+    }
+
+} // namespace
+
+static_assert(std::is_trivially_copyable_v<PioSnapshot>, "recordings patch PioSnapshot bytes");
+
+/* ----- PioRecording ----- */
+
+void PioRecording::clear()
+{
+    initial = PioSnapshot{};
+    events.clear();
+    event_count = 0;
+    end_clock = -1;
+    end_hash = 0;
+}
+
+void PioRecording::save(const std::string& filepath) const
+{
+    std::vector<uint8_t> header(std::begin(kMagic), std::end(kMagic));
+    putVarint(header, sizeof(PioSnapshot));
+    header.insert(header.end(), bytesOf(initial), bytesOf(initial) + sizeof(PioSnapshot));
+    putVarint(header, static_cast<uint64_t>(end_clock + 1));
+    for (int i = 0; i < 8; i++)
+        header.push_back(static_cast<uint8_t>(end_hash >> (8 * i)));
+    putVarint(header, event_count);
+
+    std::ofstream file(filepath, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Cannot open file: " + filepath);
+    file.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+    file.write(reinterpret_cast<const char*>(events.data()), static_cast<std::streamsize>(events.size()));
+    if (!file)
+        throw std::runtime_error("Cannot write file: " + filepath);
+}
+
+void PioRecording::load(const std::string& filepath)
+{
+    std::ifstream file(filepath, std::ios::binary);
+    if (!file)
+        throw std::runtime_error("Cannot open file: " + filepath);
+    std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    if (data.size() < sizeof(kMagic) || std::memcmp(data.data(), kMagic, sizeof(kMagic)) != 0)
+        throw std::runtime_error("Not a pio_emu recording: " + filepath);
+    size_t pos = sizeof(kMagic);
+    if (getVarint(data, pos) != sizeof(PioSnapshot))
+        throw std::runtime_error("Recording made by a build with a different state layout: " + filepath);
+    if (data.size() - pos < sizeof(PioSnapshot) + 1)
+        throw std::runtime_error("Truncated recording");
+
+    clear();
+    std::memcpy(bytesOf(initial), data.data() + pos, sizeof(PioSnapshot));
+    pos += sizeof(PioSnapshot);
+    end_clock = static_cast<int>(getVarint(data, pos)) - 1;
+    if (data.size() - pos < 8)
+        throw std::runtime_error("Truncated recording");
+    for (int i = 0; i < 8; i++)
+        end_hash |= static_cast<uint64_t>(data[pos++]) << (8 * i);
+    event_count = getVarint(data, pos);
+    events.assign(data.begin() + static_cast<std::ptrdiff_t>(pos), data.end());
+}
+
+/* ----- PioRecorder ----- */
+
+void PioRecorder::start(const PioStateMachine& pio)
+{
+    recording.clear();
+    recording.initial.capture(pio);
+    last_ = recording.initial;
+    last_clock_ = 0;
+}
+
+void PioRecorder::beforeCycle(const PioStateMachine& pio)
+{
+    record(pio);
+}
+
+void PioRecorder::afterCycle(const PioStateMachine& pio)
+{
+    last_.capture(pio);
+}
+
+void PioRecorder::finish(const PioStateMachine& pio)
+{
+    record(pio);
+    recording.end_clock = pio.clock;
+    recording.end_hash = stateHash(pio);
+}
+
+void PioRecorder::record(const PioStateMachine& pio)
+{
+    now_.capture(pio);
+    const uint8_t* before = bytesOf(last_);
+    const uint8_t* after = bytesOf(now_);
+    if (std::memcmp(before, after, sizeof(PioSnapshot)) == 0)
+        return;
+
+    // Runs of changed bytes, [begin, end)
+    std::vector<std::pair<size_t, size_t>> runs;
+    for (size_t i = 0; i < sizeof(PioSnapshot); i++)
+    {
+        if (before[i] == after[i])
+            continue;
+        if (!runs.empty() && i - runs.back().second < kMergeGap)
+            runs.back().second = i + 1;
+        else
+            runs.push_back({ i, i + 1 });
+    }
+
+    std::vector<uint8_t>& out = recording.events;
+    putSigned(out, static_cast<int64_t>(pio.clock) - last_clock_);
+    putVarint(out, runs.size());
+    size_t previous_end = 0;
+    for (auto [begin, end] : runs)
+    {
+        putVarint(out, begin - previous_end);
+        putVarint(out, end - begin);
+        out.insert(out.end(), after + begin, after + end);
+        previous_end = end;
+    }
+    recording.event_count++;
+    last_clock_ = pio.clock;
+    last_ = now_;
+}
+
+/* ----- PioReplay ----- */
+
+void PioReplay::begin(PioStateMachine& pio)
+{
+    recording_.initial.restore(pio);
+    position_ = 0;
+    events_left_ = recording_.event_count;
+    next_clock_ = 0;
+    decodeNextClock();
+}
+
+bool PioReplay::replay(PioStateMachine& pio)
+{
+    begin(pio);
+    if (recording_.end_clock < 0)
+        return false;
+
+    pio.input_sources.push_back(this);
+    if (recording_.end_clock > pio.clock)
+        pio.run(recording_.end_clock - pio.clock);
+    std::erase(pio.input_sources, static_cast<PioInputSource*>(this));
+    return finish(pio);
+}
+
+bool PioReplay::finish(PioStateMachine& pio)
+{
+    apply(pio);
+    return pio.clock == recording_.end_clock && stateHash(pio) == recording_.end_hash;
+}
+
+void PioReplay::decodeNextClock()
+{
+    // next_clock_ holds the previous event's clock (0 before the first)
+    if (events_left_ == 0)
+    {
+        next_clock_ = -1;
+        return;
+    }
+    next_clock_ = static_cast<int>(next_clock_ + getSigned(recording_.events, position_));
+}
+
+void PioReplay::apply(PioStateMachine& pio)
+{
+    const std::vector<uint8_t>& data = recording_.events;
+    while (next_clock_ >= 0 && next_clock_ <= pio.clock)
+    {
+        scratch_.capture(pio);
+        uint8_t* bytes = bytesOf(scratch_);
+        size_t patches = getVarint(data, position_);
+        size_t offset = 0;
+        for (size_t i = 0; i < patches; i++)
+        {
+            offset += getVarint(data, position_);
+            size_t length = getVarint(data, position_);
+            if (offset + length > sizeof(PioSnapshot) || position_ + length > data.size())
+                throw std::runtime_error("Corrupt recording");
+            std::memcpy(bytes + offset, data.data() + position_, length);
+            position_ += length;
+            offset += length;
+        }
+        scratch_.restore(pio);
+        events_left_--;
+        decodeNextClock();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioSnapshot.h"
+#include "PioStateMachine.h"
+
+// Record/replay of everything that reaches a state machine from outside, for bit-exact reruns.
+//
+// The recorder compares the machine at the start of every cycle (after the input sources) with
+// where the previous cycle left it. Whatever differs came from outside: external_data from
+// stimulus or devices, host FIFO writes and reads, IRQ pokes, set_var() or GUI edits. Only those
+// bytes are kept, so a replay needs none of the original harness: restore the initial state,
+// attach a PioReplay and run() headless to the same state hash.
+//
+// Offsets are into PioSnapshot, so a recording is only read back by a build with the same layout
+// (the header carries sizeof(PioSnapshot) and load() checks it).
+//
+// File: 8 byte magic, varint snapshot size, the initial snapshot, varint end clock + 1 (0: not
+// finished), u64 end hash, varint event count, then per event: varint clock delta, varint patch
+// count, per patch varint offset delta (from the end of the previous patch), varint length, bytes.
+struct PioRecording
+{
+    PioSnapshot initial{};
+    std::vector<uint8_t> events; // encoded as in the file
+    size_t event_count = 0;
+    int end_clock = -1;          // set by PioRecorder::finish()
+    uint64_t end_hash = 0;
+
+    void clear();
+    void save(const std::string& filepath) const; // throws std::runtime_error
+    void load(const std::string& filepath);       // throws std::runtime_error
+};
+
+// Attach with pio.recorder = &recorder after start(). Forces run() through tick(), the fast paths
+// can't see host pokes between their cycles.
+class PioRecorder
+{
+public:
+    PioRecording recording;
+
+    void start(const PioStateMachine& pio);         // clears, takes the initial state
+    void beforeCycle(const PioStateMachine& pio);    // called by tick() after the input sources
+    void afterCycle(const PioStateMachine& pio);     // called by tick() at its end
+    void finish(const PioStateMachine& pio);         // pokes since the last cycle, end clock and hash
+
+private:
+    void record(const PioStateMachine& pio);
+
+    PioSnapshot last_{}; // where the last cycle left the machine
+    PioSnapshot now_{};
+    int last_clock_ = 0; // of the previous event
+};
+
+// Plays a recording's changes back at their clocks (the recording is not owned).
+class PioReplay : public PioInputSource
+{
+public:
+    explicit PioReplay(const PioRecording& recording) : recording_(recording) {}
+
+    void begin(PioStateMachine& pio);  // restores the initial state, rewinds
+    // begin(), run() to the end clock, finish(): true when the state hash matches
+    bool replay(PioStateMachine& pio);
+    bool finish(PioStateMachine& pio); // applies what is due at the current clock, compares the hash
+
+    int nextEventClock() const override { return next_clock_; }
+    void apply(PioStateMachine& pio) override;
+
+private:
+    void decodeNextClock();
+
+    const PioRecording& recording_;
+    size_t position_ = 0;     // into recording_.events
+    size_t events_left_ = 0;
+    int next_clock_ = -1;
+    PioSnapshot scratch_{};
+};
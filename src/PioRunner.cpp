@@ -0,0 +1,587 @@
+#include "PioRunner.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <fmt/format.h>
+#include "PioBitOps.h"
+#include "PioBreakpoints.h"
+#include "PioJson.h"
+#include "PioProfiler.h"
+#include "PioProgram.h"
+#include "PioSigrok.h"
+#include "PioStateHash.h"
+#include "PioStimulus.h"
+#include "PioText.h"
+#include "PioTrace.h"
+
+void PioHostFifos::rewind()
+{
+    rx.clear();
+    next_tx_ = 0;
+    next_clock_ = 0;
+}
+
+bool PioHostFifos::canPush(const PioStateMachine& pio)
+{
+    for (uint16_t instruction : pio.instructionMemory)
+    {
+        int opcode = instruction >> 13;
+        int destination = (instruction >> 5) & 0x7;
+        if (opcode == 0b100 && !(instruction & 0x80)) // push
+            return true;
+        if (opcode == 0b010 && pio.settings.in_shift_autopush) // in, with autopush
+            return true;
+        if ((opcode == 0b011 && destination == 0b111) || (opcode == 0b101 && destination == 0b100)) // out/mov exec: anything
+            return true;
+    }
+    return false;
+}
+
+void PioHostFifos::apply(PioStateMachine& pio)
+{
+    auto& fifo = pio.fifo;
+    while (fifo.tx_fifo_count < 4 && next_tx_ < tx.size())
+        fifo.tx_fifo[fifo.tx_fifo_count++] = tx[next_tx_++];
+
+    if (drain_rx)
+        drain(pio);
+
+    // The earliest clock the TX FIFO can run dry or the RX FIFO fill up
+    int next = -1;
+    if (next_tx_ < tx.size())
+    {
+        next = pio.clock + std::max<int>(fifo.tx_fifo_count, 1);
+    }
+    else if (drain_rx && canPush(pio))
+    {
+        bool waiting_outside = pio.wait_is_stalling || pio.irq_is_waiting || (fifo.pull_is_stalling && fifo.tx_fifo_count == 0);
+        if (pio.delay_delay && waiting_outside)
+        {
+            // Stalled on wait, irq wait or a pull with no words coming: nothing moves until
+            // another source changes something (run() fast-forwards to there), look again then
+            for (const PioInputSource* source : pio.input_sources)
+            {
+                int source_next = source == this ? -1 : source->nextEventClock();
+                if (source_next >= 0)
+                    source_next = std::max(source_next, pio.clock + 1);
+                if (source_next >= 0 && (next < 0 || source_next < next))
+                    next = source_next;
+            }
+        }
+        else
+        {
+            next = pio.clock + 4;
+        }
+    }
+    next_clock_ = next;
+}
+
+void PioHostFifos::drain(PioStateMachine& pio)
+{
+    auto& fifo = pio.fifo;
+    for (int i = 0; i < fifo.rx_fifo_count; i++)
+    {
+        rx.push_back(fifo.rx_fifo[i]);
+        fifo.rx_fifo[i] = 0;
+    }
+    fifo.rx_fifo_count = 0;
+}
+
+std::vector<uint32_t> PioHostFifos::loadWords(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if (!file)
+        throw std::runtime_error("Cannot open file: " + filepath);
+
+    std::vector<uint32_t> words;
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        line = line.substr(0, line.find_first_of("#;"));
+        std::replace(line.begin(), line.end(), ',', ' ');
+
+        size_t pos = 0;
+        while ((pos = line.find_first_not_of(" \t\r", pos)) != std::string::npos)
+        {
+            size_t end = line.find_first_of(" \t\r", pos);
+            std::string token = line.substr(pos, end - pos);
+            pos = end;
+            try
+            {
+                size_t used = 0;
+                unsigned long long value = std::stoull(token, &used, 0);
+                if (used != token.size() || value > UINT32_MAX)
+                    throw std::invalid_argument(token);
+                words.push_back(static_cast<uint32_t>(value));
+            }
+            catch (const std::exception&)
+            {
+                throw std::runtime_error(fmt::format("{}:{}: not a 32-bit word: {}", filepath, line_number, token));
+            }
+        }
+    }
+    return words;
+}
+
+void PioHostFifos::saveWords(const std::string& filepath, const std::vector<uint32_t>& words)
+{
+    std::FILE* file = std::fopen(filepath.c_str(), "w");
+    if (!file)
+        throw std::runtime_error("Cannot write file: " + filepath);
+    for (uint32_t word : words)
+        fmt::print(file, "0x{:08x}\n", word);
+    bool failed = std::ferror(file) != 0;
+    if (std::fclose(file) != 0 || failed)
+        throw std::runtime_error("Cannot write file: " + filepath);
+}
+
+namespace PioRunner {
+
+    namespace {
+
+        int64_t parseInteger(const std::string& option, const std::string& text, int64_t min, int64_t max)
+        {
+            try
+            {
+                int64_t value = PioText::parseNumber(text);
+                if (value >= min && value <= max)
+                    return value;
+            }
+            catch (const std::invalid_argument&)
+            {
+            }
+            throw std::invalid_argument(fmt::format("{}: expected a number from {} to {}, got '{}'", option, min, max, text));
+        }
+
+        std::vector<int> parsePins(const std::string& option, const std::string& text)
+        {
+            try
+            {
+                return PioText::parsePins(text);
+            }
+            catch (const std::invalid_argument& e)
+            {
+                throw std::invalid_argument(fmt::format("{}: {}", option, e.what()));
+            }
+        }
+
+        std::pair<std::string, std::string> parseAssignment(const std::string& option, const std::string& text)
+        {
+            size_t equal = text.find('=');
+            if (equal == std::string::npos || equal == 0)
+                throw std::invalid_argument(fmt::format("{}: expected name=value, got '{}'", option, text));
+            return { text.substr(0, equal), text.substr(equal + 1) };
+        }
+
+        void writeText(const std::string& filepath, const std::string& text)
+        {
+            std::FILE* file = std::fopen(filepath.c_str(), "w");
+            if (!file)
+                throw std::runtime_error("Cannot write file: " + filepath);
+            bool failed = std::fwrite(text.data(), 1, text.size(), file) != text.size();
+            if (std::fclose(file) != 0 || failed)
+                throw std::runtime_error("Cannot write file: " + filepath);
+        }
+
+    } // namespace
+
+    Options parseArgs(const std::vector<std::string>& args)
+    {
+        Options options;
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            const std::string& arg = args[i];
+            if (arg.empty() || arg[0] != '-')
+            {
+                if (!options.program.empty())
+                    throw std::invalid_argument(fmt::format("more than one program: '{}' and '{}'", options.program, arg));
+                options.program = arg;
+                continue;
+            }
+            if (arg == "--json")
+            {
+                options.json = true;
+                continue;
+            }
+            if (arg == "--list-vars")
+            {
+                options.list_vars = true;
+                continue;
+            }
+
+            if (i + 1 >= args.size())
+                throw std::invalid_argument(fmt::format("{} needs a value", arg));
+            const std::string& value = args[++i];
+            if (arg == "--set")
+                options.settings.push_back(parseAssignment(arg, value));
+            else if (arg == "--var")
+            {
+                auto [name, text] = parseAssignment(arg, value);
+                options.vars.emplace_back(name, static_cast<uint32_t>(parseInteger(arg, text, INT32_MIN, UINT32_MAX)));
+            }
+            else if (arg == "--cycles")
+                options.cycles = parseInteger(arg, value, 0, INT_MAX);
+            else if (arg == "--until")
+                options.until.push_back(value);
+            else if (arg == "--break")
+                options.break_pcs.push_back(static_cast<int>(parseInteger(arg, value, 0, 31)));
+            else if (arg == "--clock")
+            {
+                size_t used = 0;
+                try
+                {
+                    options.sm_clock_hz = std::stod(value, &used);
+                }
+                catch (const std::exception&)
+                {
+                }
+                if (used != value.size() || !(options.sm_clock_hz > 0))
+                    throw std::invalid_argument(fmt::format("{}: expected a frequency in Hz, got '{}'", arg, value));
+            }
+            else if (arg == "--stimulus")
+                options.stimulus = value;
+            else if (arg == "--capture")
+                options.capture = value;
+            else if (arg == "--tx")
+                options.tx_file = value;
+            else if (arg == "--rx")
+                options.rx_file = value;
+            else if (arg == "--trace")
+                options.trace_file = value;
+            else if (arg == "--profile")
+                options.profile_file = value;
+            else if (arg == "--hash")
+                options.hash_file = value;
+            else if (arg == "--expect-hash")
+                options.expect_hash = value;
+            else if (arg == "--hash-interval")
+                options.hash_interval = static_cast<int>(parseInteger(arg, value, 1, INT_MAX));
+            else if (arg == "--sr")
+                options.sr_file = value;
+            else if (arg == "--pins")
+                options.sr_pins = parsePins(arg, value);
+            else if (arg == "--summary")
+                options.summary_file = value;
+            else if (arg == "--log")
+                options.log_file = value;
+            else
+                throw std::invalid_argument(fmt::format("unknown option {}", arg));
+        }
+
+        if (options.program.empty() && !options.list_vars)
+            throw std::invalid_argument("no program given");
+        if (!options.sr_file.empty() && options.sr_pins.empty())
+            throw std::invalid_argument("--sr needs --pins");
+        return options;
+    }
+
+    std::vector<std::string> splitLine(const std::string& line)
+    {
+        std::vector<std::string> words;
+        std::string word;
+        bool in_word = false;
+        char quote = 0;
+        for (char c : line)
+        {
+            if (quote)
+            {
+                if (c == quote)
+                    quote = 0;
+                else
+                    word += c;
+            }
+            else if (c == '"' || c == '\'')
+            {
+                quote = c;
+                in_word = true;
+            }
+            else if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                if (in_word)
+                    words.push_back(std::move(word));
+                word.clear();
+                in_word = false;
+            }
+            else
+            {
+                word += c;
+                in_word = true;
+            }
+        }
+        if (quote)
+            throw std::invalid_argument("unterminated quote");
+        if (in_word)
+            words.push_back(std::move(word));
+        return words;
+    }
+
+    void printUsage()
+    {
+        fmt::println(stderr, "usage: pio_emu_cli <program> [options]");
+        fmt::println(stderr, "       pio_emu_cli --batch <jobs> [-j N]");
+        fmt::println(stderr, "  program: .ini, pioasm .h output, or .pio (assembled with $PIOASM or pioasm)");
+        fmt::println(stderr, "  --set key=value     .ini [settings] key applied after loading (out_base, pindir, ...)");
+        fmt::println(stderr, "  --var name=value    variable set before running (x, y, pc, gpioN, ...)");
+        fmt::println(stderr, "  --cycles N          clocks to run, default 1000000");
+        fmt::println(stderr, "  --until EXPR        stop before the first cycle EXPR holds at, e.g. \"pc == 3 && x == 0\"");
+        fmt::println(stderr, "  --break PC          stop before the instruction at PC is fetched");
+        fmt::println(stderr, "  --clock HZ          state machine clock for VCD and capture timing, default 125e6");
+        fmt::println(stderr, "  --stimulus FILE     input transitions, .csv (clock,pin,value) or .vcd");
+        fmt::println(stderr, "  --capture FILE      logic analyser capture replayed on the inputs, .sr or sigrok .csv");
+        fmt::println(stderr, "  --tx FILE           words fed to the TX FIFO whenever it has room");
+        fmt::println(stderr, "  --rx FILE           the RX FIFO drained as it fills, one word per line");
+        fmt::println(stderr, "  --trace FILE        cycle trace, see pio_emu_trace");
+        fmt::println(stderr, "  --profile FILE      per-address cycle counters, JSON");
+        fmt::println(stderr, "  --hash FILE         state hash marks, see pio_emu_hashdiff");
+        fmt::println(stderr, "  --hash-interval N   clocks per mark, default 1024");
+        fmt::println(stderr, "  --expect-hash FILE  compare the marks with a golden run");
+        fmt::println(stderr, "  --sr FILE --pins L  sigrok session of the pins, L like 0-3,22");
+        fmt::println(stderr, "  --summary FILE      write the JSON summary to a file");
+        fmt::println(stderr, "  --json              print the summary as JSON");
+        fmt::println(stderr, "  --log FILE          the emulator's log (not shown otherwise)");
+        fmt::println(stderr, "  --list-vars         print the variable names --var, --until and watches take");
+        fmt::println(stderr, "  batch: one job per line (program and options), '#' comments; -j runs N at once (0: per core)");
+        fmt::println(stderr, "  exit status 0: ok, 1: a check failed (hash diverged, --until/--break never hit), 2: error");
+    }
+
+    int Result::exitCode() const
+    {
+        if (stop == "error")
+            return 2;
+        if (diverged || !expected_stop)
+            return 1;
+        return 0;
+    }
+
+    std::string Result::toJson() const
+    {
+        std::string out = "{\"program\":";
+        PioJson::appendString(out, program);
+        out += ",\"stop\":";
+        PioJson::appendString(out, stop);
+        out += ",\"detail\":";
+        PioJson::appendString(out, detail);
+        out += fmt::format(",\"cycles\":{},\"clock\":{},\"pc\":{},\"x\":{},\"y\":{},\"pins\":{}", cycles, clock, pc, x, y, pins);
+        out += fmt::format(",\"seconds\":{:.6f},\"cycles_per_second\":{:.0f}", seconds, seconds > 0 ? cycles / seconds : 0.0);
+        out += fmt::format(",\"tx_words\":{},\"tx_left\":{},\"rx_words\":{}", tx_words, tx_left, rx_words);
+        if (hashed)
+            out += fmt::format(",\"hash\":\"{:016x}\"", hash);
+        if (hash_checked)
+            out += fmt::format(",\"diverged\":{},\"good_clock\":{},\"bad_clock\":{}", diverged, good_clock, bad_clock);
+        out += fmt::format(",\"exit_code\":{}}}", exitCode());
+        return out;
+    }
+
+    std::string Result::toText() const
+    {
+        if (stop == "error")
+            return fmt::format("{}: error: {}", program, detail);
+
+        std::string out = fmt::format("{}: {} cycles, stopped by {}{}{}", program, cycles, stop, detail.empty() ? "" : ": ", detail);
+        out += fmt::format("\n  clock {}  pc {}  x {:08x}  y {:08x}  pins {:08x}", clock, pc, x, y, pins);
+        out += fmt::format("\n  {:.3f} s, {:.2f} Mcycles/s", seconds, seconds > 0 ? cycles / seconds / 1e6 : 0.0);
+        if (tx_words || tx_left || rx_words)
+            out += fmt::format("\n  tx {} words sent, {} left  rx {} words", tx_words, tx_left, rx_words);
+        if (hashed)
+            out += fmt::format("\n  state hash {:016x}", hash);
+        if (hash_checked)
+            out += diverged ? fmt::format("  DIVERGED between clocks {} and {}", good_clock, bad_clock) : std::string("  matches");
+        if (!expected_stop)
+            out += "\n  the stop condition never came";
+        return out;
+    }
+
+    Result run(const Options& options)
+    {
+        Result result;
+        result.program = options.program;
+        result.expected_stop = options.until.empty() && options.break_pcs.empty();
+        try
+        {
+            PioStateMachine pio;
+            PioProgram::load(pio, options.program);
+            for (const auto& [key, value] : options.settings)
+            {
+                if (!pio.applySetting(key, value))
+                    throw std::invalid_argument("unknown setting: " + key);
+            }
+            for (const auto& [name, value] : options.vars)
+            {
+                if (!pio.var_setters.contains(name))
+                    throw std::invalid_argument("unknown variable: " + name);
+                pio.set_var(name, value);
+            }
+
+            // Inputs
+            PioStimulus stimulus;
+            if (!options.stimulus.empty())
+            {
+                if (PioText::extensionOf(options.stimulus) == ".vcd")
+                    stimulus.loadVcd(options.stimulus, options.sm_clock_hz);
+                else
+                    stimulus.loadCsv(options.stimulus);
+                pio.input_sources.push_back(&stimulus);
+            }
+            std::unique_ptr<PioSigrokCapture> capture;
+            if (!options.capture.empty())
+            {
+                PioSigrokCapture::Options capture_options;
+                capture_options.sm_clock_hz = options.sm_clock_hz;
+                capture_options.start_clock = pio.clock;
+                capture = std::make_unique<PioSigrokCapture>(options.capture, capture_options);
+                pio.input_sources.push_back(capture.get());
+            }
+            PioHostFifos host;
+            if (!options.tx_file.empty() || !options.rx_file.empty())
+            {
+                if (!options.tx_file.empty())
+                    host.tx = PioHostFifos::loadWords(options.tx_file);
+                host.drain_rx = !options.rx_file.empty();
+                pio.input_sources.push_back(&host);
+            }
+
+            // Stops
+            PioBreakpoints breakpoints;
+            for (const std::string& condition : options.until)
+                breakpoints.addCondition(pio, condition);
+            for (int address : options.break_pcs)
+                breakpoints.setPc(address);
+            if (!breakpoints.empty())
+                pio.breakpoints = &breakpoints;
+
+            // Instruments
+            PioProfiler profiler;
+            if (!options.profile_file.empty())
+                pio.profiler = &profiler;
+            PioStateHash golden;
+            if (!options.expect_hash.empty())
+                golden.load(options.expect_hash);
+            PioStateHash state_hash(options.expect_hash.empty() ? options.hash_interval : golden.interval);
+            if (!options.hash_file.empty() || !options.expect_hash.empty())
+            {
+                state_hash.reset(pio.clock);
+                pio.state_hash = &state_hash;
+            }
+            std::unique_ptr<PioTrace::Writer> tracer;
+            if (!options.trace_file.empty())
+            {
+                tracer = std::make_unique<PioTrace::Writer>(options.trace_file);
+                pio.tracer = tracer.get();
+            }
+            std::unique_ptr<PioSigrokWriter> sigrok;
+            if (!options.sr_file.empty())
+            {
+                sigrok = std::make_unique<PioSigrokWriter>(options.sr_file, options.sr_pins, options.sm_clock_hz);
+                sigrok->begin(pio);
+            }
+
+            if (options.cycles > INT_MAX - static_cast<int64_t>(pio.clock))
+                throw std::invalid_argument("--cycles runs past the 32-bit clock");
+
+            auto start = std::chrono::steady_clock::now();
+            const int start_clock = pio.clock;
+            pio.run(static_cast<int>(options.cycles));
+            result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            result.cycles = pio.clock - start_clock;
+            result.stop = "cycles";
+            if (breakpoints.hit().kind != PioBreakpoints::Kind::None)
+            {
+                result.stop = "breakpoint";
+                result.detail = breakpoints.describe(breakpoints.hit());
+                result.expected_stop = true;
+            }
+            result.clock = pio.clock;
+            result.pc = pio.regs.pc;
+            result.x = pio.regs.x;
+            result.y = pio.regs.y;
+            result.pins = PioBitOps::gatherPins(pio.gpio.raw_data);
+
+            // Outputs
+            if (sigrok)
+                sigrok->finish(pio);
+            if (tracer)
+            {
+                pio.tracer = nullptr;
+                tracer->close();
+            }
+            if (!options.profile_file.empty())
+                writeText(options.profile_file, profiler.toJson(&pio));
+            if (pio.state_hash)
+            {
+                state_hash.finish(pio);
+                result.hashed = true;
+                result.hash = state_hash.current();
+                if (!options.hash_file.empty())
+                    state_hash.save(options.hash_file);
+                if (!options.expect_hash.empty())
+                {
+                    PioStateHash::Divergence divergence = PioStateHash::compare(golden, state_hash);
+                    result.hash_checked = true;
+                    result.diverged = divergence.found;
+                    result.good_clock = divergence.good_clock;
+                    result.bad_clock = divergence.bad_clock;
+                }
+            }
+            if (host.drain_rx)
+            {
+                host.drain(pio); // what the program pushed since the last look, the machine is done
+                PioHostFifos::saveWords(options.rx_file, host.rx);
+            }
+            result.tx_words = host.txSent();
+            result.tx_left = host.tx.size() - host.txSent();
+            result.rx_words = host.rx.size();
+        }
+        catch (const std::exception& e)
+        {
+            result.stop = "error";
+            result.detail = e.what();
+        }
+
+        if (!options.summary_file.empty())
+        {
+            try
+            {
+                writeText(options.summary_file, result.toJson() + "\n");
+            }
+            catch (const std::exception& e)
+            {
+                result.stop = "error";
+                result.detail = e.what();
+            }
+        }
+        return result;
+    }
+
+    std::vector<Result> runBatch(const std::vector<Options>& jobs, unsigned threads)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::min<unsigned>(threads, static_cast<unsigned>(std::max<size_t>(jobs.size(), 1)));
+
+        std::vector<Result> results(jobs.size());
+        std::atomic<size_t> next{ 0 };
+        auto worker = [&]() {
+            for (size_t job = next++; job < jobs.size(); job = next++)
+                results[job] = run(jobs[job]);
+        };
+
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; i++)
+            pool.emplace_back(worker);
+        worker();
+        for (std::thread& thread : pool)
+            thread.join();
+        return results;
+    }
+
+} // namespace PioRunner
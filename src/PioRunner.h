@@ -0,0 +1,106 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+#include "PioStateMachine.h"
+
+// The host end of the FIFOs, the way a DMA channel runs it: tops the TX FIFO up from a word list
+// and empties the RX FIFO into another. The state machine moves at most one word per clock each
+// way, so looking again after as many clocks as the FIFO had room or words is enough: a pull
+// never finds TX empty while words are left, a push never finds RX full.
+class PioHostFifos : public PioInputSource
+{
+public:
+    std::vector<uint32_t> tx;    // fed in order
+    std::vector<uint32_t> rx;    // drained, when drain_rx
+    bool drain_rx = false;
+
+    size_t txSent() const { return next_tx_; }
+    void drain(PioStateMachine& pio); // RX FIFO into rx
+    void rewind();
+
+    // RX is only looked at while the program can push (a push, autopush or exec in its memory)
+    // and isn't stalled on anything else
+    int nextEventClock() const override { return next_clock_; }
+    void apply(PioStateMachine& pio) override;
+
+    // Whitespace or comma separated words, decimal or 0x hex, '#' and ';' start a comment;
+    // throws std::runtime_error
+    static std::vector<uint32_t> loadWords(const std::string& filepath);
+    static void saveWords(const std::string& filepath, const std::vector<uint32_t>& words); // one 0x%08x per line
+
+private:
+    static bool canPush(const PioStateMachine& pio);
+
+    size_t next_tx_ = 0;
+    int next_clock_ = 0; // -1: nothing left to do
+};
+
+// Headless sessions, what pio_emu_cli runs: load a program, attach the inputs and instruments the
+// options ask for, run to a cycle count or a stop condition, write the outputs and summarise.
+namespace PioRunner {
+
+    struct Options
+    {
+        std::string program;                                      // .ini, pioasm .h or .pio (see PioProgram)
+        std::vector<std::pair<std::string, std::string>> settings; // --set key=value, after loading
+        std::vector<std::pair<std::string, uint32_t>> vars;       // --var name=value, before running
+        int64_t cycles = 1'000'000;
+        std::vector<std::string> until;                           // PioExpression conditions
+        std::vector<int> break_pcs;
+        double sm_clock_hz = 125'000'000.0;                       // VCD and capture timing
+
+        std::string stimulus;       // .csv / .vcd, see PioStimulus
+        std::string capture;        // .sr / .csv, see PioSigrokCapture
+        std::string tx_file;        // words for the TX FIFO
+        std::string rx_file;        // the RX FIFO drained into it
+
+        std::string trace_file;     // see PioTrace
+        std::string profile_file;   // PioProfiler::toJson()
+        std::string hash_file;      // PioStateHash marks
+        std::string expect_hash;    // golden marks to compare with
+        int hash_interval = 1024;
+        std::string sr_file;        // sigrok session of sr_pins
+        std::vector<int> sr_pins;
+
+        std::string summary_file;   // toJson() of the result
+        bool json = false;          // print the summary as JSON
+        std::string log_file;       // the emulator's log, pio_emu_cli sets it up (the logger is global)
+        bool list_vars = false;
+    };
+
+    // Everything after the program name on a command line; throws std::invalid_argument
+    Options parseArgs(const std::vector<std::string>& args);
+    // A batch file line split like a shell would: blanks separate, quotes group, no expansion
+    std::vector<std::string> splitLine(const std::string& line);
+    void printUsage(); // to stderr
+
+    struct Result
+    {
+        std::string program;
+        std::string stop = "error";  // "cycles", "breakpoint" or "error"
+        std::string detail;          // the breakpoint (PioBreakpoints::describe) or the error
+        bool expected_stop = false;  // false when --until / --break were given and none of them stopped the run
+        int64_t cycles = 0;
+        int clock = 0;
+        uint32_t pc = 0, x = 0, y = 0, pins = 0;
+        double seconds = 0;
+        uint64_t tx_words = 0, tx_left = 0, rx_words = 0;
+        bool hashed = false;
+        uint64_t hash = 0;
+        bool hash_checked = false, diverged = false;
+        int good_clock = -1, bad_clock = -1;
+
+        // 0: ran as asked; 1: a check failed (hash diverged, the stop condition never came);
+        // 2: the session couldn't run
+        int exitCode() const;
+        std::string toJson() const;
+        std::string toText() const;
+    };
+
+    Result run(const Options& options); // never throws, errors land in the result
+    // Sessions on up to 'threads' threads (0: one per core), results in job order
+    std::vector<Result> runBatch(const std::vector<Options>& jobs, unsigned threads);
+
+} // namespace PioRunner
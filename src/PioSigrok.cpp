@@ -0,0 +1,766 @@
+#include "PioSigrok.h"
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cmath>
+#include <fmt/format.h>
+#include <sstream>
+#include <stdexcept>
+#include <zlib.h>
+#include "PioBitOps.h"
+#include "PioText.h"
+
+namespace {
+
+    // Zip records (APPNOTE.TXT), ZIP64 once offsets pass 4 GB
+    constexpr uint32_t kLocalHeader = 0x04034b50;
+    constexpr uint32_t kCentralHeader = 0x02014b50;
+    constexpr uint32_t kEndOfDirectory = 0x06054b50;
+    constexpr uint32_t kZip64EndOfDirectory = 0x06064b50;
+    constexpr uint32_t kZip64Locator = 0x07064b50;
+    constexpr uint16_t kStored = 0;
+    constexpr uint16_t kDeflated = 8;
+    constexpr uint16_t kDosDate = (1 << 5) | 1; // 1980-01-01
+    constexpr uint32_t kNoValue32 = 0xffffffff;
+
+    void put16(std::vector<uint8_t>& out, uint16_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    void put32(std::vector<uint8_t>& out, uint32_t value)
+    {
+        put16(out, static_cast<uint16_t>(value));
+        put16(out, static_cast<uint16_t>(value >> 16));
+    }
+
+    void put64(std::vector<uint8_t>& out, uint64_t value)
+    {
+        put32(out, static_cast<uint32_t>(value));
+        put32(out, static_cast<uint32_t>(value >> 32));
+    }
+
+    uint16_t get16(const uint8_t* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+    uint32_t get32(const uint8_t* p) { return get16(p) | static_cast<uint32_t>(get16(p + 2)) << 16; }
+    uint64_t get64(const uint8_t* p) { return get32(p) | static_cast<uint64_t>(get32(p + 4)) << 32; }
+
+    // "125 MHz", "1.5k", "48000" -> Hz, 0 when it doesn't parse
+    double parseRate(const std::string& text)
+    {
+        std::istringstream in(text);
+        double value = 0;
+        if (!(in >> value))
+            return 0;
+        std::string unit;
+        in >> unit;
+        unit = PioText::lower(unit);
+        if (unit.starts_with("k"))
+            value *= 1e3;
+        else if (unit.starts_with("m"))
+            value *= 1e6;
+        else if (unit.starts_with("g"))
+            value *= 1e9;
+        return value;
+    }
+
+    // The way libsigrok writes it: "125 MHz", "20 kHz", "300 Hz"
+    std::string formatRate(double hz)
+    {
+        uint64_t rate = static_cast<uint64_t>(std::llround(hz));
+        if (rate >= 1'000'000'000 && rate % 1'000'000'000 == 0)
+            return fmt::format("{} GHz", rate / 1'000'000'000);
+        if (rate >= 1'000'000 && rate % 1'000'000 == 0)
+            return fmt::format("{} MHz", rate / 1'000'000);
+        if (rate >= 1'000 && rate % 1'000 == 0)
+            return fmt::format("{} kHz", rate / 1'000);
+        return fmt::format("{} Hz", rate);
+    }
+
+    uint32_t crc(const uint8_t* data, size_t size)
+    {
+        uLong value = crc32(0, nullptr, 0);
+        while (size > 0)
+        {
+            uInt piece = static_cast<uInt>(std::min<size_t>(size, 1u << 30));
+            value = crc32(value, data, piece);
+            data += piece;
+            size -= piece;
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    struct ZipEntry
+    {
+        std::string name;
+        uint16_t method = kStored;
+        uint64_t size = 0;          // stored bytes
+        uint64_t original_size = 0;
+        uint64_t data = 0;          // file offset of the stored bytes
+    };
+
+    std::vector<ZipEntry> readDirectory(const uint8_t* data, size_t size)
+    {
+        const std::runtime_error corrupt("Not a zip archive (or a damaged one)");
+        if (data == nullptr || size < 22)
+            throw corrupt;
+
+        // The end of directory record sits behind at most 64K of comment
+        size_t end = size - 22;
+        size_t stop = end > 0xffff ? end - 0xffff : 0;
+        while (get32(data + end) != kEndOfDirectory)
+        {
+            if (end == stop)
+                throw corrupt;
+            end--;
+        }
+        uint64_t count = get16(data + end + 10);
+        uint64_t directory = get32(data + end + 16);
+        if (end >= 20 && get32(data + end - 20) == kZip64Locator)
+        {
+            uint64_t zip64 = get64(data + end - 20 + 8);
+            if (zip64 > size || size - zip64 < 56 || get32(data + zip64) != kZip64EndOfDirectory)
+                throw corrupt;
+            count = get64(data + zip64 + 32);
+            directory = get64(data + zip64 + 48);
+        }
+
+        std::vector<ZipEntry> entries;
+        uint64_t p = directory;
+        for (uint64_t i = 0; i < count; i++)
+        {
+            if (p > size || size - p < 46 || get32(data + p) != kCentralHeader)
+                throw corrupt;
+            ZipEntry entry;
+            entry.method = get16(data + p + 10);
+            entry.size = get32(data + p + 20);
+            entry.original_size = get32(data + p + 24);
+            uint16_t name_length = get16(data + p + 28);
+            uint16_t extra_length = get16(data + p + 30);
+            uint16_t comment_length = get16(data + p + 32);
+            uint64_t local = get32(data + p + 42);
+            if (p + 46 + name_length + extra_length > size)
+                throw corrupt;
+            entry.name.assign(reinterpret_cast<const char*>(data + p + 46), name_length);
+
+            // ZIP64 extra field: the 64-bit values of the fields left at 0xffffffff, in this order
+            const uint64_t extra_end = p + 46 + name_length + extra_length;
+            for (uint64_t x = p + 46 + name_length; x + 4 <= extra_end;)
+            {
+                uint16_t id = get16(data + x), length = get16(data + x + 2);
+                if (x + 4 + length > extra_end)
+                    throw corrupt;
+                const uint8_t* value = data + x + 4;
+                const uint8_t* value_end = value + length;
+                auto next64 = [&]() {
+                    if (value_end - value < 8)
+                        throw corrupt;
+                    uint64_t field = get64(value);
+                    value += 8;
+                    return field;
+                };
+                if (id == 1)
+                {
+                    if (entry.original_size == kNoValue32)
+                        entry.original_size = next64();
+                    if (entry.size == kNoValue32)
+                        entry.size = next64();
+                    if (local == kNoValue32)
+                        local = next64();
+                }
+                x += 4 + length;
+            }
+
+            // Offsets and sizes from the file can be anything, compare without overflowing
+            if (local > size || size - local < 30 || get32(data + local) != kLocalHeader)
+                throw corrupt;
+            entry.data = local + 30 + get16(data + local + 26) + get16(data + local + 28);
+            if (entry.data > size || entry.size > size - entry.data)
+                throw corrupt;
+            entries.push_back(entry);
+            p += 46 + name_length + extra_length + comment_length;
+        }
+        return entries;
+    }
+
+    // The bytes of one entry, straight from the mapping or inflated a buffer at a time
+    class EntryStream
+    {
+    public:
+        EntryStream(const uint8_t* file, const ZipEntry& entry)
+            : in_(file + entry.data), remaining_(entry.size), inflate_(entry.method == kDeflated)
+        {
+            if (entry.method != kStored && entry.method != kDeflated)
+                throw std::runtime_error(fmt::format("{}: unsupported zip compression method {}", entry.name, entry.method));
+            if (inflate_ && inflateInit2(&z_, -MAX_WBITS) != Z_OK)
+                throw std::runtime_error("inflateInit2 failed");
+        }
+        ~EntryStream()
+        {
+            if (inflate_)
+                inflateEnd(&z_);
+        }
+        EntryStream(const EntryStream&) = delete;
+        EntryStream& operator=(const EntryStream&) = delete;
+
+        // Up to 'capacity' bytes, 0 at the end of the entry
+        size_t read(uint8_t* out, size_t capacity)
+        {
+            if (!inflate_)
+            {
+                size_t count = static_cast<size_t>(std::min<uint64_t>(capacity, remaining_));
+                std::copy(in_, in_ + count, out);
+                in_ += count;
+                remaining_ -= count;
+                return count;
+            }
+
+            z_.next_out = out;
+            z_.avail_out = static_cast<uInt>(std::min<size_t>(capacity, UINT_MAX));
+            while (z_.avail_out > 0 && !finished_)
+            {
+                if (z_.avail_in == 0)
+                {
+                    uInt piece = static_cast<uInt>(std::min<uint64_t>(remaining_, 1u << 30));
+                    z_.next_in = const_cast<Bytef*>(in_);
+                    z_.avail_in = piece;
+                    in_ += piece;
+                    remaining_ -= piece;
+                }
+                int result = ::inflate(&z_, Z_NO_FLUSH);
+                if (result == Z_STREAM_END)
+                    finished_ = true;
+                else if (result != Z_OK && !(result == Z_BUF_ERROR && z_.avail_in == 0 && remaining_ == 0))
+                    throw std::runtime_error("Damaged compressed data in capture");
+                else if (z_.avail_in == 0 && remaining_ == 0)
+                    finished_ = true; // truncated stream: keep what came out
+            }
+            return static_cast<size_t>(z_.next_out - out);
+        }
+
+        std::string readAll()
+        {
+            std::string text;
+            uint8_t buffer[4096];
+            while (size_t count = read(buffer, sizeof(buffer)))
+                text.append(reinterpret_cast<const char*>(buffer), count);
+            return text;
+        }
+
+    private:
+        const uint8_t* in_;
+        uint64_t remaining_;
+        bool inflate_;
+        bool finished_ = false;
+        z_stream z_{};
+    };
+
+} // namespace
+
+/* ----- PioSigrokWriter ----- */
+
+PioSigrokWriter::PioSigrokWriter(const std::string& filepath, const std::vector<int>& pins, double sm_clock_hz, bool compress)
+    : path_(filepath), pins_(pins), compress_(compress)
+{
+    if (pins.empty() || pins.size() > 32)
+        throw std::runtime_error("A sigrok session needs 1 to 32 channels");
+    for (int pin : pins)
+    {
+        if (pin < 0 || pin >= 32)
+            throw std::runtime_error(fmt::format("Invalid pin {} for a sigrok channel", pin));
+        mask_ |= 1u << pin;
+    }
+    unitsize_ = static_cast<int>((pins.size() + 7) / 8);
+
+    file_ = std::fopen(filepath.c_str(), "wb");
+    if (file_ == nullptr)
+        throw std::runtime_error("Cannot open file: " + filepath);
+
+    std::string metadata = fmt::format("[global]\nsigrok version=0.5.2\n\n[device 1]\ncapturefile=logic-1\ntotal probes={}\n"
+                                       "samplerate={}\ntotal analog=0\n",
+        pins.size(), formatRate(sm_clock_hz));
+    for (size_t channel = 0; channel < pins.size(); channel++)
+        metadata += fmt::format("probe{}=gpio{}\n", channel + 1, pins[channel]);
+    metadata += fmt::format("unitsize={}\n", unitsize_);
+
+    const std::string version = "2";
+    writeEntry("version", reinterpret_cast<const uint8_t*>(version.data()), version.size(), false);
+    writeEntry("metadata", reinterpret_cast<const uint8_t*>(metadata.data()), metadata.size(), false);
+}
+
+PioSigrokWriter::~PioSigrokWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::exception& e)
+    {
+        LOG_ERROR_FMT("sigrok session {} not finished: {}", path_, e.what());
+    }
+}
+
+void PioSigrokWriter::begin(PioStateMachine& pio)
+{
+    clock_ = pio.clock;
+    onPinChange(pio.clock, PioBitOps::gatherPins(pio.gpio.raw_data));
+    if (std::find(pio.pin_listeners.begin(), pio.pin_listeners.end(), this) == pio.pin_listeners.end())
+        pio.pin_listeners.push_back(this);
+}
+
+void PioSigrokWriter::finish(PioStateMachine& pio)
+{
+    if (clock_ >= 0)
+        fill(pio.clock);
+    std::erase(pio.pin_listeners, this);
+    close();
+}
+
+void PioSigrokWriter::onPinChange(int clock, uint32_t pins)
+{
+    if (clock_ < 0 || file_ == nullptr)
+        return;
+    fill(clock);
+    level_ = 0;
+    for (size_t channel = 0; channel < pins_.size(); channel++)
+        level_ |= ((pins >> pins_[channel]) & 1u) << channel;
+}
+
+void PioSigrokWriter::fill(int64_t until)
+{
+    for (; clock_ < until; clock_++)
+    {
+        for (int byte = 0; byte < unitsize_; byte++)
+            chunk_.push_back(static_cast<uint8_t>(level_ >> (8 * byte)));
+        samples_++;
+        if (chunk_.size() >= chunk_bytes)
+            flushChunk();
+    }
+}
+
+void PioSigrokWriter::flushChunk()
+{
+    if (chunk_.empty() || file_ == nullptr)
+        return;
+    chunk_number_++;
+    writeEntry(fmt::format("logic-1-{}", chunk_number_), chunk_.data(), chunk_.size(), compress_);
+    chunk_.clear();
+}
+
+void PioSigrokWriter::writeEntry(const std::string& name, const uint8_t* data, size_t size, bool deflate)
+{
+    Entry entry{ name, crc(data, size), size, size, offset_, false };
+
+    std::vector<uint8_t> packed;
+    if (deflate)
+    {
+        z_stream z{};
+        if (deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+            throw std::runtime_error("deflateInit2 failed");
+        packed.resize(deflateBound(&z, static_cast<uLong>(size)));
+        z.next_in = const_cast<Bytef*>(data);
+        z.avail_in = static_cast<uInt>(size);
+        z.next_out = packed.data();
+        z.avail_out = static_cast<uInt>(packed.size());
+        int result = ::deflate(&z, Z_FINISH);
+        packed.resize(z.total_out);
+        deflateEnd(&z);
+        if (result == Z_STREAM_END && packed.size() < size) // else stored is smaller
+        {
+            data = packed.data();
+            entry.size = packed.size();
+            entry.deflated = true;
+        }
+    }
+
+    std::vector<uint8_t> header;
+    put32(header, kLocalHeader);
+    put16(header, 20); // version needed: 2.0
+    put16(header, 0);  // flags
+    put16(header, entry.deflated ? kDeflated : kStored);
+    put16(header, 0);  // time
+    put16(header, kDosDate);
+    put32(header, entry.crc);
+    put32(header, static_cast<uint32_t>(entry.size));
+    put32(header, static_cast<uint32_t>(entry.original_size));
+    put16(header, static_cast<uint16_t>(name.size()));
+    put16(header, 0);  // extra
+    header.insert(header.end(), name.begin(), name.end());
+
+    if (std::fwrite(header.data(), 1, header.size(), file_) != header.size()
+        || std::fwrite(data, 1, static_cast<size_t>(entry.size), file_) != entry.size)
+        throw std::runtime_error("Cannot write file: " + path_);
+    offset_ += header.size() + entry.size;
+    entries_.push_back(entry);
+}
+
+void PioSigrokWriter::close()
+{
+    if (file_ == nullptr)
+        return;
+    flushChunk();
+
+    std::vector<uint8_t> directory;
+    bool zip64 = false;
+    for (const Entry& entry : entries_)
+    {
+        bool far = entry.offset >= kNoValue32;
+        zip64 |= far;
+        put32(directory, kCentralHeader);
+        put16(directory, far ? 45 : 20); // made by
+        put16(directory, far ? 45 : 20); // needed
+        put16(directory, 0);
+        put16(directory, entry.deflated ? kDeflated : kStored);
+        put16(directory, 0);
+        put16(directory, kDosDate);
+        put32(directory, entry.crc);
+        put32(directory, static_cast<uint32_t>(entry.size));
+        put32(directory, static_cast<uint32_t>(entry.original_size));
+        put16(directory, static_cast<uint16_t>(entry.name.size()));
+        put16(directory, far ? 12 : 0); // extra
+        put16(directory, 0);            // comment
+        put16(directory, 0);            // disk
+        put16(directory, 0);            // internal attributes
+        put32(directory, 0);            // external attributes
+        put32(directory, far ? kNoValue32 : static_cast<uint32_t>(entry.offset));
+        directory.insert(directory.end(), entry.name.begin(), entry.name.end());
+        if (far)
+        {
+            put16(directory, 1);
+            put16(directory, 8);
+            put64(directory, entry.offset);
+        }
+    }
+
+    uint64_t directory_offset = offset_;
+    uint64_t directory_size = directory.size();
+    uint64_t count = entries_.size();
+    zip64 |= directory_offset >= kNoValue32 || count >= 0xffff;
+    if (zip64)
+    {
+        uint64_t record = directory_offset + directory_size;
+        put32(directory, kZip64EndOfDirectory);
+        put64(directory, 44);
+        put16(directory, 45);
+        put16(directory, 45);
+        put32(directory, 0);
+        put32(directory, 0);
+        put64(directory, count);
+        put64(directory, count);
+        put64(directory, directory_size);
+        put64(directory, directory_offset);
+        put32(directory, kZip64Locator);
+        put32(directory, 0);
+        put64(directory, record);
+        put32(directory, 1);
+    }
+    put32(directory, kEndOfDirectory);
+    put16(directory, 0);
+    put16(directory, 0);
+    put16(directory, zip64 ? 0xffff : static_cast<uint16_t>(count));
+    put16(directory, zip64 ? 0xffff : static_cast<uint16_t>(count));
+    put32(directory, zip64 ? kNoValue32 : static_cast<uint32_t>(directory_size));
+    put32(directory, zip64 ? kNoValue32 : static_cast<uint32_t>(directory_offset));
+    put16(directory, 0);
+
+    std::FILE* file = file_;
+    file_ = nullptr;
+    bool ok = std::fwrite(directory.data(), 1, directory.size(), file) == directory.size();
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+        throw std::runtime_error("Cannot write file: " + path_);
+}
+
+/* ----- PioSigrokCapture ----- */
+
+class PioSigrokCapture::Samples
+{
+public:
+    virtual ~Samples() = default;
+    virtual bool next(uint32_t& word) = 0; // channel N in bit N, false at the end
+};
+
+namespace {
+
+    // The logic chunks of a session, one after the other
+    class SessionSamples : public PioSigrokCapture::Samples
+    {
+    public:
+        SessionSamples(const uint8_t* file, std::vector<ZipEntry> chunks, int unitsize)
+            : file_(file), chunks_(std::move(chunks)), unitsize_(unitsize), buffer_(64 * 1024)
+        {
+        }
+
+        bool next(uint32_t& word) override
+        {
+            word = 0;
+            for (int byte = 0; byte < unitsize_; byte++)
+            {
+                if (pos_ == length_ && !refill())
+                    return false; // a partial sample at the end is dropped
+                if (byte < 4)
+                    word |= static_cast<uint32_t>(buffer_[pos_]) << (8 * byte);
+                pos_++;
+            }
+            return true;
+        }
+
+    private:
+        bool refill()
+        {
+            pos_ = length_ = 0;
+            while (length_ == 0)
+            {
+                if (!stream_)
+                {
+                    if (next_chunk_ == chunks_.size())
+                        return false;
+                    stream_ = std::make_unique<EntryStream>(file_, chunks_[next_chunk_++]);
+                }
+                length_ = stream_->read(buffer_.data(), buffer_.size());
+                if (length_ == 0)
+                    stream_.reset();
+            }
+            return true;
+        }
+
+        const uint8_t* file_;
+        std::vector<ZipEntry> chunks_;
+        size_t next_chunk_ = 0;
+        std::unique_ptr<EntryStream> stream_;
+        int unitsize_;
+        std::vector<uint8_t> buffer_;
+        size_t pos_ = 0;
+        size_t length_ = 0;
+    };
+
+    // sigrok's CSV output, read in place from the mapping
+    class CsvSamples : public PioSigrokCapture::Samples
+    {
+    public:
+        CsvSamples(const uint8_t* data, size_t size, std::vector<std::string>& channels, double& sample_rate)
+            : data_(reinterpret_cast<const char*>(data)), size_(size)
+        {
+            while (pos_ < size_)
+            {
+                size_t start = pos_;
+                std::string line = PioText::trim(nextLine());
+                if (line.empty())
+                    continue;
+                if (line[0] == ';' || line[0] == '#')
+                {
+                    size_t rate = PioText::lower(line).find("samplerate:");
+                    if (rate != std::string::npos)
+                        sample_rate = parseRate(line.substr(rate + 11));
+                    continue;
+                }
+
+                std::vector<std::string> fields;
+                std::stringstream ss(line);
+                for (std::string field; std::getline(ss, field, ',');)
+                    fields.push_back(PioText::trim(field));
+                bool header = std::any_of(fields.begin(), fields.end(), [](const std::string& f) { return f != "0" && f != "1"; });
+                for (size_t column = 0; column < fields.size(); column++)
+                {
+                    if (header && PioText::lower(fields[column]).find("time") != std::string::npos)
+                    {
+                        channel_of_column_.push_back(-1);
+                        continue;
+                    }
+                    channel_of_column_.push_back(static_cast<int>(channels.size()));
+                    channels.push_back(header ? fields[column] : fmt::format("D{}", column));
+                }
+                if (!header)
+                    pos_ = start; // that was already a sample
+                return;
+            }
+        }
+
+        bool next(uint32_t& word) override
+        {
+            while (pos_ < size_)
+            {
+                char first = data_[pos_];
+                if (first == '\n' || first == '\r' || first == ';' || first == '#')
+                {
+                    nextLine();
+                    continue;
+                }
+
+                word = 0;
+                size_t column = 0;
+                bool value_seen = false;
+                for (; pos_ < size_ && data_[pos_] != '\n'; pos_++)
+                {
+                    char c = data_[pos_];
+                    if (c == ',')
+                    {
+                        column++;
+                        value_seen = false;
+                    }
+                    else if (!value_seen && c != ' ' && c != '\t' && c != '\r')
+                    {
+                        value_seen = true;
+                        int channel = column < channel_of_column_.size() ? channel_of_column_[column] : -1;
+                        if (c == '1' && channel >= 0 && channel < 32)
+                            word |= 1u << channel;
+                    }
+                }
+                pos_++;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        std::string nextLine()
+        {
+            size_t end = pos_;
+            while (end < size_ && data_[end] != '\n')
+                end++;
+            std::string line(data_ + pos_, end - pos_);
+            pos_ = end + 1;
+            return line;
+        }
+
+        const char* data_;
+        size_t size_;
+        size_t pos_ = 0;
+        std::vector<int> channel_of_column_;
+    };
+
+} // namespace
+
+PioSigrokCapture::PioSigrokCapture(const std::string& filepath, const Options& options)
+    : file_(filepath), start_clock_(options.start_clock)
+{
+    if (PioText::lower(filepath).ends_with(".csv"))
+    {
+        source_ = std::make_unique<CsvSamples>(file_.data(), file_.size(), channels_, sample_rate_);
+    }
+    else
+    {
+        std::vector<ZipEntry> entries = readDirectory(file_.data(), file_.size());
+        auto metadata = std::find_if(entries.begin(), entries.end(), [](const ZipEntry& e) { return e.name == "metadata"; });
+        if (metadata == entries.end())
+            throw std::runtime_error("Not a sigrok session (no metadata): " + filepath);
+
+        // [device 1] of the metadata INI
+        std::string capturefile = "logic-1";
+        int unitsize = 1;
+        std::vector<std::string> probes;
+        std::istringstream text(EntryStream(file_.data(), *metadata).readAll());
+        bool device = false;
+        for (std::string line; std::getline(text, line);)
+        {
+            line = PioText::trim(line);
+            if (line.starts_with("["))
+            {
+                device = line == "[device 1]";
+                continue;
+            }
+            size_t equals = line.find('=');
+            if (!device || equals == std::string::npos)
+                continue;
+            std::string key = PioText::trim(line.substr(0, equals)), value = PioText::trim(line.substr(equals + 1));
+            if (key == "capturefile")
+                capturefile = value;
+            else if (key == "samplerate")
+                sample_rate_ = parseRate(value);
+            else if (key == "unitsize")
+                unitsize = std::max(1, std::atoi(value.c_str()));
+            else if (key.starts_with("probe") && key.size() > 5 && std::isdigit(static_cast<unsigned char>(key[5])))
+            {
+                size_t index = static_cast<size_t>(std::atoi(key.c_str() + 5));
+                if (index >= 1 && index <= 64)
+                {
+                    probes.resize(std::max(probes.size(), index));
+                    probes[index - 1] = value;
+                }
+            }
+        }
+        for (size_t channel = 0; channel < probes.size(); channel++)
+            channels_.push_back(probes[channel].empty() ? fmt::format("D{}", channel) : probes[channel]);
+
+        // "logic-1" (version 1) or "logic-1-1", "logic-1-2", ... in number order
+        std::vector<std::pair<int, ZipEntry>> chunks;
+        for (const ZipEntry& entry : entries)
+        {
+            if (entry.name == capturefile)
+                chunks.push_back({ 0, entry });
+            else if (entry.name.starts_with(capturefile + "-"))
+                chunks.push_back({ std::atoi(entry.name.c_str() + capturefile.size() + 1), entry });
+        }
+        std::stable_sort(chunks.begin(), chunks.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+        std::vector<ZipEntry> logic;
+        for (auto& chunk : chunks)
+            logic.push_back(std::move(chunk.second));
+        source_ = std::make_unique<SessionSamples>(file_.data(), std::move(logic), unitsize);
+    }
+
+    if (options.sample_rate > 0)
+        sample_rate_ = options.sample_rate;
+    if (sample_rate_ <= 0)
+        throw std::runtime_error("No sample rate in " + filepath + ", give one in the options");
+    clocks_per_sample_ = static_cast<long double>(options.sm_clock_hz) / sample_rate_;
+
+    for (size_t channel = 0; channel < channels_.size(); channel++)
+    {
+        int pin = -1;
+        if (!options.pins.empty())
+            pin = channel < options.pins.size() ? options.pins[channel] : -1;
+        else
+        {
+            pin = PioText::pinFromName(channels_[channel]);
+            if (pin < 0)
+                pin = static_cast<int>(channel);
+        }
+        if (pin >= 32 || channel >= 32)
+            pin = -1;
+        pins_.push_back(pin);
+        if (pin >= 0)
+            driven_ |= 1u << channel;
+    }
+
+    advance();
+}
+
+PioSigrokCapture::~PioSigrokCapture() = default;
+
+void PioSigrokCapture::advance()
+{
+    uint32_t word;
+    while (source_->next(word))
+    {
+        uint64_t index = samples_++;
+        if (started_ && ((word ^ level_) & driven_) == 0)
+            continue;
+        started_ = true;
+        int64_t clock = start_clock_ + static_cast<int64_t>(std::floor(static_cast<long double>(index) * clocks_per_sample_));
+        if (clock > INT_MAX)
+            break; // past what the machine's clock can reach
+        next_level_ = word;
+        next_clock_ = clock;
+        return;
+    }
+    next_clock_ = -1;
+}
+
+int PioSigrokCapture::nextEventClock() const
+{
+    return static_cast<int>(next_clock_);
+}
+
+void PioSigrokCapture::apply(PioStateMachine& pio)
+{
+    while (next_clock_ >= 0 && next_clock_ <= pio.clock)
+    {
+        for (size_t channel = 0; channel < pins_.size(); channel++)
+        {
+            if (pins_[channel] >= 0)
+                pio.gpio.external_data[pins_[channel]] = static_cast<int8_t>((next_level_ >> channel) & 1);
+        }
+        level_ = next_level_;
+        advance();
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "PioMappedFile.h"
+#include "PioStateMachine.h"
+
+// sigrok session files (.sr, what PulseView opens and saves): a zip archive with "version",
+// "metadata" (an INI naming the channels, sample rate and unit size) and the logic samples,
+// unitsize bytes per sample with channel N in bit N, split over "logic-1-1", "logic-1-2", ...
+
+// Streams the emulated GPIOs to a .sr file, one sample per SM clock. Attach as a pin listener:
+//
+//     PioSigrokWriter writer("run.sr", { 0, 5 }, 125e6);
+//     writer.begin(pio);  // the levels at pio.clock, adds itself to pio.pin_listeners
+//     pio.run(1'000'000);
+//     writer.finish(pio); // pads up to pio.clock and closes the archive
+//
+// Samples are only held until a chunk is full (chunk_bytes), then deflated and written.
+class PioSigrokWriter : public PioPinListener
+{
+public:
+    // Channel N is pins[N] (at most 32), named gpioP; throws std::runtime_error
+    PioSigrokWriter(const std::string& filepath, const std::vector<int>& pins, double sm_clock_hz, bool compress = true);
+    ~PioSigrokWriter() override; // finishes at the last change when finish() wasn't called
+    PioSigrokWriter(const PioSigrokWriter&) = delete;
+    PioSigrokWriter& operator=(const PioSigrokWriter&) = delete;
+
+    void begin(PioStateMachine& pio);
+    void finish(PioStateMachine& pio); // also detaches from pio.pin_listeners; throws std::runtime_error
+
+    uint32_t pinMask() const override { return mask_; }
+    void onPinChange(int clock, uint32_t pins) override;
+
+    uint64_t samples() const { return samples_; }
+    size_t chunk_bytes = size_t{ 4 } << 20;
+
+private:
+    struct Entry
+    {
+        std::string name;
+        uint32_t crc;
+        uint64_t size;          // stored bytes
+        uint64_t original_size;
+        uint64_t offset;        // local header
+        bool deflated;
+    };
+
+    void fill(int64_t until);  // samples of the current level up to clock 'until'
+    void flushChunk();
+    void writeEntry(const std::string& name, const uint8_t* data, size_t size, bool deflate);
+    void close();
+
+    std::FILE* file_ = nullptr;
+    std::string path_;
+    uint64_t offset_ = 0;
+    std::vector<Entry> entries_;
+    std::vector<int> pins_;
+    uint32_t mask_ = 0;
+    int unitsize_ = 1;
+    bool compress_ = true;
+
+    std::vector<uint8_t> chunk_;
+    int chunk_number_ = 0;
+    uint32_t level_ = 0;   // channel word of the current level
+    int64_t clock_ = -1;   // clock of the next sample, -1 before begin()
+    uint64_t samples_ = 0;
+};
+
+// Replays a logic analyser capture (.sr, or sigrok's CSV output) into gpio.external_data. The file
+// is mapped and decoded as the emulation reaches it, so captures of any size stream through a few
+// buffers. Samples are resampled to SM clocks: sample i lands on clock
+// start_clock + floor(i * sm_clock_hz / sample_rate), and when several fall on one clock the last
+// one wins (pulses shorter than a clock can vanish, as on the real input synchroniser).
+//
+// CSV: ';' or '#' comment lines (a "Samplerate: 1 MHz" comment sets the rate), an optional line of
+// channel names, then one row of 0/1 per sample. A column whose name contains "time" is skipped.
+class PioSigrokCapture : public PioInputSource
+{
+public:
+    struct Options
+    {
+        double sm_clock_hz = 125'000'000.0;
+        double sample_rate = 0; // Hz, 0: the file's
+        int start_clock = 0;    // where sample 0 lands
+        std::vector<int> pins;  // pin of channel N, -1 ignores it; empty: from the channel name (D3, gpio3), else N
+    };
+
+    // .csv by extension, anything else is read as a .sr archive; throws std::runtime_error
+    PioSigrokCapture(const std::string& filepath, const Options& options);
+    ~PioSigrokCapture() override;
+    PioSigrokCapture(const PioSigrokCapture&) = delete;
+    PioSigrokCapture& operator=(const PioSigrokCapture&) = delete;
+
+    const std::vector<std::string>& channels() const { return channels_; }
+    const std::vector<int>& pins() const { return pins_; } // per channel, -1: not driven
+    double sampleRate() const { return sample_rate_; }
+    uint64_t samplesRead() const { return samples_; }
+
+    int nextEventClock() const override;
+    void apply(PioStateMachine& pio) override;
+
+    class Samples; // a decoder, in the .cpp
+
+private:
+    void advance(); // on to the next sample that changes a driven channel
+
+    PioMappedFile file_;
+    std::unique_ptr<Samples> source_;
+    std::vector<std::string> channels_;
+    std::vector<int> pins_;
+    uint32_t driven_ = 0; // channel bits that map to a pin
+    double sample_rate_ = 0;
+    long double clocks_per_sample_ = 1;
+    int start_clock_ = 0;
+
+    uint64_t samples_ = 0;
+    bool started_ = false;
+    uint32_t level_ = 0;      // channel word applied last
+    uint32_t next_level_ = 0;
+    int64_t next_clock_ = -1; // -1: no more changes
+};
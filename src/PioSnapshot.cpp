@@ -0,0 +1,135 @@
+#include "PioSnapshot.h"
+
+void PioSnapshot::capture(const PioStateMachine& pio)
+{
+    settings = pio.settings;
+    regs = pio.regs;
+    gpio = pio.gpio;
+    fifo = pio.fifo;
+    irq_flags = pio.irq_flags;
+    irq_is_waiting = pio.irq_is_waiting;
+
+    instructionMemory = pio.instructionMemory;
+    currentInstruction = pio.currentInstruction;
+    stateMachineNumber = pio.stateMachineNumber;
+
+    clock = pio.clock;
+    jmp_to = pio.jmp_to;
+    skip_increase_pc = pio.skip_increase_pc;
+    delay_delay = pio.delay_delay;
+    skip_delay = pio.skip_delay;
+    exec_command = pio.exec_command;
+    wait_is_stalling = pio.wait_is_stalling;
+    clkdiv_accumulator = pio.clkdiv_accumulator;
+    out_not_finished = pio.out_not_finished;
+    out_first_shifted = pio.out_first_shifted;
+}
+
+void PioSnapshot::restore(PioStateMachine& pio) const
+{
+    pio.settings = settings;
+    pio.regs = regs;
+    pio.gpio = gpio;
+    pio.fifo = fifo;
+    pio.irq_flags = irq_flags;
+    pio.irq_is_waiting = irq_is_waiting;
+
+    pio.instructionMemory = instructionMemory; // run() rebuilds its block cache when this changes
+    pio.currentInstruction = currentInstruction;
+    pio.stateMachineNumber = stateMachineNumber;
+
+    pio.clock = clock;
+    pio.jmp_to = jmp_to;
+    pio.skip_increase_pc = skip_increase_pc;
+    pio.delay_delay = delay_delay;
+    pio.skip_delay = skip_delay;
+    pio.exec_command = exec_command;
+    pio.wait_is_stalling = wait_is_stalling;
+    pio.clkdiv_accumulator = clkdiv_accumulator;
+    pio.out_not_finished = out_not_finished;
+    pio.out_first_shifted = out_first_shifted;
+}
+
+uint64_t PioSnapshot::hash() const
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&h](const auto& field) {
+        const auto* bytes = reinterpret_cast<const unsigned char*>(&field);
+        for (size_t i = 0; i < sizeof(field); i++)
+        {
+            h ^= bytes[i];
+            h *= 0x100000001b3ull;
+        }
+    };
+
+    // Field by field: the settings struct has padding, the others are plain arrays of one type
+    mix(settings.sideset_count);
+    mix(settings.sideset_opt);
+    mix(settings.sideset_to_pindirs);
+    mix(settings.sideset_base);
+    mix(settings.in_base);
+    mix(settings.out_base);
+    mix(settings.set_base);
+    mix(settings.jmp_pin);
+    mix(settings.set_count);
+    mix(settings.out_count);
+    mix(settings.push_threshold);
+    mix(settings.pull_threshold);
+    mix(settings.fifo_level_N);
+    mix(settings.wrap_start);
+    mix(settings.wrap_end);
+    mix(settings.in_shift_right);
+    mix(settings.out_shift_right);
+    mix(settings.in_shift_autopush);
+    mix(settings.out_shift_autopull);
+    mix(settings.autopull_enable);
+    mix(settings.autopush_enable);
+    mix(settings.status_sel);
+    mix(settings.clkdiv_int);
+    mix(settings.clkdiv_frac);
+
+    mix(regs.x);
+    mix(regs.y);
+    mix(regs.isr);
+    mix(regs.osr);
+    mix(regs.isr_shift_count);
+    mix(regs.osr_shift_count);
+    mix(regs.pc);
+    mix(regs.delay);
+    mix(regs.status);
+
+    mix(gpio.raw_data);
+    mix(gpio.set_data);
+    mix(gpio.out_data);
+    mix(gpio.external_data);
+    mix(gpio.sideset_data);
+    mix(gpio.pindirs);
+    mix(gpio.set_pindirs);
+    mix(gpio.out_pindirs);
+    mix(gpio.sideset_pindirs);
+
+    mix(fifo.tx_fifo);
+    mix(fifo.rx_fifo);
+    mix(fifo.tx_fifo_count);
+    mix(fifo.rx_fifo_count);
+    mix(fifo.push_is_stalling);
+    mix(fifo.pull_is_stalling);
+    mix(irq_flags);
+    mix(irq_is_waiting);
+
+    mix(instructionMemory);
+    mix(currentInstruction);
+    mix(stateMachineNumber);
+
+    mix(clock);
+    mix(jmp_to);
+    mix(skip_increase_pc);
+    mix(delay_delay);
+    mix(skip_delay);
+    mix(exec_command);
+    mix(wait_is_stalling);
+    mix(clkdiv_accumulator);
+    mix(out_not_finished);
+    mix(out_first_shifted);
+    return h;
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include "PioStateMachine.h"
+
+// Copy of everything that changes while a state machine runs, without the reflection maps or
+// attached sources/observers. Used to hand state to the GUI from the worker thread and as a
+// checkpoint that can be restored later.
+struct PioSnapshot
+{
+    pioStateMachineSettings settings;
+    PioStateMachine::Registers regs;
+    PioStateMachine::GPIORegs gpio{};
+    PioStateMachine::Fifo fifo;
+    std::array<bool, 8> irq_flags{};
+    bool irq_is_waiting = false;
+
+    std::array<uint16_t, 32> instructionMemory{};
+    uint16_t currentInstruction = 0;
+    uint16_t stateMachineNumber = 0;
+
+    int clock = 0;
+    int jmp_to = -1;
+    bool skip_increase_pc = false;
+    bool delay_delay = false;
+    bool skip_delay = false;
+    bool exec_command = false;
+    bool wait_is_stalling = false;
+    uint32_t clkdiv_accumulator = 0;
+    bool out_not_finished = false;
+    int out_first_shifted = 0;
+
+    void capture(const PioStateMachine& pio);
+    void restore(PioStateMachine& pio) const;
+    uint64_t hash() const; // FNV-1a over every field (not the padding), equal states hash equal across runs
+
+    bool operator==(const PioSnapshot&) const = default;
+};
@@ -0,0 +1,156 @@
+#include "PioStateHash.h"
+#include <algorithm>
+#include <fmt/format.h>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include "PioStateMachine.h"
+
+namespace {
+
+    constexpr uint64_t kFnvOffset = 0xcbf29ce484222325ull;
+    constexpr uint64_t kFnvPrime = 0x100000001b3ull;
+
+    void mix(uint64_t& h, uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            h ^= (value >> (8 * i)) & 0xff;
+            h *= kFnvPrime;
+        }
+    }
+
+} // namespace
+
+PioStateHash::PioStateHash(int interval)
+    : interval(interval > 0 ? interval : 1)
+{
+    reset();
+}
+
+void PioStateHash::reset(int start_clock)
+{
+    marks.clear();
+    rolling_ = kFnvOffset;
+    next_clock_ = (start_clock / interval + 1) * interval;
+}
+
+uint64_t PioStateHash::stateHash(const PioStateMachine& pio)
+{
+    uint64_t h = kFnvOffset;
+    const auto& regs = pio.regs;
+    mix(h, regs.x);
+    mix(h, regs.y);
+    mix(h, regs.isr);
+    mix(h, regs.osr);
+    mix(h, regs.isr_shift_count);
+    mix(h, regs.osr_shift_count);
+    mix(h, regs.pc);
+    mix(h, regs.delay);
+
+    // Pins as bitmasks, plus the directions; -1 (never driven) hashes like its own level
+    uint32_t levels = 0, outputs = 0;
+    for (int pin = 0; pin < 32; pin++)
+    {
+        levels |= (pio.gpio.raw_data[pin] == 1 ? 1u : 0u) << pin;
+        outputs |= (pio.gpio.pindirs[pin] == 0 ? 1u : 0u) << pin;
+    }
+    mix(h, levels);
+    mix(h, outputs);
+
+    // Only the valid FIFO entries, what lies past the count is not state
+    mix(h, pio.fifo.tx_fifo_count);
+    for (int i = 0; i < pio.fifo.tx_fifo_count && i < 8; i++)
+        mix(h, pio.fifo.tx_fifo[i]);
+    mix(h, pio.fifo.rx_fifo_count);
+    for (int i = 0; i < pio.fifo.rx_fifo_count && i < 8; i++)
+        mix(h, pio.fifo.rx_fifo[i]);
+
+    uint32_t irqs = 0;
+    for (int i = 0; i < 8; i++)
+        irqs |= (pio.irq_flags[i] ? 1u : 0u) << i;
+    mix(h, irqs);
+    return h;
+}
+
+void PioStateHash::sample(const PioStateMachine& pio)
+{
+    uint64_t state = stateHash(pio);
+    mix(rolling_, static_cast<uint32_t>(pio.clock));
+    mix(rolling_, static_cast<uint32_t>(state));
+    mix(rolling_, static_cast<uint32_t>(state >> 32));
+    marks.push_back({ pio.clock, rolling_ });
+    next_clock_ = (pio.clock / interval + 1) * interval;
+}
+
+void PioStateHash::finish(const PioStateMachine& pio)
+{
+    if (pio.clock >= next_clock_)
+        sample(pio);
+}
+
+void PioStateHash::save(const std::string& filepath) const
+{
+    std::ofstream file(filepath);
+    if (!file)
+        throw std::runtime_error("Cannot open file: " + filepath);
+    file << fmt::format("# pio_emu state hash, interval {}\n", interval);
+    for (const Mark& mark : marks)
+        file << fmt::format("{} {:016x}\n", mark.clock, mark.hash);
+    if (!file)
+        throw std::runtime_error("Cannot write file: " + filepath);
+}
+
+void PioStateHash::load(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if (!file)
+        throw std::runtime_error("Cannot open file: " + filepath);
+
+    std::string line;
+    const std::string header = "# pio_emu state hash, interval ";
+    if (!std::getline(file, line) || line.rfind(header, 0) != 0)
+        throw std::runtime_error("Not a state hash file: " + filepath);
+    interval = std::stoi(line.substr(header.size()));
+    if (interval <= 0)
+        throw std::runtime_error("Bad interval in " + filepath);
+
+    reset();
+    int line_number = 1;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::istringstream fields(line);
+        Mark mark{};
+        if (!(fields >> mark.clock >> std::hex >> mark.hash))
+            throw std::runtime_error(fmt::format("{}:{}: expected 'clock hash'", filepath, line_number));
+        marks.push_back(mark);
+    }
+    if (!marks.empty())
+    {
+        rolling_ = marks.back().hash; // sample() carries on from the last mark
+        next_clock_ = marks.back().clock + interval;
+    }
+}
+
+PioStateHash::Divergence PioStateHash::compare(const PioStateHash& a, const PioStateHash& b)
+{
+    if (a.interval != b.interval)
+        throw std::invalid_argument(fmt::format("State hash intervals differ: {} and {}", a.interval, b.interval));
+
+    Divergence result;
+    size_t common = std::min(a.marks.size(), b.marks.size());
+    for (size_t i = 0; i < common; i++)
+    {
+        if (a.marks[i].clock == b.marks[i].clock && a.marks[i].hash == b.marks[i].hash)
+            continue;
+        result.found = true;
+        result.index = i;
+        result.good_clock = i > 0 ? a.marks[i - 1].clock : -1;
+        result.bad_clock = a.marks[i].clock;
+        break;
+    }
+    return result;
+}
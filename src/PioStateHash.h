@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class PioStateMachine;
+
+// Rolling hash of the architectural state (registers, pins, pindirs, FIFOs, IRQ flags), folded in
+// every 'interval' clocks and kept as one mark per interval. Two runs, or two emulator builds,
+// compare in O(intervals): the first differing mark names the interval to re-run with tracing.
+//
+// Sampled at the start of the tick whose clock is a multiple of the interval, before anything
+// executes; run() stops its fast paths there, so the marks don't depend on how the machine got
+// there. Emulator-internal flags are left out on purpose, only what the hardware has counts.
+//
+// File: text, "# pio_emu state hash, interval N" then one "clock hash" line (hash in hex) per mark.
+class PioStateHash
+{
+public:
+    struct Mark
+    {
+        int clock;
+        uint64_t hash; // rolling: covers every sample up to and including this one
+    };
+
+    // Where two runs part, 'index' into both marks lists. The states still agreed at
+    // good_clock (-1: unknown, the first mark already differs) and no longer at bad_clock.
+    struct Divergence
+    {
+        bool found = false;
+        size_t index = 0;
+        int good_clock = -1;
+        int bad_clock = -1;
+    };
+
+    explicit PioStateHash(int interval = 1024);
+
+    int interval;
+    std::vector<Mark> marks;
+
+    int nextClock() const { return next_clock_; }
+    uint64_t current() const { return rolling_; }
+    void sample(const PioStateMachine& pio);       // called by tick() when pio.clock reaches nextClock()
+    void finish(const PioStateMachine& pio);       // takes a sample due at pio.clock that no tick took yet
+    void reset(int start_clock = 0);               // next mark at the first multiple of interval after start_clock
+
+    static uint64_t stateHash(const PioStateMachine& pio); // the architectural state alone
+
+    void save(const std::string& filepath) const; // throws std::runtime_error
+    void load(const std::string& filepath);       // throws std::runtime_error
+
+    // Marks are compared in order; a run that stopped early only diverges if its marks differ.
+    // Throws std::invalid_argument when the intervals are not the same.
+    static Divergence compare(const PioStateHash& a, const PioStateHash& b);
+
+private:
+    uint64_t rolling_;
+    int next_clock_;
+};
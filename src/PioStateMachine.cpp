@@ -1,6 +1,15 @@
 #include "PioStateMachine.h"
 #include "iniparse.h"
+#include "PioBitOps.h"
+#include "PioBreakpoints.h"
+#include "PioProfiler.h"
+#include "PioFifoStats.h"
+#include "PioPinStats.h"
+#include "PioRecorder.h"
+#include "PioStateHash.h"
+#include "PioTrace.h"
 #include <format>
+#include <algorithm>
 
 using u16 = uint16_t;
 using u32 = uint32_t;
@@ -56,6 +65,9 @@ void PioStateMachine::setDefault()
     exec_command = false;
     clock = 0;
     wait_is_stalling = false;
+    out_not_finished = false;
+    out_first_shifted = 0;
+    clkdiv_accumulator = 0;
 
     regs.x = 0;
     regs.y = 0;
@@ -89,6 +101,8 @@ void PioStateMachine::setDefault()
     settings.autopull_enable = false;
     settings.autopush_enable = false;
     settings.status_sel = false;
+    settings.clkdiv_int = 1;
+    settings.clkdiv_frac = 0;
 
     fifo.tx_fifo = { 0 };
     fifo.rx_fifo = { 0 };
@@ -100,6 +114,68 @@ void PioStateMachine::setDefault()
     irq_is_waiting = false;
 }
 
+bool PioStateMachine::applySetting(const std::string& key, const std::string& val)
+{
+    if (key == "sideset_count")
+        settings.sideset_count = std::stoi(val);
+    else if (key == "sideset_opt")
+        settings.sideset_opt = (val == "true");
+    else if (key == "sideset_to_pindirs")
+        settings.sideset_to_pindirs = (val == "true");
+    else if (key == "sideset_base")
+        settings.sideset_base = std::stoi(val);
+    else if (key == "in_base")
+        settings.in_base = std::stoi(val);
+    else if (key == "out_base")
+        settings.out_base = std::stoi(val);
+    else if (key == "set_base")
+        settings.set_base = std::stoi(val);
+    else if (key == "jmp_pin")
+        settings.jmp_pin = std::stoi(val);
+    else if (key == "set_count")
+        settings.set_count = std::stoi(val);
+    else if (key == "out_count")
+        settings.out_count = std::stoi(val);
+    else if (key == "push_threshold")
+        settings.push_threshold = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "pull_threshold")
+        settings.pull_threshold = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "fifo_level_N")
+        settings.fifo_level_N = std::stoi(val);
+    else if (key == "wrap_start")
+        settings.wrap_start = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "wrap_end")
+        settings.wrap_end = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "in_shift_right")
+        settings.in_shift_right = (val == "true");
+    else if (key == "out_shift_right")
+        settings.out_shift_right = (val == "true");
+    else if (key == "in_shift_autopush")
+        settings.in_shift_autopush = (val == "true");
+    else if (key == "out_shift_autopull")
+        settings.out_shift_autopull = (val == "true");
+    else if (key == "autopull_enable")
+        settings.autopull_enable = (val == "true");
+    else if (key == "autopush_enable")
+        settings.autopush_enable = (val == "true");
+    else if (key == "status_sel")
+        settings.status_sel = (val == "true");
+    else if (key == "clkdiv_int")
+        settings.clkdiv_int = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "clkdiv_frac")
+        settings.clkdiv_frac = static_cast<uint32_t>(std::stoul(val));
+    else if (key == "pindir")
+    {
+        uint32_t pindirMask = static_cast<uint32_t>(std::stoul(val, nullptr, 16));
+
+        for (size_t i = 0; i < gpio.pindirs.size(); ++i)
+            gpio.pindirs[i] = (pindirMask >> i) & 1u;
+    }
+    else
+        return false;
+    return true;
+}
+
 void PioStateMachine::parseSetting(const std::string& filepath)
 {
     IniParse::IniData data = IniParse::parseIni(filepath);
@@ -112,58 +188,7 @@ void PioStateMachine::parseSetting(const std::string& filepath)
 
         //fmt::println("Checking: {}", setting.first);
         try {
-            if (key == "sideset_count")
-                settings.sideset_count = std::stoi(val);
-            else if (key == "sideset_opt")
-                settings.sideset_opt = (val == "true");
-            else if (key == "sideset_to_pindirs")
-                settings.sideset_to_pindirs = (val == "true");
-            else if (key == "sideset_base")
-                settings.sideset_base = std::stoi(val);
-            else if (key == "in_base")
-                settings.in_base = std::stoi(val);
-            else if (key == "out_base")
-                settings.out_base = std::stoi(val);
-            else if (key == "set_base")
-                settings.set_base = std::stoi(val);
-            else if (key == "jmp_pin")
-                settings.jmp_pin = std::stoi(val);
-            else if (key == "set_count")
-                settings.set_count = std::stoi(val);
-            else if (key == "out_count")
-                settings.out_count = std::stoi(val);
-            else if (key == "push_threshold")
-                settings.push_threshold = static_cast<uint32_t>(std::stoul(val));
-            else if (key == "pull_threshold")
-                settings.pull_threshold = static_cast<uint32_t>(std::stoul(val));
-            else if (key == "fifo_level_N")
-                settings.fifo_level_N = std::stoi(val);
-            else if (key == "wrap_start")
-                settings.wrap_start = static_cast<uint32_t>(std::stoul(val));
-            else if (key == "wrap_end")
-                settings.wrap_end = static_cast<uint32_t>(std::stoul(val));
-            else if (key == "in_shift_right")
-                settings.in_shift_right = (val == "true");
-            else if (key == "out_shift_right")
-                settings.out_shift_right = (val == "true");
-            else if (key == "in_shift_autopush")
-                settings.in_shift_autopush = (val == "true");
-            else if (key == "out_shift_autopull")
-                settings.out_shift_autopull = (val == "true");
-            else if (key == "autopull_enable")
-                settings.autopull_enable = (val == "true");
-            else if (key == "autopush_enable")
-                settings.autopush_enable = (val == "true");
-            else if (key == "status_sel")
-                settings.status_sel = (val == "true");
-            else if (key == "pindir")
-            {
-                uint32_t pindirMask = static_cast<uint32_t>(std::stoul(val, nullptr, 16));
-
-                for (size_t i = 0; i < gpio.pindirs.size(); ++i)
-                    gpio.pindirs[i] = (pindirMask >> i) & 1u;
-            }
-            else
+            if (!applySetting(key, val))
                 LOG_FATAL("Unknown setting when parsing ini file.");
         }
         catch (const std::exception& e)
@@ -220,7 +245,6 @@ void PioStateMachine::parseSetting(const std::string& filepath)
             LOG_FATAL_FMT("{}", e.what());
         }
     }
-    fmt::print("\n");
 }
 
 void PioStateMachine::reset(const std::string& filepath)
@@ -260,6 +284,19 @@ void PioStateMachine::pull_from_tx_fifo()
 
 void PioStateMachine::tick()
 {
+    /* ----- Apply scheduled external inputs ----- */
+    if (!input_sources.empty())
+        applyInputSources();
+    if (recorder)
+        recorder->beforeCycle(*this);
+    if (state_hash && clock >= state_hash->nextClock())
+        state_hash->sample(*this);
+
+    if (profiler)
+        profiler->recordCycle(*this);
+    if (fifo_stats)
+        fifo_stats->recordCycles(*this);
+
     bool should_execute = false;
     if (delay_delay == true)  // stalling
     {
@@ -282,6 +319,68 @@ void PioStateMachine::tick()
 
     /* ----- Update the 'status' depending on RxFIFO or TxFIFO count ----- */
         // TODO: Check If we want to do this before, or after executeinst?
+    updateStatus();
+
+    if (should_execute == true)
+    {
+        /* ----- Get new instruction and execute it ----- */
+        if (exec_command == false)
+            currentInstruction = instructionMemory[regs.pc];
+        else
+            exec_command = false;
+
+        executeInstruction();
+
+        /* ----- Update PC ----- */
+        advancePc();
+    }
+
+    /* Update gpio */
+    setAllGpio();
+    if (pin_stats)
+        pin_stats->sample(*this);
+    if (!pin_listeners.empty())
+        notifyPinListeners();
+    if (tracer)
+        tracer->record(*this);
+    clock++;
+    if (recorder)
+        recorder->afterCycle(*this);
+}
+
+uint32_t PioStateMachine::clkdivDivisor() const
+{
+    // s3.5.5: INT of 0 is a divisor of 65536, the 8-bit FRAC adds 1/256ths
+    u32 integer = settings.clkdiv_int & 0xffff;
+    if (integer == 0)
+        integer = 65536;
+    return (integer << 8) | (settings.clkdiv_frac & 0xff);
+}
+
+bool PioStateMachine::systemTick()
+{
+    // The divider is a fractional accumulator: it fires on average once every INT + FRAC/256
+    // system clocks, with the same one-cycle jitter as the hardware for fractional values
+    clkdiv_accumulator += 256;
+    u32 divisor = clkdivDivisor();
+    if (clkdiv_accumulator < divisor)
+        return false;
+    clkdiv_accumulator -= divisor;
+    tick();
+    return true;
+}
+
+uint64_t PioStateMachine::systemTicksToSmTicks(uint64_t system_cycles)
+{
+    // Same as calling systemTick() system_cycles times, without the ticks
+    u32 divisor = clkdivDivisor();
+    uint64_t total = clkdiv_accumulator + system_cycles * 256;
+    clkdiv_accumulator = static_cast<u32>(total % divisor);
+    return total / divisor;
+}
+
+void PioStateMachine::updateStatus()
+{
     if (settings.status_sel == 0)
     {
         // For Tx FIFO, All-ones if TX FIFO count < N, otherwise all-zeroes
@@ -294,41 +393,262 @@ void PioStateMachine::tick()
     }
     else
         LOG_ERROR("Unknow status_sel");
+}
 
-    if (should_execute == true)
+void PioStateMachine::advancePc()
+{
+    // for 'jmp' and 'wait' instruction
+    if (skip_increase_pc == false)  // We should increase PC as normal 
     {
-        /* ----- Get new instruction and execute it ----- */
-        if (exec_command == false)
-            currentInstruction = instructionMemory[regs.pc];
-        else
-            exec_command = false;
+        regs.pc++;
+        if (regs.pc == settings.wrap_end + 1)
+            regs.pc = settings.wrap_start;
+    }
+    else
+    {
+        // We want to skip increase pc
+        // Check if the skip is due to a jmp, set pc to the address to jmp to
+        if (jmp_to >= 0)
+        {
+            regs.pc = jmp_to;
+            jmp_to = -1;  // Back to unset
+        }
+        skip_increase_pc = false;
+    }
+}
 
-        executeInstruction();
+int PioStateMachine::nextInputClock() const
+{
+    // The state hash is no input, but its samples need a tick at their exact clock just the same
+    int next = state_hash ? state_hash->nextClock() : -1;
+    for (const PioInputSource* source : input_sources)
+    {
+        int source_next = source->nextEventClock();
+        if (source_next >= 0 && (next < 0 || source_next < next))
+            next = source_next;
+    }
+    return next;
+}
 
-        /* ----- Update PC ----- */
-        // for 'jmp' and 'wait' instruction
-        if (skip_increase_pc == false)  // We should increase PC as normal 
+void PioStateMachine::applyInputSources()
+{
+    for (PioInputSource* source : input_sources)
+    {
+        int source_next = source->nextEventClock();
+        if (source_next >= 0 && source_next <= clock)
+            source->apply(*this);
+    }
+}
+
+bool PioStateMachine::notifyPinListeners()
+{
+    u32 pins = PioBitOps::gatherPins(gpio.raw_data);
+    u32 changed = pins ^ listened_pins;
+    if (changed == 0)
+        return false;
+
+    listened_pins = pins;
+    bool notified = false;
+    for (PioPinListener* listener : pin_listeners)
+    {
+        if (listener->pinMask() & changed)
         {
-            regs.pc++;
-            if (regs.pc == settings.wrap_end + 1)
-                regs.pc = settings.wrap_start;
+            listener->onPinChange(clock, pins);
+            notified = true;
         }
-        else
+    }
+    return notified;
+}
+
+bool PioStateMachine::needsCycleVisibility() const
+{
+    return cycle_accurate || recorder || tracer || (breakpoints && breakpoints->needsEveryCycle());
+}
+
+bool PioStateMachine::step()
+{
+    if (breakpoints == nullptr || breakpoints->empty())
+    {
+        tick();
+        return true;
+    }
+
+    if (breakpoints->beforeCycle(*this))
+        return false;
+    tick();
+    return !breakpoints->afterCycle(*this);
+}
+
+int PioStateMachine::run(int cycles)
+{
+    const int start_clock = clock;
+    const int end_clock = cycles > kMaxClock - clock ? kMaxClock : clock + cycles;
+
+    // Checked once here, the loops below only pay for breakpoints when there are some
+    PioBreakpoints* active = (breakpoints && !breakpoints->empty()) ? breakpoints : nullptr;
+    if (active)
+        active->clearHit();
+
+    if (needsCycleVisibility())
+    {
+        while (clock < end_clock && step())
+            ;
+        return clock - start_clock;
+    }
+
+    refreshBlocks();
+    const uint32_t pc_mask = active ? active->pcMask() : 0;
+    while (clock < end_clock)
+    {
+        // PC breakpoints only (anything else needs cycle visibility): check the fetch, and
+        // don't run blocks that pass over a breakpoint address
+        if (active && active->beforeCycle(*this))
+            break;
+
+        // Nothing but the input sources can change the sm from outside, fast paths stop at their next event
+        int event_clock = nextInputClock();
+        int limit = (event_clock >= 0 && event_clock < end_clock) ? event_clock : end_clock;
+
+        bool idle = !delay_delay && regs.delay == 0 && !exec_command;
+        if (limit <= clock)
+        {
+            tick(); // applies the due inputs
+        }
+        else if (idle && blocks.length[regs.pc] > 0 && (blocks.span[regs.pc] & pc_mask) == 0)
+        {
+            executeBlock(limit);
+        }
+        else if (delay_delay)
         {
-            // We want to skip increase pc
-            // Check if the skip is due to a jmp, set pc to the address to jmp to
-            if (jmp_to >= 0)
+            // Stalled: tick once, if nothing moved the sm is waiting on something that can't
+            // change before the next input event (no host access), so fast-forward to it
+            Registers regs_before = regs;
+            GPIORegs gpio_before = gpio;
+            Fifo fifo_before = fifo;
+            std::array<bool, 8> irq_before = irq_flags;
+
+            tick();
+
+            // The tick may have woken a device that scheduled an answer
+            event_clock = nextInputClock();
+            if (event_clock >= 0 && event_clock < limit)
+                limit = event_clock;
+
+            if (delay_delay && clock < limit && regs == regs_before && gpio == gpio_before && fifo == fifo_before && irq_flags == irq_before)
             {
-                regs.pc = jmp_to;
-                jmp_to = -1;  // Back to unset
+                if (profiler)
+                    profiler->addStalled(*this, limit - clock);
+                if (fifo_stats)
+                    fifo_stats->recordCycles(*this, limit - clock);
+                clock = limit;
             }
-            skip_increase_pc = false;
+        }
+        else
+        {
+            tick();
         }
     }
+    return clock - start_clock;
+}
 
-    /* Update gpio */
-    setAllGpio();
-    clock++;
+bool PioStateMachine::isBlockSafe(uint16_t instruction)
+{
+    // Only instructions that can never stall and don't touch FIFOs, IRQs or exec
+    u16 opcode = (instruction & 0xe000) >> 13;
+    switch (opcode)
+    {
+    case 0b000: // JMP
+    case 0b111: // SET
+        return true;
+    case 0b101: // MOV (everything but 'mov exec')
+        return ((instruction >> 5) & 0b111) != 0b100;
+    default:    // WAIT, IN, OUT, PUSH/PULL, IRQ
+        return false;
+    }
+}
+
+bool PioStateMachine::isBlockTerminator(uint16_t instruction)
+{
+    // Anything that might not fall through to pc + 1
+    u16 opcode = (instruction & 0xe000) >> 13;
+    if (opcode == 0b000) // JMP
+        return true;
+    if (opcode == 0b101 && ((instruction >> 5) & 0b111) == 0b101) // MOV PC
+        return true;
+    return false;
+}
+
+void PioStateMachine::refreshBlocks()
+{
+    if (blocks.valid && blocks.instructions == instructionMemory
+        && blocks.wrap_start == settings.wrap_start && blocks.wrap_end == settings.wrap_end)
+        return;
+
+    blocks.instructions = instructionMemory;
+    blocks.wrap_start = settings.wrap_start;
+    blocks.wrap_end = settings.wrap_end;
+    blocks.length.fill(0);
+    blocks.span.fill(0);
+
+    for (u32 start = 0; start < 32; start++)
+    {
+        // Follow the straight-line path (with wrap) until an unsafe instruction or a terminator
+        u32 pc = start;
+        u32 length = 0;
+        while (length < 32 && isBlockSafe(instructionMemory[pc]))
+        {
+            length++;
+            blocks.span[start] |= 1u << pc;
+            if (isBlockTerminator(instructionMemory[pc]))
+                break;
+            pc++;
+            if (pc == settings.wrap_end + 1)
+                pc = settings.wrap_start;
+            pc %= 32;
+        }
+        blocks.length[start] = static_cast<uint8_t>(length);
+    }
+    blocks.valid = true;
+}
+
+void PioStateMachine::executeBlock(int end_clock)
+{
+    // Same as tick() for every instruction of the block, but the delay cycles after each of them
+    // are collapsed: nothing in a block can stall or change state while the delay counts down.
+    for (u32 n = blocks.length[regs.pc]; n > 0 && clock < end_clock; n--)
+    {
+        const u32 pc = regs.pc;
+        if (fifo_stats)
+            fifo_stats->recordCycles(*this);
+        updateStatus();
+        currentInstruction = instructionMemory[regs.pc];
+        executeInstruction();
+        advancePc();
+        setAllGpio();
+        if (pin_stats)
+            pin_stats->sample(*this);
+        if (!pin_listeners.empty() && notifyPinListeners())
+        {
+            // A listener that is also an input source (a device) may have scheduled its answer
+            int event_clock = nextInputClock();
+            if (event_clock >= 0 && event_clock < end_clock)
+                end_clock = std::max(event_clock, clock + 1);
+        }
+        clock++;
+
+        int skipped = 0;
+        if (regs.delay > 0)
+        {
+            skipped = std::min<int>(regs.delay, end_clock - clock);
+            regs.delay -= skipped;
+            clock += skipped;
+            updateStatus(); // autopull in the instruction might have changed the FIFO level
+            if (fifo_stats && skipped > 0)
+                fifo_stats->recordCycles(*this, skipped);
+        }
+        if (profiler)
+            profiler->addExecuted(pc, skipped);
+    }
 }
 
 void PioStateMachine::doSideSet(uint16_t delay_side_set_field)
@@ -464,7 +784,7 @@ void PioStateMachine::executeInstruction()
     // settings.sideset_count = settings.sideset_opt ? (settings.sideset_count - 1) : settings.sideset_count; TODO: Might be wrong
     u16 delay_bit_count = 5 - settings.sideset_count - (settings.sideset_opt ? 1 : 0);
     // extract the delay filed
-    regs.delay = delay_side_set_field & ((1 << delay_bit_count) - 1);
+    regs.delay = delay_side_set_field & PioBitOps::lowMask(delay_bit_count);
 
     // --- Do side set (s3.5.1: Sideset take place before the instrucion) --- 
     PioStateMachine::doSideSet(delay_side_set_field);
@@ -681,9 +1001,7 @@ void PioStateMachine::executeIn()
     if (bitCount == 0)
         bitCount = 32; // 32 is encoded as 0b00000
 
-    u32 mask = (1 << bitCount) - 1;
-    if (bitCount == 32)
-        mask = 0xff'ff'ff'ff;
+    u32 mask = PioBitOps::lowMask(bitCount);
     u32 data = 0;
 
     switch (source)
@@ -694,14 +1012,8 @@ void PioStateMachine::executeIn()
             LOG_WARNING("'in_base' isn't set before use in 'in pin', continuing");
             return;
         }
-        // Loop through the pins we need to read
-        for (u16 i = 0; i < bitCount; i++)
-        {
-            // Calc the actual GPIO pin number (wrap around if > 31)
-            u16 readPinNumber = (settings.in_base + i) % 32;
-            // Shift the pin state to the correct position in data
-            data |= ((gpio.raw_data[readPinNumber] & 1) << i);
-        }
+        // Rotate the pin word so in_base lands on bit 0 (wraps around at 31), keep bitCount bits
+        data = std::rotr(PioBitOps::gatherPins(gpio.raw_data), settings.in_base) & mask;
         break;
     case 0b001: // X
         data = regs.x & mask;
@@ -727,19 +1039,8 @@ void PioStateMachine::executeIn()
         return;
     }
 
-    // Shift the data into ISR
-    if (settings.in_shift_right == true)
-    {
-        // right shift
-        regs.isr = regs.isr >> bitCount;
-        regs.isr |= (data << (32 - bitCount));
-    }
-    else
-    {
-        // left shift
-        regs.isr = regs.isr << bitCount;
-        regs.isr |= data;
-    }
+    // Shift the data into ISR (right shift fills from the msb, left shift from the lsb)
+    regs.isr = PioBitOps::shiftIn(regs.isr, data, bitCount, settings.in_shift_right);
 
     // update ISR_shift_count
     regs.isr_shift_count += bitCount;
@@ -773,11 +1074,9 @@ void PioStateMachine::executeOut()
         bitCount = 32;
     u32 osrOriginal = regs.osr; // For EXEC
 
-    // flag
+    // flag (out_not_finished, out_first_shifted)
     // when is bitcount is bigger then what we have in osr and autopull is enabled, we can only shift what ever we have now,
     // letfovers will be shift out next cycle.
-    static bool out_not_finished = false;
-    static int first_shifted = 0;
     bool isSecond = false;
     u16 bitCountOriginal = bitCount;
 
@@ -816,45 +1115,29 @@ void PioStateMachine::executeOut()
     if (((regs.osr_shift_count + bitCount) >= settings.pull_threshold) && settings.autopull_enable && (out_not_finished == false))
     {
         // data in osr is not enough
-        first_shifted = settings.pull_threshold - regs.osr_shift_count;
-        bitCount = first_shifted;
-        mask = (1 << first_shifted) - 1; // can't shift out all the bits in this cycle, shift till pull_thres
+        out_first_shifted = settings.pull_threshold - regs.osr_shift_count;
+        bitCount = out_first_shifted;
+        mask = PioBitOps::lowMask(out_first_shifted); // can't shift out all the bits in this cycle, shift till pull_thres
         //if(!(regs.osr_shift_count + bitCount) == settings.pull_threshold)
         out_not_finished = true;
     }
     else if (out_not_finished == true)
     {
         // second times
-        mask = (1 << (bitCount - first_shifted)) - 1;
-        bitCount = bitCount - first_shifted;
+        mask = PioBitOps::lowMask(bitCount - out_first_shifted);
+        bitCount = bitCount - out_first_shifted;
         // reset states
         out_not_finished = false;
-        first_shifted = 0;
+        out_first_shifted = 0;
         isSecond = true;
     }
     else
-        mask = (1 << bitCount) - 1;
-
-    if (bitCount == 32) // mask calc when bitcount=32 will fail(overflow)
-        mask = 0xff'ff'ff'ff;
+        mask = PioBitOps::lowMask(bitCount);
 
-    // get data
-    if (settings.out_shift_right)
-    {
-        // shift right
-        // take bitCount from lsb
-        data = regs.osr & mask;
-        regs.osr = regs.osr >> bitCount;
-    }
-    else
-    {
-        // shit left
-        // take bitCount from msb
-        mask = mask << (32 - bitCount);
-        data = regs.osr & mask;
-        data = data >> (32 - bitCount);
-        regs.osr = regs.osr << bitCount;
-    }
+    // get data (shift right takes bitCount from lsb, shift left from msb)
+    data = PioBitOps::shiftOut(regs.osr, bitCount, settings.out_shift_right);
+    if (!settings.out_shift_right)
+        mask = PioBitOps::shiftLeft(mask, 32 - bitCount); // mask follows the bits taken from the msb
 
     //update the shift counter
     regs.osr_shift_count += bitCount;
@@ -864,8 +1147,8 @@ void PioStateMachine::executeOut()
     // Shift mask for out_not_finished
     if (out_not_finished == true)
     {
-        mask = mask << (bitCountOriginal - first_shifted);
-        data = data << (bitCountOriginal - first_shifted);
+        mask = mask << (bitCountOriginal - out_first_shifted);
+        data = data << (bitCountOriginal - out_first_shifted);
     }
 
     // Put the data to destination
@@ -877,13 +1160,10 @@ void PioStateMachine::executeOut()
             LOG_WARNING("'out_base' isn't set before use in 'out pin', continuing");
             return;
         }
-        // Loop through the pins we need to set
-        for (u16 i = 0; i < bitCount; i++)
-        {
-            // Calc the actual GPIO pin number (wrap around if > 31)
-            u16 writePinNumber = (settings.out_base + i) % 32;
-            gpio.out_data[writePinNumber] = (data & (1 << i)) ? 1 : 0;
-        }
+        // Rotate bitCount bits up to out_base (wraps around at 31) and write them in one go
+        PioBitOps::scatterPins(gpio.out_data,
+            std::rotl(PioBitOps::lowMask(bitCount), settings.out_base),
+            std::rotl(data, settings.out_base));
         break;
     case 0b001: // X
         // TODO: Check should we clear the register first or just shift in?
@@ -909,11 +1189,9 @@ void PioStateMachine::executeOut()
         }
         else
         {
-            for (int i = 0; i < bitCount; i++)
-            {
-                u16 outPin = (settings.out_base + i) % 32;
-                gpio.out_pindirs[outPin] = (data & (1 << i)) ? 1 : 0;
-            }
+            PioBitOps::scatterPins(gpio.out_pindirs,
+                std::rotl(PioBitOps::lowMask(bitCount), settings.out_base),
+                std::rotl(data, settings.out_base));
         }
         break;
     case 0b101: // PC
@@ -1002,6 +1280,8 @@ void PioStateMachine::executePush()
             regs.isr = 0;
             regs.isr_shift_count = 0;
             LOG_WARNING("RX_STALL, isr is claered, potential data lost");
+            if (fifo_stats)
+                fifo_stats->recordEvent(PioFifoStats::EventKind::RxDropped, *this);
         }
     }
 }
@@ -1043,6 +1323,8 @@ void PioStateMachine::executePull()
             // (s3.4.7.2): A nonblocking PULL on an empty FIFO has the same effect as 'MOV OSR, X'
             regs.osr = regs.x;
             fifo.pull_is_stalling = false;
+            if (fifo_stats)
+                fifo_stats->recordEvent(PioFifoStats::EventKind::TxEmptyPull, *this);
             LOG_INFO("A non-blocking PULL on an empty FIFO has the same effect as 'MOV OSR, X', continuing");
         }
     }
@@ -1067,14 +1349,8 @@ void PioStateMachine::executeMov()
             LOG_WARNING("'in_base' isn't set before use in 'mov dst, pin', continuing");
             return;
         }
-        // Loop through the pins we need to read
-        for (u16 i = 0; i < 32; i++)
-        {
-            // Calc the actual GPIO pin number (wrap around if > 31)
-            u16 readPinNumber = (settings.in_base + i) % 32;
-            // Shift the pin state to the correct position in data
-            data |= ((gpio.raw_data[readPinNumber] & 1) << i);
-        }
+        // All 32 pins, rotated so in_base is bit 0
+        data = std::rotr(PioBitOps::gatherPins(gpio.raw_data), settings.in_base);
         break;
     case 0b001: // X
         data = regs.x;
@@ -1111,15 +1387,8 @@ void PioStateMachine::executeMov()
         data = ~data;
         break;
     case 0b10: // bit-reverse
-    {
-        u32 old_data = data;
-        data = 0;
-        for (int i = 0; i < 32; i++) // function checked
-        {
-            data |= ((old_data >> i) & 1) << (31 - i);
-        }
+        data = PioBitOps::bitReverse(data);
         break;
-    }
     case 0b11: // reserved
         break;
     default:
@@ -1141,14 +1410,10 @@ void PioStateMachine::executeMov()
             LOG_WARNING("'out_count' isn't set before use in 'mov pin, continuing");
             return;
         }
-        // Loop through the pins we need to write
-        for (u16 i = 0; i < settings.out_count; i++)
-            // P.337 OUT_COUNT: The number of pins asserted by ... MOV PINS instruction.
-        {
-            // Calc the actual GPIO pin number (wrap around if > 31)
-            u16 writePinNumber = (settings.out_base + i) % 32;
-            gpio.out_data[writePinNumber] = (data & (1 << i)) ? 1 : 0;
-        }
+        // P.337 OUT_COUNT: The number of pins asserted by ... MOV PINS instruction.
+        PioBitOps::scatterPins(gpio.out_data,
+            std::rotl(PioBitOps::lowMask(settings.out_count), settings.out_base),
+            std::rotl(data, settings.out_base));
         break;
     case 0b001: // X
         regs.x = data;
@@ -1250,11 +1515,9 @@ void PioStateMachine::executeSet()
             LOG_WARNING("'set_count' isn't set before use in SET instruction, continuing");
         else
         {
-            for (int i = 0; i < settings.set_count; i++)
-            {
-                u16 setPin = (settings.set_base + i) % 32;
-                gpio.set_data[setPin] = (data & (1 << i)) ? 1 : 0;
-            }
+            PioBitOps::scatterPins(gpio.set_data,
+                std::rotl(PioBitOps::lowMask(settings.set_count), settings.set_base),
+                std::rotl(static_cast<u32>(data), settings.set_base));
         }
         break;
     case 0b001: // X
@@ -1272,11 +1535,9 @@ void PioStateMachine::executeSet()
             LOG_WARNING("'set_count' isn't set before use in SET instruction, continuing");
         else
         {
-            for (int i = 0; i < settings.set_count; i++)
-            {
-                u16 setPin = (settings.set_base + i) % 32;
-                gpio.set_pindirs[setPin] = (data & (1 << i)) ? 1 : 0;
-            }
+            PioBitOps::scatterPins(gpio.set_pindirs,
+                std::rotl(PioBitOps::lowMask(settings.set_count), settings.set_base),
+                std::rotl(static_cast<u32>(data), settings.set_base));
         }
         break;
     case 0b101: // Reserved
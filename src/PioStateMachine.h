@@ -3,8 +3,11 @@
 #include <array>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <functional>
+#include <limits>
 #include "Logger/Logger.h"
+#include "Logger/LogContext.h"
 
 struct pioStateMachineSettings
 {
@@ -30,6 +33,73 @@ struct pioStateMachineSettings
     bool autopull_enable = false;
     bool autopush_enable = false;
     bool status_sel = false;  // 0 for txfifo, 1 for rxfifo
+    uint32_t clkdiv_int = 1;   // SMx_CLKDIV integer part, 0 means 65536
+    uint32_t clkdiv_frac = 0;  // SMx_CLKDIV fractional part, in 1/256ths
+
+    bool operator==(const pioStateMachineSettings&) const = default;
+};
+
+class PioStateMachine;
+class PioBreakpoints;
+class PioExpression;
+class PioProfiler;
+class PioFifoStats;
+class PioPinStats;
+class PioRecorder;
+class PioStateHash;
+namespace PioTrace { class Writer; }
+
+// Where a reflected variable lives inside a PioStateMachine. Tools that evaluate variables every
+// cycle (breakpoints, expressions) resolve the name once and read through this, no lookup and no
+// std::function call. Offsets rather than pointers, so a ref works on any copy of the machine.
+struct PioVarRef
+{
+    enum class Type : uint8_t
+    {
+        U8,
+        I8,
+        Bool,
+        U32,
+        I32
+    };
+
+    uint32_t offset = 0;
+    Type type = Type::U32;
+
+    uint32_t read(const PioStateMachine& pio) const
+    {
+        const char* field = reinterpret_cast<const char*>(&pio) + offset;
+        switch (type)
+        {
+        case Type::U8:   return *reinterpret_cast<const uint8_t*>(field);
+        case Type::I8:   return static_cast<uint32_t>(*reinterpret_cast<const int8_t*>(field));
+        case Type::Bool: return *reinterpret_cast<const bool*>(field);
+        case Type::I32:  return static_cast<uint32_t>(*reinterpret_cast<const int32_t*>(field));
+        default:         return *reinterpret_cast<const uint32_t*>(field);
+        }
+    }
+};
+
+// Anything outside the state machine that drives gpio.external_data on its own schedule
+// (stimulus files, device models). Changes are applied at the start of the tick whose clock
+// they are due at, exactly like a host poking external_data between two ticks.
+class PioInputSource
+{
+public:
+    virtual ~PioInputSource() = default;
+    virtual int nextEventClock() const = 0;       // clock of the next change, -1 when there is none
+    virtual void apply(PioStateMachine& pio) = 0; // apply every change due at or before pio.clock
+};
+
+// Anything that follows the GPIO levels (protocol decoders, see PioDecoders.h). onPinChange() is
+// called after the pin update of each clock on which one of the pins in pinMask() changed, so
+// listeners run at edge rate; run()'s fast paths only skip clocks where no pin can move.
+class PioPinListener
+{
+public:
+    virtual ~PioPinListener() = default;
+    virtual uint32_t pinMask() const = 0;
+    virtual void onPinChange(int clock, uint32_t pins) = 0; // pins: all 32 levels from 'clock' on, bit n = gpio n
 };
 
 class PioStateMachine
@@ -37,7 +107,14 @@ class PioStateMachine
 public:
     PioStateMachine();
     PioStateMachine(const std::string& filepath); // loads the settings and instruction from .ini
+    // One [settings] key of the .ini ("set_base", "pindir", ...); false for an unknown key, the
+    // std::stoi family's exceptions for a bad value
+    bool applySetting(const std::string& key, const std::string& val);
     void tick(); // Forward a clock
+    bool systemTick(); // Forward a system clock, ticks the sm when the clock divider fires
+    int run(int cycles); // Forward up to 'cycles' clocks, collapsing straight-line blocks when possible, returns clocks advanced
+    static constexpr int kMaxClock = std::numeric_limits<int>::max(); // the clock is an int, run() stops here
+    bool step(); // tick() with the breakpoint checks, false when a breakpoint stopped it (see PioBreakpoints)
 
     std::array<uint16_t, 32> instructionMemory;
     uint16_t currentInstruction;
@@ -52,6 +129,10 @@ public:
     bool exec_command = false; // for 'out exec' and 'mov exec', might alter the logic for get nextInstruction for memory
     int clock = 0;
     bool wait_is_stalling = false;
+    uint32_t clkdiv_accumulator = 0; // in 1/256 system clocks, see systemTick()
+    // An 'out' that runs past pull_threshold with autopull is split over two cycles (see executeOut)
+    bool out_not_finished = false;
+    int out_first_shifted = 0;
 
     // State registers
     struct Registers
@@ -65,6 +146,8 @@ public:
         uint32_t pc = 0;
         uint32_t delay = 0;
         uint32_t status = 0;  // Indecate FIFO level > fifo_level_N, status_sel 0 for Tx 1 for Rx
+
+        bool operator==(const Registers&) const = default;
     } regs;
 
     // Configuration settings
@@ -85,6 +168,8 @@ public:
         std::array<int8_t, 32> set_pindirs;
         std::array<int8_t, 32> out_pindirs;
         std::array<int8_t, 32> sideset_pindirs;
+
+        bool operator==(const GPIORegs&) const = default;
     } gpio;
 
     // FIFOs
@@ -95,6 +180,8 @@ public:
         uint8_t rx_fifo_count = 0;
         bool push_is_stalling = false; // TODO: use of these variable need check
         bool pull_is_stalling = false;
+
+        bool operator==(const Fifo&) const = default;
     } fifo;
     void push_to_rx_fifo();
     void pull_from_tx_fifo();
@@ -110,16 +197,75 @@ public:
 
     // runtime helper
     bool run_until_var(const std::string& var_name, uint32_t target, int max_cycles = 10000);
+    bool run_until(PioExpression& condition, int max_cycles = 10000); // true once the condition holds, checked before every tick
+    bool run_until(const std::string& expression, int max_cycles = 10000); // compiles it first, see PioExpression
     std::array<std::string, 32> instruction_text;
 
+    // Scheduled external inputs (not owned), see PioInputSource
+    std::vector<PioInputSource*> input_sources;
+    int nextInputClock() const; // earliest nextEventClock() of all input sources (and the next state hash sample), -1 when none
+    void applyInputSources();
+
+    // Pin change listeners (not owned), see PioPinListener
+    std::vector<PioPinListener*> pin_listeners;
+    uint32_t listened_pins = 0; // levels the listeners last saw
+    bool notifyPinListeners(); // true when a listener was called
+
+    // Breakpoints and watchpoints (not owned), run() and step() stop on them
+    PioBreakpoints* breakpoints = nullptr;
+    // Per-address cycle counters (not owned), see PioProfiler
+    PioProfiler* profiler = nullptr;
+    // FIFO occupancy histograms and stall/overrun counters (not owned), see PioFifoStats
+    PioFifoStats* fifo_stats = nullptr;
+    // Edge counts and pulse-width histograms of selected pins (not owned), see PioPinStats
+    PioPinStats* pin_stats = nullptr;
+    // Records every change from outside the machine for replay (not owned), see PioRecorder
+    PioRecorder* recorder = nullptr;
+    // Rolling architectural state hash, sampled every N clocks (not owned), see PioStateHash
+    PioStateHash* state_hash = nullptr;
+    // Writes every cycle to an indexed trace file (not owned), see PioTrace::Writer
+    PioTrace::Writer* tracer = nullptr;
+
+    // Fast-path execution (see run())
+    bool cycle_accurate = false; // force run() through tick() so every cycle can be observed
+    bool needsCycleVisibility() const;
+
+    // Logging: LOG_* inside member functions land here and are tagged with stateMachineNumber and clock
+    LogContext log_context;
+    template <typename... Args>
+    void emitLog(Logger::LogLevel level, int lineNumber, const char* fileName, fmt::format_string<Args...> format, Args&&... args) const
+    {
+        log_context.logFormat(Logger::Origin{ stateMachineNumber, clock }, level, lineNumber, fileName, format, std::forward<Args>(args)...);
+    }
+
     //private:
     void setup_var_access();
     std::vector<std::string> get_available_set_vars() const;
     std::vector<std::string> get_available_get_vars() const;
     std::unordered_map <std::string, std::function<uint32_t()>> var_getters;
     std::unordered_map <std::string, std::function<void(uint32_t)>> var_setters;
+    std::unordered_map <std::string, PioVarRef> var_refs;
+    const PioVarRef* find_var_ref(const std::string& name) const; // nullptr for unknown names
 
     void executeInstruction();
+    void updateStatus();
+    void advancePc();
+
+    // Basic blocks: straight-line runs of instructions that can't stall or touch the FIFOs/IRQs,
+    // executed as one superinstruction by run(). Rebuilt when the program or wrap changes.
+    struct BlockCache
+    {
+        std::array<uint16_t, 32> instructions = { 0 };
+        uint32_t wrap_start = 0;
+        uint32_t wrap_end = 0;
+        std::array<uint8_t, 32> length = { 0 }; // 0: pc isn't a block start, use tick()
+        std::array<uint32_t, 32> span = { 0 };  // addresses the block runs through, bit N for address N
+        bool valid = false;
+    } blocks;
+    void refreshBlocks();
+    static bool isBlockSafe(uint16_t instruction);
+    static bool isBlockTerminator(uint16_t instruction);
+    void executeBlock(int end_clock);
 
     // Instruction handlers
     void executeJmp();
@@ -135,6 +281,9 @@ public:
     void doSideSet(uint16_t delay_side_set_field);
     void setAllGpio();
 
+    uint32_t clkdivDivisor() const; // clock divider in 1/256ths
+    uint64_t systemTicksToSmTicks(uint64_t system_cycles); // consumes the divider accumulator
+
     void setDefault();
     void parseSetting(const std::string& filepath);
     void reset(const std::string& filepath);
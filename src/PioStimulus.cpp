@@ -0,0 +1,211 @@
+#include "PioStimulus.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include "PioText.h"
+
+namespace {
+
+    int8_t parseLevel(const std::string& text)
+    {
+        if (text == "0")
+            return 0;
+        if (text == "1")
+            return 1;
+        return -1; // z, x, -1: released
+    }
+
+    // Free text up to $end, which can hold anything ("$var" included)
+    bool isTextSection(const std::string& token)
+    {
+        return token == "$comment" || token == "$date" || token == "$version";
+    }
+
+    // VCD timescale ("1ns", "10 us", ...) in seconds
+    double parseTimescale(const std::string& text)
+    {
+        std::string compact;
+        for (char c : text)
+            if (c != ' ' && c != '\t')
+                compact += c;
+
+        size_t unit_pos = compact.find_first_not_of("0123456789");
+        double magnitude = (unit_pos == 0) ? 1.0 : std::stod(compact.substr(0, unit_pos));
+        std::string unit = (unit_pos == std::string::npos) ? "s" : compact.substr(unit_pos);
+
+        static const std::map<std::string, double> units = {
+            { "s", 1.0 }, { "ms", 1e-3 }, { "us", 1e-6 }, { "ns", 1e-9 }, { "ps", 1e-12 }, { "fs", 1e-15 },
+        };
+        auto it = units.find(unit);
+        if (it == units.end())
+        {
+            LOG_WARNING_FMT("Unknown VCD timescale unit '{}', assuming seconds", unit);
+            return magnitude;
+        }
+        return magnitude * it->second;
+    }
+
+}
+
+void PioStimulus::add(int clock, int pin, int8_t value)
+{
+    if (pin < 0 || pin >= 32)
+    {
+        LOG_WARNING_FMT("Stimulus for invalid pin {} ignored", pin);
+        return;
+    }
+
+    Event event{ clock, static_cast<uint8_t>(pin), value };
+    // Upper bound keeps events at the same clock in insertion order
+    auto it = std::upper_bound(events_.begin() + next_, events_.end(), event,
+        [](const Event& a, const Event& b) { return a.clock < b.clock; });
+    events_.insert(it, event);
+}
+
+void PioStimulus::clear()
+{
+    events_.clear();
+    next_ = 0;
+}
+
+void PioStimulus::loadCsv(const std::string& filepath)
+{
+    std::ifstream file(filepath);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open file: " + filepath);
+
+    std::string line;
+    int line_number = 0;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        line = PioText::trim(line);
+        if (line.empty() || line[0] == '#' || line[0] == ';')
+            continue;
+
+        std::stringstream ss(line);
+        std::string clock_field, pin_field, value_field;
+        if (!std::getline(ss, clock_field, ',') || !std::getline(ss, pin_field, ',') || !std::getline(ss, value_field, ','))
+        {
+            LOG_WARNING_FMT("Malformed stimulus line {} in {}, skipping", line_number, filepath);
+            continue;
+        }
+
+        try
+        {
+            add(std::stoi(PioText::trim(clock_field)), std::stoi(PioText::trim(pin_field)), parseLevel(PioText::trim(value_field)));
+        }
+        catch (const std::exception&)
+        {
+            // header line ("clock,pin,value") or garbage
+            if (line_number != 1)
+                LOG_WARNING_FMT("Malformed stimulus line {} in {}, skipping", line_number, filepath);
+        }
+    }
+}
+
+void PioStimulus::loadVcd(const std::string& filepath, double sm_clock_hz)
+{
+    std::ifstream file(filepath);
+    if (!file.is_open())
+        throw std::runtime_error("Cannot open file: " + filepath);
+
+    double timescale = 1e-9; // unspecified: 1ns
+    std::map<std::string, int> pin_of_id;
+    std::string token;
+    bool in_definitions = true;
+    long long time = 0;
+
+    try
+    {
+        while (file >> token)
+        {
+            if (isTextSection(token))
+            {
+                while (file >> token && token != "$end") {}
+                continue;
+            }
+
+            if (in_definitions)
+            {
+                if (token == "$timescale")
+                {
+                    std::string text;
+                    while (file >> token && token != "$end")
+                        text += token;
+                    timescale = parseTimescale(text);
+                }
+                else if (token == "$var")
+                {
+                    // $var wire 1 <id> <name> [range] $end
+                    std::string type, width, id, name;
+                    file >> type >> width >> id >> name;
+                    while (file >> token && token != "$end") {}
+
+                    int pin = PioText::pinFromName(name);
+                    if (width == "1" && pin >= 0)
+                        pin_of_id[id] = pin;
+                    else
+                        LOG_INFO_FMT("VCD signal '{}' isn't a single GPIO, ignored", name);
+                }
+                else if (token == "$enddefinitions")
+                {
+                    while (file >> token && token != "$end") {}
+                    in_definitions = false;
+                }
+                continue;
+            }
+
+            if (token[0] == '#')
+            {
+                time = std::stoll(token.substr(1));
+            }
+            else if (token[0] == '0' || token[0] == '1' || token[0] == 'x' || token[0] == 'X' || token[0] == 'z' || token[0] == 'Z')
+            {
+                auto it = pin_of_id.find(token.substr(1));
+                if (it == pin_of_id.end())
+                    continue;
+                double clock = std::round(static_cast<double>(time) * timescale * sm_clock_hz);
+                if (clock < 0 || clock > PioStateMachine::kMaxClock)
+                {
+                    // Nothing runs that far (see PioStateMachine::kMaxClock), later changes can't apply either
+                    LOG_WARNING_FMT("VCD {} goes past the last sm clock at #{}, the rest is ignored", filepath, time);
+                    break;
+                }
+                add(static_cast<int>(clock), it->second, parseLevel(token.substr(0, 1)));
+            }
+            else if (token[0] == '$')
+            {
+                // $dumpvars / $end etc. wrap value changes we already handle
+                continue;
+            }
+            else if (token[0] == 'b' || token[0] == 'r')
+            {
+                file >> token; // vector/real value, skip its id
+            }
+        }
+    }
+    catch (const std::logic_error&)
+    {
+        // std::stoll / std::stod on a damaged timestamp or timescale
+        throw std::runtime_error("Malformed VCD in " + filepath + " near '" + token + "'");
+    }
+}
+
+int PioStimulus::nextEventClock() const
+{
+    return next_ < events_.size() ? events_[next_].clock : -1;
+}
+
+void PioStimulus::apply(PioStateMachine& pio)
+{
+    while (next_ < events_.size() && events_[next_].clock <= pio.clock)
+    {
+        const Event& event = events_[next_];
+        pio.gpio.external_data[event.pin] = event.value;
+        next_++;
+    }
+}
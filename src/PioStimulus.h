@@ -0,0 +1,35 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "PioStateMachine.h"
+
+// Time-sorted list of GPIO input transitions, applied to gpio.external_data at their exact clock.
+//
+// CSV: one "clock,pin,value" per line, value is 0, 1 or z/x/-1 to release the pin.
+// VCD: scalar wires named gpioN/pinN (or just N), times converted to sm clocks with sm_clock_hz.
+class PioStimulus : public PioInputSource
+{
+public:
+    struct Event
+    {
+        int clock;
+        uint8_t pin;
+        int8_t value; // -1 releases the pin (not driven externally)
+    };
+
+    void add(int clock, int pin, int8_t value); // events at the same clock keep their order
+    void loadCsv(const std::string& filepath);
+    void loadVcd(const std::string& filepath, double sm_clock_hz);
+    void rewind() { next_ = 0; }
+    void clear();
+
+    int nextEventClock() const override;
+    void apply(PioStateMachine& pio) override;
+
+    const std::vector<Event>& events() const { return events_; }
+
+private:
+    std::vector<Event> events_;
+    size_t next_ = 0;
+};
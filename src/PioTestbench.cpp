@@ -0,0 +1,213 @@
+#include "PioTestbench.h"
+#include <algorithm>
+#include <bit>
+
+/* ----- PioTask ----- */
+
+PioTask& PioTask::operator=(PioTask&& other) noexcept
+{
+    if (this != &other)
+    {
+        if (handle_)
+            handle_.destroy();
+        handle_ = std::exchange(other.handle_, {});
+    }
+    return *this;
+}
+
+PioTask::~PioTask()
+{
+    if (handle_)
+        handle_.destroy();
+}
+
+/* ----- PioTestbench ----- */
+
+PioTestbench::~PioTestbench()
+{
+    // Scripts still waiting are dropped with their frames
+    for (auto handle : tasks_)
+        handle.destroy();
+}
+
+void PioTestbench::spawn(PioTask task)
+{
+    auto handle = std::exchange(task.handle_, {});
+    if (!handle)
+        return;
+    tasks_.push_back(handle);
+    resume(handle);
+    rethrow();
+}
+
+bool PioTestbench::push(uint32_t word)
+{
+    if (pio.fifo.tx_fifo_count >= 4)
+        return false;
+    pio.fifo.tx_fifo[pio.fifo.tx_fifo_count++] = word;
+    return true;
+}
+
+bool PioTestbench::pop(uint32_t& word)
+{
+    if (pio.fifo.rx_fifo_count == 0)
+        return false;
+    word = pio.fifo.rx_fifo[0];
+    for (int i = 0; i < pio.fifo.rx_fifo_count - 1; i++)
+        pio.fifo.rx_fifo[i] = pio.fifo.rx_fifo[i + 1];
+    pio.fifo.rx_fifo[--pio.fifo.rx_fifo_count] = 0;
+    return true;
+}
+
+int PioTestbench::run(int max_cycles)
+{
+    const int start_clock = pio.clock;
+    const int end_clock = pio.clock + max_cycles;
+
+    resumeDue(); // anything that came true since the last run (the host may have ticked)
+    rethrow();
+    while (!tasks_.empty() && pio.clock < end_clock)
+    {
+        if (!stepping())
+        {
+            // Only timed waits: let run() collapse everything up to the earliest one
+            int target = timed_.empty() ? end_clock : std::min(end_clock, timed_.top().arg);
+            int cycles = target - pio.clock;
+            if (cycles > 0 && pio.run(cycles) < cycles)
+                break; // breakpoint
+        }
+        else if (!pio.step())
+        {
+            break;
+        }
+        resumeDue();
+        rethrow();
+    }
+    return pio.clock - start_clock;
+}
+
+bool PioTestbench::ready(WaitKind kind, int arg) const
+{
+    switch (kind)
+    {
+    case WaitKind::Cycles:     return arg <= pio.clock;
+    case WaitKind::TxEmpty:    return pio.fifo.tx_fifo_count == 0;
+    case WaitKind::RxNotEmpty: return pio.fifo.rx_fifo_count > 0;
+    case WaitKind::Irq:        return pio.irq_flags[arg];
+    default:                   return false; // edges and pc need a tick first
+    }
+}
+
+void PioTestbench::suspend(std::coroutine_handle<> handle, WaitKind kind, int arg)
+{
+    Waiter waiter{ handle, kind, arg, next_order_++ };
+    const uint32_t bit = 1u << (arg & 31);
+    switch (kind)
+    {
+    case WaitKind::Cycles:
+        timed_.push(waiter);
+        break;
+    case WaitKind::Rise:
+    case WaitKind::Fall:
+        // Edges count from the level now, the same for every waiter on the pin
+        if (!(edge_pins_ & bit))
+            edge_levels_ = pio.gpio.raw_data[arg] == 1 ? edge_levels_ | bit : edge_levels_ & ~bit;
+        edge_pins_ |= bit;
+        edge_waiters_[arg].push_back(waiter);
+        break;
+    case WaitKind::Pc:
+        pc_addresses_ |= bit;
+        pc_waiters_[arg].push_back(waiter);
+        break;
+    default:
+        polled_.push_back(waiter);
+        break;
+    }
+}
+
+void PioTestbench::resume(std::coroutine_handle<> handle)
+{
+    handle.resume();
+    if (!handle.done())
+        return;
+
+    auto it = std::find_if(tasks_.begin(), tasks_.end(), [&](auto task) { return task.address() == handle.address(); });
+    if (it == tasks_.end())
+        return;
+    if (it->promise().exception && !exception_)
+        exception_ = it->promise().exception;
+    it->destroy();
+    tasks_.erase(it);
+}
+
+void PioTestbench::resumeDue()
+{
+    due_.clear();
+    while (!timed_.empty() && timed_.top().arg <= pio.clock)
+    {
+        due_.push_back(timed_.top());
+        timed_.pop();
+    }
+
+    // Edge waiters: only the pins that changed since the last look
+    if (edge_pins_)
+    {
+        uint32_t levels = 0;
+        for (uint32_t mask = edge_pins_; mask; mask &= mask - 1)
+        {
+            int pin = std::countr_zero(mask);
+            if (pio.gpio.raw_data[pin] == 1)
+                levels |= 1u << pin;
+        }
+        for (uint32_t changed = (levels ^ edge_levels_) & edge_pins_; changed; changed &= changed - 1)
+        {
+            int pin = std::countr_zero(changed);
+            WaitKind edge = (levels >> pin) & 1 ? WaitKind::Rise : WaitKind::Fall;
+            std::vector<Waiter>& waiters = edge_waiters_[pin];
+            size_t kept = 0;
+            for (const Waiter& waiter : waiters)
+            {
+                if (waiter.kind == edge)
+                    due_.push_back(waiter);
+                else
+                    waiters[kept++] = waiter;
+            }
+            waiters.resize(kept);
+            if (waiters.empty())
+                edge_pins_ &= ~(1u << pin);
+        }
+        edge_levels_ = levels;
+    }
+
+    // Pc waiters: only the ones on the current pc
+    uint32_t pc = pio.regs.pc & 31;
+    if ((pc_addresses_ >> pc) & 1)
+    {
+        due_.insert(due_.end(), pc_waiters_[pc].begin(), pc_waiters_[pc].end());
+        pc_waiters_[pc].clear();
+        pc_addresses_ &= ~(1u << pc);
+    }
+
+    size_t kept = 0;
+    for (const Waiter& waiter : polled_)
+    {
+        if (ready(waiter.kind, waiter.arg))
+            due_.push_back(waiter);
+        else
+            polled_[kept++] = waiter;
+    }
+    polled_.resize(kept);
+
+    if (due_.empty())
+        return;
+    std::sort(due_.begin(), due_.end(), [](const Waiter& a, const Waiter& b) { return a.order < b.order; });
+    // Resumed scripts only add waiters (to timed_ / polled_), due_ stays as it is
+    for (const Waiter& waiter : due_)
+        resume(waiter.handle);
+}
+
+void PioTestbench::rethrow()
+{
+    if (exception_)
+        std::rethrow_exception(std::exchange(exception_, nullptr));
+}
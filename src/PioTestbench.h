@@ -0,0 +1,150 @@
+#pragma once
+#include <array>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "PioStateMachine.h"
+
+// Coroutine testbench: stimulus scripts are plain C++20 coroutines that co_await events on the
+// state machine instead of hand-written state machines around tick().
+//
+//   PioTask blink(PioTestbench& tb)
+//   {
+//       for (;;)
+//       {
+//           co_await tb.rise(3);
+//           tb.drive(4, 1);
+//           co_await tb.cycles(10);
+//           tb.drive(4, 0);
+//       }
+//   }
+//   tb.spawn(blink(tb));
+//   tb.run(10000);
+//
+// Scripts run on the caller's thread, between two ticks (where a host would poke the machine).
+// While every script waits on cycles() the machine runs through run()'s fast paths up to the
+// earliest wake-up. Any other pending wait drops the scheduler to one pio.step() per clock until
+// it fires. Each of those clocks looks at the pins edge waits are on and only at the waiters of
+// the pins that changed, and at the pc waiters of the current pc; tx_empty(), rx_not_empty() and
+// irq() waiters are checked one by one. Thousands of scripts on cycles() cost a heap operation
+// per wake-up; thousands on the other waits are only cheap while few of them fire.
+class PioTestbench;
+
+class PioTask
+{
+public:
+    struct promise_type
+    {
+        PioTask get_return_object() { return PioTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; } // started by PioTestbench::spawn()
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        std::exception_ptr exception;
+    };
+
+    PioTask() = default;
+    PioTask(PioTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    PioTask& operator=(PioTask&& other) noexcept;
+    PioTask(const PioTask&) = delete;
+    PioTask& operator=(const PioTask&) = delete;
+    ~PioTask();
+
+    bool done() const { return !handle_ || handle_.done(); }
+
+private:
+    friend class PioTestbench;
+    explicit PioTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+class PioTestbench
+{
+public:
+    enum class WaitKind : uint8_t
+    {
+        Cycles,     // until a clock
+        Rise,       // the next 0 -> 1 of a pin
+        Fall,       // the next 1 -> 0 of a pin
+        TxEmpty,    // TX FIFO empty (at once if it already is)
+        RxNotEmpty, // something to pop from the RX FIFO (at once if there is)
+        Irq,        // IRQ flag set (at once if it already is)
+        Pc,         // the next tick after which pc is the address
+    };
+
+    // What co_await suspends on, made by the functions below
+    struct Wait
+    {
+        PioTestbench* testbench;
+        WaitKind kind;
+        int arg;
+
+        bool await_ready() const { return testbench->ready(kind, arg); }
+        void await_suspend(std::coroutine_handle<> handle) { testbench->suspend(handle, kind, arg); }
+        void await_resume() const {}
+    };
+
+    explicit PioTestbench(PioStateMachine& pio) : pio(pio) {}
+    ~PioTestbench();
+    PioTestbench(const PioTestbench&) = delete;
+    PioTestbench& operator=(const PioTestbench&) = delete;
+
+    PioStateMachine& pio;
+
+    void spawn(PioTask task); // runs up to its first co_await right away
+    // Forward up to max_cycles clocks, returns early when every script has finished or a breakpoint
+    // stopped the machine. A script's exception is rethrown here. Returns clocks advanced.
+    int run(int max_cycles);
+    size_t active() const { return tasks_.size(); }
+    bool idle() const { return tasks_.empty(); }
+
+    Wait cycles(int n) { return { this, WaitKind::Cycles, pio.clock + (n > 0 ? n : 0) }; }
+    Wait until(int clock) { return { this, WaitKind::Cycles, clock }; }
+    Wait rise(int pin) { return { this, WaitKind::Rise, pin & 31 }; }
+    Wait fall(int pin) { return { this, WaitKind::Fall, pin & 31 }; }
+    Wait tx_empty() { return { this, WaitKind::TxEmpty, 0 }; }
+    Wait rx_not_empty() { return { this, WaitKind::RxNotEmpty, 0 }; }
+    Wait irq(int n) { return { this, WaitKind::Irq, n & 7 }; }
+    Wait pc(uint32_t address) { return { this, WaitKind::Pc, static_cast<int>(address & 31) }; }
+
+    // Host side of the machine, for use inside scripts
+    void drive(int pin, int8_t value) { pio.gpio.external_data[pin & 31] = value; } // -1 releases
+    bool push(uint32_t word);   // into the TX FIFO, false when it is full
+    bool pop(uint32_t& word);   // from the RX FIFO, false when it is empty
+
+private:
+    struct Waiter
+    {
+        std::coroutine_handle<> handle;
+        WaitKind kind;
+        int arg;
+        uint64_t order;  // suspension order, scripts woken together resume in it
+    };
+    struct LaterFirst
+    {
+        bool operator()(const Waiter& a, const Waiter& b) const { return a.arg != b.arg ? a.arg > b.arg : a.order > b.order; }
+    };
+
+    bool ready(WaitKind kind, int arg) const;
+    void suspend(std::coroutine_handle<> handle, WaitKind kind, int arg);
+    void resume(std::coroutine_handle<> handle);
+    void resumeDue(); // after a tick
+    void rethrow();
+    bool stepping() const { return edge_pins_ != 0 || pc_addresses_ != 0 || !polled_.empty(); } // a wait needs every tick
+
+    std::vector<std::coroutine_handle<PioTask::promise_type>> tasks_; // owned, not finished
+    std::priority_queue<Waiter, std::vector<Waiter>, LaterFirst> timed_; // Cycles, by clock
+    std::array<std::vector<Waiter>, 32> edge_waiters_; // Rise / Fall, by pin
+    uint32_t edge_pins_ = 0;   // pins with edge waiters
+    uint32_t edge_levels_ = 0; // their levels when last looked at
+    std::array<std::vector<Waiter>, 32> pc_waiters_; // Pc, by address
+    uint32_t pc_addresses_ = 0;
+    std::vector<Waiter> polled_; // TxEmpty, RxNotEmpty, Irq: checked after every tick
+    std::vector<Waiter> due_;    // scratch for resumeDue()
+    uint64_t next_order_ = 0;
+    std::exception_ptr exception_;
+};
@@ -0,0 +1,91 @@
+#include "PioText.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <stdexcept>
+#include <fmt/format.h>
+
+namespace PioText {
+
+    std::string trim(const std::string& str)
+    {
+        size_t first = str.find_first_not_of(" \t\r");
+        if (first == std::string::npos)
+            return "";
+        size_t last = str.find_last_not_of(" \t\r");
+        return str.substr(first, last - first + 1);
+    }
+
+    std::string lower(std::string str)
+    {
+        std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return str;
+    }
+
+    int pinFromName(const std::string& name)
+    {
+        size_t digits = name.find_last_not_of("0123456789");
+        std::string number = (digits == std::string::npos) ? name : name.substr(digits + 1);
+        if (number.empty() || number.size() > 2)
+            return -1;
+        int pin = std::stoi(number);
+        return pin < 32 ? pin : -1;
+    }
+
+    int64_t parseNumber(std::string_view text)
+    {
+        bool negative = !text.empty() && text.front() == '-';
+        if (negative)
+            text.remove_prefix(1);
+        int base = 10;
+        if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+            base = 16;
+        else if (text.size() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+            base = 2;
+        if (base != 10)
+            text.remove_prefix(2);
+
+        uint64_t value = 0;
+        auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+        if (text.empty() || error != std::errc() || end != text.data() + text.size())
+            throw std::invalid_argument(fmt::format("not a number: {}{}", negative ? "-" : "", text));
+        return negative ? -static_cast<int64_t>(value) : static_cast<int64_t>(value);
+    }
+
+    int parsePin(std::string_view text)
+    {
+        if (text.starts_with("gpio"))
+            text.remove_prefix(4);
+        int64_t pin = parseNumber(text);
+        if (pin < 0 || pin > 31)
+            throw std::invalid_argument(fmt::format("no such pin: {}", text));
+        return static_cast<int>(pin);
+    }
+
+    std::vector<int> parsePins(std::string_view text)
+    {
+        std::vector<int> pins;
+        size_t pos = 0;
+        while (pos <= text.size())
+        {
+            size_t end = std::min(text.find(',', pos), text.size());
+            std::string_view item = text.substr(pos, end - pos);
+            size_t dash = item.find('-', 1);
+            int first = parsePin(item.substr(0, dash));
+            int last = dash == std::string_view::npos ? first : parsePin(item.substr(dash + 1));
+            if (last < first)
+                throw std::invalid_argument(fmt::format("pin range runs backwards: {}", item));
+            for (int pin = first; pin <= last; pin++)
+                pins.push_back(pin);
+            pos = end + 1;
+        }
+        return pins;
+    }
+
+    std::string extensionOf(const std::string& filepath)
+    {
+        return lower(std::filesystem::path(filepath).extension().string());
+    }
+
+} // namespace PioText
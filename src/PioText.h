@@ -0,0 +1,26 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Small text helpers shared by the file readers (stimulus, sigrok) and the two front ends
+// (pio_emu_cli, pio_emu_dbg), so they all accept the same names, numbers and pin lists
+namespace PioText {
+
+    std::string trim(const std::string& str); // spaces, tabs and '\r' off both ends
+    std::string lower(std::string str);
+    // "gpio12", "pin12", "D3", "12" -> the pin, -1 when the name doesn't end in one or two digits
+    // below 32 ("data_20240101" ends in a date, not a pin)
+    int pinFromName(const std::string& name);
+
+    // Decimal, 0x hex or 0b binary, an optional '-' (a leading 0 is still decimal); throws
+    // std::invalid_argument
+    int64_t parseNumber(std::string_view text);
+    int parsePin(std::string_view text); // "gpio5" or "5"; throws std::invalid_argument
+    // "0-3,gpio22" -> 0 1 2 3 22; throws std::invalid_argument for a pin outside 0..31, an empty
+    // item or a range that runs backwards
+    std::vector<int> parsePins(std::string_view text);
+    std::string extensionOf(const std::string& filepath); // ".pio", lower case, "" without one
+
+} // namespace PioText
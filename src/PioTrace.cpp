@@ -0,0 +1,245 @@
+#include "PioTrace.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include "PioBitOps.h"
+#include "PioStateMachine.h"
+
+namespace PioTrace {
+
+    Record capture(const PioStateMachine& pio)
+    {
+        Record record{};
+        record.pins = PioBitOps::gatherPins(pio.gpio.raw_data);
+        record.x = pio.regs.x;
+        record.y = pio.regs.y;
+        record.pc = static_cast<uint8_t>(pio.regs.pc & 31);
+        record.fifo = static_cast<uint8_t>(std::min<int>(pio.fifo.tx_fifo_count, 15) << 4 | std::min<int>(pio.fifo.rx_fifo_count, 15));
+        for (int i = 0; i < 8; i++)
+            record.irqs |= static_cast<uint8_t>((pio.irq_flags[i] ? 1 : 0) << i);
+        record.flags = static_cast<uint8_t>((pio.delay_delay ? kStalled : 0) | (pio.regs.delay > 0 ? kDelay : 0));
+        return record;
+    }
+
+    /* ----- Writer ----- */
+
+    Writer::Writer(const std::string& filepath, uint32_t chunk_records)
+        : path_(filepath)
+    {
+        std::memcpy(header_.magic, kMagic, sizeof(kMagic));
+        header_.version = kVersion;
+        header_.record_size = sizeof(Record);
+        header_.chunk_records = chunk_records > 0 ? chunk_records : 1;
+        chunk_.reserve(header_.chunk_records);
+
+        file_ = std::fopen(filepath.c_str(), "wb");
+        if (file_ == nullptr)
+            throw std::runtime_error("Cannot open file: " + filepath);
+        if (std::fwrite(&header_, sizeof(header_), 1, file_) != 1)
+            throw std::runtime_error("Cannot write file: " + filepath);
+    }
+
+    Writer::~Writer()
+    {
+        try
+        {
+            close();
+        }
+        catch (const std::exception&)
+        {
+            // Left without an index, the reader refuses it
+        }
+    }
+
+    void Writer::record(const PioStateMachine& pio)
+    {
+        append(pio.clock, capture(pio));
+    }
+
+    void Writer::append(int64_t clock, const Record& record)
+    {
+        if (file_ == nullptr)
+            return;
+        if (last_clock_ >= 0 && clock <= last_clock_)
+        {
+            skipped_++;
+            return;
+        }
+
+        bool follows = last_clock_ >= 0 && clock == last_clock_ + 1;
+        if (!chunk_.empty() && (!follows || chunk_.size() == header_.chunk_records))
+            flushChunk();
+        if (chunk_.empty())
+        {
+            info_ = ChunkInfo{};
+            info_.first_clock = clock;
+        }
+
+        if (follows)
+            info_.pins_touched |= record.pins ^ last_pins_;
+        info_.pins_high |= record.pins;
+        info_.pins_low |= ~record.pins;
+        info_.pcs |= 1u << (record.pc & 31);
+        info_.irqs |= record.irqs;
+        info_.flags |= record.flags;
+        chunk_.push_back(record);
+
+        last_clock_ = clock;
+        last_pins_ = record.pins;
+        header_.record_count++;
+    }
+
+    void Writer::flushChunk()
+    {
+        info_.offset = offset_;
+        info_.count = static_cast<uint32_t>(chunk_.size());
+        if (std::fwrite(chunk_.data(), sizeof(Record), chunk_.size(), file_) != chunk_.size())
+            throw std::runtime_error("Cannot write file: " + path_);
+        offset_ += chunk_.size() * sizeof(Record);
+        index_.push_back(info_);
+        chunk_.clear();
+    }
+
+    void Writer::close()
+    {
+        if (file_ == nullptr)
+            return;
+        std::FILE* file = file_;
+        file_ = nullptr;
+
+        bool ok = true;
+        if (!chunk_.empty())
+        {
+            info_.offset = offset_;
+            info_.count = static_cast<uint32_t>(chunk_.size());
+            ok = std::fwrite(chunk_.data(), sizeof(Record), chunk_.size(), file) == chunk_.size();
+            offset_ += chunk_.size() * sizeof(Record);
+            index_.push_back(info_);
+            chunk_.clear();
+        }
+
+        header_.chunk_count = index_.size();
+        header_.index_offset = offset_;
+        ok = ok && (index_.empty() || std::fwrite(index_.data(), sizeof(ChunkInfo), index_.size(), file) == index_.size());
+        ok = ok && std::fseek(file, 0, SEEK_SET) == 0 && std::fwrite(&header_, sizeof(header_), 1, file) == 1;
+        ok = std::fclose(file) == 0 && ok;
+        if (!ok)
+            throw std::runtime_error("Cannot write file: " + path_);
+    }
+
+    /* ----- Reader ----- */
+
+    Reader::Reader(const std::string& filepath)
+        : file_(filepath)
+    {
+        const uint8_t* data = file_.data();
+        size_t size = file_.size();
+        if (data == nullptr || size < sizeof(Header))
+            throw std::runtime_error("Not a pio_emu trace: " + filepath);
+        header_ = reinterpret_cast<const Header*>(data);
+        if (std::memcmp(header_->magic, kMagic, sizeof(kMagic)) != 0 || header_->version != kVersion || header_->record_size != sizeof(Record))
+            throw std::runtime_error("Not a pio_emu trace (or another version): " + filepath);
+        if (header_->index_offset == 0)
+            throw std::runtime_error("Trace was not closed: " + filepath);
+        if (header_->index_offset > size || header_->chunk_count > (size - header_->index_offset) / sizeof(ChunkInfo))
+            throw std::runtime_error("Truncated trace: " + filepath);
+        index_ = reinterpret_cast<const ChunkInfo*>(data + header_->index_offset);
+        for (const ChunkInfo& chunk : chunks())
+        {
+            if (chunk.offset < sizeof(Header) || chunk.offset > header_->index_offset
+                || chunk.count > (header_->index_offset - chunk.offset) / sizeof(Record))
+                throw std::runtime_error("Corrupt trace index: " + filepath);
+        }
+    }
+
+    std::span<const Record> Reader::records(size_t chunk) const
+    {
+        const ChunkInfo& info = index_[chunk];
+        return { reinterpret_cast<const Record*>(file_.data() + info.offset), info.count };
+    }
+
+    int64_t Reader::firstClock() const
+    {
+        return header_->chunk_count ? index_[0].first_clock : -1;
+    }
+
+    int64_t Reader::endClock() const
+    {
+        if (header_->chunk_count == 0)
+            return -1;
+        const ChunkInfo& last = index_[header_->chunk_count - 1];
+        return last.first_clock + last.count;
+    }
+
+    const Record* Reader::at(int64_t clock) const
+    {
+        auto all = chunks();
+        auto it = std::upper_bound(all.begin(), all.end(), clock, [](int64_t c, const ChunkInfo& chunk) { return c < chunk.first_clock; });
+        if (it == all.begin())
+            return nullptr;
+        --it;
+        if (clock >= it->first_clock + it->count)
+            return nullptr;
+        return reinterpret_cast<const Record*>(file_.data() + it->offset) + (clock - it->first_clock);
+    }
+
+    const Record* Reader::previous(size_t chunk) const
+    {
+        if (chunk == 0)
+            return nullptr;
+        const ChunkInfo& before = index_[chunk - 1];
+        if (before.first_clock + before.count != index_[chunk].first_clock)
+            return nullptr;
+        return reinterpret_cast<const Record*>(file_.data() + before.offset) + (before.count - 1);
+    }
+
+    bool Reader::chunkMayMatch(const ChunkInfo& chunk, const Query& query) const
+    {
+        uint32_t edges = query.rise | query.fall;
+        uint32_t high = query.high | query.rise;
+        uint32_t low = query.low | query.fall;
+        if (query.pc >= 0 && !((chunk.pcs >> (query.pc & 31)) & 1))
+            return false;
+        if ((chunk.pins_touched & edges) != edges || (chunk.pins_high & high) != high || (chunk.pins_low & low) != low)
+            return false;
+        if (query.irq >= 0 && !((chunk.irqs >> (query.irq & 7)) & 1))
+            return false;
+        return true;
+    }
+
+    std::vector<int64_t> Reader::find(const Query& query, size_t limit) const
+    {
+        std::vector<int64_t> found;
+        auto all = chunks();
+        for (size_t c = 0; c < all.size() && found.size() < limit; c++)
+        {
+            const ChunkInfo& chunk = all[c];
+            int64_t begin = std::max(query.from, chunk.first_clock);
+            int64_t end = std::min(query.to, chunk.first_clock + chunk.count);
+            if (begin >= end || !chunkMayMatch(chunk, query))
+                continue;
+
+            std::span<const Record> records = this->records(c);
+            const Record* before = begin > chunk.first_clock ? &records[begin - chunk.first_clock - 1] : previous(c);
+            for (int64_t clock = begin; clock < end && found.size() < limit; clock++)
+            {
+                const Record& record = records[clock - chunk.first_clock];
+                uint32_t rose = before ? record.pins & ~before->pins : 0;
+                uint32_t fell = before ? ~record.pins & before->pins : 0;
+                before = &record;
+
+                if (query.pc >= 0 && record.pc != query.pc)
+                    continue;
+                if ((rose & query.rise) != query.rise || (fell & query.fall) != query.fall)
+                    continue;
+                if ((record.pins & query.high) != query.high || (~record.pins & query.low) != query.low)
+                    continue;
+                if (query.irq >= 0 && !((record.irqs >> (query.irq & 7)) & 1))
+                    continue;
+                found.push_back(clock);
+            }
+        }
+        return found;
+    }
+
+} // namespace PioTrace
@@ -0,0 +1,151 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+#include "PioMappedFile.h"
+
+class PioStateMachine;
+
+// Cycle trace files: one fixed-size record per traced cycle, in chunks of up to chunk_records
+// consecutive clocks, with a chunk index at the end. Each index entry summarises its chunk (pins
+// that moved, levels seen, PCs visited, IRQs raised), so seeking to a clock is a binary search over
+// the index and a query only opens the chunks that can match. The reader maps the file, pages
+// come in as they are touched.
+//
+// File (host byte order, little endian in practice):
+//   header      64 bytes, see Header; index_offset stays 0 until the writer is closed
+//   records     chunk after chunk, Record[count] each
+//   index       ChunkInfo[chunk_count]
+namespace PioTrace {
+
+    inline constexpr char kMagic[8] = { 'P', 'I', 'O', 'T', 'R', 'C', '0', '1' };
+    inline constexpr uint32_t kVersion = 1;
+
+    enum RecordFlags : uint8_t
+    {
+        kStalled = 1 << 0, // waiting (wait, full/empty FIFO, irq wait)
+        kDelay = 1 << 1,   // counting down a delay
+    };
+
+    // The machine at the end of a cycle
+    struct Record
+    {
+        uint32_t pins; // gpio.raw_data, pin N is bit N
+        uint32_t x;
+        uint32_t y;
+        uint8_t pc;    // next instruction
+        uint8_t fifo;  // TX level << 4 | RX level
+        uint8_t irqs;  // IRQ flag N is bit N
+        uint8_t flags; // RecordFlags
+    };
+    static_assert(sizeof(Record) == 16);
+
+    struct ChunkInfo
+    {
+        uint64_t offset;       // file offset of the chunk's first record
+        int64_t first_clock;
+        uint32_t count;        // records, consecutive clocks
+        uint32_t pins_touched; // pins that changed in the chunk (against the cycle before it, when traced)
+        uint32_t pins_high;    // pins that were high in some record
+        uint32_t pins_low;     // pins that were low in some record
+        uint32_t pcs;          // bit N: pc N seen
+        uint8_t irqs;          // IRQ flags seen set
+        uint8_t flags;         // RecordFlags seen
+        uint8_t reserved[2];
+    };
+    static_assert(sizeof(ChunkInfo) == 40);
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t record_size;
+        uint32_t chunk_records; // capacity of a chunk
+        uint32_t reserved0;
+        uint64_t chunk_count;
+        uint64_t record_count;
+        uint64_t index_offset;  // 0: not closed
+        uint8_t reserved[16];
+    };
+    static_assert(sizeof(Header) == 64);
+
+    // Cycles that match every condition given (the defaults match anything)
+    struct Query
+    {
+        int64_t from = 0;                                  // clocks [from, to)
+        int64_t to = std::numeric_limits<int64_t>::max();
+        int pc = -1;
+        uint32_t rise = 0;  // pins that rose in this cycle
+        uint32_t fall = 0;  // pins that fell in this cycle
+        uint32_t high = 0;  // pins high at the end of the cycle
+        uint32_t low = 0;   // pins low at the end of the cycle
+        int irq = -1;       // IRQ flag set
+    };
+
+    Record capture(const PioStateMachine& pio);
+
+    // Attach with pio.tracer = &writer. Records the cycles tick() runs (run() goes through tick()
+    // while a tracer is attached). A clock that doesn't follow the last one starts a new chunk,
+    // one that goes backwards (a restored snapshot) is skipped and counted.
+    class Writer
+    {
+    public:
+        explicit Writer(const std::string& filepath, uint32_t chunk_records = 65536); // throws std::runtime_error
+        ~Writer();
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        void record(const PioStateMachine& pio); // the cycle pio.clock, called by tick() before the clock moves on
+        void append(int64_t clock, const Record& record);
+        void close();                            // writes the index, throws std::runtime_error
+
+        uint64_t records() const { return header_.record_count; }
+        uint64_t skipped() const { return skipped_; }
+
+    private:
+        void flushChunk();
+
+        std::FILE* file_ = nullptr;
+        std::string path_;
+        Header header_{};
+        uint64_t offset_ = sizeof(Header); // where the next chunk goes
+        std::vector<ChunkInfo> index_;
+        std::vector<Record> chunk_;
+        ChunkInfo info_{};
+        int64_t last_clock_ = -1;
+        uint32_t last_pins_ = 0;
+        uint64_t skipped_ = 0;
+    };
+
+    class Reader
+    {
+    public:
+        explicit Reader(const std::string& filepath); // maps the file, throws std::runtime_error
+        Reader(const Reader&) = delete;
+        Reader& operator=(const Reader&) = delete;
+
+        uint64_t recordCount() const { return header_->record_count; }
+        uint32_t chunkRecords() const { return header_->chunk_records; }
+        std::span<const ChunkInfo> chunks() const { return { index_, static_cast<size_t>(header_->chunk_count) }; }
+        std::span<const Record> records(size_t chunk) const;
+        int64_t firstClock() const; // -1 for an empty trace
+        int64_t endClock() const;   // one past the last traced clock
+
+        const Record* at(int64_t clock) const; // nullptr when that clock wasn't traced
+        // Clocks of the matching cycles in order, at most 'limit'
+        std::vector<int64_t> find(const Query& query, size_t limit = std::numeric_limits<size_t>::max()) const;
+        bool chunkMayMatch(const ChunkInfo& chunk, const Query& query) const;
+
+    private:
+        const Record* previous(size_t chunk) const; // the record of the clock before the chunk, if traced
+
+        PioMappedFile file_;
+        const Header* header_ = nullptr;
+        const ChunkInfo* index_ = nullptr;
+    };
+
+} // namespace PioTrace
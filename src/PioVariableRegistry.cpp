@@ -1,8 +1,32 @@
 #include "PioStateMachine.h"
+#include "PioExpression.h"
+#include <type_traits>
+
+namespace {
+    template <typename T>
+    PioVarRef makeVarRef(const PioStateMachine* pio, const T& member)
+    {
+        PioVarRef ref;
+        ref.offset = static_cast<uint32_t>(reinterpret_cast<const char*>(&member) - reinterpret_cast<const char*>(pio));
+        if constexpr (std::is_same_v<T, bool>)
+            ref.type = PioVarRef::Type::Bool;
+        else if constexpr (std::is_same_v<T, int8_t>)
+            ref.type = PioVarRef::Type::I8;
+        else if constexpr (sizeof(T) == 1)
+            ref.type = PioVarRef::Type::U8;
+        else if constexpr (std::is_signed_v<T>)
+            ref.type = PioVarRef::Type::I32;
+        else
+            ref.type = PioVarRef::Type::U32;
+        static_assert(sizeof(T) == 1 || sizeof(T) == 4, "PioVarRef only reads 8 and 32 bit fields");
+        return ref;
+    }
+}
 
 #define REGISTER_VAR(name, member) \
     var_getters[name] = [this]() { return static_cast<uint32_t>(member); }; \
-    var_setters[name] = [this](uint32_t val) { member = static_cast<decltype(member)>(val); }
+    var_setters[name] = [this](uint32_t val) { member = static_cast<decltype(member)>(val); }; \
+    var_refs[name] = makeVarRef(this, member)
 
 void PioStateMachine::setup_var_access()
 {
@@ -35,6 +59,7 @@ void PioStateMachine::setup_var_access()
         var_setters[pin_name] = [this, i](uint32_t val) {
             fifo.tx_fifo[i] = val;
             };
+        var_refs[pin_name] = makeVarRef(this, fifo.tx_fifo[i]);
 
         // rx fifo
         pin_name = "rx_fifo" + std::to_string(i);
@@ -44,6 +69,7 @@ void PioStateMachine::setup_var_access()
         var_setters[pin_name] = [this, i](uint32_t val) {
             fifo.rx_fifo[i] = val;
             };
+        var_refs[pin_name] = makeVarRef(this, fifo.rx_fifo[i]);
     }
 
     // GPIO pins 
@@ -57,6 +83,7 @@ void PioStateMachine::setup_var_access()
         var_setters[pin_name] = [this, i](uint32_t val) {
             gpio.raw_data[i] = static_cast<int8_t>(val & 1);  // TODO: check this correct
             };
+        var_refs[pin_name] = makeVarRef(this, gpio.raw_data[i]);
 
         // pindir
         std::string dir_name = "pindir" + std::to_string(i);
@@ -66,6 +93,7 @@ void PioStateMachine::setup_var_access()
         var_setters[dir_name] = [this, i](uint32_t val) {
             gpio.pindirs[i] = static_cast<int8_t>(val);
             };
+        var_refs[dir_name] = makeVarRef(this, gpio.pindirs[i]);
     }
 
     // IRQ
@@ -79,6 +107,7 @@ void PioStateMachine::setup_var_access()
         var_setters[pin_name] = [this, i](uint32_t val) {
             irq_flags[i] = static_cast<bool>(val & 1);
             };
+        var_refs[pin_name] = makeVarRef(this, irq_flags[i]);
     }
 }
 
@@ -89,6 +118,12 @@ uint32_t PioStateMachine::get_var(const std::string& name) const {
     return 0;
 }
 
+const PioVarRef* PioStateMachine::find_var_ref(const std::string& name) const
+{
+    auto it = var_refs.find(name);
+    return it != var_refs.end() ? &it->second : nullptr;
+}
+
 void PioStateMachine::set_var(const std::string& name, uint32_t value) {
     auto it = var_setters.find(name);
     if (it != var_setters.end()) {
@@ -119,14 +154,30 @@ std::vector<std::string> PioStateMachine::get_available_get_vars() const
 }
 
 bool PioStateMachine::run_until_var(const std::string& var_name, uint32_t target, int max_cycles) {
+    // Resolved once, unknown names read as 0 like get_var()
+    const PioVarRef* ref = find_var_ref(var_name);
     for (int i = 0; i < max_cycles; ++i)
     {
-        auto var = get_var(var_name);
-        //fmt::println("***value: {} ***pc: {}", var, regs.pc);
+        auto var = ref ? ref->read(*this) : 0;
         if (var == target)
             return true;
         else
             tick();
     }
     return false;
+}
+
+bool PioStateMachine::run_until(PioExpression& condition, int max_cycles) {
+    for (int i = 0; i < max_cycles; ++i)
+    {
+        if (condition.test(*this))
+            return true;
+        tick();
+    }
+    return false;
+}
+
+bool PioStateMachine::run_until(const std::string& expression, int max_cycles) {
+    PioExpression condition = PioExpression::compile(*this, expression);
+    return run_until(condition, max_cycles);
 }
\ No newline at end of file
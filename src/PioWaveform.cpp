@@ -0,0 +1,106 @@
+#include "PioWaveform.h"
+#include <algorithm>
+#include <bit>
+
+PioWaveform::PioWaveform(size_t max_changes)
+    : max_changes_(std::max<size_t>(max_changes, 2))
+{
+}
+
+void PioWaveform::add(int64_t clock, uint32_t pins)
+{
+    if (clock + 1 < end_clock_)
+        clear(); // the machine went back (reset), start over
+    end_clock_ = clock + 1;
+    if (!changes_.empty() && changes_.back().pins == pins)
+        return;
+
+    if (changes_.size() >= max_changes_)
+    {
+        changes_.erase(changes_.begin(), changes_.begin() + changes_.size() / 2);
+        rebuild();
+    }
+    changes_.push_back({ clock, pins });
+    extend(changes_.size() - 1);
+}
+
+void PioWaveform::clear()
+{
+    changes_.clear();
+    for (auto& level : levels_)
+        level.clear();
+    end_clock_ = 0;
+}
+
+void PioWaveform::extend(size_t index)
+{
+    const Change& change = changes_[index];
+    uint32_t toggled = index > 0 ? change.pins ^ changes_[index - 1].pins : 0;
+    size_t span = 1;
+    for (auto& level : levels_)
+    {
+        span *= kFanout;
+        if (index / span == level.size())
+            level.push_back({ change.clock, change.pins, change.pins });
+        Bucket& bucket = level.back();
+        bucket.min &= change.pins;
+        bucket.max |= change.pins;
+        for (uint32_t bits = toggled; bits; bits &= bits - 1)
+            bucket.edges[std::countr_zero(bits)]++;
+    }
+}
+
+void PioWaveform::rebuild()
+{
+    for (auto& level : levels_)
+        level.clear();
+    for (size_t i = 0; i < changes_.size(); i++)
+        extend(i);
+}
+
+PioWaveform::View PioWaveform::view(int64_t from, int64_t to, size_t max_points) const
+{
+    View view;
+    view.end = std::min(to, end_clock_);
+    view.first_clock = firstClock();
+    view.end_clock = end_clock_;
+    if (changes_.empty() || from >= to)
+        return view;
+    max_points = std::max<size_t>(max_points, 1);
+
+    // Changes [lo, hi): the one in effect at 'from' up to the last before 'to'
+    auto before = [](int64_t clock, const Change& change) { return clock < change.clock; };
+    size_t lo = std::upper_bound(changes_.begin(), changes_.end(), from, before) - changes_.begin();
+    lo = lo > 0 ? lo - 1 : 0;
+    size_t hi = std::lower_bound(changes_.begin(), changes_.end(), to, [](const Change& change, int64_t clock) { return change.clock < clock; })
+        - changes_.begin();
+    hi = std::max(hi, lo + 1);
+
+    if (hi - lo <= max_points)
+    {
+        view.buckets.reserve(hi - lo);
+        for (size_t i = lo; i < hi; i++)
+        {
+            Bucket bucket{ changes_[i].clock, changes_[i].pins, changes_[i].pins };
+            uint32_t toggled = i > 0 ? changes_[i].pins ^ changes_[i - 1].pins : 0;
+            for (uint32_t bits = toggled; bits; bits &= bits - 1)
+                bucket.edges[std::countr_zero(bits)] = 1;
+            view.buckets.push_back(bucket);
+        }
+        return view;
+    }
+
+    size_t span = 1;
+    for (int k = 0; k < kLevels; k++)
+    {
+        span *= kFanout;
+        size_t first = lo / span, last = (hi - 1) / span;
+        if (last - first + 1 <= max_points || k == kLevels - 1)
+        {
+            view.level = k + 1;
+            view.buckets.assign(levels_[k].begin() + first, levels_[k].begin() + last + 1);
+            break;
+        }
+    }
+    return view;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Multi-resolution pin history for plotting long captures, no GUI code so it can be tested anywhere.
+//
+// Only the samples that change a pin are kept (level 0). Above that, level k groups kFanout^k
+// changes into a bucket holding the AND and OR of the pin words (a pin whose bit is set in both
+// stayed high, clear in both stayed low, otherwise it toggled) and per-pin edge counts. Buckets are
+// extended as changes arrive, so adding a sample costs O(levels). view() picks the finest level
+// that covers the range in at most max_points buckets: drawing cost follows the plot's pixel
+// width, not the capture length.
+class PioWaveform
+{
+public:
+    static constexpr int kFanout = 16;
+    static constexpr int kLevels = 7; // levels above the changes, the top bucket spans 16^7 changes
+
+    struct Bucket
+    {
+        int64_t clock = 0;   // first clock the bucket covers
+        uint32_t min = 0;    // AND of the pin words
+        uint32_t max = 0;    // OR of the pin words
+        std::array<uint32_t, 32> edges{}; // pin N changed edges[N] times inside the bucket
+    };
+
+    struct View
+    {
+        int level = 0;               // 0: every change
+        std::vector<Bucket> buckets; // in clock order; a bucket lasts until the next one (the last until end)
+        int64_t end = 0;             // the clock after the last sample, clamped to the requested range
+        int64_t first_clock = 0;     // the whole capture, e.g. for the axis limits
+        int64_t end_clock = 0;
+    };
+
+    // Past max_changes the older half of the changes is dropped, so memory stays bounded
+    explicit PioWaveform(size_t max_changes = size_t{ 1 } << 22);
+
+    void add(int64_t clock, uint32_t pins); // a clock before the last sample starts over (a reset)
+    void clear();
+
+    bool empty() const { return changes_.empty(); }
+    size_t changes() const { return changes_.size(); }
+    int64_t firstClock() const { return changes_.empty() ? 0 : changes_.front().clock; }
+    int64_t endClock() const { return end_clock_; } // one past the last sample
+
+    // The clocks [from, to) in at most max_points buckets, plus the bucket in effect at 'from'
+    View view(int64_t from, int64_t to, size_t max_points) const;
+
+private:
+    struct Change
+    {
+        int64_t clock;
+        uint32_t pins;
+    };
+
+    void extend(size_t index); // fold change 'index' into the buckets of every level
+    void rebuild();
+
+    size_t max_changes_;
+    std::vector<Change> changes_;
+    std::array<std::vector<Bucket>, kLevels> levels_; // levels_[k] groups kFanout^(k + 1) changes
+    int64_t end_clock_ = 0;
+};
@@ -0,0 +1,332 @@
+#include "PioWorker.h"
+#include <algorithm>
+#include "PioBitOps.h"
+
+namespace {
+    constexpr uint64_t kChunkCycles = 1 << 14; // between pause/cancel checks, well under a frame
+    constexpr double kMaxLagSeconds = 0.1;     // RealTime: further behind than this, give up catching up
+    constexpr double kRateSmoothing = 0.2;     // weight of the newest cycles/sec measurement
+
+    using Clock = std::chrono::steady_clock;
+}
+
+PioWorker::PioWorker(PioStateMachine& pio) :
+    pio_(pio)
+{
+    publish();
+    thread_ = std::thread(&PioWorker::threadLoop, this);
+}
+
+PioWorker::~PioWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        quit_ = true;
+        cancel_requested_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+bool PioWorker::start(const Job& job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ != State::Idle || job_pending_)
+        return false;
+
+    job_ = job;
+    job_.breakpoints.skipAt(pio_.clock);
+    job_cycles_ = 0;
+    stop_reason_ = StopReason::None;
+    cycles_per_second_ = 0;
+    target_cycles_per_second_ = job.pacing == Pacing::RealTime
+        ? job.system_clock_hz * 256.0 / pio_.clkdivDivisor() * job.time_scale
+        : 0.0;
+    pause_requested_ = false;
+    cancel_requested_ = false;
+    job_pending_ = true;
+    state_ = State::Running; // the machine is the worker's from here on
+    cv_.notify_all();
+    return true;
+}
+
+void PioWorker::pause()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (state_ != State::Running)
+        return;
+    pause_requested_ = true;
+    cv_.notify_all(); // wakes a RealTime job waiting for its next chunk
+    cv_.wait(lock, [this] { return state_ != State::Running; });
+}
+
+void PioWorker::resume()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    pause_requested_ = false;
+    cv_.notify_all();
+}
+
+void PioWorker::cancel()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (state_ == State::Idle)
+        return;
+    cancel_requested_ = true;
+    cv_.notify_all();
+    cv_.wait(lock, [this] { return state_ == State::Idle; });
+}
+
+void PioWorker::wait()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return state_ == State::Idle && !job_pending_; });
+}
+
+bool PioWorker::waitFor(std::chrono::milliseconds timeout)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    return cv_.wait_for(lock, timeout, [this] { return state_ == State::Idle && !job_pending_; });
+}
+
+const PioWorker::Frame& PioWorker::latest()
+{
+    frames_.update();
+    return frames_.front();
+}
+
+// The owner only writes frames while the worker can't: state_ leaves Running under mutex_,
+// and the worker publishes its Paused/Idle frame before letting go of it
+
+void PioWorker::publishNow()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Running)
+        return;
+    publish();
+}
+
+void PioWorker::recordPins()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Running)
+        return;
+    samplePins();
+    publish();
+}
+
+void PioWorker::clearPinHistory()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (state_ == State::Running)
+        return;
+    history_.clear();
+    history_head_ = 0;
+    waveform_pending_.clear();
+    {
+        std::lock_guard<std::mutex> waveform_lock(waveform_mutex_);
+        waveform_.clear();
+    }
+    publish();
+}
+
+/* ----- Worker thread ----- */
+
+void PioWorker::threadLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        cv_.wait(lock, [this] { return job_pending_ || quit_; });
+        if (quit_)
+            return;
+
+        lock.unlock();
+        runJob();
+        lock.lock();
+
+        job_pending_ = false;
+        state_ = State::Idle;
+        publish(); // after state_ so the frame says Idle
+        cv_.notify_all();
+    }
+}
+
+void PioWorker::runJob()
+{
+    PioBreakpoints* owner_breakpoints = pio_.breakpoints;
+    pio_.breakpoints = &job_.breakpoints;
+
+    const double target_hz = target_cycles_per_second_;
+    uint64_t chunk = kChunkCycles;
+    if (target_hz > 0)
+        chunk = std::clamp<uint64_t>(static_cast<uint64_t>(target_hz / 1000), 1, kChunkCycles); // ~1 ms of wall time
+
+    auto last_publish = Clock::now();
+    uint64_t last_publish_cycles = 0;
+    pace_start_ = last_publish;
+    pace_cycles_ = 0;
+
+    while (stop_reason_ == StopReason::None)
+    {
+        if (cancel_requested_)
+        {
+            stop_reason_ = StopReason::Cancelled;
+            break;
+        }
+
+        if (pause_requested_)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            state_ = State::Paused;
+            publish();
+            cv_.notify_all();
+            cv_.wait(lock, [this] { return !pause_requested_ || cancel_requested_; });
+            state_ = State::Running;
+
+            // Time spent paused counts neither for pacing nor for the rate
+            last_publish = pace_start_ = Clock::now();
+            last_publish_cycles = pace_cycles_ = job_cycles_;
+            continue;
+        }
+
+        if (job_cycles_ >= job_.max_cycles)
+        {
+            stop_reason_ = StopReason::Completed;
+            break;
+        }
+
+        if (pio_.clock >= PioStateMachine::kMaxClock)
+        {
+            stop_reason_ = StopReason::ClockLimit; // free-runs end here instead of spinning in place
+            break;
+        }
+
+        const uint64_t clocks_left = static_cast<uint64_t>(PioStateMachine::kMaxClock - pio_.clock);
+        stop_reason_ = runChunk(std::min({ job_.max_cycles - job_cycles_, chunk, clocks_left }));
+        if (target_hz > 0 && !pace(target_hz))
+            continue; // woken for pause/cancel
+
+        auto now = Clock::now();
+        if (now - last_publish >= publish_interval)
+        {
+            double seconds = std::chrono::duration<double>(now - last_publish).count();
+            double rate = (job_cycles_ - last_publish_cycles) / seconds;
+            cycles_per_second_ = cycles_per_second_ == 0 ? rate : cycles_per_second_ + kRateSmoothing * (rate - cycles_per_second_);
+            publish();
+            last_publish = now;
+            last_publish_cycles = job_cycles_;
+        }
+    }
+
+    pio_.breakpoints = owner_breakpoints;
+}
+
+bool PioWorker::pace(double target_hz)
+{
+    // Seconds the emulation is ahead of the wall clock
+    auto now = Clock::now();
+    double ahead = (job_cycles_ - pace_cycles_) / target_hz - std::chrono::duration<double>(now - pace_start_).count();
+    if (ahead < -kMaxLagSeconds)
+    {
+        // Too slow for this rate: carry on from here instead of bursting to catch up
+        pace_start_ = now;
+        pace_cycles_ = job_cycles_;
+        return true;
+    }
+    if (ahead <= 0)
+        return true;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    return !cv_.wait_for(lock, std::chrono::duration<double>(ahead), [this] { return pause_requested_ || cancel_requested_; });
+}
+
+PioWorker::StopReason PioWorker::runChunk(uint64_t cycles)
+{
+    bool stopped = false;
+    if (!record_pins)
+    {
+        // run() keeps its fast paths unless the breakpoints need every cycle
+        job_cycles_ += pio_.run(static_cast<int>(cycles));
+        stopped = job_.breakpoints.hit().kind != PioBreakpoints::Kind::None;
+    }
+    else
+    {
+        job_.breakpoints.clearHit();
+        for (uint64_t i = 0; i < cycles && !stopped; i++)
+        {
+            int clock = pio_.clock;
+            stopped = !pio_.step();
+            if (pio_.clock != clock) // a watchpoint stops after its cycle
+            {
+                job_cycles_++;
+                samplePins();
+            }
+        }
+    }
+
+    if (!stopped)
+        return StopReason::None;
+    switch (job_.breakpoints.hit().kind)
+    {
+    case PioBreakpoints::Kind::Condition: return StopReason::Condition;
+    case PioBreakpoints::Kind::Watch:     return StopReason::Watchpoint;
+    default:                              return StopReason::Breakpoint;
+    }
+}
+
+void PioWorker::samplePins()
+{
+    PinSample sample{ pio_.clock, PioBitOps::gatherPins(pio_.gpio.raw_data) };
+    waveform_pending_.push_back(sample);
+    if (history_.size() < pin_history_size)
+    {
+        history_.push_back(sample);
+        return;
+    }
+    history_[history_head_] = sample;
+    history_head_ = (history_head_ + 1) % history_.size();
+}
+
+void PioWorker::publish()
+{
+    Frame& frame = frames_.back();
+    frame.machine.capture(pio_);
+    frame.state = state_;
+    frame.stop_reason = stop_reason_;
+    frame.job_cycles = job_cycles_;
+    frame.job_max_cycles = job_.max_cycles;
+    frame.stop_detail = stop_reason_ == StopReason::Completed || stop_reason_ == StopReason::Cancelled || stop_reason_ == StopReason::ClockLimit
+        ? std::string()
+        : job_.breakpoints.describe(job_.breakpoints.hit());
+    frame.cycles_per_second = cycles_per_second_;
+    frame.target_cycles_per_second = target_cycles_per_second_;
+
+    if (pio_.profiler)
+        frame.profile = *pio_.profiler;
+    else
+        frame.profile.reset();
+    if (pio_.fifo_stats)
+        frame.fifo_stats = *pio_.fifo_stats;
+    else
+        frame.fifo_stats.reset();
+
+    // Unroll the ring, oldest first (reuses the frame's capacity)
+    frame.pins.resize(history_.size());
+    std::rotate_copy(history_.begin(), history_.begin() + history_head_, history_.end(), frame.pins.begin());
+    frames_.publish();
+
+    if (!waveform_pending_.empty())
+    {
+        std::lock_guard<std::mutex> waveform_lock(waveform_mutex_);
+        for (const PinSample& sample : waveform_pending_)
+            waveform_.add(sample.clock, sample.pins);
+        waveform_pending_.clear();
+    }
+}
+
+PioWaveform::View PioWorker::waveform(int64_t from, int64_t to, size_t max_points)
+{
+    std::lock_guard<std::mutex> waveform_lock(waveform_mutex_);
+    return waveform_.view(from, to, max_points);
+}
@@ -0,0 +1,149 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PioBreakpoints.h"
+#include "PioFifoStats.h"
+#include "PioProfiler.h"
+#include "PioStateMachine.h"
+#include "PioSnapshot.h"
+#include "PioWaveform.h"
+#include "TripleBuffer.h"
+
+// Runs jobs on a PioStateMachine on a dedicated thread so long runs never block the caller
+// (GUI frame loop). Progress is published as Frames through a triple buffer at most every
+// publish_interval. The machine belongs to the worker while a job is Running; the owner may
+// touch it again once the worker is Idle or Paused.
+//
+// Jobs run either as fast as possible (free-run: max_cycles = kForever, stopped by cancel(), a
+// breakpoint or the condition) or paced to wall-clock time at the SM's clock rate, scaled by
+// time_scale, so they can be watched or checked against host code that keeps real time.
+class PioWorker
+{
+public:
+    enum class State
+    {
+        Idle,
+        Running,
+        Paused
+    };
+
+    enum class StopReason
+    {
+        None,       // still running (or nothing ran yet)
+        Completed,  // ran max_cycles
+        Breakpoint, // about to fetch from a breakpoint address
+        Condition,  // a breakpoint condition became true
+        Watchpoint, // a watched variable changed
+        Cancelled,
+        ClockLimit  // the machine's clock reached PioStateMachine::kMaxClock
+    };
+
+    enum class Pacing
+    {
+        FreeRun,  // as fast as possible
+        RealTime  // system_clock_hz / clock divider * time_scale SM cycles per wall-clock second
+    };
+
+    static constexpr uint64_t kForever = UINT64_MAX; // max_cycles to run until stopped
+
+    struct Job
+    {
+        uint64_t max_cycles = 0;
+        Pacing pacing = Pacing::FreeRun;
+        double system_clock_hz = 125'000'000.0;
+        double time_scale = 1.0;            // RealTime: emulated seconds per wall-clock second
+        PioBreakpoints breakpoints;         // compiled against the worker's machine, not checked before the job's first cycle
+    };
+
+    struct PinSample
+    {
+        int clock;
+        uint32_t pins; // gpio.raw_data, pin N is bit N
+    };
+
+    // What the owner gets to see
+    struct Frame
+    {
+        PioSnapshot machine;
+        State state = State::Idle;
+        StopReason stop_reason = StopReason::None;
+        std::string stop_detail;     // the breakpoint that stopped the job, e.g. "pc 3" or "x: 5 -> 4"
+        uint64_t job_cycles = 0;     // cycles the current/last job ran
+        uint64_t job_max_cycles = 0;
+        double cycles_per_second = 0;        // measured SM cycles per wall-clock second, smoothed
+        double target_cycles_per_second = 0; // RealTime jobs, 0 otherwise
+        std::vector<PinSample> pins; // last pin_history_size samples, oldest first
+        PioProfiler profile;         // copy of the machine's profiler, all zero without one
+        PioFifoStats fifo_stats;     // same for the FIFO statistics
+    };
+
+    explicit PioWorker(PioStateMachine& pio);
+    ~PioWorker();
+    PioWorker(const PioWorker&) = delete;
+    PioWorker& operator=(const PioWorker&) = delete;
+
+    bool start(const Job& job); // false while another job is running or paused
+    void pause();               // returns once the worker has stopped touching the machine
+    void resume();
+    void cancel();              // ends the job, returns once the worker is idle
+    void wait();                // blocks until the job ends
+    bool waitFor(std::chrono::milliseconds timeout); // wait() for at most 'timeout', true when the job has ended
+    State state() const { return state_.load(); }
+    bool busy() const { return state() != State::Idle; }
+
+    // Owner thread
+    const Frame& latest();      // newest published frame
+    void publishNow();          // publish the machine as it is now (not while Running), e.g. after an edit
+    void recordPins();          // add a pin sample for a cycle the owner ran itself (not while Running)
+    void clearPinHistory();     // not while Running
+    // Every pin sample since the last clear, decimated for plotting (see PioWaveform); any time,
+    // a running job's samples show up as frames are published
+    PioWaveform::View waveform(int64_t from, int64_t to, size_t max_points);
+
+    bool record_pins = true;    // sample the pins every cycle (forces the tick() path), set while Idle
+    size_t pin_history_size = 1000;
+    std::chrono::milliseconds publish_interval{ 16 }; // ~60 fps
+
+private:
+    void threadLoop();
+    void runJob();
+    bool pace(double target_hz);
+    StopReason runChunk(uint64_t cycles);
+    void samplePins();
+    void publish();
+
+    PioStateMachine& pio_;
+    Job job_;
+    uint64_t job_cycles_ = 0;
+    StopReason stop_reason_ = StopReason::None;
+    double cycles_per_second_ = 0;
+    double target_cycles_per_second_ = 0;
+
+    // RealTime baseline: job_cycles_ was pace_cycles_ at pace_start_
+    std::chrono::steady_clock::time_point pace_start_;
+    uint64_t pace_cycles_ = 0;
+
+    std::vector<PinSample> history_; // ring buffer
+    size_t history_head_ = 0;
+    std::vector<PinSample> waveform_pending_; // since the last publish
+    PioWaveform waveform_;
+    std::mutex waveform_mutex_;
+
+    TripleBuffer<Frame> frames_;
+
+    std::atomic<State> state_{ State::Idle };
+    std::atomic<bool> pause_requested_{ false };
+    std::atomic<bool> cancel_requested_{ false };
+    bool job_pending_ = false;
+    bool quit_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+};
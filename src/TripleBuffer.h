@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free triple buffer for one writer and one reader: the writer fills back() and publishes
+// it, the reader picks up the newest published value with update() and reads front(). Neither
+// side ever waits; values the reader didn't get to are simply skipped.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer side
+    T& back() { return buffers_[back_]; }
+    void publish()
+    {
+        // Swap back <-> middle, marking the middle as fresh
+        back_ = state_.exchange(static_cast<uint8_t>(back_ | kFresh), std::memory_order_acq_rel) & kIndex;
+    }
+
+    // Reader side, true when a newer value was picked up
+    bool update()
+    {
+        if ((state_.load(std::memory_order_relaxed) & kFresh) == 0)
+            return false;
+        front_ = state_.exchange(front_, std::memory_order_acq_rel) & kIndex;
+        return true;
+    }
+    const T& front() const { return buffers_[front_]; }
+
+private:
+    static constexpr uint8_t kIndex = 0b011;
+    static constexpr uint8_t kFresh = 0b100;
+
+    std::array<T, 3> buffers_{};
+    alignas(64) std::atomic<uint8_t> state_{ 1 }; // index of the middle buffer + fresh bit
+    alignas(64) uint8_t back_ = 0;                // writer only
+    alignas(64) uint8_t front_ = 2;               // reader only
+};
@@ -17,10 +17,6 @@ void PioStateMachineApp::initialize() {
     done = false;
     breakpoints.clear();
 
-    timing_timestamps.clear();
-    timing_values.clear();
-    timing_values.resize(32);
-    current_cycle = 0;  // Reset to 0
     for (int i = 0; i < 32; i++) {
         selected_pins[i] = false;
     }
@@ -54,9 +50,11 @@ void PioStateMachineApp::renderControlWindow() {
     ImGui::Text("Emulator Controls");
     ImGui::Separator();
 
+    // Multi-cycle runs go to the worker thread, the controls wait until it is done
+    ImGui::BeginDisabled(worker.busy());
     if (ImGui::Button("Tick Once")) {
         pio.tick();
-        updateTimingData();
+        worker.recordPins();
     }
 
     ImGui::SameLine();
@@ -64,55 +62,121 @@ void PioStateMachineApp::renderControlWindow() {
     if (tick_steps < 1) tick_steps = 1;
     ImGui::SameLine();
     if (ImGui::Button("Tick Multiple")) {
-        int steps_done = 0;
-        while (steps_done < tick_steps) {
-            if (breakpoints.count(static_cast<int>(pio.regs.pc))) {
-                break;
-            }
-            pio.tick();
-            updateTimingData();
-            steps_done++;
-        }
+        startJob(makeJob(tick_steps));
     }
+    ImGui::EndDisabled();
 
     if (ImGui::Button("Reset Emulator")) {
+        worker.cancel();
         pio.reset(ini_filepath); // reset state machine 
         reset();                 // reset gui state
-        // reset timing diagram
-        timing_timestamps.clear();
-        timing_values.clear();
-        current_cycle = 0.0;
+        worker.clearPinHistory(); // reset timing diagram
     }
 
     ImGui::Separator();
     ImGui::Text("Run Until Condition");
-    static char var_name[32] = "pc";
-    static uint32_t target_value = 0;
+    static char until_text[128] = "pc == 0";
     static int max_cycles = 10000;
-    ImGui::InputText("Variable Name", var_name, IM_ARRAYSIZE(var_name));
-    ImGui::InputScalar("Target Value", ImGuiDataType_U32, &target_value, nullptr, nullptr, "%u");
+    ImGui::BeginDisabled(worker.busy());
+    ImGui::InputText("Condition", until_text, IM_ARRAYSIZE(until_text));
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("e.g. x == 0 && rise(gpio22), count(irq0) >= 3, tx_fifo_count < 2");
+    }
     ImGui::InputInt("Max Cycles", &max_cycles);
     if (max_cycles < 1) max_cycles = 1;
+    static std::string run_until_error;
     if (ImGui::Button("Run Until")) {
-        pio.run_until_var(var_name, target_value, max_cycles);
+        PioWorker::Job job;
+        job.max_cycles = max_cycles;
+        try {
+            job.breakpoints.addCondition(pio, until_text);
+            run_until_error.clear();
+            startJob(job);
+        }
+        catch (const std::exception& e) {
+            run_until_error = e.what();
+        }
+    }
+    if (!run_until_error.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", run_until_error.c_str());
     }
+    ImGui::EndDisabled();
 
     ImGui::Separator();
     ImGui::Text("Breakpoints");
     static int max_cycles_bp = 10000;
+    ImGui::BeginDisabled(worker.busy());
     ImGui::InputInt("Max Cycles BP", &max_cycles_bp);
     if (max_cycles_bp < 1) max_cycles_bp = 1;
     if (ImGui::Button("Continue to Breakpoint")) {
-        int cycles = 0;
-        while (cycles < max_cycles_bp) {
-            if (breakpoints.count(static_cast<int>(pio.regs.pc))) {
-                break;
+        startJob(makeJob(max_cycles_bp));
+    }
+
+    // Conditions ("x == 0 && gpio22 rising") stop before the cycle they become true at,
+    // watchpoints after a cycle that changed the variable
+    static char breakpoint_text[128] = "";
+    static std::string breakpoint_error;
+    ImGui::InputText("Condition / Variable", breakpoint_text, IM_ARRAYSIZE(breakpoint_text));
+    bool add_condition = ImGui::Button("Add Condition");
+    ImGui::SameLine();
+    bool add_watch = ImGui::Button("Add Watchpoint");
+    if (add_condition || add_watch) {
+        try {
+            if (add_condition) {
+                breakpoints.addCondition(pio, breakpoint_text);
+            }
+            else {
+                breakpoints.addWatch(pio, breakpoint_text);
             }
-            pio.tick();
-            updateTimingData();
-            cycles++;
+            breakpoint_error.clear();
+        }
+        catch (const std::exception& e) {
+            breakpoint_error = e.what();
+        }
+    }
+    if (!breakpoint_error.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", breakpoint_error.c_str());
+    }
+
+    int remove_id = -1;
+    for (const auto& entry : breakpoints.entries()) {
+        ImGui::PushID(entry.id);
+        if (ImGui::SmallButton("x")) {
+            remove_id = entry.id;
         }
+        ImGui::SameLine();
+        ImGui::Text("%s %s", entry.kind == PioBreakpoints::Kind::Watch ? "watch" : "when", entry.text.c_str());
+        ImGui::PopID();
     }
+    if (remove_id >= 0) {
+        breakpoints.remove(remove_id);
+    }
+    ImGui::EndDisabled();
+
+    ImGui::Separator();
+    ImGui::Text("Run Modes");
+    static float system_clock_mhz = 125.0f;
+    static float time_scale = 0.001f;
+    ImGui::BeginDisabled(worker.busy());
+    ImGui::Checkbox("Record Pins (slower)", &worker.record_pins);
+    if (ImGui::Button("Free Run")) {
+        startJob(makeJob(PioWorker::kForever));
+    }
+    ImGui::InputFloat("System Clock (MHz)", &system_clock_mhz, 1.0f, 10.0f, "%.3f");
+    ImGui::InputFloat("Time Scale", &time_scale, 0.0f, 0.0f, "%g");
+    if (system_clock_mhz <= 0.0f) system_clock_mhz = 1.0f;
+    if (time_scale <= 0.0f) time_scale = 1e-6f;
+    if (ImGui::Button("Run Real Time")) {
+        PioWorker::Job job = makeJob(PioWorker::kForever);
+        job.pacing = PioWorker::Pacing::RealTime;
+        job.system_clock_hz = system_clock_mhz * 1e6;
+        job.time_scale = time_scale;
+        startJob(job);
+    }
+    ImGui::EndDisabled();
+
+    ImGui::Separator();
+    renderWorkerStatus();
 
     ImGui::End();
 }
@@ -126,6 +190,10 @@ void PioStateMachineApp::renderVariableWindow() {
     ImGui::Text("State Machine Variables");
     ImGui::Separator();
 
+    // While a job runs the windows show the worker's latest frame, read only
+    PioStateMachine& sm = view();
+    ImGui::BeginDisabled(worker.state() == PioWorker::State::Running);
+
     if (ImGui::BeginTabBar("VariableTabs")) {
         if (ImGui::BeginTabItem("Registers")) {
             if (ImGui::BeginTable("RegistersTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
@@ -137,34 +205,34 @@ void PioStateMachineApp::renderVariableWindow() {
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("X");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t x_val = pio.regs.x;
+                uint32_t x_val = sm.regs.x;
                 if (ImGui::InputScalar("##x", ImGuiDataType_U32, &x_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                    pio.regs.x = x_val;
+                    sm.regs.x = x_val;
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("Y");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t y_val = pio.regs.y;
+                uint32_t y_val = sm.regs.y;
                 if (ImGui::InputScalar("##y", ImGuiDataType_U32, &y_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                    pio.regs.y = y_val;
+                    sm.regs.y = y_val;
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("ISR");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t isr_val = pio.regs.isr;
+                uint32_t isr_val = sm.regs.isr;
                 if (ImGui::InputScalar("##isr", ImGuiDataType_U32, &isr_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                    pio.regs.isr = isr_val;
+                    sm.regs.isr = isr_val;
                 }
                 ImGui::SameLine();
                 ImGui::Text("(Shift Count:");
                 ImGui::SameLine();
-                uint32_t isr_count = pio.regs.isr_shift_count;
+                uint32_t isr_count = sm.regs.isr_shift_count;
                 if (ImGui::InputScalar("##isrcount", ImGuiDataType_U32, &isr_count)) {
-                    if (isr_count <= 32) pio.regs.isr_shift_count = isr_count;
+                    if (isr_count <= 32) sm.regs.isr_shift_count = isr_count;
                 }
                 ImGui::SameLine();
                 ImGui::Text(")");
@@ -173,16 +241,16 @@ void PioStateMachineApp::renderVariableWindow() {
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("OSR");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t osr_val = pio.regs.osr;
+                uint32_t osr_val = sm.regs.osr;
                 if (ImGui::InputScalar("##osr", ImGuiDataType_U32, &osr_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                    pio.regs.osr = osr_val;
+                    sm.regs.osr = osr_val;
                 }
                 ImGui::SameLine();
                 ImGui::Text("(Shift Count:");
                 ImGui::SameLine();
-                uint32_t osr_count = pio.regs.osr_shift_count;
+                uint32_t osr_count = sm.regs.osr_shift_count;
                 if (ImGui::InputScalar("##osrcount", ImGuiDataType_U32, &osr_count)) {
-                    if (osr_count <= 32) pio.regs.osr_shift_count = osr_count;
+                    if (osr_count <= 32) sm.regs.osr_shift_count = osr_count;
                 }
                 ImGui::SameLine();
                 ImGui::Text(")");
@@ -191,28 +259,28 @@ void PioStateMachineApp::renderVariableWindow() {
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("PC");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t pc_val = pio.regs.pc;
+                uint32_t pc_val = sm.regs.pc;
                 if (ImGui::InputScalar("##pc", ImGuiDataType_U32, &pc_val)) {
                     if (pc_val < 32)
-                        pio.regs.pc = pc_val;
+                        sm.regs.pc = pc_val;
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("Delay");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t delay_val = pio.regs.delay;
+                uint32_t delay_val = sm.regs.delay;
                 if (ImGui::InputScalar("##delay", ImGuiDataType_U32, &delay_val)) {
-                    pio.regs.delay = delay_val;
+                    sm.regs.delay = delay_val;
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("Status");
                 ImGui::TableSetColumnIndex(1);
-                uint32_t status_val = pio.regs.status;
+                uint32_t status_val = sm.regs.status;
                 if (ImGui::InputScalar("##status", ImGuiDataType_U32, &status_val)) {
-                    pio.regs.status = status_val;
+                    sm.regs.status = status_val;
                 }
 
                 ImGui::EndTable();
@@ -232,17 +300,17 @@ void PioStateMachineApp::renderVariableWindow() {
                     ImGui::TableSetColumnIndex(0);
                     ImGui::Text("%d", pin);
                     ImGui::TableSetColumnIndex(1);
-                    int raw_data = pio.gpio.raw_data[pin];
+                    int raw_data = sm.gsm.raw_data[pin];
                     ImGui::PushID(pin * 2);
                     if (ImGui::InputInt("##raw_data", &raw_data, 0)) {
-                        pio.gpio.raw_data[pin] = static_cast<int8_t>(raw_data & 1);
+                        sm.gsm.raw_data[pin] = static_cast<int8_t>(raw_data & 1);
                     }
                     ImGui::PopID();
                     ImGui::TableSetColumnIndex(2);
-                    int pindir = pio.gpio.pindirs[pin];
+                    int pindir = sm.gsm.pindirs[pin];
                     ImGui::PushID(pin * 2 + 1);
                     if (ImGui::InputInt("##pindir", &pindir, 0)) {
-                        pio.gpio.pindirs[pin] = static_cast<int8_t>(pindir & 1);
+                        sm.gsm.pindirs[pin] = static_cast<int8_t>(pindir & 1);
                     }
                     ImGui::PopID();
                 }
@@ -262,36 +330,36 @@ void PioStateMachineApp::renderVariableWindow() {
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("TX FIFO Count");
                 ImGui::TableSetColumnIndex(1);
-                int tx_count = pio.fifo.tx_fifo_count;
+                int tx_count = sm.fifo.tx_fifo_count;
                 if (ImGui::InputInt("##txcount", &tx_count)) {
-                    if (tx_count >= 0 && tx_count <= 8) pio.fifo.tx_fifo_count = static_cast<uint8_t>(tx_count);
+                    if (tx_count >= 0 && tx_count <= 8) sm.fifo.tx_fifo_count = static_cast<uint8_t>(tx_count);
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("RX FIFO Count");
                 ImGui::TableSetColumnIndex(1);
-                int rx_count = pio.fifo.rx_fifo_count;
+                int rx_count = sm.fifo.rx_fifo_count;
                 if (ImGui::InputInt("##rxcount", &rx_count)) {
-                    if (rx_count >= 0 && rx_count <= 8) pio.fifo.rx_fifo_count = static_cast<uint8_t>(rx_count);
+                    if (rx_count >= 0 && rx_count <= 8) sm.fifo.rx_fifo_count = static_cast<uint8_t>(rx_count);
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("Push is Stalling");
                 ImGui::TableSetColumnIndex(1);
-                bool push_stall = pio.fifo.push_is_stalling;
+                bool push_stall = sm.fifo.push_is_stalling;
                 if (ImGui::Checkbox("##push_stall", &push_stall)) {
-                    pio.fifo.push_is_stalling = push_stall;
+                    sm.fifo.push_is_stalling = push_stall;
                 }
 
                 ImGui::TableNextRow();
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("Pull is Stalling");
                 ImGui::TableSetColumnIndex(1);
-                bool pull_stall = pio.fifo.pull_is_stalling;
+                bool pull_stall = sm.fifo.pull_is_stalling;
                 if (ImGui::Checkbox("##pull_stall", &pull_stall)) {
-                    pio.fifo.pull_is_stalling = pull_stall;
+                    sm.fifo.pull_is_stalling = pull_stall;
                 }
 
                 for (int i = 0; i < 4; ++i) {
@@ -299,10 +367,10 @@ void PioStateMachineApp::renderVariableWindow() {
                     ImGui::TableSetColumnIndex(0);
                     ImGui::Text("TX FIFO[%d]", i);
                     ImGui::TableSetColumnIndex(1);
-                    uint32_t tx_val = pio.fifo.tx_fifo[i];
+                    uint32_t tx_val = sm.fifo.tx_fifo[i];
                     ImGui::PushID(i);
                     if (ImGui::InputScalar("##tx", ImGuiDataType_U32, &tx_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                        pio.fifo.tx_fifo[i] = tx_val;
+                        sm.fifo.tx_fifo[i] = tx_val;
                     }
                     ImGui::PopID();
                 }
@@ -312,16 +380,50 @@ void PioStateMachineApp::renderVariableWindow() {
                     ImGui::TableSetColumnIndex(0);
                     ImGui::Text("RX FIFO[%d]", i);
                     ImGui::TableSetColumnIndex(1);
-                    uint32_t rx_val = pio.fifo.rx_fifo[i];
+                    uint32_t rx_val = sm.fifo.rx_fifo[i];
                     ImGui::PushID(i + 4);
                     if (ImGui::InputScalar("##rx", ImGuiDataType_U32, &rx_val, nullptr, nullptr, "%08X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                        pio.fifo.rx_fifo[i] = rx_val;
+                        sm.fifo.rx_fifo[i] = rx_val;
                     }
                     ImGui::PopID();
                 }
 
                 ImGui::EndTable();
             }
+
+            // Occupancy histograms, watermarks and stall/overrun counters
+            ImGui::Separator();
+            ImGui::BeginDisabled(worker.busy());
+            bool collecting = pio.fifo_stats != nullptr;
+            if (ImGui::Checkbox("Collect Statistics", &collecting)) {
+                pio.fifo_stats = collecting ? &fifo_stats : nullptr;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Reset Statistics")) {
+                fifo_stats.reset();
+            }
+            ImGui::EndDisabled();
+
+            const PioFifoStats& stats = worker.latest().fifo_stats;
+            auto renderHistogram = [](const char* label, const PioFifoStats::Histogram& histogram, uint64_t stall_cycles) {
+                float levels[PioFifoStats::kMaxLevel + 1];
+                uint64_t total = histogram.total();
+                for (int level = 0; level <= PioFifoStats::kMaxLevel; level++)
+                    levels[level] = total ? static_cast<float>(histogram.cycles[level]) / total : 0.0f;
+                ImGui::PlotHistogram(label, levels, PioFifoStats::kMaxLevel + 1, 0, nullptr, 0.0f, 1.0f, ImVec2(0, 60));
+                ImGui::Text("min %d  max %d  mean %.2f  stalled %llu cycles", histogram.min, histogram.max, histogram.mean(),
+                    static_cast<unsigned long long>(stall_cycles));
+            };
+            renderHistogram("TX level", stats.tx, stats.tx_stall_cycles);
+            renderHistogram("RX level", stats.rx, stats.rx_stall_cycles);
+            ImGui::Text("RX data lost: %llu  Empty TX pulls: %llu",
+                static_cast<unsigned long long>(stats.count(PioFifoStats::EventKind::RxDropped)),
+                static_cast<unsigned long long>(stats.count(PioFifoStats::EventKind::TxEmptyPull)));
+            if (!stats.events.empty() && ImGui::TreeNode("First Events")) {
+                for (const auto& event : stats.events)
+                    ImGui::Text("%-14s clock %d  pc %u", PioFifoStats::eventName(event.kind), event.clock, event.pc);
+                ImGui::TreePop();
+            }
             ImGui::EndTabItem();
         }
 
@@ -335,9 +437,9 @@ void PioStateMachineApp::renderVariableWindow() {
                 ImGui::TableSetColumnIndex(0);
                 ImGui::Text("IRQ Waiting");
                 ImGui::TableSetColumnIndex(1);
-                bool irq_w = pio.irq_is_waiting;
+                bool irq_w = sm.irq_is_waiting;
                 if (ImGui::Checkbox("##irqwait", &irq_w)) {
-                    pio.irq_is_waiting = irq_w;
+                    sm.irq_is_waiting = irq_w;
                 }
 
                 for (int i = 0; i < 8; ++i) {
@@ -346,9 +448,9 @@ void PioStateMachineApp::renderVariableWindow() {
                     ImGui::Text("IRQ Flag %d", i);
                     ImGui::TableSetColumnIndex(1);
                     ImGui::PushID(i);
-                    bool irq_f = pio.irq_flags[i];
+                    bool irq_f = sm.irq_flags[i];
                     if (ImGui::Checkbox("##irq", &irq_f)) {
-                        pio.irq_flags[i] = irq_f;
+                        sm.irq_flags[i] = irq_f;
                     }
                     ImGui::PopID();
                 }
@@ -358,12 +460,66 @@ void PioStateMachineApp::renderVariableWindow() {
             ImGui::EndTabItem();
         }
 
+        if (ImGui::BeginTabItem("Watch")) {
+            renderWatchTab(sm);
+            ImGui::EndTabItem();
+        }
+
         ImGui::EndTabBar();
     }
 
+    ImGui::EndDisabled();
     ImGui::End();
 }
 
+void PioStateMachineApp::renderWatchTab(const PioStateMachine& sm) {
+    // Expressions over the variables, evaluated against what the windows show
+    static char watch_text[128] = "";
+    static std::string watch_error;
+    ImGui::InputText("##watch", watch_text, IM_ARRAYSIZE(watch_text));
+    ImGui::SameLine();
+    if (ImGui::Button("Add Watch") && watch_text[0] != '\0') {
+        try {
+            watches.push_back(PioExpression::compile(pio, watch_text));
+            watch_error.clear();
+        }
+        catch (const std::exception& e) {
+            watch_error = e.what();
+        }
+    }
+    if (!watch_error.empty()) {
+        ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", watch_error.c_str());
+    }
+
+    if (ImGui::BeginTable("WatchTable", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
+        ImGui::TableSetupColumn("Expression");
+        ImGui::TableSetupColumn("Value");
+        ImGui::TableSetupColumn("", ImGuiTableColumnFlags_WidthFixed);
+        ImGui::TableHeadersRow();
+
+        int remove_index = -1;
+        for (int i = 0; i < static_cast<int>(watches.size()); ++i) {
+            uint32_t value = watches[i].evaluate(sm);
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%s", watches[i].text().c_str());
+            ImGui::TableSetColumnIndex(1);
+            ImGui::Text("%u (0x%08X)", value, value);
+            ImGui::TableSetColumnIndex(2);
+            ImGui::PushID(i);
+            if (ImGui::SmallButton("x")) {
+                remove_index = i;
+            }
+            ImGui::PopID();
+        }
+        if (remove_index >= 0) {
+            watches.erase(watches.begin() + remove_index);
+        }
+
+        ImGui::EndTable();
+    }
+}
+
 void PioStateMachineApp::renderSettingsWindow() {
     if (!ImGui::Begin("Settings", &show_settings_window)) {
         ImGui::End();
@@ -374,6 +530,10 @@ void PioStateMachineApp::renderSettingsWindow() {
     ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "Settings are editable only when clock is 0");
     ImGui::Separator();
 
+    // While a job runs the windows show the worker's latest frame, read only
+    PioStateMachine& sm = view();
+    ImGui::BeginDisabled(worker.state() == PioWorker::State::Running);
+
     if (ImGui::BeginTable("SettingsTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp | ImGuiTableFlags_ScrollY, ImVec2(0.0f, ImGui::GetTextLineHeight() * 20))) {
         ImGui::TableSetupColumn("Setting", ImGuiTableColumnFlags_WidthFixed);
         ImGui::TableSetupColumn("Value");
@@ -383,313 +543,342 @@ void PioStateMachineApp::renderSettingsWindow() {
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Sideset Count");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int sideset_count = pio.settings.sideset_count;
+        if (sm.clock == 0) {
+            int sideset_count = sm.settings.sideset_count;
             if (ImGui::InputInt("##sideset_count", &sideset_count)) {
-                pio.settings.sideset_count = sideset_count;
+                sm.settings.sideset_count = sideset_count;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.sideset_count);
+            ImGui::Text("%d", sm.settings.sideset_count);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Sideset Opt");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool sideset_opt = pio.settings.sideset_opt;
+        if (sm.clock == 0) {
+            bool sideset_opt = sm.settings.sideset_opt;
             if (ImGui::Checkbox("##sideset_opt", &sideset_opt)) {
-                pio.settings.sideset_opt = sideset_opt;
+                sm.settings.sideset_opt = sideset_opt;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.sideset_opt ? "true" : "false");
+            ImGui::Text("%s", sm.settings.sideset_opt ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Sideset to Pindirs");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool sideset_to_pindirs = pio.settings.sideset_to_pindirs;
+        if (sm.clock == 0) {
+            bool sideset_to_pindirs = sm.settings.sideset_to_pindirs;
             if (ImGui::Checkbox("##sideset_to_pindirs", &sideset_to_pindirs)) {
-                pio.settings.sideset_to_pindirs = sideset_to_pindirs;
+                sm.settings.sideset_to_pindirs = sideset_to_pindirs;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.sideset_to_pindirs ? "true" : "false");
+            ImGui::Text("%s", sm.settings.sideset_to_pindirs ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Sideset Base");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int sideset_base = pio.settings.sideset_base;
+        if (sm.clock == 0) {
+            int sideset_base = sm.settings.sideset_base;
             if (ImGui::InputInt("##sideset_base", &sideset_base)) {
-                pio.settings.sideset_base = sideset_base;
+                sm.settings.sideset_base = sideset_base;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.sideset_base);
+            ImGui::Text("%d", sm.settings.sideset_base);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("In Base");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int in_base = pio.settings.in_base;
+        if (sm.clock == 0) {
+            int in_base = sm.settings.in_base;
             if (ImGui::InputInt("##in_base", &in_base)) {
-                pio.settings.in_base = in_base;
+                sm.settings.in_base = in_base;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.in_base);
+            ImGui::Text("%d", sm.settings.in_base);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Out Base");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int out_base = pio.settings.out_base;
+        if (sm.clock == 0) {
+            int out_base = sm.settings.out_base;
             if (ImGui::InputInt("##out_base", &out_base)) {
-                pio.settings.out_base = out_base;
+                sm.settings.out_base = out_base;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.out_base);
+            ImGui::Text("%d", sm.settings.out_base);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Set Base");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int set_base = pio.settings.set_base;
+        if (sm.clock == 0) {
+            int set_base = sm.settings.set_base;
             if (ImGui::InputInt("##set_base", &set_base)) {
-                pio.settings.set_base = set_base;
+                sm.settings.set_base = set_base;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.set_base);
+            ImGui::Text("%d", sm.settings.set_base);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Jmp Pin");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int jmp_pin = pio.settings.jmp_pin;
+        if (sm.clock == 0) {
+            int jmp_pin = sm.settings.jmp_pin;
             if (ImGui::InputInt("##jmp_pin", &jmp_pin)) {
-                pio.settings.jmp_pin = jmp_pin;
+                sm.settings.jmp_pin = jmp_pin;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.jmp_pin);
+            ImGui::Text("%d", sm.settings.jmp_pin);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Set Count");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int set_count = pio.settings.set_count;
+        if (sm.clock == 0) {
+            int set_count = sm.settings.set_count;
             if (ImGui::InputInt("##set_count", &set_count)) {
-                pio.settings.set_count = set_count;
+                sm.settings.set_count = set_count;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.set_count);
+            ImGui::Text("%d", sm.settings.set_count);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Out Count");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int out_count = pio.settings.out_count;
+        if (sm.clock == 0) {
+            int out_count = sm.settings.out_count;
             if (ImGui::InputInt("##out_count", &out_count)) {
-                pio.settings.out_count = out_count;
+                sm.settings.out_count = out_count;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.out_count);
+            ImGui::Text("%d", sm.settings.out_count);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Push Threshold");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            uint32_t push_threshold = pio.settings.push_threshold;
+        if (sm.clock == 0) {
+            uint32_t push_threshold = sm.settings.push_threshold;
             if (ImGui::InputScalar("##push_threshold", ImGuiDataType_U32, &push_threshold)) {
-                pio.settings.push_threshold = push_threshold;
+                sm.settings.push_threshold = push_threshold;
             }
         }
         else {
-            ImGui::Text("%u", pio.settings.push_threshold);
+            ImGui::Text("%u", sm.settings.push_threshold);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Pull Threshold");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            uint32_t pull_threshold = pio.settings.pull_threshold;
+        if (sm.clock == 0) {
+            uint32_t pull_threshold = sm.settings.pull_threshold;
             if (ImGui::InputScalar("##pull_threshold", ImGuiDataType_U32, &pull_threshold)) {
-                pio.settings.pull_threshold = pull_threshold;
+                sm.settings.pull_threshold = pull_threshold;
             }
         }
         else {
-            ImGui::Text("%u", pio.settings.pull_threshold);
+            ImGui::Text("%u", sm.settings.pull_threshold);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("FIFO Level N");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            int fifo_level_N = pio.settings.fifo_level_N;
+        if (sm.clock == 0) {
+            int fifo_level_N = sm.settings.fifo_level_N;
             if (ImGui::InputInt("##fifo_level_N", &fifo_level_N)) {
-                pio.settings.fifo_level_N = fifo_level_N;
+                sm.settings.fifo_level_N = fifo_level_N;
             }
         }
         else {
-            ImGui::Text("%d", pio.settings.fifo_level_N);
+            ImGui::Text("%d", sm.settings.fifo_level_N);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Wrap Start");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            uint32_t wrap_start = pio.settings.wrap_start;
+        if (sm.clock == 0) {
+            uint32_t wrap_start = sm.settings.wrap_start;
             if (ImGui::InputScalar("##wrap_start", ImGuiDataType_U32, &wrap_start)) {
-                pio.settings.wrap_start = wrap_start;
+                sm.settings.wrap_start = wrap_start;
             }
         }
         else {
-            ImGui::Text("%u", pio.settings.wrap_start);
+            ImGui::Text("%u", sm.settings.wrap_start);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Wrap End");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            uint32_t wrap_end = pio.settings.wrap_end;
+        if (sm.clock == 0) {
+            uint32_t wrap_end = sm.settings.wrap_end;
             if (ImGui::InputScalar("##wrap_end", ImGuiDataType_U32, &wrap_end)) {
-                pio.settings.wrap_end = wrap_end;
+                sm.settings.wrap_end = wrap_end;
             }
         }
         else {
-            ImGui::Text("%u", pio.settings.wrap_end);
+            ImGui::Text("%u", sm.settings.wrap_end);
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("In Shift Right");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool in_shift_right = pio.settings.in_shift_right;
+        if (sm.clock == 0) {
+            bool in_shift_right = sm.settings.in_shift_right;
             if (ImGui::Checkbox("##in_shift_right", &in_shift_right)) {
-                pio.settings.in_shift_right = in_shift_right;
+                sm.settings.in_shift_right = in_shift_right;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.in_shift_right ? "true" : "false");
+            ImGui::Text("%s", sm.settings.in_shift_right ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Out Shift Right");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool out_shift_right = pio.settings.out_shift_right;
+        if (sm.clock == 0) {
+            bool out_shift_right = sm.settings.out_shift_right;
             if (ImGui::Checkbox("##out_shift_right", &out_shift_right)) {
-                pio.settings.out_shift_right = out_shift_right;
+                sm.settings.out_shift_right = out_shift_right;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.out_shift_right ? "true" : "false");
+            ImGui::Text("%s", sm.settings.out_shift_right ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("In Shift Autopush");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool in_shift_autopush = pio.settings.in_shift_autopush;
+        if (sm.clock == 0) {
+            bool in_shift_autopush = sm.settings.in_shift_autopush;
             if (ImGui::Checkbox("##in_shift_autopush", &in_shift_autopush)) {
-                pio.settings.in_shift_autopush = in_shift_autopush;
+                sm.settings.in_shift_autopush = in_shift_autopush;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.in_shift_autopush ? "true" : "false");
+            ImGui::Text("%s", sm.settings.in_shift_autopush ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Out Shift Autopull");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool out_shift_autopull = pio.settings.out_shift_autopull;
+        if (sm.clock == 0) {
+            bool out_shift_autopull = sm.settings.out_shift_autopull;
             if (ImGui::Checkbox("##out_shift_autopull", &out_shift_autopull)) {
-                pio.settings.out_shift_autopull = out_shift_autopull;
+                sm.settings.out_shift_autopull = out_shift_autopull;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.out_shift_autopull ? "true" : "false");
+            ImGui::Text("%s", sm.settings.out_shift_autopull ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Autopull Enable");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool autopull_enable = pio.settings.autopull_enable;
+        if (sm.clock == 0) {
+            bool autopull_enable = sm.settings.autopull_enable;
             if (ImGui::Checkbox("##autopull_enable", &autopull_enable)) {
-                pio.settings.autopull_enable = autopull_enable;
+                sm.settings.autopull_enable = autopull_enable;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.autopull_enable ? "true" : "false");
+            ImGui::Text("%s", sm.settings.autopull_enable ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Autopush Enable");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool autopush_enable = pio.settings.autopush_enable;
+        if (sm.clock == 0) {
+            bool autopush_enable = sm.settings.autopush_enable;
             if (ImGui::InputScalar("##autopush_enable", ImGuiDataType_U32, &autopush_enable)) {
-                pio.settings.autopush_enable = autopush_enable;
+                sm.settings.autopush_enable = autopush_enable;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.autopush_enable ? "true" : "false");
+            ImGui::Text("%s", sm.settings.autopush_enable ? "true" : "false");
         }
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Status Sel");
         ImGui::TableSetColumnIndex(1);
-        if (pio.clock == 0) {
-            bool status_sel = pio.settings.status_sel;
+        if (sm.clock == 0) {
+            bool status_sel = sm.settings.status_sel;
             if (ImGui::Checkbox("##status_sel", &status_sel)) {
-                pio.settings.status_sel = status_sel;
+                sm.settings.status_sel = status_sel;
+            }
+        }
+        else {
+            ImGui::Text("%s", sm.settings.status_sel ? "true" : "false");
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Clkdiv Int");
+        ImGui::TableSetColumnIndex(1);
+        if (sm.clock == 0) {
+            uint32_t clkdiv_int = sm.settings.clkdiv_int;
+            if (ImGui::InputScalar("##clkdiv_int", ImGuiDataType_U32, &clkdiv_int)) {
+                sm.settings.clkdiv_int = clkdiv_int;
+            }
+        }
+        else {
+            ImGui::Text("%u", sm.settings.clkdiv_int);
+        }
+
+        ImGui::TableNextRow();
+        ImGui::TableSetColumnIndex(0);
+        ImGui::Text("Clkdiv Frac");
+        ImGui::TableSetColumnIndex(1);
+        if (sm.clock == 0) {
+            uint32_t clkdiv_frac = sm.settings.clkdiv_frac;
+            if (ImGui::InputScalar("##clkdiv_frac", ImGuiDataType_U32, &clkdiv_frac)) {
+                sm.settings.clkdiv_frac = clkdiv_frac & 0xff;
             }
         }
         else {
-            ImGui::Text("%s", pio.settings.status_sel ? "true" : "false");
+            ImGui::Text("%u", sm.settings.clkdiv_frac);
         }
 
         ImGui::EndTable();
     }
 
+    ImGui::EndDisabled();
     ImGui::End();
 }
 
@@ -701,25 +890,43 @@ void PioStateMachineApp::renderProgramWindow() {
 
     ImGui::Text("Instruction Memory");
     ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "Instructions are editable only when clock is 0");
+
+    // Per-line cycle counts: executing, delay and stalls by cause
+    ImGui::BeginDisabled(worker.busy());
+    bool profiling = pio.profiler != nullptr;
+    if (ImGui::Checkbox("Profile", &profiling)) {
+        pio.profiler = profiling ? &profiler : nullptr;
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Reset Profile")) {
+        profiler.reset();
+    }
+    ImGui::EndDisabled();
     ImGui::Separator();
 
-    if (ImGui::BeginTable("InstructionTable", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
+    PioStateMachine& sm = view();
+    const bool editable = sm.clock == 0 && !worker.busy();
+    const PioProfiler& profile = worker.latest().profile;
+    const uint64_t profile_total = profile.total();
+
+    if (ImGui::BeginTable("InstructionTable", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
         ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed);
         ImGui::TableSetupColumn("Instruction");
         ImGui::TableSetupColumn("Text");
         ImGui::TableSetupColumn("BP", ImGuiTableColumnFlags_WidthFixed);
         ImGui::TableSetupColumn("Current");
+        ImGui::TableSetupColumn("Cycles");
         ImGui::TableHeadersRow();
 
         // Estimate the current instruction's address (typically pc - 1, unless jumped)
         int current_addr = -1;
-        if (pio.regs.pc > 0 && pio.instructionMemory[pio.regs.pc - 1] == pio.currentInstruction && !pio.exec_command) {
-            current_addr = pio.regs.pc - 1;
+        if (sm.regs.pc > 0 && sm.instructionMemory[sm.regs.pc - 1] == sm.currentInstruction && !sm.exec_command) {
+            current_addr = sm.regs.pc - 1;
         }
         else {
             // Fallback: search for the current instruction in memory
             for (int i = 0; i < 32; ++i) {
-                if (pio.instructionMemory[i] == pio.currentInstruction) {
+                if (sm.instructionMemory[i] == sm.currentInstruction) {
                     current_addr = i;
                     break;
                 }
@@ -735,10 +942,10 @@ void PioStateMachineApp::renderProgramWindow() {
             ImGui::Text("%d", i);
             ImGui::TableSetColumnIndex(1);
             ImGui::PushID(i);
-            uint16_t instr = pio.instructionMemory[i];
-            if (pio.clock == 0) {
+            uint16_t instr = sm.instructionMemory[i];
+            if (editable) {
                 if (ImGui::InputScalar("##instr", ImGuiDataType_U16, &instr, nullptr, nullptr, "%04X", ImGuiInputTextFlags_CharsHexadecimal)) {
-                    pio.instructionMemory[i] = instr;
+                    sm.instructionMemory[i] = instr;
                 }
             }
             else {
@@ -746,26 +953,34 @@ void PioStateMachineApp::renderProgramWindow() {
             }
             ImGui::PopID();
             ImGui::TableSetColumnIndex(2);
-            ImGui::Text("%s", pio.instruction_text[i].c_str());
+            ImGui::Text("%s", sm.instruction_text[i].c_str());
             ImGui::TableSetColumnIndex(3);
             ImGui::PushID(i + 32);
-            bool is_bp = breakpoints.count(i);
+            bool is_bp = breakpoints.hasPc(i);
             if (ImGui::Checkbox("##bp", &is_bp)) {
-                if (is_bp) {
-                    breakpoints.insert(i);
-                }
-                else {
-                    breakpoints.erase(i);
-                }
+                breakpoints.setPc(i, is_bp);
             }
             ImGui::PopID();
             ImGui::TableSetColumnIndex(4);
             if (i == current_addr) {
                 ImGui::Text("<-- Current");
             }
-            else if (i == pio.regs.pc) {
+            else if (i == sm.regs.pc) {
                 ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "<-- Next");
             }
+            ImGui::TableSetColumnIndex(5);
+            uint64_t line_total = profile.total(i);
+            if (line_total > 0) {
+                ImGui::Text("%llu (%.1f%%)", static_cast<unsigned long long>(line_total), 100.0 * line_total / profile_total);
+                if (ImGui::IsItemHovered()) {
+                    ImGui::BeginTooltip();
+                    for (int counter = 0; counter < PioProfiler::kCounters; counter++) {
+                        ImGui::Text("%-10s %llu", PioProfiler::counterName(static_cast<PioProfiler::Counter>(counter)),
+                            static_cast<unsigned long long>(profile.cycles[i][counter]));
+                    }
+                    ImGui::EndTooltip();
+                }
+            }
         }
 
         ImGui::EndTable();
@@ -783,6 +998,8 @@ void PioStateMachineApp::renderRuntimeWindow() {
     ImGui::Text("Runtime Flags and State");
     ImGui::Separator();
 
+    const PioStateMachine& sm = view();
+
     if (ImGui::BeginTable("RuntimeTable", 2, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingStretchProp)) {
         ImGui::TableSetupColumn("Property", ImGuiTableColumnFlags_WidthFixed);
         ImGui::TableSetupColumn("Value");
@@ -792,55 +1009,55 @@ void PioStateMachineApp::renderRuntimeWindow() {
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Clock");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%d", pio.clock);
+        ImGui::Text("%d", sm.clock);
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Current Instruction");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("0x%04X", pio.currentInstruction);
+        ImGui::Text("0x%04X", sm.currentInstruction);
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("State Machine Number");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%u", pio.stateMachineNumber);
+        ImGui::Text("%u", sm.stateMachineNumber);
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Jmp To");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%d", pio.jmp_to);
+        ImGui::Text("%d", sm.jmp_to);
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Skip Increase PC");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%s", pio.skip_increase_pc ? "true" : "false");
+        ImGui::Text("%s", sm.skip_increase_pc ? "true" : "false");
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Delay Delay");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%s", pio.delay_delay ? "true" : "false");
+        ImGui::Text("%s", sm.delay_delay ? "true" : "false");
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Skip Delay");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%s", pio.skip_delay ? "true" : "false");
+        ImGui::Text("%s", sm.skip_delay ? "true" : "false");
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Exec Command");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%s", pio.exec_command ? "true" : "false");
+        ImGui::Text("%s", sm.exec_command ? "true" : "false");
 
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("Wait is Stalling");
         ImGui::TableSetColumnIndex(1);
-        ImGui::Text("%s", pio.wait_is_stalling ? "true" : "false");
+        ImGui::Text("%s", sm.wait_is_stalling ? "true" : "false");
 
         ImGui::EndTable();
     }
@@ -848,7 +1065,78 @@ void PioStateMachineApp::renderRuntimeWindow() {
     ImGui::End();
 }
 
+PioStateMachine& PioStateMachineApp::view() {
+    // The machine itself is only safe to read while the worker is not running a job
+    return worker.state() == PioWorker::State::Running ? shown : pio;
+}
+
+PioWorker::Job PioStateMachineApp::makeJob(uint64_t max_cycles) const {
+    PioWorker::Job job;
+    job.max_cycles = max_cycles;
+    job.breakpoints = breakpoints;
+    return job;
+}
+
+void PioStateMachineApp::startJob(const PioWorker::Job& job) {
+    shown = pio; // also carries what the snapshots leave out (instruction text, ...)
+    worker.start(job);
+}
+
+void PioStateMachineApp::renderWorkerStatus() {
+    static const char* state_names[] = { "Idle", "Running", "Paused" };
+    static const char* stop_names[] = { "-", "Completed", "Breakpoint", "Condition met", "Watchpoint", "Cancelled", "Clock limit" };
+
+    const PioWorker::Frame& frame = worker.latest();
+    const PioWorker::State state = worker.state();
+    ImGui::Text("Worker: %s", state_names[static_cast<int>(state)]);
+
+    if (state == PioWorker::State::Idle) {
+        if (frame.stop_reason != PioWorker::StopReason::None) {
+            ImGui::Text("Last run: %s after %llu cycles", stop_names[static_cast<int>(frame.stop_reason)],
+                static_cast<unsigned long long>(frame.job_cycles));
+            if (!frame.stop_detail.empty()) {
+                ImGui::Text("Stopped at: %s", frame.stop_detail.c_str());
+            }
+        }
+        return;
+    }
+
+    if (frame.target_cycles_per_second > 0) {
+        ImGui::Text("%.0f cycles/s (target %.0f)", frame.cycles_per_second, frame.target_cycles_per_second);
+    }
+    else {
+        ImGui::Text("%.0f cycles/s", frame.cycles_per_second);
+    }
+    if (frame.job_max_cycles != PioWorker::kForever) {
+        float progress = frame.job_max_cycles ? static_cast<float>(frame.job_cycles) / frame.job_max_cycles : 0.0f;
+        ImGui::ProgressBar(progress, ImVec2(-1, 0));
+    }
+    else {
+        ImGui::Text("%llu cycles", static_cast<unsigned long long>(frame.job_cycles));
+    }
+    if (state == PioWorker::State::Running) {
+        if (ImGui::Button("Pause")) {
+            worker.pause();
+        }
+    }
+    else if (ImGui::Button("Resume")) {
+        worker.resume();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Cancel")) {
+        worker.cancel();
+    }
+}
+
 void PioStateMachineApp::renderUI() {
+    // Running: show the worker's newest frame. Otherwise the machine is ours, keep the frames in step with it
+    if (worker.state() == PioWorker::State::Running) {
+        worker.latest().machine.restore(shown);
+    }
+    else {
+        worker.publishNow();
+    }
+
     renderControlWindow();
     renderVariableWindow();
     renderSettingsWindow();
@@ -862,25 +1150,6 @@ void PioStateMachineApp::renderUI() {
 }
 
 
-void PioStateMachineApp::updateTimingData() {
-    current_cycle += 1;  // Integer increment
-
-    timing_timestamps.push_back(current_cycle);
-
-    // Record data for all pins as 0 or 1 integers
-    for (int pin = 0; pin < 32; pin++) {
-        timing_values[pin].push_back(pio.gpio.raw_data[pin] ? 1 : 0);  // Pure integers
-    }
-
-    // Keep buffer size manageable
-    if (timing_timestamps.size() > MAX_TIMING_SAMPLES) {
-        timing_timestamps.erase(timing_timestamps.begin());
-        for (int pin = 0; pin < 32; pin++) {
-            timing_values[pin].erase(timing_values[pin].begin());
-        }
-    }
-}
-
 void PioStateMachineApp::renderTimingWindow() {
     if (!ImGui::Begin("Timing Diagram", &show_timing_window)) {
         ImGui::End();
@@ -921,7 +1190,7 @@ void PioStateMachineApp::renderTimingWindow() {
         for (int slot = 0; slot < 5; slot++) {
             ImGui::TableSetColumnIndex(slot);
             if (selected_pin_list[slot] >= 0 && selected_pin_list[slot] < 32) {
-                ImGui::Text("Current: %d", pio.gpio.raw_data[selected_pin_list[slot]]);
+                ImGui::Text("Current: %d", view().gpio.raw_data[selected_pin_list[slot]]);
             }
             else {
                 ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "(-1 = disabled)");
@@ -951,18 +1220,19 @@ void PioStateMachineApp::renderTimingWindow() {
         }
     }
     ImGui::SameLine();
+    ImGui::BeginDisabled(worker.state() == PioWorker::State::Running);
     if (ImGui::Button("Clear History")) {
-        timing_timestamps.clear();
-        for (auto& pin_data : timing_values) {
-            pin_data.clear();
-        }
-        current_cycle = 0;
+        worker.clearPinHistory();
     }
+    ImGui::EndDisabled();
+
+    // Pin samples recorded by the worker (and by Tick Once) since the last clear, just the extent here
+    PioWaveform::View capture = worker.waveform(0, 0, 0);
 
     // Plot with proper vertical separation
-    if (timing_timestamps.size() > 1 && selected_count > 0 && ImPlot::BeginPlot("##Timing", ImVec2(-1, 400))) {
+    if (capture.end_clock > capture.first_clock + 1 && selected_count > 0 && ImPlot::BeginPlot("##Timing", ImVec2(-1, 400))) {
         ImPlot::SetupAxes("Clock Cycles", "Channels");
-        ImPlot::SetupAxisLimits(ImAxis_X1, 0, current_cycle + 1);
+        ImPlot::SetupAxisLimits(ImAxis_X1, static_cast<double>(capture.first_clock), static_cast<double>(capture.end_clock));
         ImPlot::SetupAxisLimits(ImAxis_Y1, -1, selected_count * 2, ImPlotCond_Always);
 
         ImPlot::SetupAxisFormat(ImAxis_X1, "%.0f");
@@ -1001,23 +1271,49 @@ void PioStateMachineApp::renderTimingWindow() {
             ImVec4(1.0f, 0.0f, 1.0f, 1.0f)   // Magenta
         };
 
+        // Only the visible clocks, at most one bucket per pixel column: the cost doesn't grow with the capture
+        ImPlotRect limits = ImPlot::GetPlotLimits();
+        PioWaveform::View waveform = worker.waveform(static_cast<int64_t>(limits.X.Min), static_cast<int64_t>(limits.X.Max) + 1,
+            static_cast<size_t>(std::max(1.0f, ImPlot::GetPlotSize().x)));
+
+        std::vector<double> double_timestamps;
+        for (const auto& bucket : waveform.buckets) {
+            double_timestamps.push_back(static_cast<double>(bucket.clock));
+        }
+        if (!waveform.buckets.empty()) {
+            // The last bucket lasts until the end of the capture (or of the view)
+            double_timestamps.push_back(std::max(static_cast<double>(waveform.end), double_timestamps.back()));
+        }
+
         plot_index = 0;
         for (int slot = 0; slot < 5; slot++) {
             int pin = selected_pin_list[slot];
-            if (pin >= 0 && pin < 32 && pin < timing_values.size() && !timing_values[pin].empty()) {
-                // Convert to double with proper channel separation
-                std::vector<double> double_timestamps(timing_timestamps.begin(), timing_timestamps.end());
-                std::vector<double> offset_values;
-                for (int val : timing_values[pin]) {
-                    offset_values.push_back(static_cast<double>(val + plot_index * 2));
+            if (pin >= 0 && pin < 32) {
+                // Convert to double with proper channel separation. A bucket where the pin toggled has
+                // different high and low values, drawn as two lines: the pin's activity band
+                std::vector<double> high_values, low_values;
+                uint64_t edges = 0;
+                for (const auto& bucket : waveform.buckets) {
+                    high_values.push_back(static_cast<double>(((bucket.max >> pin) & 1) + plot_index * 2));
+                    low_values.push_back(static_cast<double>(((bucket.min >> pin) & 1) + plot_index * 2));
+                    edges += bucket.edges[pin];
+                }
+                if (!high_values.empty()) {
+                    high_values.push_back(high_values.back());
+                    low_values.push_back(low_values.back());
                 }
 
-                std::string label = "GPIO " + std::to_string(pin);
+                std::string label = "GPIO " + std::to_string(pin) + " (" + std::to_string(edges) + " edges)###GPIO" + std::to_string(pin);
+                ImPlot::SetNextLineStyle(colors[plot_index % 5], 2.0f);
+                ImPlot::PlotStairs(label.c_str(),
+                    double_timestamps.data(),
+                    high_values.data(),
+                    static_cast<int>(high_values.size()));
                 ImPlot::SetNextLineStyle(colors[plot_index % 5], 2.0f);
                 ImPlot::PlotStairs(label.c_str(),
                     double_timestamps.data(),
-                    offset_values.data(),
-                    static_cast<int>(timing_timestamps.size()));
+                    low_values.data(),
+                    static_cast<int>(low_values.size()));
                 plot_index++;
             }
         }
@@ -1,15 +1,18 @@
 #pragma once
 #include "../PioStateMachine.h"
+#include "../PioBreakpoints.h"
+#include "../PioWorker.h"
 #include "imgui.h"
 #include "implot.h"
 #include <string>
-#include <set>
 #include <vector>
 #include <deque>
 
 class PioStateMachineApp {
 private:
     PioStateMachine pio;
+    PioWorker worker{ pio };  // runs the multi-cycle jobs, declared after pio
+    PioStateMachine shown;    // copy the windows show while a job is running
     std::string ini_filepath;
     bool show_control_window = true;
     bool show_variable_window = true;
@@ -18,25 +21,28 @@ private:
     bool show_settings_window = true;
     bool done = false;
     int tick_steps = 1;
-    std::set<int> breakpoints;
+    PioBreakpoints breakpoints;  // copied into every worker job
+    std::vector<PioExpression> watches; // Variables window, Watch tab
+    PioProfiler profiler;        // attached to pio while profiling is on
+    PioFifoStats fifo_stats;     // attached to pio while FIFO statistics are on
 
     // timing diagram
     bool show_timing_window = true;
     bool selected_pins[32] = { false };
-    std::vector<int> timing_timestamps;
-    std::vector<std::vector<int>> timing_values{ 32 };
-    int current_cycle = 0;
-    static const size_t MAX_TIMING_SAMPLES = 1000;
 
     // UI rendering methods for each window
     void renderControlWindow();
     void renderVariableWindow();
+    void renderWatchTab(const PioStateMachine& sm);
     void renderProgramWindow();
     void renderRuntimeWindow();
     void renderSettingsWindow();
     void renderTimingWindow();
+    void renderWorkerStatus();
 
-    void updateTimingData();
+    PioStateMachine& view();  // pio, or the latest worker frame while a job is running
+    PioWorker::Job makeJob(uint64_t max_cycles) const;
+    void startJob(const PioWorker::Job& job);
 public:
     PioStateMachineApp(const std::string& filepath = "");
     void initialize();
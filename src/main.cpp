@@ -1,121 +1,147 @@
+// pio_emu_cli: headless runner, see PioRunner.h and printUsage()
 #include <fmt/format.h>
-#include <cstdint>
-#include <cassert>
+#include <algorithm>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "PioRunner.h"
 #include "PioStateMachine.h"
 
-inline void varialbeAccessTest(PioStateMachine& pio)
+static void listVars()
 {
-    fmt::println("before: {}", pio.get_var("pc"));
-    pio.set_var("pc", 69);
-    fmt::println("after: {}", pio.get_var("pc"));
+    PioStateMachine pio;
+    auto setters = pio.get_available_set_vars();
+    auto getters = pio.get_available_get_vars();
+    std::sort(setters.begin(), setters.end());
+    std::sort(getters.begin(), getters.end());
 
-    fmt::println("before: {}", static_cast<int8_t>(pio.get_var("gpio22")));
-    pio.set_var("gpio22", 1);
-    fmt::println("after: {}", static_cast<int8_t>(pio.get_var("gpio22")));
-    pio.set_var("gpio22", 0);
-    fmt::println("after: {}", static_cast<int8_t>(pio.get_var("gpio22")));
-
-    fmt::println("before: {}", (int8_t)pio.get_var("tx_fifo0"));
-    pio.set_var("tx_fifo0", 1);
-    fmt::println("after: {}", pio.get_var("tx_fifo0"));
-    pio.set_var("tx_fifo0", 0);
-    fmt::println("after: {}", pio.get_var("tx_fifo0"));
-
-    fmt::println("before: {}", static_cast<bool>(pio.get_var("irq1")));
-    pio.set_var("irq1", true);
-    fmt::println("after: {}", static_cast<bool>(pio.get_var("irq1")));
-    pio.set_var("irq1", false);
-    fmt::println("after: {}", static_cast<bool>(pio.get_var("irq1")));
-
-    pio.set_var("pc", 0);
-    pio.run_until_var("pc", 3);
-    fmt::println("pc: {} clock: {}", pio.regs.pc, pio.clock);
+    fmt::println("-----setters:");
+    for (const auto& name : setters)
+        fmt::println("{}", name);
+    fmt::println("-----getters:");
+    for (const auto& name : getters)
+        fmt::println("{}", name);
 }
 
-inline void ws2812_test(PioStateMachine& pio)
+static void setupLog(const std::string& log_file)
 {
-    static const uint16_t ws2812_program_instructions[] = {
-        //     .wrap_target
-        0x6321, //  0: out    x, 1    side 0 [3] ; Side-set still takes place when instruction stalls
-        0x1223, //  1: jmp    !x, 3   side 1 [2] ; Branch on the bit we shifted out. Positive pulse
-        0x1200, //  2: jmp    0       side 1 [2] ; Continue driving high, for a long pulse
-        0xa242, //  3: nop            side 0 [2] ; Or drive low, for a short pulse
-        //     .wrap
-    };
-
-    // Put in instructions 
-    for (size_t i = 0; i < _countof(ws2812_program_instructions); i++)
-        pio.instructionMemory[i] = ws2812_program_instructions[i];
-
-    // settings
-    pio.settings.sideset_opt = false;    // side-set bit is mandatory 
-    pio.settings.sideset_count = 1;      // 1bit side-set, 4bit delay
-    pio.settings.sideset_base = 22;      // gpio pin 22
-    pio.settings.pull_threshold = 24;    // 24bit gbr data
-    pio.settings.out_shift_right = false;// shift left
-    pio.settings.autopull_enable = true; // we need auto pull
-    pio.settings.wrap_start = 0;
-    pio.settings.wrap_end = 3;
-
-    pio.gpio.pindirs[22] = 0;   // pin22 pindir to output
+    logger.enableConsoleOutput(false); // stdout is for the summary
+    if (!log_file.empty())
+        logger.setLogFile(log_file);
+}
 
-    // data
-    pio.fifo.tx_fifo[0] = 0xba'ab'ff'00;
-    pio.fifo.tx_fifo[1] = 0xff'12'ff'00;
-    pio.fifo.tx_fifo_count = 2;
+static int runBatch(const std::vector<std::string>& args)
+{
+    std::string jobs_file;
+    unsigned threads = 0;
+    std::string log_file;
+    for (size_t i = 0; i < args.size(); i++)
+    {
+        if (i + 1 >= args.size())
+        {
+            PioRunner::printUsage();
+            return 2;
+        }
+        const std::string& value = args[++i];
+        if (args[i - 1] == "--batch")
+            jobs_file = value;
+        else if (args[i - 1] == "-j")
+            threads = static_cast<unsigned>(std::stoul(value));
+        else if (args[i - 1] == "--log")
+            log_file = value;
+        else
+        {
+            PioRunner::printUsage();
+            return 2;
+        }
+    }
 
-    for (size_t i = 0; i < 24; i++)
-        fmt::print("{:<2}: {:#010x}\n\n", i, pio.fifo.tx_fifo[0] << i);
+    std::ifstream file(jobs_file);
+    if (!file)
+    {
+        fmt::println(stderr, "Cannot open file: {}", jobs_file);
+        return 2;
+    }
+    setupLog(log_file);
 
-    // tick
-    for (int i = 0; i < 245 * 2; ++i)
+    // A line that doesn't parse still gets its result line, so the output lines up with the jobs
+    std::vector<PioRunner::Options> jobs;
+    std::vector<std::pair<size_t, std::string>> bad_lines; // job index, error
+    std::string line;
+    for (int line_number = 1; std::getline(file, line); line_number++)
     {
-        pio.tick(); // Update the emulator
-        //fmt::print("{}", pio.gpio.raw_data[22] ? '-' : '_');
-        fmt::print("clock: {:<3}, pin22: {}, pc: {}, osr: {:#010x} osr_count: {:<2}\n", pio.clock, pio.gpio.raw_data[22], pio.regs.pc, pio.regs.osr, pio.regs.osr_shift_count);
-        if (!((pio.clock - 5) % 10))
+        size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        try
+        {
+            jobs.push_back(PioRunner::parseArgs(PioRunner::splitLine(line)));
+        }
+        catch (const std::exception& e)
         {
-            static int ist = 1;
-            fmt::println("data: {:<2}\n", ist++);
+            bad_lines.emplace_back(jobs.size(), fmt::format("{}:{}: {}", jobs_file, line_number, e.what()));
+            jobs.emplace_back(); // empty program, not run
         }
     }
-}
-
-void testIniParse(PioStateMachine& pio)
-{
 
-    
-}
+    std::vector<PioRunner::Options> runnable;
+    std::vector<size_t> job_of;
+    for (size_t job = 0; job < jobs.size(); job++)
+    {
+        if (!jobs[job].program.empty())
+        {
+            runnable.push_back(jobs[job]);
+            job_of.push_back(job);
+        }
+    }
+    std::vector<PioRunner::Result> ran = PioRunner::runBatch(runnable, threads);
 
-void getVar(PioStateMachine& pio)
-{
-    fmt::println("-----setters:");
-    auto keys = pio.get_available_set_vars();
-    for (const auto& i : keys)
-        fmt::println("{}", i);
-    fmt::println("-----getters:");
-    keys = pio.get_available_get_vars();
-    for (const auto& i : keys)
-        fmt::println("{}", i);
+    std::vector<PioRunner::Result> results(jobs.size());
+    for (size_t i = 0; i < ran.size(); i++)
+        results[job_of[i]] = std::move(ran[i]);
+    for (const auto& [job, error] : bad_lines)
+        results[job].detail = error;
 
+    int exit_code = 0;
+    for (const PioRunner::Result& result : results)
+    {
+        fmt::println("{}", result.toJson());
+        exit_code = std::max(exit_code, result.exitCode());
+    }
+    return exit_code;
 }
 
 int main(int argc, char* argv[])
 {
+    if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        PioRunner::printUsage();
+        return 2;
+    }
+    std::vector<std::string> args(argv + 1, argv + argc);
+
     try
     {
-        std::string filepath(argv[1]);
-        fmt::println("{}", filepath);
-        if (argc < 2)
-            LOG_FATAL("No config provided, using default config");
+        if (std::find(args.begin(), args.end(), "--batch") != args.end())
+            return runBatch(args);
 
-        PioStateMachine pio(filepath);
-        getVar(pio);
-        return 0;
+        PioRunner::Options options = PioRunner::parseArgs(args);
+        if (options.list_vars)
+        {
+            listVars();
+            return 0;
+        }
+
+        setupLog(options.log_file);
+        PioRunner::Result result = PioRunner::run(options);
+        fmt::println("{}", options.json ? result.toJson() : result.toText());
+        return result.exitCode();
     }
     catch (const std::exception& e)
     {
         fmt::println(stderr, "{}", e.what());
+        PioRunner::printUsage();
+        return 2;
     }
-    
-}
\ No newline at end of file
+}
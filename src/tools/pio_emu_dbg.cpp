@@ -0,0 +1,145 @@
+// pio_emu_dbg: terminal debugger over the core, see PioDebugger.h for the commands. Runs happen on
+// the debugger's worker thread, Ctrl-C stops them and returns to the prompt.
+#include <fmt/format.h>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../PioDebugger.h"
+#include "../PioProgram.h"
+#include "../PioStateMachine.h"
+
+static std::atomic<bool> g_interrupted{ false };
+
+static void onInterrupt(int)
+{
+    g_interrupted = true;
+    std::signal(SIGINT, onInterrupt); // some platforms reset the handler
+}
+
+static void usage()
+{
+    fmt::println(stderr, "usage: pio_emu_dbg <program> [--set key=value]... [-x commands] [--log file]");
+    fmt::println(stderr, "  program: .ini, pioasm .h or .pio (see PioProgram.h)");
+    fmt::println(stderr, "  -x: run the commands in a file first, then read more from stdin");
+    fmt::println(stderr, "  type help at the prompt for the commands, Ctrl-C stops a run");
+}
+
+// One command, waiting out a run it starts; false after quit
+static bool runCommand(PioDebugger& debugger, const std::string& line)
+{
+    std::string out;
+    g_interrupted = false;
+    bool more = debugger.execute(line, out);
+    fmt::print("{}", out);
+    std::fflush(stdout);
+
+    if (debugger.running())
+    {
+        while (!debugger.waitFor(std::chrono::milliseconds(20)))
+        {
+            if (g_interrupted.exchange(false))
+                debugger.interrupt();
+        }
+        out.clear();
+        debugger.finish(out);
+        fmt::print("{}", out);
+    }
+    return more;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        usage();
+        return 2;
+    }
+
+    std::vector<std::pair<std::string, std::string>> settings;
+    std::string commands_file;
+    std::string log_file;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage();
+            return 2;
+        }
+        std::string value = argv[++i];
+        size_t equals = value.find('=');
+        if (arg == "--set" && equals != std::string::npos)
+            settings.emplace_back(value.substr(0, equals), value.substr(equals + 1));
+        else if (arg == "-x")
+            commands_file = value;
+        else if (arg == "--log")
+            log_file = value;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+
+    logger.enableConsoleOutput(false); // the terminal is the debugger's
+    if (!log_file.empty())
+        logger.setLogFile(log_file);
+
+    PioStateMachine pio;
+    try
+    {
+        PioProgram::load(pio, argv[1]);
+        for (const auto& [key, value] : settings)
+        {
+            if (!pio.applySetting(key, value))
+                throw std::runtime_error("unknown setting: " + key);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "{}", e.what());
+        return 2;
+    }
+
+    PioDebugger debugger(pio);
+    std::signal(SIGINT, onInterrupt);
+
+    std::string line;
+    if (!commands_file.empty())
+    {
+        std::ifstream file(commands_file);
+        if (!file)
+        {
+            fmt::println(stderr, "Cannot open file: {}", commands_file);
+            return 2;
+        }
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue; // an empty line would repeat the last run
+            fmt::println("(pio) {}", line);
+            if (!runCommand(debugger, line))
+                return 0;
+        }
+    }
+
+    std::string out;
+    debugger.execute("info", out);
+    fmt::print("{}", out);
+    while (true)
+    {
+        fmt::print("(pio) ");
+        std::fflush(stdout);
+        if (!std::getline(std::cin, line))
+            break; // Ctrl-D
+        if (!runCommand(debugger, line))
+            break;
+    }
+    return 0;
+}
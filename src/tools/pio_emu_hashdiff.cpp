@@ -0,0 +1,51 @@
+// pio_emu_hashdiff: compare two state hash files (PioStateHash::save) and name the first interval
+// where the runs part, the one to re-run with full tracing
+#include <fmt/format.h>
+#include <algorithm>
+#include <exception>
+#include <string>
+#include "../PioStateHash.h"
+
+static void usage()
+{
+    fmt::println(stderr, "usage: pio_emu_hashdiff <a.hash> <b.hash>");
+    fmt::println(stderr, "  exit status 0: identical over the common intervals, 1: they diverge, 2: error");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc != 3 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        PioStateHash a, b;
+        a.load(argv[1]);
+        b.load(argv[2]);
+        PioStateHash::Divergence divergence = PioStateHash::compare(a, b);
+        size_t common = std::min(a.marks.size(), b.marks.size());
+        if (!divergence.found)
+        {
+            fmt::println("identical over {} intervals of {} clocks", common, a.interval);
+            if (a.marks.size() != b.marks.size())
+                fmt::println("{} is longer ({} against {} intervals)", a.marks.size() > b.marks.size() ? argv[1] : argv[2],
+                    std::max(a.marks.size(), b.marks.size()), common);
+            return 0;
+        }
+
+        fmt::println("first divergence in interval {} of {}", divergence.index, common);
+        if (divergence.good_clock >= 0)
+            fmt::println("states agree at clock {} and differ at clock {}", divergence.good_clock, divergence.bad_clock);
+        else
+            fmt::println("states already differ at clock {}", divergence.bad_clock);
+        return 1;
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "{}", e.what());
+        return 2;
+    }
+}
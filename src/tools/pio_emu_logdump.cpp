@@ -0,0 +1,77 @@
+// pio_emu_logdump: turn a binary log (Logger::setBinaryLogFile) back into text or JSON lines
+#include <fmt/format.h>
+#include <fstream>
+#include <string>
+#include "../Logger/LogBinary.h"
+
+static void usage()
+{
+    fmt::println(stderr, "usage: pio_emu_logdump [--json] [-o output] <log.bin>");
+    fmt::println(stderr, "  --json      one JSON object per line instead of the text log layout");
+    fmt::println(stderr, "  -o output   write to a file instead of stdout");
+}
+
+int main(int argc, char* argv[])
+{
+    bool json = false;
+    std::string input, output;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--json")
+            json = true;
+        else if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg == "-h" || arg == "--help")
+        {
+            usage();
+            return 0;
+        }
+        else if (input.empty() && arg[0] != '-')
+            input = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (input.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    std::ifstream in(input, std::ios::binary);
+    if (!in.is_open())
+    {
+        fmt::println(stderr, "Cannot open file: {}", input);
+        return 1;
+    }
+
+    std::FILE* out = stdout;
+    if (!output.empty() && (out = std::fopen(output.c_str(), "w")) == nullptr)
+    {
+        fmt::println(stderr, "Cannot open file: {}", output);
+        return 1;
+    }
+
+    LogBinary::Reader reader(in);
+    LogBinary::Entry entry;
+    size_t count = 0;
+    while (reader.next(entry))
+    {
+        fmt::println(out, "{}", json ? LogBinary::toJson(entry) : LogBinary::toText(entry));
+        count++;
+    }
+
+    if (out != stdout)
+        std::fclose(out);
+
+    if (!reader.error().empty())
+    {
+        // A log cut short by a crash still decodes up to the damaged entry
+        fmt::println(stderr, "{}: {} (after {} entries)", input, reader.error(), count);
+        return 1;
+    }
+    return 0;
+}
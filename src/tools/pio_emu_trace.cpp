@@ -0,0 +1,124 @@
+// pio_emu_trace: look into a cycle trace (PioTrace::Writer) without loading it, seek to a clock
+// or list the cycles that match a query
+#include <fmt/format.h>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+#include "../PioTrace.h"
+
+static void usage()
+{
+    fmt::println(stderr, "usage: pio_emu_trace info <trace>");
+    fmt::println(stderr, "       pio_emu_trace dump <trace> [--from C] [--count N]");
+    fmt::println(stderr, "       pio_emu_trace find <trace> [conditions] [--from C] [--to C] [--limit N]");
+    fmt::println(stderr, "  conditions (all must hold): --pc N, --rise PIN, --fall PIN, --high PIN, --low PIN, --irq N");
+    fmt::println(stderr, "  exit status 0: ok (find: something matched), 1: nothing matched, 2: error");
+}
+
+static void printRecord(int64_t clock, const PioTrace::Record& record)
+{
+    fmt::println("{:>10}  pc {:2}  pins {:08x}  x {:08x}  y {:08x}  tx {}  rx {}  irq {:02x}{}{}", clock, record.pc, record.pins,
+        record.x, record.y, record.fifo >> 4, record.fifo & 15, record.irqs,
+        record.flags & PioTrace::kStalled ? "  stalled" : "", record.flags & PioTrace::kDelay ? "  delay" : "");
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || std::string(argv[1]) == "-h" || std::string(argv[1]) == "--help")
+    {
+        usage();
+        return 2;
+    }
+    std::string command = argv[1];
+    std::string input = argv[2];
+
+    PioTrace::Query query;
+    int64_t count = 20;
+    size_t limit = 100;
+    try
+    {
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (i + 1 >= argc)
+            {
+                usage();
+                return 2;
+            }
+            int64_t value = std::stoll(argv[++i], nullptr, 0);
+            if (arg == "--from")
+                query.from = value;
+            else if (arg == "--to")
+                query.to = value;
+            else if (arg == "--count")
+                count = value;
+            else if (arg == "--limit")
+                limit = static_cast<size_t>(value);
+            else if (arg == "--pc")
+                query.pc = static_cast<int>(value);
+            else if (arg == "--irq")
+                query.irq = static_cast<int>(value);
+            else if (value < 0 || value > 31)
+            {
+                fmt::println(stderr, "pin out of range: {}", value);
+                return 2;
+            }
+            else if (arg == "--rise")
+                query.rise |= 1u << value;
+            else if (arg == "--fall")
+                query.fall |= 1u << value;
+            else if (arg == "--high")
+                query.high |= 1u << value;
+            else if (arg == "--low")
+                query.low |= 1u << value;
+            else
+            {
+                usage();
+                return 2;
+            }
+        }
+    }
+    catch (const std::exception&)
+    {
+        usage();
+        return 2;
+    }
+
+    try
+    {
+        PioTrace::Reader reader(input);
+        if (command == "info")
+        {
+            fmt::println("{} records in {} chunks of up to {}", reader.recordCount(), reader.chunks().size(), reader.chunkRecords());
+            fmt::println("clocks {} to {}", reader.firstClock(), reader.endClock());
+            for (const PioTrace::ChunkInfo& chunk : reader.chunks())
+                fmt::println("  {:>10} +{:<8} pins touched {:08x}  pcs {:08x}  irqs {:02x}", chunk.first_clock, chunk.count,
+                    chunk.pins_touched, chunk.pcs, chunk.irqs);
+            return 0;
+        }
+        if (command == "dump")
+        {
+            for (int64_t clock = query.from; clock < query.from + count; clock++)
+            {
+                if (const PioTrace::Record* record = reader.at(clock))
+                    printRecord(clock, *record);
+            }
+            return 0;
+        }
+        if (command == "find")
+        {
+            std::vector<int64_t> clocks = reader.find(query, limit);
+            for (int64_t clock : clocks)
+                printRecord(clock, *reader.at(clock));
+            return clocks.empty() ? 1 : 0;
+        }
+        usage();
+        return 2;
+    }
+    catch (const std::exception& e)
+    {
+        fmt::println(stderr, "{}", e.what());
+        return 2;
+    }
+}
@@ -0,0 +1,94 @@
+// Micro-benchmarks for the PioBitOps kernels against the bit-by-bit loops they replaced.
+// Build in release mode, results are printed as ns per call.
+#include "../../src/PioBitOps.h"
+#include <fmt/core.h>
+#include <chrono>
+#include <vector>
+
+static volatile uint32_t sink; // keeps the results alive
+
+template <typename Fn>
+void bench(const char* name, Fn&& fn, int iterations = 10'000'000)
+{
+    uint32_t acc = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+        acc += fn(static_cast<uint32_t>(i) * 2654435761u);
+    auto end = std::chrono::steady_clock::now();
+    sink = acc;
+
+    double ns = std::chrono::duration<double, std::nano>(end - start).count() / iterations;
+    fmt::print("{:<32} {:8.3f} ns\n", name, ns);
+}
+
+int main()
+{
+    std::array<int8_t, 32> pins{};
+    for (int i = 0; i < 32; i++)
+        pins[i] = (i * 7 + 3) % 3 == 0;
+
+    fmt::print("bitops kernels{}{}\n",
+#ifdef PIO_BITOPS_HAS_BMI2
+        " [bmi2]",
+#else
+        " [portable]",
+#endif
+#ifdef PIO_BITOPS_HAS_BITREVERSE
+        " [builtin bitreverse]"
+#else
+        " [lut bitreverse]"
+#endif
+    );
+
+    bench("bit reverse (loop)", [](uint32_t v) {
+        uint32_t r = 0;
+        for (int i = 0; i < 32; i++)
+            r |= ((v >> i) & 1) << (31 - i);
+        return r;
+        });
+    bench("bit reverse (PioBitOps)", [](uint32_t v) { return PioBitOps::bitReverse(v); });
+
+    bench("in shift 1..32 (branchy)", [](uint32_t v) {
+        uint32_t count = (v & 31) + 1;
+        uint32_t mask = (1u << (count & 31)) - 1;
+        if (count == 32)
+            mask = 0xff'ff'ff'ff;
+        return ((count == 32) ? 0 : (v << count)) | (v & mask);
+        });
+    bench("in shift 1..32 (PioBitOps)", [](uint32_t v) { return PioBitOps::shiftIn(v, v, (v & 31) + 1, false); });
+
+    bench("gather 32 pins (loop)", [&](uint32_t v) {
+        uint32_t word = 0;
+        int base = v & 31;
+        for (int i = 0; i < 32; i++)
+            word |= (pins[(base + i) % 32] & 1u) << i;
+        return word;
+        });
+    bench("gather 32 pins (PioBitOps)", [&](uint32_t v) {
+        return std::rotr(PioBitOps::gatherPins(pins), static_cast<int>(v & 31));
+        });
+
+    bench("scatter 16 pins (loop)", [&](uint32_t v) {
+        int base = v & 31;
+        for (int i = 0; i < 16; i++)
+            pins[(base + i) % 32] = (v & (1u << i)) ? 1 : 0;
+        return static_cast<uint32_t>(pins[0]);
+        });
+    bench("scatter 16 pins (PioBitOps)", [&](uint32_t v) {
+        int base = v & 31;
+        PioBitOps::scatterPins(pins, std::rotl(PioBitOps::lowMask(16), base), std::rotl(v, base));
+        return static_cast<uint32_t>(pins[0]);
+        });
+
+    bench("scatter 32 pins (loop)", [&](uint32_t v) {
+        for (int i = 0; i < 32; i++)
+            pins[i] = (v & (1u << i)) ? 1 : 0;
+        return static_cast<uint32_t>(pins[0]);
+        });
+    bench("scatter 32 pins (PioBitOps)", [&](uint32_t v) {
+        PioBitOps::scatterPins(pins, 0xff'ff'ff'ff, v);
+        return static_cast<uint32_t>(pins[0]);
+        });
+
+    return 0;
+}
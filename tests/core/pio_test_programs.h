@@ -0,0 +1,41 @@
+#pragma once
+#include <cstdint>
+#include "../../src/PioStateMachine.h"
+
+// Programs shared by the core tests, written straight into instruction memory
+
+// gpio5 high for 8 clocks, then low until the x loop is done: 24 clocks a turn with x = 3,
+// 80 with x = 31
+inline void loadBlink(PioStateMachine& pio, int x = 3)
+{
+    pio.instructionMemory[0] = 0xe701; //  0: set    pins, 1 [7]
+    pio.instructionMemory[1] = 0xe300; //  1: set    pins, 0 [3]
+    pio.instructionMemory[2] = static_cast<uint16_t>(0xe020 | x); //  2: set    x, <x>
+    pio.instructionMemory[3] = 0x0143; //  3: jmp    x--, 3 [1]
+    pio.instructionMemory[4] = 0x0200; //  4: jmp    0 [2]
+    pio.settings.set_base = 5;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 4;
+    pio.gpio.pindirs[5] = 0;
+}
+
+// One instruction wrapping onto itself
+inline void loadSingle(PioStateMachine& pio, uint16_t instruction)
+{
+    pio.instructionMemory[0] = instruction;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 0;
+}
+
+// Autopull from an empty OSR inside a straight-line block
+inline void loadAutopull(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0x6020; // 0: out x, 32
+    pio.instructionMemory[1] = 0xa142; // 1: nop [1]
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 1;
+    pio.settings.autopull_enable = true;
+    pio.settings.pull_threshold = 32;
+    pio.regs.osr_shift_count = 32; // OSR empty
+}
@@ -0,0 +1,118 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "../../src/PioBitOps.h"
+
+// Bit-by-bit reference versions of the PioBitOps kernels
+uint32_t referenceReverse(uint32_t value)
+{
+    uint32_t reversed = 0;
+    for (int i = 0; i < 32; i++)
+        reversed |= ((value >> i) & 1) << (31 - i);
+    return reversed;
+}
+
+uint32_t nextValue(uint32_t& seed)
+{
+    // xorshift32, enough to cover the bit patterns
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+TEST_CASE("PioBitOps masks and shifts")
+{
+    SUBCASE("lowMask")
+    {
+        CHECK(PioBitOps::lowMask(0) == 0);
+        CHECK(PioBitOps::lowMask(1) == 1);
+        CHECK(PioBitOps::lowMask(5) == 0b11111);
+        CHECK(PioBitOps::lowMask(31) == 0x7f'ff'ff'ff);
+        CHECK(PioBitOps::lowMask(32) == 0xff'ff'ff'ff);
+        CHECK(PioBitOps::lowMask(40) == 0xff'ff'ff'ff);
+        static_assert(PioBitOps::lowMask(8) == 0xff);
+    }
+
+    SUBCASE("bitReverse")
+    {
+        static_assert(PioBitOps::bitReverse(1) == 0x80'00'00'00);
+        CHECK(PioBitOps::bitReverse(0x00'00'00'01) == 0x80'00'00'00);
+        CHECK(PioBitOps::bitReverse(0x12'34'56'78) == 0x1e'6a'2c'48);
+        uint32_t seed = 0x1234'5678;
+        for (int i = 0; i < 1000; i++)
+        {
+            uint32_t value = nextValue(seed);
+            CHECK(PioBitOps::bitReverse(value) == referenceReverse(value));
+        }
+    }
+
+    SUBCASE("shiftIn")
+    {
+        // left: new bits at the lsb end
+        CHECK(PioBitOps::shiftIn(0x0000'00ab, 0xff'ff'ff'0c, 4, false) == 0x0000'0abc);
+        // right: new bits at the msb end
+        CHECK(PioBitOps::shiftIn(0xab00'0000, 0xc, 4, true) == 0xca'b0'00'00);
+        // 32 bits replaces the register in both directions
+        CHECK(PioBitOps::shiftIn(0x1234'5678, 0xdead'beef, 32, false) == 0xdead'beef);
+        CHECK(PioBitOps::shiftIn(0x1234'5678, 0xdead'beef, 32, true) == 0xdead'beef);
+    }
+
+    SUBCASE("shiftOut")
+    {
+        uint32_t reg = 0xab'cd'ef'01;
+        CHECK(PioBitOps::shiftOut(reg, 8, false) == 0xab);
+        CHECK(reg == 0xcd'ef'01'00);
+
+        reg = 0xab'cd'ef'01;
+        CHECK(PioBitOps::shiftOut(reg, 8, true) == 0x01);
+        CHECK(reg == 0x00'ab'cd'ef);
+
+        reg = 0xab'cd'ef'01;
+        CHECK(PioBitOps::shiftOut(reg, 32, false) == 0xab'cd'ef'01);
+        CHECK(reg == 0);
+
+        reg = 0xab'cd'ef'01;
+        CHECK(PioBitOps::shiftOut(reg, 0, true) == 0);
+        CHECK(reg == 0xab'cd'ef'01);
+    }
+}
+
+TEST_CASE("PioBitOps pin gather and scatter")
+{
+    uint32_t seed = 0xcafe'f00d;
+
+    SUBCASE("gatherPins")
+    {
+        for (int round = 0; round < 200; round++)
+        {
+            std::array<int8_t, 32> pins;
+            uint32_t expected = nextValue(seed);
+            for (int i = 0; i < 32; i++)
+                pins[i] = (expected >> i) & 1;
+            CHECK(PioBitOps::gatherPins(pins) == expected);
+        }
+    }
+
+    SUBCASE("scatterPins leaves unmasked pins alone")
+    {
+        for (int round = 0; round < 200; round++)
+        {
+            std::array<int8_t, 32> pins;
+            pins.fill(-1);
+            uint32_t mask = nextValue(seed);
+            if (round % 2)
+                mask |= 0x00'ff'00'ff; // whole lanes take the single store path
+            uint32_t values = nextValue(seed);
+
+            PioBitOps::scatterPins(pins, mask, values);
+            for (int i = 0; i < 32; i++)
+            {
+                INFO("pin: ", i);
+                if ((mask >> i) & 1)
+                    CHECK(pins[i] == static_cast<int8_t>((values >> i) & 1));
+                else
+                    CHECK(pins[i] == -1);
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioBreakpoints.h"
+#include "pio_test_programs.h"
+
+// Clock of the next fetch from 'address', by plain ticking
+int nextFetch(PioStateMachine pio, int address)
+{
+    pio.tick(); // like a resumed run, never stops before the first cycle
+    while (pio.delay_delay || pio.regs.delay != 0 || pio.exec_command || pio.regs.pc != static_cast<uint32_t>(address))
+        pio.tick();
+    return pio.clock;
+}
+
+TEST_CASE("pc breakpoints stop before the fetch")
+{
+    PioStateMachine pio, reference;
+    loadBlink(pio);
+    loadBlink(reference);
+    PioBreakpoints breakpoints;
+    pio.breakpoints = &breakpoints;
+
+    SUBCASE("inside a straight-line block")
+    {
+        breakpoints.setPc(2);
+        CHECK(breakpoints.pcMask() == 0b100);
+
+        int expected = nextFetch(reference, 2);
+        int ran = pio.run(1000);
+        CHECK(ran == expected);
+        CHECK(pio.clock == expected);
+        CHECK(pio.regs.pc == 2);
+        CHECK(breakpoints.hit().kind == PioBreakpoints::Kind::Pc);
+        CHECK(breakpoints.hit().id == 2);
+        CHECK(breakpoints.describe(breakpoints.hit()) == "pc 2");
+
+        // Continuing runs the breakpoint's cycle and stops at the next fetch
+        while (reference.clock < pio.clock)
+            reference.tick();
+        expected = nextFetch(reference, 2);
+        pio.run(1000);
+        CHECK(pio.clock == expected);
+    }
+
+    SUBCASE("a loop is hit on every pass")
+    {
+        breakpoints.setPc(3);
+        pio.run(1000);
+        CHECK(pio.regs.x == 3);
+        pio.run(1000);
+        CHECK(pio.regs.x == 2);
+        int clock = pio.clock;
+        pio.run(1000);
+        CHECK(pio.clock == clock + 2); // jmp [1]
+    }
+
+    SUBCASE("unreached breakpoints don't change the result")
+    {
+        breakpoints.setPc(20);
+        CHECK(pio.run(5000) == 5000);
+        for (int i = 0; i < 5000; i++)
+            reference.tick();
+        CHECK(pio.regs == reference.regs);
+        CHECK(pio.gpio == reference.gpio);
+        CHECK(breakpoints.hit().kind == PioBreakpoints::Kind::None);
+    }
+
+    SUBCASE("removing breakpoints")
+    {
+        breakpoints.setPc(2);
+        breakpoints.setPc(2, false);
+        CHECK(breakpoints.empty());
+        CHECK(pio.run(100) == 100);
+    }
+}
+
+TEST_CASE("conditional breakpoints")
+{
+    PioStateMachine pio;
+    loadBlink(pio);
+    PioBreakpoints breakpoints;
+    pio.breakpoints = &breakpoints;
+
+    SUBCASE("comparisons and edges")
+    {
+        int id = breakpoints.addCondition(pio, "x == 0 && gpio5 rising");
+        CHECK(breakpoints.needsEveryCycle());
+
+        // By plain ticking: x reaches 0 in the first loop, the pin rises on the next pass through 0
+        PioStateMachine reference;
+        loadBlink(reference);
+        int previous_pin = reference.gpio.raw_data[5];
+        while (!(reference.regs.x == 0 && previous_pin == 0 && reference.gpio.raw_data[5] == 1))
+        {
+            previous_pin = reference.gpio.raw_data[5];
+            reference.tick();
+        }
+
+        pio.run(1000);
+        CHECK(breakpoints.hit().kind == PioBreakpoints::Kind::Condition);
+        CHECK(breakpoints.hit().id == id);
+        CHECK(pio.clock == reference.clock);
+        CHECK(pio.regs == reference.regs);
+        CHECK(breakpoints.describe(breakpoints.hit()) == "x == 0 && gpio5 rising");
+    }
+
+    SUBCASE("number formats and operators")
+    {
+        breakpoints.addCondition(pio, "clock>=0x10&&pc<=0b11 && pc != 0");
+        pio.run(1000);
+        CHECK(pio.clock >= 16);
+        CHECK(pio.regs.pc >= 1);
+        CHECK(pio.regs.pc <= 3);
+    }
+
+    SUBCASE("syntax errors")
+    {
+        CHECK_THROWS(breakpoints.addCondition(pio, "nope == 1"));
+        CHECK_THROWS(breakpoints.addCondition(pio, "x =< 1"));
+        CHECK_THROWS(breakpoints.addCondition(pio, "x == 12z"));
+        CHECK_THROWS(breakpoints.addCondition(pio, "x == 1 &&"));
+        CHECK_THROWS(breakpoints.addCondition(pio, "x == 1 y == 2"));
+        CHECK_THROWS(breakpoints.addCondition(pio, "(x + 1"));
+        CHECK(breakpoints.empty());
+    }
+}
+
+TEST_CASE("watchpoints")
+{
+    PioStateMachine pio;
+    loadBlink(pio);
+    PioBreakpoints breakpoints;
+    pio.breakpoints = &breakpoints;
+
+    int id = breakpoints.addWatch(pio, "x");
+    CHECK_THROWS(breakpoints.addWatch(pio, "x2"));
+
+    pio.run(1000);
+    const auto& hit = breakpoints.hit();
+    CHECK(hit.kind == PioBreakpoints::Kind::Watch);
+    CHECK(hit.id == id);
+    CHECK(hit.old_value == 0);
+    CHECK(hit.new_value == 3);
+    CHECK(pio.regs.x == 3);
+    CHECK(hit.clock == pio.clock); // after the cycle that wrote it
+    CHECK(breakpoints.describe(hit) == "x: 0 -> 3");
+
+    pio.run(1000);
+    CHECK(pio.regs.x == 2);
+
+    // step() is the per-cycle form
+    int clock = pio.clock;
+    while (pio.step())
+        ;
+    CHECK(pio.regs.x == 1);
+    CHECK(pio.clock > clock);
+
+    CHECK(breakpoints.entries().size() == 1);
+    CHECK(breakpoints.remove(id));
+    CHECK_FALSE(breakpoints.remove(id));
+    CHECK(breakpoints.empty());
+    CHECK(pio.run(100) == 100);
+}
+
+TEST_CASE("copies of the machine share the compiled breakpoints")
+{
+    PioStateMachine pio;
+    loadBlink(pio);
+    PioBreakpoints breakpoints;
+    breakpoints.addWatch(pio, "gpio5");
+
+    PioStateMachine copy = pio;
+    copy.breakpoints = &breakpoints;
+    copy.run(1000);
+    CHECK(breakpoints.hit().kind == PioBreakpoints::Kind::Watch);
+    CHECK(copy.gpio.raw_data[5] == 1);
+    CHECK(pio.clock == 0);
+}
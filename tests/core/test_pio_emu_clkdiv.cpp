@@ -0,0 +1,190 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "../../src/PioBlock.h"
+#include "../../src/PioBreakpoints.h"
+
+TEST_CASE("State machine clock divider")
+{
+    PioStateMachine pio;
+
+    SUBCASE("divider 1 ticks every system clock")
+    {
+        for (int i = 0; i < 10; i++)
+            CHECK(pio.systemTick() == true);
+        CHECK(pio.clock == 10);
+    }
+
+    SUBCASE("integer divider")
+    {
+        pio.settings.clkdiv_int = 4;
+        int fired = 0;
+        for (int i = 1; i <= 40; i++)
+        {
+            if (pio.systemTick())
+            {
+                CHECK(i % 4 == 0);
+                fired++;
+            }
+        }
+        CHECK(fired == 10);
+        CHECK(pio.clock == 10);
+    }
+
+    SUBCASE("fractional divider 2.5 alternates 3 and 2 system clocks")
+    {
+        pio.settings.clkdiv_int = 2;
+        pio.settings.clkdiv_frac = 128;
+        std::vector<int> fire_at;
+        for (int i = 1; i <= 20; i++)
+        {
+            if (pio.systemTick())
+                fire_at.push_back(i);
+        }
+        CHECK(fire_at == std::vector<int>{ 3, 5, 8, 10, 13, 15, 18, 20 });
+    }
+
+    SUBCASE("integer 0 means 65536")
+    {
+        pio.settings.clkdiv_int = 0;
+        CHECK(pio.clkdivDivisor() == 65536u * 256);
+        CHECK(pio.systemTicksToSmTicks(65535) == 0);
+        CHECK(pio.systemTicksToSmTicks(1) == 1);
+    }
+
+    SUBCASE("bulk conversion matches single steps")
+    {
+        PioStateMachine stepped;
+        pio.settings.clkdiv_int = stepped.settings.clkdiv_int = 3;
+        pio.settings.clkdiv_frac = stepped.settings.clkdiv_frac = 77;
+
+        uint64_t fired = 0;
+        for (int i = 0; i < 1000; i++)
+            fired += stepped.systemTick() ? 1 : 0;
+        CHECK(pio.systemTicksToSmTicks(1000) == fired);
+        CHECK(pio.clkdiv_accumulator == stepped.clkdiv_accumulator);
+    }
+}
+
+TEST_CASE("PIO block")
+{
+    PioBlock block;
+
+    SUBCASE("state machine numbers")
+    {
+        for (int i = 0; i < 4; i++)
+            CHECK(block.sm[i].stateMachineNumber == i);
+    }
+
+    SUBCASE("disabled state machines don't move")
+    {
+        block.setEnabled(1, true);
+        block.setEnabled(3, true);
+        block.sm[3].settings.clkdiv_int = 2;
+        for (int i = 0; i < 100; i++)
+            block.tick();
+
+        CHECK(block.system_clock == 100);
+        CHECK(block.sm[0].clock == 0);
+        CHECK(block.sm[1].clock == 100);
+        CHECK(block.sm[2].clock == 0);
+        CHECK(block.sm[3].clock == 50);
+
+        block.setEnabled(1, false);
+        CHECK(block.isEnabled(1) == false);
+        block.tick();
+        CHECK(block.sm[1].clock == 100);
+    }
+
+    SUBCASE("run() matches tick()")
+    {
+        PioBlock stepped;
+        for (PioBlock* b : { &block, &stepped })
+        {
+            b->setEnabled(0, true);
+            b->setEnabled(2, true);
+            b->sm[0].instructionMemory[0] = 0xe701; // set pins, 1 [7]
+            b->sm[0].instructionMemory[1] = 0xe300; // set pins, 0 [3]
+            b->sm[0].settings.wrap_end = 1;
+            b->sm[0].settings.set_base = 0;
+            b->sm[0].settings.set_count = 1;
+            b->sm[0].gpio.pindirs[0] = 0;
+            b->sm[2].settings.clkdiv_int = 5;
+            b->sm[2].settings.clkdiv_frac = 200;
+        }
+
+        for (int i = 0; i < 1234; i++)
+            stepped.tick();
+        block.run(1234);
+
+        CHECK(block.system_clock == stepped.system_clock);
+        for (int i = 0; i < 4; i++)
+        {
+            CHECK(block.sm[i].clock == stepped.sm[i].clock);
+            CHECK(block.sm[i].regs == stepped.sm[i].regs);
+            CHECK(block.sm[i].gpio == stepped.sm[i].gpio);
+        }
+    }
+
+    SUBCASE("a breakpoint stops the whole block")
+    {
+        PioBlock stepped;
+        PioBreakpoints breakpoints[2];
+        PioBlock* blocks[] = { &block, &stepped };
+        for (int b = 0; b < 2; b++)
+        {
+            PioBlock& each = *blocks[b];
+            each.setEnabled(0, true);
+            each.setEnabled(1, true);
+            for (PioStateMachine& machine : each.sm)
+            {
+                machine.instructionMemory[0] = 0xe03f; // set x, 31
+                machine.instructionMemory[1] = 0x0041; // jmp x--, 1
+                machine.settings.wrap_end = 1;
+            }
+            each.sm[1].settings.clkdiv_int = 3;
+            each.sm[1].settings.clkdiv_frac = 128;
+            breakpoints[b].setPc(0);
+            each.sm[1].breakpoints = &breakpoints[b];
+        }
+
+        // sm1 fetches pc 0 on its first clock, 4 system clocks in
+        CHECK(block.run(1000) == 3);
+        CHECK(block.sm[1].clock == 0);
+        while (stepped.tick())
+        {
+        }
+        CHECK(stepped.system_clock == block.system_clock);
+        for (int i = 0; i < 2; i++)
+        {
+            CHECK(block.sm[i].clock == stepped.sm[i].clock);
+            CHECK(block.sm[i].regs == stepped.sm[i].regs);
+            CHECK(block.sm[i].clkdiv_accumulator == stepped.sm[i].clkdiv_accumulator);
+        }
+
+        // Running again goes on from the breakpoint to the next one, 33 clocks of sm1 later
+        CHECK(block.run(1000) == 115);
+        CHECK(block.sm[1].clock == 33);
+        CHECK(block.sm[0].clock == 118);
+    }
+
+    SUBCASE("the clock limit stops the whole block")
+    {
+        block.setEnabled(0, true);
+        block.setEnabled(1, true);
+        block.sm[1].settings.clkdiv_int = 2;
+        block.sm[1].clock = PioStateMachine::kMaxClock - 10;
+        // sm1's last clock is at system clock 20, the block stops before it would tick again
+        CHECK(block.run(100) == 21);
+        CHECK(block.sm[0].clock == 21);
+        CHECK(block.sm[1].clock == PioStateMachine::kMaxClock);
+        CHECK(block.run(100) == 0);
+        CHECK(block.system_clock == 21);
+    }
+
+    SUBCASE("wall-clock time")
+    {
+        block.system_clock_hz = 1'000'000.0;
+        block.run(2'500'000);
+        CHECK(block.elapsedSeconds() == doctest::Approx(2.5));
+    }
+}
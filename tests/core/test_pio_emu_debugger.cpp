@@ -0,0 +1,217 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "../../src/PioDebugger.h"
+#include "../../src/PioStateMachine.h"
+#include "pio_test_programs.h"
+
+// A command and, when it starts a run, its report
+static std::string run(PioDebugger& debugger, const std::string& line)
+{
+    std::string out;
+    debugger.execute(line, out);
+    if (debugger.running())
+    {
+        debugger.waitFor(std::chrono::seconds(10));
+        debugger.finish(out);
+    }
+    return out;
+}
+
+static bool contains(const std::string& text, const std::string& part)
+{
+    return text.find(part) != std::string::npos;
+}
+
+TEST_CASE("stepping")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+
+    // pc is the next instruction from its fetch on, through the delay
+    CHECK(run(debugger, "step") == "clock 1  pc 1: set    pins, 0         [3]  [delay 7]\n");
+    CHECK(run(debugger, "step 3") == "clock 4  pc 1: set    pins, 0         [3]  [delay 4]\n");
+
+    // next runs over the delay to the next fetch, an empty line does it again
+    CHECK(run(debugger, "next") == "clock 8  pc 1: set    pins, 0         [3]\n");
+    CHECK(run(debugger, "") == "clock 12  pc 2: set    x, 31\n");
+    CHECK(run(debugger, "n") == "clock 13  pc 3: jmp    x--, 3          [1]\n");
+    CHECK(pio.regs.x == 31);
+
+    std::string out = run(debugger, "continue 100");
+    CHECK(out == "ran 100 clocks\nclock 113  pc 3: jmp    x--, 3          [1]\n");
+}
+
+TEST_CASE("breakpoints and watches")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+
+    CHECK(run(debugger, "break 4") == "breakpoint at pc 4: jmp    0               [2]\n");
+    CHECK(run(debugger, "c") == "breakpoint pc 4 after 77 clocks\nclock 77  pc 4: jmp    0               [2]\n");
+    CHECK(run(debugger, "delete pc 4").empty());
+
+    CHECK(run(debugger, "when x == 7") == "1: when x == 7\n");
+    std::string out = run(debugger, "continue");
+    CHECK(contains(out, "condition x == 7 after"));
+    CHECK(pio.regs.x == 7);
+    CHECK(run(debugger, "delete 1").empty());
+
+    CHECK(run(debugger, "watch gpio5") == "2: watch gpio5\n");
+    out = run(debugger, "continue");
+    CHECK(contains(out, "watch gpio5: 0 -> 1 after"));
+    CHECK(pio.get_var("gpio5") == 1);
+
+    // next stops on the user's breakpoints too, and reports them
+    CHECK(run(debugger, "delete all").empty());
+    run(debugger, "break 1");
+    CHECK(contains(run(debugger, "next"), "breakpoint pc 1"));
+    CHECK(contains(run(debugger, "info"), "break at pc 1"));
+
+    CHECK(contains(run(debugger, "break 32"), "error: no such address"));
+    CHECK(contains(run(debugger, "when x =="), "error: "));
+    CHECK(contains(run(debugger, "delete 9"), "error: no condition or watch 9"));
+}
+
+TEST_CASE("a run without an end stays interruptible")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+
+    std::string out;
+    debugger.execute("continue", out);
+    CHECK(debugger.running());
+    CHECK_FALSE(debugger.waitFor(std::chrono::milliseconds(20)));
+    debugger.execute("regs", out);
+    CHECK(out == "running, interrupt it first\n");
+
+    debugger.interrupt();
+    CHECK(debugger.waitFor(std::chrono::milliseconds(0)));
+    CHECK(debugger.running()); // until reported
+    out.clear();
+    debugger.finish(out);
+    CHECK(out.starts_with("interrupted after "));
+    CHECK(pio.clock > 0);
+
+    // Reported once
+    CHECK_FALSE(debugger.running());
+    out.clear();
+    debugger.finish(out);
+    CHECK(out.empty());
+}
+
+TEST_CASE("runs end at the clock limit")
+{
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x80a0; // pull block, TX stays empty
+    pio.settings.wrap_end = 0;
+    PioDebugger debugger(pio);
+
+    // A stall is fast-forwarded, continue and next get there within a second
+    std::string out = run(debugger, "continue");
+    CHECK(contains(out, "the clock can't count past 2147483647"));
+    CHECK(pio.clock == PioStateMachine::kMaxClock);
+    CHECK(contains(run(debugger, "next"), "stopped after 0 clocks"));
+    CHECK(contains(run(debugger, "rewind"), "clock 2147483647 "));
+    CHECK(contains(run(debugger, "rewind"), "clock 0 "));
+}
+
+TEST_CASE("state dumps and edits")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+
+    CHECK(run(debugger, "set x 0x1234") == "x = 0x1234\n");
+    CHECK(contains(run(debugger, "regs"), "x   0x00001234  y   0x00000000"));
+    CHECK(run(debugger, "print x + 1") == "x + 1 = 4661 (0x1235)\n");
+    CHECK(run(debugger, "set set_base 6").empty());
+    CHECK(pio.settings.set_base == 6);
+    CHECK(contains(run(debugger, "set bogus 1"), "error: no variable or setting named bogus"));
+
+    CHECK(run(debugger, "push 7").empty());
+    CHECK(run(debugger, "push 0x80000000").empty());
+    CHECK(run(debugger, "fifo") == "tx 2/4: 0x00000007 0x80000000\nrx 0/4:\n");
+    CHECK(contains(run(debugger, "pop"), "error: the RX FIFO is empty"));
+    pio.fifo.rx_fifo[0] = 0xabc;
+    pio.fifo.rx_fifo_count = 1;
+    CHECK(run(debugger, "pop") == "0x00000abc\n");
+
+    CHECK(run(debugger, "drive gpio3 1").empty());
+    CHECK(pio.gpio.external_data[3] == 1);
+    CHECK(run(debugger, "drive 3 z").empty());
+    CHECK(pio.gpio.external_data[3] == -1);
+
+    std::string listing = run(debugger, "disas");
+    CHECK(contains(listing, "            .wrap_target\n=>   0: e701  set    pins, 1         [7]\n"));
+    CHECK(contains(listing, "    4: 0200  jmp    0               [2]\n            .wrap\n"));
+    run(debugger, "b 2");
+    CHECK(contains(run(debugger, "disas 2 1"), "  *  2: e03f  set    x, 31\n"));
+
+    CHECK(contains(run(debugger, "bogus"), "unknown command 'bogus'"));
+    CHECK(contains(run(debugger, "help"), "checkpoint [NAME], cp"));
+    std::string out;
+    CHECK_FALSE(debugger.execute("quit", out));
+}
+
+TEST_CASE("pin waveforms as ASCII stairs")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+    CHECK(run(debugger, "wave") == "nothing ran yet\n");
+
+    // High for 8 clocks, low for the other 72 of the 80 clock loop
+    run(debugger, "continue 100");
+    std::string wave = run(debugger, "wave 5 24");
+    CHECK(wave == "clock 76 .. 100, 1 clock a column\n"
+                  "            ________            \n"
+                  "gpio5   ____|       |___________\n");
+
+    // Longer than the width: several clocks a column, a toggling column shows as '#'
+    run(debugger, "continue 1000");
+    wave = run(debugger, "wave 5 640");
+    CHECK(contains(wave, "clock 460 .. 1100, 10 clocks a column\n"));
+    CHECK(contains(wave, "#"));
+    CHECK(contains(run(debugger, "wave 5-6,gpio7"), "gpio7"));
+    CHECK(contains(run(debugger, "wave 40"), "error: no such pin"));
+    CHECK(contains(run(debugger, "wave 5-3"), "error: pin range runs backwards"));
+}
+
+TEST_CASE("checkpoints and rewind")
+{
+    PioStateMachine pio;
+    loadBlink(pio, 31);
+    PioDebugger debugger(pio);
+
+    run(debugger, "continue 50");
+    CHECK(run(debugger, "checkpoint") == "checkpoint cp1 at clock 50\n");
+    run(debugger, "continue 500");
+    run(debugger, "cp later");
+    run(debugger, "step 7");
+    CHECK(pio.clock == 557);
+
+    // Undo goes back one run at a time
+    CHECK(contains(run(debugger, "rewind"), "clock 550 "));
+    CHECK(contains(run(debugger, "rewind"), "clock 50 "));
+    CHECK(contains(run(debugger, "rewind later"), "clock 550 "));
+    CHECK(contains(run(debugger, "rw cp1"), "clock 50 "));
+    CHECK(contains(run(debugger, "rewind nowhere"), "error: no checkpoint named nowhere"));
+
+    // The pin history starts over from the restored machine
+    CHECK(debugger.waveform().firstClock() == 50);
+    run(debugger, "continue 30");
+    CHECK(debugger.waveform().endClock() <= 80);
+
+    // Reset is undoable too
+    CHECK(contains(run(debugger, "reset"), "clock 0 "));
+    CHECK(contains(run(debugger, "rewind"), "clock 80 "));
+    CHECK(contains(run(debugger, "rewind"), "clock 50 "));
+    CHECK(contains(run(debugger, "rewind"), "clock 0 "));
+    CHECK(contains(run(debugger, "rewind"), "error: nothing to rewind"));
+}
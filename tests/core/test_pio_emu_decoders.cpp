@@ -0,0 +1,300 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioDecoders.h"
+
+static const uint16_t ws2812_program_instructions[] = {
+    //     .wrap_target
+    0x6321, //  0: out    x, 1    side 0 [3]
+    0x1223, //  1: jmp    !x, 3   side 1 [2]
+    0x1200, //  2: jmp    0       side 1 [2]
+    0xa242, //  3: nop            side 0 [2]
+    //     .wrap
+};
+
+void loadWs2812(PioStateMachine& pio)
+{
+    for (int i = 0; i < 4; i++)
+        pio.instructionMemory[i] = ws2812_program_instructions[i];
+    pio.settings.sideset_opt = false;
+    pio.settings.sideset_count = 1;
+    pio.settings.sideset_base = 22;
+    pio.settings.pull_threshold = 24;
+    pio.settings.out_shift_right = false;
+    pio.settings.autopull_enable = true;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 3;
+    pio.gpio.pindirs[22] = 0;
+}
+
+void pushTx(PioStateMachine& pio, uint32_t word)
+{
+    pio.fifo.tx_fifo[pio.fifo.tx_fifo_count++] = word;
+}
+
+TEST_CASE("WS2812 frame from the ws2812 program")
+{
+    PioStateMachine pio;
+    PioWs2812Decoder decoder(22, 5, 50);
+    loadWs2812(pio);
+    pio.pin_listeners.push_back(&decoder);
+
+    // The out of a word's last bit only completes once the next word is pulled, so a black
+    // pixel follows; then the out stalls with the line low
+    pushTx(pio, 0xba'ab'ff'00);
+    pushTx(pio, 0x00'00'00'00);
+    pio.run(1000);
+    CHECK(decoder.frames.empty()); // the reset gap is only known at the end of the capture
+    decoder.finish(pio.clock);
+
+    REQUIRE(decoder.frames.size() == 1);
+    const auto& frame = decoder.frames[0];
+    REQUIRE_FALSE(frame.pixels.empty());
+    CHECK(frame.pixels[0] == 0xbaabff);
+    CHECK(frame.start_clock < frame.end_clock);
+    CHECK(frame.end_clock < 600);
+    CHECK(decoder.framebuffer == frame.pixels);
+
+    decoder.reset();
+    CHECK(decoder.frames.empty());
+    CHECK(decoder.pin == 22);
+}
+
+TEST_CASE("WS2812 decoding is the same through run() and tick()")
+{
+    PioStateMachine fast, slow;
+    PioWs2812Decoder fast_decoder(22, 5, 50), slow_decoder(22, 5, 50);
+    loadWs2812(fast);
+    loadWs2812(slow);
+    fast.pin_listeners.push_back(&fast_decoder);
+    slow.pin_listeners.push_back(&slow_decoder);
+    for (uint32_t word : { 0x01'02'03'00u, 0xa0'b0'c0'00u, 0x00'00'01'00u })
+    {
+        pushTx(fast, word);
+        pushTx(slow, word);
+    }
+
+    fast.run(2000);
+    for (int i = 0; i < 2000; i++)
+        slow.tick();
+    fast_decoder.finish(fast.clock);
+    slow_decoder.finish(slow.clock);
+
+    REQUIRE(fast_decoder.frames.size() == 1);
+    REQUIRE(slow_decoder.frames.size() == 1);
+    CHECK(fast_decoder.frames[0].pixels == slow_decoder.frames[0].pixels);
+    CHECK(fast_decoder.frames[0].trailing_bits == slow_decoder.frames[0].trailing_bits);
+    CHECK(fast_decoder.frames[0].start_clock == slow_decoder.frames[0].start_clock);
+    CHECK(fast_decoder.frames[0].end_clock == slow_decoder.frames[0].end_clock);
+    CHECK(fast_decoder.frames[0].pixels[0] == 0x010203);
+}
+
+TEST_CASE("WS2812 reset gaps latch frames, 32-bit pixels")
+{
+    PioWs2812Decoder decoder(7, 6, 100, 32);
+    int clock = 0;
+    auto send = [&](uint64_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--)
+        {
+            int high = (value >> i) & 1 ? 8 : 4;
+            decoder.onPinChange(clock, 1u << 7);
+            decoder.onPinChange(clock + high, 0);
+            clock += 12;
+        }
+    };
+
+    send(0x11223344, 32);
+    send(0x5, 3);       // stray bits after the pixel
+    clock += 200;
+    send(0xaabbccdd, 32);
+    decoder.finish(clock + 50); // gap not long enough yet
+    REQUIRE(decoder.frames.size() == 1);
+    CHECK(decoder.frames[0].pixels == std::vector<uint32_t>{ 0x11223344 });
+    CHECK(decoder.frames[0].trailing_bits == 3);
+    CHECK(decoder.frames[0].start_clock == 0);
+
+    decoder.finish(clock + 100);
+    REQUIRE(decoder.frames.size() == 2);
+    CHECK(decoder.framebuffer == std::vector<uint32_t>{ 0xaabbccdd });
+    CHECK(decoder.toJson().find("\"pixels\":[2864434397],\"trailing_bits\":0") != std::string::npos);
+}
+
+TEST_CASE("UART 8N1 from a program shifting out preformatted frames")
+{
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x6701; // 0: out    pins, 1   [7]
+    pio.settings.out_base = 0;
+    pio.settings.out_count = 1;
+    pio.settings.out_shift_right = true;
+    pio.settings.autopull_enable = true;
+    pio.settings.pull_threshold = 32;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 0;
+    pio.gpio.pindirs[0] = 0;
+    pio.gpio.raw_data[0] = 1; // idle line
+
+    // Three 10-bit frames (start, 8 data LSB first, stop) and two idle bits in one word
+    uint32_t word = 0b11;
+    for (char c : std::string("!iH"))
+        word = (word << 10) | (1u << 9) | (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 1);
+    pushTx(pio, word);
+
+    PioUartDecoder decoder(0, 8);
+    pio.pin_listeners.push_back(&decoder);
+    pio.run(400);
+    decoder.finish(pio.clock);
+
+    CHECK(decoder.text() == "Hi!");
+    REQUIRE(decoder.bytes.size() == 3);
+    CHECK(decoder.bytes[0].end_clock - decoder.bytes[0].start_clock == 80);
+    CHECK(decoder.bytes[1].start_clock == decoder.bytes[0].end_clock);
+    CHECK_FALSE(decoder.bytes[0].framing_error);
+
+    std::string json = decoder.toJson();
+    CHECK(json.find("\"value\":72,\"framing_error\":false,\"parity_error\":false") != std::string::npos);
+}
+
+TEST_CASE("UART framing and parity errors")
+{
+    PioUartDecoder decoder(3, 10, 8, PioUartDecoder::Parity::Even);
+    // Start bit, 0x01 LSB first, parity 0 (wrong, one bit set), stop bit low
+    std::vector<int> bits = { 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+    int level = 1;
+    for (size_t i = 0; i < bits.size(); i++)
+    {
+        if (bits[i] != level)
+        {
+            level = bits[i];
+            decoder.onPinChange(100 + static_cast<int>(i) * 10, level ? 1u << 3 : 0);
+        }
+    }
+    decoder.onPinChange(100 + 11 * 10 + 50, 1u << 3);
+
+    REQUIRE(decoder.bytes.size() == 1);
+    CHECK(decoder.bytes[0].value == 0x01);
+    CHECK(decoder.bytes[0].parity_error);
+    CHECK(decoder.bytes[0].framing_error);
+    CHECK(decoder.bytes[0].start_clock == 100);
+    CHECK(decoder.bytes[0].end_clock == 210);
+}
+
+TEST_CASE("SPI mode 0 from the pico-examples spi program")
+{
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x6101; // 0: out    pins, 1   side 0 [1]
+    pio.instructionMemory[1] = 0x5101; // 1: in     pins, 1   side 1 [1]
+    pio.settings.sideset_count = 1;
+    pio.settings.sideset_base = 2;     // sck
+    pio.settings.out_base = 0;         // mosi
+    pio.settings.out_count = 1;
+    pio.settings.in_base = 1;          // miso
+    pio.settings.autopull_enable = true;
+    pio.settings.pull_threshold = 16;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 1;
+    pio.gpio.pindirs[0] = 0;
+    pio.gpio.pindirs[2] = 0;
+
+    PioSpiDecoder decoder(2, 0, 1);
+    pio.pin_listeners.push_back(&decoder);
+    pushTx(pio, 0xa5'3c'00'00);
+    pushTx(pio, 0); // completes the last bit of the first word
+    pio.run(200);
+
+    REQUIRE(decoder.words.size() >= 2);
+    CHECK(decoder.words[0].mosi == 0xa5);
+    CHECK(decoder.words[1].mosi == 0x3c);
+    CHECK(decoder.words[0].miso == 0);
+    CHECK(decoder.words[1].start_clock > decoder.words[0].end_clock);
+}
+
+TEST_CASE("SPI chip select and mode 3")
+{
+    const int sck = 0, mosi = 1, cs = 2;
+    PioSpiDecoder decoder(sck, mosi, -1, cs, true, true, 4);
+    int clock = 0;
+    uint32_t pins = (1u << sck) | (1u << cs);
+    auto set = [&](int pin, bool high) {
+        pins = high ? pins | (1u << pin) : pins & ~(1u << pin);
+        decoder.onPinChange(++clock, pins);
+    };
+    auto transfer = [&](uint32_t value, int bits) {
+        for (int i = bits - 1; i >= 0; i--)
+        {
+            set(sck, false);                 // leading edge, data changes
+            set(mosi, (value >> i) & 1);
+            set(sck, true);                  // trailing edge, sampled
+        }
+    };
+
+    transfer(0xf, 4); // not selected, ignored
+    set(cs, false);
+    transfer(0x9, 4);
+    transfer(0x2, 2); // partial, dropped at deselect
+    set(cs, true);
+    set(cs, false);
+    transfer(0x6, 4);
+
+    REQUIRE(decoder.words.size() == 2);
+    CHECK(decoder.words[0].mosi == 0x9);
+    CHECK(decoder.words[1].mosi == 0x6);
+}
+
+TEST_CASE("I2C address write, data, repeated start and stop")
+{
+    const int sda = 4, scl = 5;
+    PioI2cDecoder decoder(sda, scl);
+    int clock = 0;
+    uint32_t pins = (1u << sda) | (1u << scl);
+    auto set = [&](int pin, bool high) {
+        pins = high ? pins | (1u << pin) : pins & ~(1u << pin);
+        decoder.onPinChange(clock += 10, pins);
+    };
+    auto start = [&]() {
+        set(sda, true);
+        set(scl, true);
+        set(sda, false);
+        set(scl, false);
+    };
+    auto byte = [&](uint8_t value, bool ack) {
+        for (int i = 7; i >= 0; i--)
+        {
+            set(sda, (value >> i) & 1);
+            set(scl, true);
+            set(scl, false);
+        }
+        set(sda, !ack);
+        set(scl, true);
+        set(scl, false);
+    };
+
+    start();
+    byte(0x50 << 1, true);     // write to 0x50
+    byte(0x12, true);
+    start();                   // repeated start
+    byte((0x50 << 1) | 1, true);
+    byte(0xab, false);         // master NACKs the last read
+    set(sda, false);
+    set(scl, true);
+    set(sda, true);            // stop
+
+    using Kind = PioI2cDecoder::Kind;
+    REQUIRE(decoder.events.size() == 7);
+    CHECK(decoder.events[0].kind == Kind::Start);
+    CHECK(decoder.events[1].kind == Kind::Address);
+    CHECK(decoder.events[1].value == 0x50);
+    CHECK_FALSE(decoder.events[1].read);
+    CHECK(decoder.events[1].ack);
+    CHECK(decoder.events[2].kind == Kind::Data);
+    CHECK(decoder.events[2].value == 0x12);
+    CHECK(decoder.events[3].kind == Kind::RepeatedStart);
+    CHECK(decoder.events[4].read);
+    CHECK(decoder.events[5].value == 0xab);
+    CHECK_FALSE(decoder.events[5].ack);
+    CHECK(decoder.events[6].kind == Kind::Stop);
+    CHECK(decoder.events[1].end_clock > decoder.events[1].start_clock);
+
+    CHECK(decoder.toJson().rfind("{\"events\":[{\"kind\":\"start\",", 0) == 0);
+}
@@ -0,0 +1,298 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include <vector>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioDevices.h"
+#include "../../src/PioPinStats.h"
+
+void pushTx(PioStateMachine& pio, uint32_t word)
+{
+    pio.fifo.tx_fifo[pio.fifo.tx_fifo_count++] = word;
+}
+
+// SPI master: one explicit pull of the command word, then clock forever (the OSR runs dry and
+// shifts zeros), 32-bit autopush of MISO. mosi 0, miso 1, sck 2, cs 3 (never driven: low, selected)
+void loadSpiMaster(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0x80a0; // 0: pull   block     side 0
+    pio.instructionMemory[1] = 0x6101; // 1: out    pins, 1   side 0 [1]
+    pio.instructionMemory[2] = 0x5101; // 2: in     pins, 1   side 1 [1]
+    pio.settings.sideset_count = 1;
+    pio.settings.sideset_base = 2;
+    pio.settings.out_base = 0;
+    pio.settings.out_count = 1;
+    pio.settings.in_base = 1;
+    pio.settings.in_shift_autopush = true;
+    pio.settings.push_threshold = 32;
+    pio.settings.wrap_start = 1;
+    pio.settings.wrap_end = 2;
+    pio.gpio.pindirs[0] = 0;
+    pio.gpio.pindirs[2] = 0;
+    pio.gpio.raw_data[1] = 1; // MISO pull-up
+}
+
+TEST_CASE("SPI flash read by a PIO program")
+{
+    for (bool cycle_accurate : { false, true })
+    {
+        PioStateMachine pio;
+        PioSpiFlashDevice flash(2, 0, 1, 3);
+        loadSpiMaster(pio);
+        pio.cycle_accurate = cycle_accurate;
+        flash.memory[0x10] = 0xde;
+        flash.memory[0x11] = 0xad;
+        flash.memory[0x12] = 0xbe;
+        flash.memory[0x13] = 0xef;
+        flash.attach(pio);
+
+        pushTx(pio, 0x03'00'00'10); // read from 0x000010
+        pio.run(300);
+
+        INFO("cycle_accurate: ", cycle_accurate);
+        REQUIRE(pio.fifo.rx_fifo_count >= 2);
+        CHECK(pio.fifo.rx_fifo[0] == 0xffffffff); // nothing driven during the command
+        CHECK(pio.fifo.rx_fifo[1] == 0xdeadbeef);
+
+        flash.detach(pio);
+        CHECK(pio.input_sources.empty());
+        CHECK(pio.pin_listeners.empty());
+    }
+}
+
+TEST_CASE("SPI flash commands")
+{
+    // Bit-banged mode 0 master, the flash's MISO is read back from external_data
+    const int mosi = 0, miso = 1, sck = 2, cs = 3;
+    PioStateMachine bus;
+    PioSpiFlashDevice flash(sck, mosi, miso, cs, 0x2000);
+    int clock = 0;
+    uint32_t pins = 1u << cs;
+    auto step = [&](uint32_t levels) {
+        clock += 4;
+        bus.clock = clock;
+        flash.apply(bus);
+        if (levels != pins)
+            flash.onPinChange(clock, levels);
+        pins = levels;
+        bus.clock = clock + 2;
+        flash.apply(bus);
+    };
+    auto transfer = [&](std::vector<uint8_t> out, int read_bytes) {
+        std::vector<uint8_t> in;
+        out.resize(out.size() + read_bytes, 0);
+        step(0); // select
+        for (uint8_t byte : out)
+        {
+            uint8_t value = 0;
+            for (int i = 7; i >= 0; i--)
+            {
+                uint32_t data = (byte >> i) & 1 ? 1u << mosi : 0;
+                step(data);             // SCK falls, data changes
+                step(data | 1u << sck); // SCK rises, both sides sample
+                value = static_cast<uint8_t>((value << 1) | (bus.gpio.external_data[miso] == 1 ? 1 : 0));
+            }
+            in.push_back(value);
+        }
+        step(0);
+        step(1u << cs);
+        in.erase(in.begin(), in.end() - read_bytes);
+        return in;
+    };
+
+    CHECK(transfer({ 0x9f }, 3) == std::vector<uint8_t>{ 0xef, 0x40, 0x14 });
+    CHECK(transfer({ 0x05 }, 1) == std::vector<uint8_t>{ 0x00 });
+
+    transfer({ 0x02, 0x00, 0x01, 0xfe, 0x12, 0x34, 0x56 }, 0); // not write enabled: ignored
+    CHECK(flash.memory[0x1fe] == 0xff);
+
+    transfer({ 0x06 }, 0);
+    CHECK(transfer({ 0x05 }, 1) == std::vector<uint8_t>{ 0x02 });
+    transfer({ 0x02, 0x00, 0x01, 0xfe, 0x12, 0x34, 0x56 }, 0); // wraps inside the page
+    CHECK_FALSE(flash.write_enabled);
+    CHECK(flash.memory[0x1fe] == 0x12);
+    CHECK(flash.memory[0x1ff] == 0x34);
+    CHECK(flash.memory[0x100] == 0x56);
+    CHECK(transfer({ 0x03, 0x00, 0x01, 0xfe }, 3) == std::vector<uint8_t>{ 0x12, 0x34, 0xff });
+
+    transfer({ 0x06 }, 0);
+    transfer({ 0x20, 0x00, 0x01, 0x00 }, 0);
+    CHECK(flash.memory[0x1fe] == 0xff);
+    CHECK(flash.memory[0x100] == 0xff);
+}
+
+TEST_CASE("I2C EEPROM write and random read")
+{
+    // Bit-banged master on a wired-AND bus: SDA is low when either side pulls it low
+    const int sda = 4, scl = 5;
+    PioStateMachine bus;
+    PioI2cEepromDevice eeprom(sda, scl);
+    int clock = 0;
+    bool master_sda = true, master_scl = true;
+    uint32_t pins = (1u << sda) | (1u << scl);
+    auto settle = [&]() {
+        bool line = master_sda && bus.gpio.external_data[sda] != 0;
+        uint32_t levels = (line ? 1u << sda : 0) | (master_scl ? 1u << scl : 0);
+        if (levels != pins)
+            eeprom.onPinChange(clock, levels);
+        pins = levels;
+    };
+    auto set = [&](bool scl_level, bool sda_level) {
+        master_scl = scl_level;
+        master_sda = sda_level;
+        clock += 10;
+        bus.clock = clock;
+        eeprom.apply(bus);
+        settle();
+        clock += 5;
+        bus.clock = clock;
+        eeprom.apply(bus); // the device's answer
+        settle();
+    };
+    auto sdaLine = [&]() { return (pins >> sda) & 1; };
+    auto start = [&]() {
+        set(false, true);
+        set(true, true);
+        set(true, false);
+        set(false, false);
+    };
+    auto stop = [&]() {
+        set(false, false);
+        set(true, false);
+        set(true, true);
+    };
+    auto write = [&](uint8_t value) {
+        for (int i = 7; i >= 0; i--)
+        {
+            set(false, (value >> i) & 1);
+            set(true, (value >> i) & 1);
+        }
+        set(false, true); // release for the ACK
+        set(true, true);
+        bool ack = !sdaLine();
+        set(false, true);
+        return ack;
+    };
+    auto read = [&](bool ack) {
+        uint8_t value = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            set(false, true);
+            set(true, true);
+            value = static_cast<uint8_t>((value << 1) | sdaLine());
+        }
+        set(false, !ack);
+        set(true, !ack);
+        set(false, true);
+        return value;
+    };
+
+    start();
+    CHECK(write(0xa0));
+    CHECK(write(0x10));
+    CHECK(write(0x11));
+    CHECK(write(0x22));
+    stop();
+    CHECK(eeprom.memory[0x10] == 0x11);
+    CHECK(eeprom.memory[0x11] == 0x22);
+
+    start();
+    CHECK_FALSE(write(0xa4)); // another address: no ACK
+    stop();
+
+    start();
+    CHECK(write(0xa0));
+    CHECK(write(0x10));
+    start(); // repeated start
+    CHECK(write(0xa1));
+    CHECK(read(true) == 0x11);
+    CHECK(read(false) == 0x22);
+    stop();
+    CHECK(sdaLine() == 1);
+}
+
+TEST_CASE("UART loopback to a PIO transmitter")
+{
+    // TX on pin 0 shifts out three preformatted 8N1 frames, the device echoes them on pin 1
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x6701; // 0: out    pins, 1   [7]
+    pio.settings.out_base = 0;
+    pio.settings.out_count = 1;
+    pio.settings.out_shift_right = true;
+    pio.settings.autopull_enable = true;
+    pio.settings.pull_threshold = 32;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 0;
+    pio.gpio.pindirs[0] = 0;
+    pio.gpio.raw_data[0] = 1;
+
+    uint32_t word = 0b11;
+    for (char c : std::string("!iH"))
+        word = (word << 10) | (1u << 9) | (static_cast<uint32_t>(static_cast<uint8_t>(c)) << 1);
+    pushTx(pio, word);
+
+    PioUartDevice uart(0, 1, 8);
+    uart.echo = true;
+    uart.turnaround_clocks = 16;
+    uart.attach(pio);
+    PioUartDecoder rx(1, 8);
+    pio.pin_listeners.push_back(&rx);
+
+    pio.run(600);
+    CHECK(uart.receivedText() == "Hi!");
+    REQUIRE(uart.received().size() == 3);
+    rx.finish(pio.clock);
+    CHECK(rx.text() == "Hi!");
+    REQUIRE(rx.bytes.size() == 3);
+    CHECK(rx.bytes[0].start_clock == uart.received()[0].end_clock + 16);
+
+    uart.send("ok", 1000);
+    pio.run(600);
+    rx.finish(pio.clock);
+    CHECK(rx.text() == "Hi!ok");
+    REQUIRE(rx.bytes.size() == 5);
+    CHECK(rx.bytes[3].start_clock == 1000);
+    CHECK(rx.bytes[4].start_clock == 1080);
+}
+
+TEST_CASE("quadrature encoder steps")
+{
+    PioStateMachine pio; // nops: run() collapses them into blocks
+    PioQuadratureEncoderDevice encoder(6, 7);
+    PioPinStats stats;
+    stats.watch(6);
+    stats.watch(7);
+    pio.pin_stats = &stats;
+    encoder.attach(pio);
+
+    encoder.move(8, 10);   // steps at 10, 20, ... 80
+    encoder.move(-4, 5);   // then 85 .. 100
+    pio.run(200);
+
+    CHECK(encoder.idle());
+    CHECK(encoder.position == 4);
+    const auto* a = stats.find(6);
+    const auto* b = stats.find(7);
+    CHECK(a->rising == 3);
+    CHECK(b->rising == 3); // the reverse run turns B back on first
+    CHECK(a->high.count(20) == 2);
+    CHECK(b->low.count(20) == 1);
+    CHECK(pio.gpio.raw_data[6] == 0); // back to phase 0 after +8 -4
+    CHECK(pio.gpio.raw_data[7] == 0);
+
+    // Same edges one clock at a time
+    PioStateMachine slow;
+    PioQuadratureEncoderDevice slow_encoder(6, 7);
+    PioPinStats slow_stats;
+    slow_stats.watch(6);
+    slow_stats.watch(7);
+    slow.pin_stats = &slow_stats;
+    slow_encoder.attach(slow);
+    slow_encoder.move(8, 10);
+    slow_encoder.move(-4, 5);
+    for (int i = 0; i < 200; i++)
+        slow.tick();
+    CHECK(slow_stats.find(6)->high.counts == a->high.counts);
+    CHECK(slow_stats.find(7)->low.counts == b->low.counts);
+    CHECK(slow_stats.find(7)->rising == b->rising);
+}
@@ -0,0 +1,58 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include "../../src/PioDisassembler.h"
+
+using PioDisassembler::disassemble;
+
+TEST_CASE("instructions read like pioasm's listing")
+{
+    // pioasm -o c-sdk of the echo program
+    CHECK(disassemble(0x80a0, 0, false) == "pull   block");
+    CHECK(disassemble(0xa027, 0, false) == "mov    x, osr");
+    CHECK(disassemble(0x4020, 0, false) == "in     x, 32");
+    CHECK(disassemble(0x8020, 0, false) == "push   block");
+    CHECK(disassemble(0xa042, 0, false) == "nop");
+    CHECK(disassemble(0xe001, 0, false) == "set    pins, 1");
+
+    CHECK(disassemble(0x0143, 0, false) == "jmp    x--, 3          [1]");
+    CHECK(disassemble(0x0000, 0, false) == "jmp    0");
+    CHECK(disassemble(0x00c5, 0, false) == "jmp    pin, 5");
+    CHECK(disassemble(0x2083, 0, false) == "wait   1 gpio, 3");
+    CHECK(disassemble(0x2021, 0, false) == "wait   0 pin, 1");
+    CHECK(disassemble(0x20d1, 0, false) == "wait   1 irq, 1 rel");
+    CHECK(disassemble(0x6001, 0, false) == "out    pins, 1");
+    CHECK(disassemble(0x60e0, 0, false) == "out    exec, 32");
+    CHECK(disassemble(0x8080, 0, false) == "pull   noblock");
+    CHECK(disassemble(0x8060, 0, false) == "push   iffull block");
+    CHECK(disassemble(0x80c0, 0, false) == "pull   ifempty noblock");
+    CHECK(disassemble(0xa02a, 0, false) == "mov    x, !y");
+    CHECK(disassemble(0xa0d6, 0, false) == "mov    isr, ::isr");
+    CHECK(disassemble(0xa0a5, 0, false) == "mov    pc, status");
+    CHECK(disassemble(0xc000, 0, false) == "irq    nowait 0");
+    CHECK(disassemble(0xc021, 0, false) == "irq    wait 1");
+    CHECK(disassemble(0xc052, 0, false) == "irq    clear 2 rel");
+    CHECK(disassemble(0xe09f, 0, false) == "set    pindirs, 31");
+}
+
+TEST_CASE("the side-set layout splits the delay field")
+{
+    // ws2812: .side_set 1
+    CHECK(disassemble(0x6221, 1, false) == "out    x, 1            side 0 [2]");
+    CHECK(disassemble(0x1123, 1, false) == "jmp    !x, 3           side 1 [1]");
+    CHECK(disassemble(0x1400, 1, false) == "jmp    0               side 1 [4]");
+    CHECK(disassemble(0xa442, 1, false) == "nop                    side 0 [4]");
+
+    // .side_set 2 opt: enable bit, two side-set bits, two delay bits
+    CHECK(disassemble(0xbe42, 2, false) == "nop                    side 3 [6]"); // without opt: three delay bits
+    CHECK(disassemble(0xbe42, 2, true) == "nop                    side 3 [2]");
+    CHECK(disassemble(0xa242, 2, true) == "nop                    [2]");
+    CHECK(disassemble(0xb842, 1, true) == "nop                    side 1");
+
+    // Without side-set the whole field is delay
+    CHECK(disassemble(0xbf42, 0, false) == "nop                    [31]");
+
+    pioStateMachineSettings settings;
+    settings.sideset_count = 1;
+    CHECK(disassemble(0x6221, settings) == "out    x, 1            side 0 [2]");
+}
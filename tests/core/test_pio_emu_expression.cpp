@@ -0,0 +1,157 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <stdexcept>
+#include <string>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioExpression.h"
+
+uint32_t eval(PioStateMachine& pio, const std::string& text)
+{
+    return PioExpression::compile(pio, text).evaluate(pio);
+}
+
+std::string errorOf(PioStateMachine& pio, const std::string& text)
+{
+    try
+    {
+        PioExpression::compile(pio, text);
+    }
+    catch (const std::runtime_error& e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+TEST_CASE("expression values and operators")
+{
+    PioStateMachine pio;
+    pio.regs.x = 5;
+    pio.regs.y = 0xf0;
+    pio.regs.pc = 3;
+    pio.gpio.raw_data[22] = 1;
+    pio.fifo.tx_fifo_count = 2;
+    pio.irq_flags[1] = true;
+    pio.clock = 7;
+
+    CHECK(eval(pio, "42") == 42);
+    CHECK(eval(pio, "0x1F + 0b11") == 34);
+    CHECK(eval(pio, "010") == 10); // decimal, not octal
+    CHECK(eval(pio, "x") == 5);
+    CHECK(eval(pio, "gpio22 + gpio21 + irq1 + tx_fifo_count + clock") == 11);
+
+    // C precedence
+    CHECK(eval(pio, "1 + 2 * 3") == 7);
+    CHECK(eval(pio, "(1 + 2) * 3") == 9);
+    CHECK(eval(pio, "y >> 4 & 0x3") == 3);
+    CHECK(eval(pio, "1 << 2 + 1") == 8);
+    CHECK(eval(pio, "x == 5 && y != 0 || pc == 9") == 1);
+    CHECK(eval(pio, "x == 4 || pc > 2 && pc < 3") == 0);
+    CHECK(eval(pio, "y & 0x30 == 0x30") == 0); // == binds tighter than &, like C
+    CHECK(eval(pio, "x ^ 1 | 8") == 12);
+    CHECK(eval(pio, "x % 3 + x / 2 - 1") == 3);
+
+    // Unary operators and wrap-around
+    CHECK(eval(pio, "!x") == 0);
+    CHECK(eval(pio, "!!x") == 1);
+    CHECK(eval(pio, "~0") == 0xffffffff);
+    CHECK(eval(pio, "-1") == 0xffffffff);
+    CHECK(eval(pio, "0 - 1 > 0") == 1); // unsigned
+
+    // No traps
+    CHECK(eval(pio, "x / 0") == 0);
+    CHECK(eval(pio, "x % 0") == 0);
+    CHECK(eval(pio, "1 << 40") == 0);
+
+    // Stays bound to the fields
+    PioExpression expression = PioExpression::compile(pio, "x * 2");
+    CHECK(expression.evaluate(pio) == 10);
+    pio.regs.x = 21;
+    CHECK(expression.evaluate(pio) == 42);
+    CHECK(expression.text() == "x * 2");
+}
+
+TEST_CASE("expression errors")
+{
+    PioStateMachine pio;
+    CHECK(errorOf(pio, "nope == 1") == "Unknown variable 'nope' at column 1 in expression: nope == 1");
+    CHECK(errorOf(pio, "x == 12z") == "Invalid number '12z' at column 6 in expression: x == 12z");
+    CHECK(errorOf(pio, "x =< 1") == "Unexpected '=' at column 3 in expression: x =< 1");
+    CHECK(errorOf(pio, "x ==") == "Missing value at column 5 in expression: x ==");
+    CHECK(errorOf(pio, "(x + 1") == "Expected ')' at column 7 in expression: (x + 1");
+    CHECK(errorOf(pio, "x y") == "Unexpected 'y' at column 3 in expression: x y");
+    CHECK(errorOf(pio, "abs(x)") == "Unknown function 'abs' at column 1 in expression: abs(x)");
+    CHECK(errorOf(pio, "") == "Missing value at column 1 in expression: ");
+    CHECK(errorOf(pio, "0x100000000") != "");
+}
+
+TEST_CASE("edges and counters follow the clock")
+{
+    PioStateMachine pio;
+    // 0: set pins, 1 [1]   1: set pins, 0 [2]   -> pin 0 high for 2 clocks, low for 3
+    pio.instructionMemory[0] = 0xe101;
+    pio.instructionMemory[1] = 0xe200;
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 1;
+    pio.gpio.pindirs[0] = 0;
+
+    PioExpression rise = PioExpression::compile(pio, "rise(gpio0)");
+    PioExpression fall = PioExpression::compile(pio, "gpio0 falling");
+    PioExpression changed = PioExpression::compile(pio, "changed(gpio0)");
+    PioExpression pulses = PioExpression::compile(pio, "count(rise(gpio0))");
+    PioExpression high = PioExpression::compile(pio, "count(gpio0)");
+
+    int rises = 0, falls = 0, changes = 0;
+    for (int i = 0; i < 50; i++)
+    {
+        rises += rise.evaluate(pio);
+        falls += fall.evaluate(pio);
+        changes += changed.evaluate(pio);
+        pulses.evaluate(pio);
+        high.evaluate(pio);
+        pio.tick();
+    }
+    // Rising edges seen at clocks 1, 6, ..., 46, falling ones at 3, 8, ..., 48
+    CHECK(rises == 10);
+    CHECK(falls == 10);
+    CHECK(changes == 20);
+    CHECK(pulses.evaluate(pio) == 10); // clock 50: pin just rose, not counted yet (clock 50 is new)
+    CHECK(high.evaluate(pio) == 20);
+
+    // Evaluating the same clock again neither counts twice nor reports edges
+    CHECK(high.evaluate(pio) == 20);
+    CHECK(rise.evaluate(pio) == 0);
+
+    // Not evaluated for a while: no edge across the gap
+    for (int i = 0; i < 3; i++)
+        pio.tick();
+    CHECK(changed.evaluate(pio) == 0);
+
+    high.reset();
+    CHECK(high.evaluate(pio) == pio.gpio.raw_data[0]);
+}
+
+TEST_CASE("run_until with an expression")
+{
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0xe03f; //  0: set    x, 31
+    pio.instructionMemory[1] = 0x0041; //  1: jmp    x--, 1
+    pio.instructionMemory[2] = 0x0000; //  2: jmp    0
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 2;
+
+    CHECK(pio.run_until("x == 10 && pc == 1", 1000));
+    CHECK(pio.regs.x == 10);
+
+    CHECK(pio.run_until("count(pc == 2) == 2", 1000));
+    CHECK(pio.regs.pc == 2);
+
+    CHECK_FALSE(pio.run_until("x == 100", 50));
+    CHECK_THROWS(pio.run_until("x ==", 50));
+
+    // run_until_var is unchanged
+    CHECK(pio.run_until_var("x", 5, 1000));
+    CHECK(pio.regs.x == 5);
+}
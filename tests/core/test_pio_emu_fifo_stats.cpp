@@ -0,0 +1,117 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioFifoStats.h"
+#include "pio_test_programs.h"
+
+TEST_CASE("occupancy histogram and watermarks")
+{
+    PioStateMachine pio;
+    PioFifoStats stats;
+    pio.fifo_stats = &stats;
+    loadSingle(pio, 0x80a0); // pull block
+    pio.fifo.tx_fifo_count = 2;
+
+    for (int i = 0; i < 100; i++)
+        pio.tick();
+
+    // Two pulls drain the FIFO, the third one waits for the rest of the run
+    CHECK(stats.tx.cycles[2] == 1);
+    CHECK(stats.tx.cycles[1] == 1);
+    CHECK(stats.tx.cycles[0] == 98);
+    CHECK(stats.tx.total() == 100);
+    CHECK(stats.tx.min == 0);
+    CHECK(stats.tx.max == 2);
+    CHECK(stats.tx.mean() == doctest::Approx(0.03));
+    CHECK(stats.rx.cycles[0] == 100);
+    CHECK(stats.rx.max == 0);
+
+    CHECK(stats.tx_stall_cycles == 97);
+    CHECK(stats.count(PioFifoStats::EventKind::TxStall) == 1);
+    REQUIRE(stats.events.size() == 1);
+    CHECK(stats.events[0].kind == PioFifoStats::EventKind::TxStall);
+    CHECK(stats.events[0].clock == 3);
+
+    stats.reset();
+    CHECK(stats.tx.total() == 0);
+    CHECK(stats.tx.min == -1);
+    CHECK(stats.events.empty());
+}
+
+TEST_CASE("autopull only counts as starved once the FIFO and the OSR are both empty")
+{
+    PioStateMachine pio;
+    PioFifoStats stats;
+    pio.fifo_stats = &stats;
+    loadAutopull(pio);
+    pio.fifo.tx_fifo_count = 1;
+
+    for (int i = 0; i < 20; i++)
+        pio.tick();
+
+    // The refill stall of the first word is not starvation, waiting for a second word is
+    CHECK(stats.count(PioFifoStats::EventKind::TxStall) == 1);
+    CHECK(stats.tx_stall_cycles > 0);
+    CHECK(stats.tx_stall_cycles < 20);
+    REQUIRE_FALSE(stats.events.empty());
+    CHECK(stats.events[0].clock > 1);
+}
+
+TEST_CASE("full RX FIFO: blocking stall and non-blocking data loss")
+{
+    PioStateMachine pio;
+    PioFifoStats stats;
+    pio.fifo_stats = &stats;
+    pio.fifo.rx_fifo_count = 4;
+
+    SUBCASE("push block")
+    {
+        loadSingle(pio, 0x8020); // push block
+        pio.run(100);
+        CHECK(stats.rx.cycles[4] == 100);
+        CHECK(stats.rx.min == 4);
+        CHECK(stats.rx_stall_cycles == 99);
+        CHECK(stats.count(PioFifoStats::EventKind::RxStall) == 1);
+        CHECK(stats.count(PioFifoStats::EventKind::RxDropped) == 0);
+    }
+
+    SUBCASE("push noblock, only the first events are kept")
+    {
+        loadSingle(pio, 0x8000); // push noblock
+        stats.max_events = 3;
+        pio.run(10);
+        CHECK(stats.rx_stall_cycles == 0);
+        CHECK(stats.count(PioFifoStats::EventKind::RxDropped) == 10);
+        REQUIRE(stats.events.size() == 3);
+        CHECK(stats.events[0].kind == PioFifoStats::EventKind::RxDropped);
+        CHECK(stats.events[0].clock == 0);
+        CHECK(stats.events[2].clock == 2);
+    }
+}
+
+TEST_CASE("non-blocking pull from an empty TX FIFO")
+{
+    PioStateMachine pio;
+    PioFifoStats stats;
+    pio.fifo_stats = &stats;
+    loadSingle(pio, 0x8080); // pull noblock
+    pio.run(5);
+    CHECK(stats.count(PioFifoStats::EventKind::TxEmptyPull) == 5);
+    CHECK(stats.tx_stall_cycles == 0);
+}
+
+TEST_CASE("stats as JSON")
+{
+    PioStateMachine pio;
+    PioFifoStats stats;
+    pio.fifo_stats = &stats;
+    loadSingle(pio, 0x8000); // push noblock
+    pio.fifo.rx_fifo_count = 4;
+    pio.run(2);
+
+    std::string json = stats.toJson();
+    CHECK(json.rfind("{\"tx\":{\"histogram\":[2,0,0,0,0,0,0,0,0],\"min\":0,\"max\":0,\"mean\":0.0000,\"stall_cycles\":0}", 0) == 0);
+    CHECK(json.find("\"rx_dropped\":2") != std::string::npos);
+    CHECK(json.find("\"events\":[{\"kind\":\"rx_dropped\",\"clock\":0,\"pc\":0},") != std::string::npos);
+}
@@ -0,0 +1,255 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../../src/Logger/Logger.h"
+#include "../../src/Logger/LogBinary.h"
+#include "../../src/PioStateMachine.h"
+
+std::vector<std::string> readLines(const char* path)
+{
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line))
+        lines.push_back(line);
+    return lines;
+}
+
+TEST_CASE("async logger formats on the writer thread")
+{
+    const char* path = "test_logger_format.log";
+    std::remove(path);
+    {
+        Logger log;
+        log.enableConsoleOutput(false);
+        log.setLogFile(path);
+
+        std::string name = "sm0";
+        log.logFormat(Logger::LogLevel::LEVEL_INFO, 1, "a.cpp", "{} {:#x} {} {:.2f} {} {}", name, 255u, -3, 1.5, true, 'c');
+        log.logFormat(Logger::LogLevel::LEVEL_DEBUG, 2, "a.cpp", "filtered {}", 1); // below the default level
+        log.warning("plain message", 3, "b.cpp");
+        log.flush();
+
+        auto lines = readLines(path);
+        REQUIRE(lines.size() == 2);
+        CHECK(lines[0] == "[INFO ] sm0 0xff -3 1.50 true c (at file:a.cpp line:1)");
+        CHECK(lines[1] == "[WARN ] plain message (at file:b.cpp line:3)");
+    }
+    std::remove(path);
+}
+
+TEST_CASE("async logger keeps every record from several threads")
+{
+    const char* path = "test_logger_threads.log";
+    std::remove(path);
+    constexpr int kThreads = 4;
+    constexpr int kRecords = 5000;
+    {
+        Logger log;
+        log.enableConsoleOutput(false);
+        log.setQueueCapacity(64); // small queue, producers have to wait for the writer
+        log.setLogFile(path);
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; t++)
+        {
+            threads.emplace_back([&log, t] {
+                for (int i = 0; i < kRecords; i++)
+                    log.logFormat(Logger::LogLevel::LEVEL_INFO, i, "thread", "t{} {}", t, i);
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        log.flush();
+
+        CHECK(log.droppedCount() == 0);
+    }
+
+    // Every record written once, each thread's records in order
+    auto lines = readLines(path);
+    CHECK(lines.size() == kThreads * kRecords);
+    std::vector<int> next(kThreads, 0);
+    bool ordered = true;
+    for (const auto& line : lines)
+    {
+        int t = -1, i = -1;
+        if (std::sscanf(line.c_str(), "[INFO ] t%d %d", &t, &i) != 2 || t < 0 || t >= kThreads || next[t] != i)
+            ordered = false;
+        else
+            next[t]++;
+    }
+    CHECK(ordered);
+    std::remove(path);
+}
+
+TEST_CASE("drop policy counts what didn't fit")
+{
+    const char* path = "test_logger_drop.log";
+    std::remove(path);
+    constexpr int kRecords = 20000;
+    uint64_t dropped = 0;
+    {
+        Logger log;
+        log.enableConsoleOutput(false);
+        log.setQueueCapacity(4);
+        log.setOverflowPolicy(Logger::OverflowPolicy::Drop);
+        log.setLogFile(path);
+
+        for (int i = 0; i < kRecords; i++)
+            log.logFormat(Logger::LogLevel::LEVEL_INFO, i, "drop", "record {}", i);
+        log.flush();
+        dropped = log.droppedCount();
+    }
+
+    int records = 0;
+    for (const auto& line : readLines(path))
+        if (line.rfind("[INFO ] record", 0) == 0)
+            records++;
+    CHECK(records + dropped == kRecords);
+    std::remove(path);
+}
+
+TEST_CASE("sync mode writes before returning")
+{
+    const char* path = "test_logger_sync.log";
+    std::remove(path);
+    {
+        Logger log;
+        log.enableConsoleOutput(false);
+        log.setAsync(false);
+        log.setFlushPolicy(Logger::FlushPolicy::EveryRecord);
+        log.setLogFile(path);
+
+        log.error("first", 1, "c.cpp");
+        CHECK(readLines(path).size() == 1);
+        log.logFormat(Logger::LogLevel::LEVEL_ERROR, 2, "c.cpp", "{}", std::string(1000, 'x')); // truncated, still one line
+        auto lines = readLines(path);
+        REQUIRE(lines.size() == 2);
+        CHECK(lines[1].find("...") != std::string::npos);
+    }
+    std::remove(path);
+}
+
+TEST_CASE("binary log decodes back to the text log")
+{
+    const char* text_path = "test_logger_binary.log";
+    const char* binary_path = "test_logger_binary.bin";
+    const char* kFile = "C:/Users/dev/source/repos/pio_emu/src/PioStateMachine.cpp"; // __FILE__ is usually a full path
+    std::remove(text_path);
+    std::remove(binary_path);
+    {
+        Logger log;
+        log.enableConsoleOutput(false);
+        log.setLogFile(text_path);
+        log.setBinaryLogFile(binary_path);
+
+        for (int i = 0; i < 200; i++)
+            log.logFormat(Logger::LogLevel::LEVEL_WARNING, 7, kFile, "pc {} osr {:#010x} {} {:.1f}", i % 32, 0xdead0000u + i, "stall", i * 0.5);
+        log.error("plain \"quoted\"", 8, kFile);
+        log.flush();
+    }
+
+    std::ifstream in(binary_path, std::ios::binary);
+    LogBinary::Reader reader(in);
+    REQUIRE(reader.valid());
+
+    std::vector<std::string> decoded;
+    std::vector<std::string> json;
+    LogBinary::Entry entry;
+    while (reader.next(entry))
+    {
+        decoded.push_back(LogBinary::toText(entry));
+        json.push_back(LogBinary::toJson(entry));
+    }
+    CHECK(reader.error().empty());
+    CHECK(decoded == readLines(text_path));
+    REQUIRE(json.size() == 201);
+    CHECK(json[0] == R"({"level":"WARN","file":"C:/Users/dev/source/repos/pio_emu/src/PioStateMachine.cpp","line":7,"message":"pc 0 osr 0xdead0000 stall 0.0"})");
+    CHECK(json[200] == R"({"level":"ERROR","file":"C:/Users/dev/source/repos/pio_emu/src/PioStateMachine.cpp","line":8,"message":"plain \"quoted\""})");
+
+    // Call sites are written once, records only carry ids and raw arguments
+    in.clear();
+    in.seekg(0, std::ios::end);
+    std::ifstream text(text_path, std::ios::binary | std::ios::ate);
+    CHECK(static_cast<long long>(in.tellg()) * 3 < static_cast<long long>(text.tellg()));
+
+    std::remove(text_path);
+    std::remove(binary_path);
+}
+
+TEST_CASE("binary reader stops at a damaged entry")
+{
+    std::stringstream stream;
+    stream.write(LogBinary::kMagic, sizeof(LogBinary::kMagic));
+    stream.put(static_cast<char>(LogBinary::kTagRecord));
+    stream.put(5); // no call site 5
+
+    LogBinary::Reader reader(stream);
+    LogBinary::Entry entry;
+    CHECK(reader.valid());
+    CHECK_FALSE(reader.next(entry));
+    CHECK_FALSE(reader.error().empty());
+
+    // A call site id that doesn't follow the previous one, like a corrupt varint, is rejected
+    // without allocating anything for it
+    std::stringstream huge;
+    huge.write(LogBinary::kMagic, sizeof(LogBinary::kMagic));
+    huge.put(static_cast<char>(LogBinary::kTagSite));
+    huge.write("\xff\xff\xff\xff\x0f", 5); // id 0xffffffff
+    huge.put(0);                            // level
+    huge.put(1);                            // line
+    huge.write("\x01" "f" "\x02" "{}", 5);  // file, format
+    LogBinary::Reader huge_reader(huge);
+    CHECK_FALSE(huge_reader.next(entry));
+    CHECK(huge_reader.error() == "bad call site id");
+
+    std::stringstream garbage("not a log");
+    CHECK_FALSE(LogBinary::Reader(garbage).valid());
+}
+
+TEST_CASE("state machines log through their own context")
+{
+    const char* path0 = "test_logger_sm0.log";
+    const char* path1 = "test_logger_sm1.log";
+    std::remove(path0);
+    std::remove(path1);
+    {
+        Logger log0, log1;
+        for (Logger* log : { &log0, &log1 })
+            log->enableConsoleOutput(false);
+        log0.setLogFile(path0);
+        log1.setLogFile(path1);
+
+        PioStateMachine sm0, sm1;
+        sm1.stateMachineNumber = 1;
+        sm0.log_context.setSink(&log0);
+        sm1.log_context.setSink(&log1);
+        for (PioStateMachine* pio : { &sm0, &sm1 })
+            pio->instructionMemory.fill(0xe001); // set    pins, 1 (set_base/set_count left unset, warns)
+
+        sm0.tick();
+        sm1.tick();
+        sm1.log_context.setEnabled(false); // silenced, sm0 keeps logging
+        sm0.tick();
+        sm1.tick();
+        sm0.log_context.setLevel(Logger::LogLevel::LEVEL_FATAL);
+        sm0.tick();
+        log0.flush();
+        log1.flush();
+    }
+
+    auto lines0 = readLines(path0);
+    auto lines1 = readLines(path1);
+    REQUIRE(lines0.size() == 4); // two warnings per tick
+    CHECK(lines0[0].rfind("[WARN ] [sm0 @0] 'set_base' isn't set", 0) == 0);
+    CHECK(lines0[2].rfind("[WARN ] [sm0 @1] ", 0) == 0);
+    REQUIRE(lines1.size() == 2);
+    CHECK(lines1[0].rfind("[WARN ] [sm1 @0] ", 0) == 0);
+    std::remove(path0);
+    std::remove(path1);
+}
@@ -0,0 +1,85 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioPinStats.h"
+#include "pio_test_programs.h"
+
+TEST_CASE("pulse widths, period and duty cycle of a blink")
+{
+    PioStateMachine pio;
+    PioPinStats stats;
+    loadBlink(pio);
+    stats.watch(5);
+    pio.pin_stats = &stats;
+
+    // 8 clocks high, 4 + 1 + 4 * 2 + 3 = 16 low. The first sample only sets the level: the pin
+    // goes high on clock 0, the first edge seen is the fall at 8
+    for (int i = 0; i < 240; i++)
+        pio.tick();
+
+    const PioPinStats::Channel* channel = stats.find(5);
+    REQUIRE(channel != nullptr);
+    CHECK(channel->rising == 9);
+    CHECK(channel->falling == 10);
+    CHECK(channel->high.pulses == 9);
+    CHECK(channel->high.count(8) == 9);
+    CHECK(channel->high.min == 8);
+    CHECK(channel->high.max == 8);
+    CHECK(channel->low.pulses == 9);
+    CHECK(channel->low.count(16) == 9);
+    CHECK(channel->period.pulses == 8);
+    CHECK(channel->period.mean() == doctest::Approx(24.0));
+    CHECK(channel->dutyCycle() == doctest::Approx(8.0 / 24.0));
+    CHECK(channel->frequency(125e6) == doctest::Approx(125e6 / 24.0));
+
+    stats.reset();
+    CHECK(stats.find(5)->rising == 0);
+    CHECK(stats.find(5)->high.min == -1);
+    CHECK(stats.channels.size() == 1);
+}
+
+TEST_CASE("long pulses share the last bin, exact min/max")
+{
+    PioStateMachine pio;
+    PioPinStats stats;
+    pio.instructionMemory[0] = 0xff01; //  0: set    pins, 1 [31]
+    for (int i = 1; i < 10; i++)
+        pio.instructionMemory[i] = 0xbf42; // nop [31]
+    pio.instructionMemory[10] = 0xe000; // 10: set   pins, 0
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 10;
+    pio.gpio.pindirs[0] = 0;
+    stats.watch(0);
+    stats.watch(0);  // no duplicate
+    stats.watch(32); // not gpio0, ignored
+    CHECK(stats.find(32) == nullptr);
+    pio.pin_stats = &stats;
+
+    pio.run(321 * 3); // high 320 clocks, low 1, the first high pulse started before the first sample
+
+    REQUIRE(stats.channels.size() == 1);
+    const auto& channel = stats.channels[0];
+    CHECK(channel.high.pulses == 2);
+    CHECK(channel.high.min == 320);
+    CHECK(channel.high.count(320) == 2);
+    CHECK(channel.high.counts[PioPinStats::kWidthBins - 1] == 2);
+    CHECK(channel.low.count(1) == 2);
+}
+
+TEST_CASE("pin stats as JSON")
+{
+    PioStateMachine pio;
+    PioPinStats stats;
+    loadBlink(pio);
+    stats.watch(5);
+    pio.pin_stats = &stats;
+    pio.run(48);
+
+    std::string json = stats.toJson();
+    CHECK(json.rfind("{\"channels\":[{\"pin\":5,\"rising\":1,\"falling\":2,\"duty_cycle\":0.3333,", 0) == 0);
+    CHECK(json.find("\"high\":{\"pulses\":1,\"min\":8,\"max\":8,\"mean\":8.0000,\"histogram\":{\"8\":1}}") != std::string::npos);
+    CHECK(json.find("\"period\":{\"pulses\":0,\"min\":-1,") != std::string::npos);
+}
@@ -0,0 +1,90 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <string>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioProfiler.h"
+#include "pio_test_programs.h"
+
+TEST_CASE("cycles are counted per address")
+{
+    PioStateMachine pio;
+    PioProfiler profiler;
+    loadBlink(pio);
+    pio.profiler = &profiler;
+
+    // One pass through the loop is 8 + 4 + 1 + 4 * 2 + 3 = 24 clocks
+    for (int i = 0; i < 240; i++)
+        pio.tick();
+
+    CHECK(profiler.total() == 240);
+    CHECK(profiler.cycles[0][PioProfiler::Executing] == 10);
+    CHECK(profiler.cycles[0][PioProfiler::Delay] == 70);
+    CHECK(profiler.cycles[1][PioProfiler::Delay] == 30);
+    CHECK(profiler.cycles[2][PioProfiler::Executing] == 10);
+    CHECK(profiler.cycles[2][PioProfiler::Delay] == 0);
+    CHECK(profiler.cycles[3][PioProfiler::Executing] == 40);
+    CHECK(profiler.cycles[3][PioProfiler::Delay] == 40);
+    CHECK(profiler.total(4) == 30);
+    CHECK(profiler.total(PioProfiler::Executing) == 80);
+    CHECK(profiler.total(5) == 0);
+
+    profiler.reset();
+    CHECK(profiler.total() == 0);
+}
+
+TEST_CASE("stalls are split by cause")
+{
+    PioStateMachine pio;
+    PioProfiler profiler;
+    pio.profiler = &profiler;
+
+    SUBCASE("pull from an empty TX FIFO")
+    {
+        loadSingle(pio, 0x80a0); // pull block
+        pio.run(100);
+        CHECK(profiler.cycles[0][PioProfiler::Executing] == 1);
+        CHECK(profiler.cycles[0][PioProfiler::StallPull] == 99);
+    }
+
+    SUBCASE("push to a full RX FIFO")
+    {
+        loadSingle(pio, 0x8020); // push block
+        pio.fifo.rx_fifo_count = 4;
+        pio.run(100);
+        CHECK(profiler.cycles[0][PioProfiler::Executing] == 1);
+        CHECK(profiler.cycles[0][PioProfiler::StallPush] == 99);
+    }
+
+    SUBCASE("wait on a pin, stalls fast-forwarded by run() or ticked")
+    {
+        loadSingle(pio, 0x2083); // wait 1 gpio, 3
+        pio.run(60);
+        for (int i = 0; i < 40; i++)
+            pio.tick();
+        CHECK(profiler.cycles[0][PioProfiler::Executing] == 1);
+        CHECK(profiler.cycles[0][PioProfiler::StallWait] == 99);
+    }
+
+    SUBCASE("irq wait")
+    {
+        loadSingle(pio, 0xc020); // irq wait 0
+        pio.run(100);
+        CHECK(profiler.cycles[0][PioProfiler::Executing] == 1);
+        CHECK(profiler.cycles[0][PioProfiler::StallIrq] == 99);
+    }
+}
+
+TEST_CASE("profile as JSON")
+{
+    PioStateMachine pio;
+    PioProfiler profiler;
+    loadBlink(pio);
+    pio.instruction_text[0] = "set pins, 1 [7]";
+    pio.profiler = &profiler;
+    pio.run(24);
+
+    std::string json = profiler.toJson(&pio);
+    CHECK(json.rfind("{\"total_cycles\":24,\"addresses\":[{\"address\":0,\"instruction\":\"set pins, 1 [7]\",\"executing\":1,\"delay\":7,", 0) == 0);
+    CHECK(json.find("\"address\":5") == std::string::npos);
+    CHECK(profiler.toJson().find("instruction") == std::string::npos);
+}
@@ -0,0 +1,148 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioRecorder.h"
+#include "../../src/PioSnapshot.h"
+#include "../../src/PioStimulus.h"
+
+// Waits for pin 5, samples it into the RX FIFO and raises IRQ 1, once per TX word
+void loadProgram(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0x80a0; // 0: pull   block
+    pio.instructionMemory[1] = 0x2085; // 1: wait   1 gpio, 5
+    pio.instructionMemory[2] = 0x4001; // 2: in     pins, 1
+    pio.instructionMemory[3] = 0x8020; // 3: push   block
+    pio.instructionMemory[4] = 0xc001; // 4: irq    set 1
+    pio.settings.in_base = 5;
+    pio.settings.wrap_end = 4;
+}
+
+uint64_t stateHash(const PioStateMachine& pio)
+{
+    PioSnapshot snapshot{};
+    snapshot.capture(pio);
+    return snapshot.hash();
+}
+
+// A harness that pokes the machine from every side: stimulus, FIFOs, IRQs and set_var()
+PioRecording recordSession(uint64_t& final_hash)
+{
+    PioStateMachine pio;
+    loadProgram(pio);
+    PioStimulus stimulus;
+    for (int clock = 7; clock < 1000; clock += 13)
+        stimulus.add(clock, 5, (clock / 13) & 1);
+    pio.input_sources.push_back(&stimulus);
+
+    PioRecorder recorder;
+    recorder.start(pio);
+    pio.recorder = &recorder;
+    for (int i = 0; i < 25; i++)
+    {
+        if (pio.fifo.tx_fifo_count < 4)
+            pio.fifo.tx_fifo[pio.fifo.tx_fifo_count++] = 0x100u + i;
+        pio.run(37);
+        if (pio.fifo.rx_fifo_count > 0)
+        {
+            for (int j = 0; j < pio.fifo.rx_fifo_count - 1; j++)
+                pio.fifo.rx_fifo[j] = pio.fifo.rx_fifo[j + 1];
+            pio.fifo.rx_fifo[--pio.fifo.rx_fifo_count] = 0;
+        }
+        if (i % 5 == 4)
+        {
+            pio.irq_flags[1] = false;
+            pio.set_var("x", i);
+        }
+    }
+    pio.set_var("y", 0x1234); // after the last cycle: finish() keeps it
+    recorder.finish(pio);
+    pio.recorder = nullptr;
+
+    final_hash = stateHash(pio);
+    return recorder.recording;
+}
+
+TEST_CASE("state hash")
+{
+    PioStateMachine a, b;
+    loadProgram(a);
+    loadProgram(b);
+    CHECK(stateHash(a) == stateHash(b));
+    b.regs.x = 1;
+    CHECK(stateHash(a) != stateHash(b));
+    b.regs.x = 0;
+    b.clock = 1;
+    CHECK(stateHash(a) != stateHash(b));
+}
+
+TEST_CASE("replay reproduces a recorded session")
+{
+    uint64_t final_hash = 0;
+    PioRecording recording = recordSession(final_hash);
+    CHECK(recording.end_clock == 25 * 37);
+    CHECK(recording.end_hash == final_hash);
+    CHECK(recording.event_count > 25);
+    CHECK(recording.events.size() < 4096); // bytes that changed, not states
+
+    SUBCASE("headless, through run()'s fast paths")
+    {
+        PioStateMachine pio; // no program, no stimulus: everything comes from the recording
+        PioReplay replay(recording);
+        CHECK(replay.replay(pio));
+        CHECK(pio.clock == recording.end_clock);
+        CHECK(stateHash(pio) == final_hash);
+        CHECK(pio.regs.y == 0x1234);
+    }
+
+    SUBCASE("one cycle at a time")
+    {
+        PioStateMachine pio;
+        pio.cycle_accurate = true;
+        PioReplay replay(recording);
+        CHECK(replay.replay(pio));
+    }
+
+    SUBCASE("from a file")
+    {
+        const char* path = "test_recording.piorec";
+        recording.save(path);
+        PioRecording loaded;
+        loaded.load(path);
+        std::remove(path);
+        CHECK(loaded.event_count == recording.event_count);
+        CHECK(loaded.events == recording.events);
+        CHECK(loaded.end_clock == recording.end_clock);
+        CHECK(loaded.end_hash == recording.end_hash);
+
+        PioStateMachine pio;
+        PioReplay replay(loaded);
+        CHECK(replay.replay(pio));
+    }
+
+    SUBCASE("a changed program diverges")
+    {
+        PioStateMachine pio;
+        PioReplay replay(recording);
+        replay.begin(pio);
+        pio.instructionMemory[4] = 0xc002; // irq set 2
+        pio.input_sources.push_back(&replay);
+        pio.run(recording.end_clock);
+        CHECK_FALSE(replay.finish(pio));
+    }
+}
+
+TEST_CASE("recording file errors")
+{
+    PioRecording recording;
+    CHECK_THROWS(recording.load("does_not_exist.piorec"));
+
+    const char* path = "test_not_a_recording.piorec";
+    {
+        FILE* file = std::fopen(path, "wb");
+        std::fputs("PIOBLOG1 and more", file);
+        std::fclose(file);
+    }
+    CHECK_THROWS(recording.load(path));
+    std::remove(path);
+}
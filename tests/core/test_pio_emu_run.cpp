@@ -0,0 +1,192 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioFifoStats.h"
+#include "../../src/PioPinStats.h"
+#include "../../src/PioProfiler.h"
+#include "pio_test_programs.h"
+
+// run() must end up in exactly the same state as calling tick() the same number of times
+void checkSameState(const PioStateMachine& a, const PioStateMachine& b)
+{
+    CHECK(a.clock == b.clock);
+    CHECK(a.regs == b.regs);
+    CHECK(a.gpio == b.gpio);
+    CHECK(a.fifo == b.fifo);
+    CHECK(a.irq_flags == b.irq_flags);
+    CHECK(a.delay_delay == b.delay_delay);
+    CHECK(a.currentInstruction == b.currentInstruction);
+}
+
+TEST_CASE("run() matches tick()")
+{
+    SUBCASE("set/jmp blocks with delays")
+    {
+        for (int cycles = 0; cycles < 200; cycles += 3)
+        {
+            INFO("cycles: ", cycles);
+            PioStateMachine ticked, ran;
+            loadBlink(ticked, 31);
+            loadBlink(ran, 31);
+
+            for (int i = 0; i < cycles; i++)
+                ticked.tick();
+            CHECK(ran.run(cycles) == cycles);
+            checkSameState(ticked, ran);
+        }
+    }
+
+    SUBCASE("split into several run() calls")
+    {
+        PioStateMachine ticked, ran;
+        loadBlink(ticked, 31);
+        loadBlink(ran, 31);
+
+        for (int chunk = 1; chunk < 20; chunk++)
+        {
+            for (int i = 0; i < chunk; i++)
+                ticked.tick();
+            ran.run(chunk);
+            checkSameState(ticked, ran);
+        }
+    }
+
+    SUBCASE("cycle accurate mode falls back to tick()")
+    {
+        PioStateMachine ticked, ran;
+        loadBlink(ticked, 31);
+        loadBlink(ran, 31);
+        ran.cycle_accurate = true;
+
+        for (int i = 0; i < 57; i++)
+            ticked.tick();
+        ran.run(57);
+        checkSameState(ticked, ran);
+    }
+
+    SUBCASE("blocks mixed with fifo instructions")
+    {
+        auto load = [](PioStateMachine& pio) {
+            pio.instructionMemory[0] = 0x80a0; //  0: pull   block
+            pio.instructionMemory[1] = 0xa027; //  1: mov    x, osr
+            pio.instructionMemory[2] = 0xe101; //  2: set    pins, 1 [1]
+            pio.instructionMemory[3] = 0x0243; //  3: jmp    x--, 3 [2]
+            pio.instructionMemory[4] = 0xe000; //  4: set    pins, 0
+            pio.settings.set_base = 0;
+            pio.settings.set_count = 1;
+            pio.settings.wrap_start = 0;
+            pio.settings.wrap_end = 4;
+            pio.gpio.pindirs[0] = 0;
+            pio.fifo.tx_fifo[0] = 5;
+            pio.fifo.tx_fifo[1] = 2;
+            pio.fifo.tx_fifo_count = 2;
+        };
+
+        for (int cycles = 0; cycles < 80; cycles++)
+        {
+            INFO("cycles: ", cycles);
+            PioStateMachine ticked, ran;
+            load(ticked);
+            load(ran);
+
+            for (int i = 0; i < cycles; i++)
+                ticked.tick();
+            ran.run(cycles);
+            checkSameState(ticked, ran);
+        }
+    }
+}
+
+TEST_CASE("run() fast-forwards stalls")
+{
+    PioStateMachine pio;
+
+    SUBCASE("wait on a pin nobody drives")
+    {
+        pio.instructionMemory[0] = 0x2083; //  0: wait   1 gpio, 3
+        CHECK(pio.run(100000) == 100000);
+        CHECK(pio.clock == 100000);
+        CHECK(pio.regs.pc == 0);
+        CHECK(pio.wait_is_stalling == true);
+
+        // Host changes the pin between runs, the sm moves on
+        pio.gpio.raw_data[3] = 1;
+        pio.run(1);
+        CHECK(pio.wait_is_stalling == false);
+        CHECK(pio.regs.pc == 1);
+    }
+
+    SUBCASE("pull on an empty fifo")
+    {
+        pio.instructionMemory[0] = 0x80a0; //  0: pull   block
+        pio.instructionMemory[1] = 0xa027; //  1: mov    x, osr
+        pio.run(5000);
+        CHECK(pio.clock == 5000);
+        CHECK(pio.fifo.pull_is_stalling == true);
+        CHECK(pio.regs.pc == 0);
+
+        pio.fifo.tx_fifo[0] = 0x1234;
+        pio.fifo.tx_fifo_count = 1;
+        pio.run(2);
+        CHECK(pio.regs.x == 0x1234);
+        CHECK(pio.regs.pc == 2);
+    }
+}
+
+TEST_CASE("run() fast paths feed the profiler and statistics like tick()")
+{
+    struct Observed
+    {
+        PioStateMachine pio;
+        PioProfiler profile;
+        PioFifoStats fifo_stats;
+        PioPinStats pin_stats;
+        Observed()
+        {
+            pio.profiler = &profile;
+            pio.fifo_stats = &fifo_stats;
+            pin_stats.watch(5);
+            pio.pin_stats = &pin_stats;
+        }
+    };
+    Observed fast, slow;
+    int cycles = 100000;
+
+    SUBCASE("set/jmp blocks with delays")
+    {
+        loadBlink(fast.pio);
+        loadBlink(slow.pio);
+    }
+    SUBCASE("stalled pull")
+    {
+        loadSingle(fast.pio, 0x80a0); // pull block
+        loadSingle(slow.pio, 0x80a0);
+    }
+    SUBCASE("autopull in a block")
+    {
+        loadAutopull(fast.pio);
+        loadAutopull(slow.pio);
+        fast.pio.fifo.tx_fifo_count = slow.pio.fifo.tx_fifo_count = 3;
+    }
+
+    fast.pio.run(cycles);
+    fast.pio.run(1234); // stops inside a delay or stall
+    for (int i = 0; i < cycles + 1234; i++)
+        slow.pio.tick();
+
+    CHECK(fast.profile.cycles == slow.profile.cycles);
+    CHECK(fast.profile.total() == static_cast<uint64_t>(cycles + 1234));
+
+    CHECK(fast.fifo_stats.tx.cycles == slow.fifo_stats.tx.cycles);
+    CHECK(fast.fifo_stats.rx.cycles == slow.fifo_stats.rx.cycles);
+    CHECK(fast.fifo_stats.tx_stall_cycles == slow.fifo_stats.tx_stall_cycles);
+    CHECK(fast.fifo_stats.event_counts == slow.fifo_stats.event_counts);
+
+    const auto& a = fast.pin_stats.channels[0];
+    const auto& b = slow.pin_stats.channels[0];
+    CHECK(a.rising == b.rising);
+    CHECK(a.falling == b.falling);
+    CHECK(a.high.counts == b.high.counts);
+    CHECK(a.low.counts == b.low.counts);
+    CHECK(a.period.counts == b.period.counts);
+}
@@ -0,0 +1,335 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../../src/PioProfiler.h"
+#include "../../src/PioProgram.h"
+#include "../../src/PioRunner.h"
+#include "../../src/PioStateMachine.h"
+
+// What pioasm -o c-sdk writes, trimmed: an echo program (TX word -> RX) and a side-set one
+static const char* kHeader = R"(// -------------------------------------------------- //
+// This file is autogenerated by pioasm; do not edit! //
+// -------------------------------------------------- //
+
+#pragma once
+
+// ---- //
+// echo //
+// ---- //
+
+#define echo_wrap_target 0
+#define echo_wrap 3
+#define echo_pio_version 0
+
+static const uint16_t echo_program_instructions[] = {
+            //     .wrap_target
+    0x80a0, //  0: pull   block
+    0xa027, //  1: mov    x, osr
+    0x4020, //  2: in     x, 32
+    0x8020, //  3: push   block
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static inline pio_sm_config echo_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + echo_wrap_target, offset + echo_wrap);
+    return c;
+}
+#endif
+
+// ----- //
+// blink //
+// ----- //
+
+#define blink_wrap_target 1
+#define blink_wrap 2
+
+static const uint16_t blink_program_instructions[] = {
+    0xe001, //  0: set    pins, 1
+            //     .wrap_target
+    0xb842, //  1: nop                    side 1
+    0xa042, //  2: nop
+            //     .wrap
+};
+
+#if !PICO_NO_HARDWARE
+static inline pio_sm_config blink_program_get_default_config(uint offset) {
+    pio_sm_config c = pio_get_default_sm_config();
+    sm_config_set_wrap(&c, offset + blink_wrap_target, offset + blink_wrap);
+    sm_config_set_sideset(&c, 2, true, false);
+    return c;
+}
+#endif
+)";
+
+static void writeFile(const char* path, const std::string& text)
+{
+    std::ofstream(path) << text;
+}
+
+static std::string readFile(const char* path)
+{
+    std::ifstream file(path);
+    std::stringstream text;
+    text << file.rdbuf();
+    return text.str();
+}
+
+static std::vector<uint32_t> testWords(int count, uint32_t seed)
+{
+    std::vector<uint32_t> words;
+    for (int i = 0; i < count; i++)
+        words.push_back(seed * (i + 1) ^ 0x5a5a0000u);
+    return words;
+}
+
+TEST_CASE("pioasm headers load like the generated .ini")
+{
+    writeFile("test_runner_program.h", kHeader);
+    PioStateMachine pio;
+
+    SUBCASE("the first program by default")
+    {
+        PioProgram::load(pio, "test_runner_program.h");
+        CHECK(pio.instructionMemory[0] == 0x80a0);
+        CHECK(pio.instructionMemory[3] == 0x8020);
+        CHECK(pio.instructionMemory[4] == 0xa042); // the rest stays nop
+        CHECK(pio.instruction_text[1] == "mov    x, osr");
+        CHECK(pio.settings.wrap_start == 0);
+        CHECK(pio.settings.wrap_end == 3);
+        CHECK(pio.settings.sideset_count == 0);
+        CHECK(pio.gpio.pindirs[5] == 1);
+    }
+
+    SUBCASE("a program by name, side-set from its default config")
+    {
+        PioProgram::loadPioasmHeader(pio, "test_runner_program.h", "blink");
+        CHECK(pio.instructionMemory[1] == 0xb842);
+        CHECK(pio.instruction_text[1] == "nop                    side 1");
+        CHECK(pio.settings.wrap_start == 1);
+        CHECK(pio.settings.wrap_end == 2);
+        CHECK(pio.settings.sideset_count == 1);
+        CHECK(pio.settings.sideset_opt);
+    }
+
+    SUBCASE("errors")
+    {
+        CHECK_THROWS(PioProgram::loadPioasmHeader(pio, "test_runner_program.h", "missing"));
+        CHECK_THROWS(PioProgram::load(pio, "test_runner_missing.h"));
+    }
+    std::remove("test_runner_program.h");
+}
+
+TEST_CASE("the host FIFOs keep up with the program")
+{
+    writeFile("test_runner_program.h", kHeader);
+    PioStateMachine pio;
+    PioProgram::load(pio, "test_runner_program.h");
+    std::remove("test_runner_program.h");
+
+    PioHostFifos host;
+    host.tx = testWords(100, 0x01234567);
+    host.drain_rx = true;
+    pio.input_sources.push_back(&host);
+    PioProfiler profiler;
+    pio.profiler = &profiler;
+
+    // 4 clocks a word, no stall while words are left
+    pio.run(400);
+    CHECK(host.txSent() == 100);
+    CHECK(profiler.total(PioProfiler::StallPull) == 0);
+    CHECK(profiler.total(PioProfiler::StallPush) == 0);
+    host.drain(pio);
+    CHECK(host.rx == host.tx);
+
+    // Out of words the pull stalls (after its fetch) for good, the host stops looking and the
+    // stall is fast-forwarded
+    pio.run(100);
+    CHECK(profiler.total(PioProfiler::StallPull) == 99);
+    CHECK(host.nextEventClock() == -1);
+}
+
+// Drives one pin high at a clock, like a stimulus file would
+struct PinHighAt : PioInputSource
+{
+    int pin;
+    int clock;
+    PinHighAt(int pin, int clock) : pin(pin), clock(clock) {}
+    int nextEventClock() const override { return clock; }
+    void apply(PioStateMachine& pio) override
+    {
+        pio.gpio.external_data[pin] = 1;
+        clock = -1;
+    }
+};
+
+TEST_CASE("the host only looks at RX while the program can push")
+{
+    PioStateMachine pio;
+    PioHostFifos host;
+    host.drain_rx = true;
+    pio.input_sources.push_back(&host);
+
+    SUBCASE("a program without push")
+    {
+        pio.instructionMemory[0] = 0xa042; // nop
+        pio.settings.wrap_start = 0;
+        pio.settings.wrap_end = 0;
+        pio.run(100);
+        CHECK(host.nextEventClock() == -1);
+    }
+
+    SUBCASE("a program waiting on a pin")
+    {
+        pio.instructionMemory[0] = 0x2083; // wait 1 gpio, 3
+        pio.instructionMemory[1] = 0x8020; // push block
+        pio.settings.wrap_start = 0;
+        pio.settings.wrap_end = 1;
+        PinHighAt pin(3, 500);
+        pio.input_sources.push_back(&pin);
+        PioProfiler profiler;
+        pio.profiler = &profiler;
+
+        // Stalled on the wait: look again when the pin source does something, not every 4 clocks
+        pio.run(100);
+        CHECK(host.nextEventClock() == 500);
+        pio.run(900);
+        CHECK(profiler.total(PioProfiler::StallPush) == 0);
+        CHECK(host.rx.size() + pio.fifo.rx_fifo_count == 250); // a push every other clock from 500 on
+    }
+}
+
+TEST_CASE("command lines")
+{
+    PioRunner::Options options = PioRunner::parseArgs({ "prog.ini", "--cycles", "0x100", "--until", "x == 5", "--break", "3",
+        "--set", "out_base=2", "--var", "y=-1", "--sr", "out.sr", "--pins", "0-2,22", "--json" });
+    CHECK(options.program == "prog.ini");
+    CHECK(options.cycles == 256);
+    CHECK(options.until == std::vector<std::string>{ "x == 5" });
+    CHECK(options.break_pcs == std::vector<int>{ 3 });
+    CHECK(options.settings[0].first == "out_base");
+    CHECK(options.settings[0].second == "2");
+    CHECK(options.vars[0].second == 0xffffffffu);
+    CHECK(options.sr_pins == std::vector<int>{ 0, 1, 2, 22 });
+    CHECK(options.json);
+
+    CHECK_THROWS(PioRunner::parseArgs({}));
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--cycles" }));
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--cycles", "12x" }));
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--break", "32" }));
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--sr", "out.sr", "--pins", "5-3" }));
+    CHECK(PioRunner::parseArgs({ "prog.ini", "--cycles", "010" }).cycles == 10); // decimal, like the debugger
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--bogus", "1" }));
+    CHECK_THROWS(PioRunner::parseArgs({ "prog.ini", "--sr", "out.sr" }));
+
+    CHECK(PioRunner::splitLine("  a.ini --until 'x == 5'\t--tx \"my words.txt\" ")
+        == std::vector<std::string>{ "a.ini", "--until", "x == 5", "--tx", "my words.txt" });
+    CHECK_THROWS(PioRunner::splitLine("a.ini --until 'x"));
+}
+
+TEST_CASE("headless sessions")
+{
+    writeFile("test_runner_program.h", kHeader);
+    std::string words;
+    for (uint32_t word : testWords(50, 7))
+        words += std::to_string(word) + "\n";
+    writeFile("test_runner_tx.txt", "# words\n" + words);
+
+    SUBCASE("TX in, RX out, stopped by an expression")
+    {
+        PioRunner::Options options = PioRunner::parseArgs({ "test_runner_program.h", "--tx", "test_runner_tx.txt",
+            "--rx", "test_runner_rx.txt", "--until", "x == (0x5a5a0000 ^ 70) && pc == 2", "--summary", "test_runner_summary.json" });
+        PioRunner::Result result = PioRunner::run(options);
+        CHECK(result.stop == "breakpoint");
+        CHECK(result.detail == "x == (0x5a5a0000 ^ 70) && pc == 2");
+        CHECK(result.exitCode() == 0);
+        CHECK(result.x == (0x5a5a0000u ^ 70));
+        CHECK(result.clock == 4 * 9 + 2); // the 10th word (7 * 10) sits in x before its 'in'
+        CHECK(result.tx_words == 13);     // the FIFO is topped up ahead of the program
+        CHECK(result.rx_words == 9);
+
+        std::vector<uint32_t> sent = testWords(9, 7);
+        CHECK(PioHostFifos::loadWords("test_runner_rx.txt") == sent);
+
+        std::string summary = readFile("test_runner_summary.json");
+        CHECK(summary.find("\"stop\":\"breakpoint\"") != std::string::npos);
+        CHECK(summary.find("\"exit_code\":0") != std::string::npos);
+        std::remove("test_runner_rx.txt");
+        std::remove("test_runner_summary.json");
+    }
+
+    SUBCASE("a stop condition that never comes fails the run")
+    {
+        PioRunner::Result result = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--cycles", "1000", "--until", "y == 1" }));
+        CHECK(result.stop == "cycles");
+        CHECK(result.cycles == 1000);
+        CHECK(result.exitCode() == 1);
+    }
+
+    SUBCASE("bad sessions are errors, not exceptions")
+    {
+        PioRunner::Result result = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--set", "bogus=1" }));
+        CHECK(result.stop == "error");
+        CHECK(result.exitCode() == 2);
+        result = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--until", "x ==" }));
+        CHECK(result.exitCode() == 2);
+        result = PioRunner::run(PioRunner::parseArgs({ "test_runner_missing.ini" }));
+        CHECK(result.exitCode() == 2);
+        CHECK(result.toJson().find("\"stop\":\"error\"") != std::string::npos);
+    }
+
+    SUBCASE("golden state hashes")
+    {
+        PioRunner::Result golden = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--tx", "test_runner_tx.txt",
+            "--rx", "test_runner_rx.txt", "--cycles", "5000", "--hash", "test_runner_golden.hash", "--hash-interval", "64" }));
+        REQUIRE(golden.exitCode() == 0);
+        CHECK(golden.hashed);
+
+        PioRunner::Result same = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--tx", "test_runner_tx.txt",
+            "--rx", "test_runner_rx.txt", "--cycles", "5000", "--expect-hash", "test_runner_golden.hash" }));
+        CHECK(same.hash_checked);
+        CHECK_FALSE(same.diverged);
+        CHECK(same.hash == golden.hash);
+        CHECK(same.exitCode() == 0);
+
+        // Word 32 changed: it goes into the TX FIFO at clock 116 and is still there at the mark at 128
+        // (marks only see the state at their clock, a word that comes and goes in between is missed)
+        std::vector<uint32_t> changed = testWords(50, 7);
+        changed[32] ^= 1;
+        std::string text;
+        for (uint32_t word : changed)
+            text += std::to_string(word) + " ";
+        writeFile("test_runner_changed.txt", text);
+        PioRunner::Result different = PioRunner::run(PioRunner::parseArgs({ "test_runner_program.h", "--tx", "test_runner_changed.txt",
+            "--rx", "test_runner_rx.txt", "--cycles", "5000", "--expect-hash", "test_runner_golden.hash" }));
+        CHECK(different.diverged);
+        CHECK(different.good_clock == 64);
+        CHECK(different.bad_clock == 128);
+        CHECK(different.exitCode() == 1);
+        std::remove("test_runner_changed.txt");
+        std::remove("test_runner_golden.hash");
+        std::remove("test_runner_rx.txt");
+    }
+
+    SUBCASE("batches run in parallel, results in job order")
+    {
+        std::vector<PioRunner::Options> jobs;
+        for (int i = 0; i < 6; i++)
+            jobs.push_back(PioRunner::parseArgs({ "test_runner_program.h", "--tx", "test_runner_tx.txt", "--cycles", std::to_string(100 * (i + 1)) }));
+        jobs[3].program = "test_runner_missing.ini";
+
+        std::vector<PioRunner::Result> results = PioRunner::runBatch(jobs, 3);
+        REQUIRE(results.size() == 6);
+        for (int i = 0; i < 6; i++)
+            CHECK(results[i].cycles == (i == 3 ? 0 : 100 * (i + 1)));
+        CHECK(results[3].exitCode() == 2);
+    }
+
+    std::remove("test_runner_program.h");
+    std::remove("test_runner_tx.txt");
+}
@@ -0,0 +1,187 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+#include "../../src/PioBitOps.h"
+#include "../../src/PioSigrok.h"
+#include "../../src/PioStateMachine.h"
+
+// Pin 0 toggles with uneven high and low times
+void loadProgram(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0xe101; // 0: set    pins, 1   [1]
+    pio.instructionMemory[1] = 0xe300; // 1: set    pins, 0   [3]
+    pio.instructionMemory[2] = 0x0040; // 2: jmp    x--, 0
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_end = 2;
+    pio.gpio.pindirs[0] = 0;
+}
+
+// The capture, clock by clock, as the machine would see it
+std::vector<int8_t> replay(PioSigrokCapture& capture, int pin, int clocks)
+{
+    PioStateMachine pio;
+    std::vector<int8_t> levels;
+    for (pio.clock = 0; pio.clock < clocks; pio.clock++)
+    {
+        capture.apply(pio);
+        levels.push_back(pio.gpio.external_data[pin]);
+    }
+    return levels;
+}
+
+TEST_CASE("an exported session reads back cycle for cycle")
+{
+    for (bool compress : { false, true })
+    {
+        const char* path = "test_sigrok.sr";
+        PioStateMachine pio, reference;
+        loadProgram(pio);
+        loadProgram(reference);
+
+        std::vector<int8_t> expected;
+        for (int i = 0; i < 5000; i++)
+        {
+            reference.tick();
+            expected.push_back(reference.gpio.raw_data[0]);
+        }
+
+        {
+            PioSigrokWriter writer(path, { 0, 7 }, 125e6, compress);
+            writer.chunk_bytes = 1000; // several logic-1-N entries
+            writer.begin(pio);
+            pio.run(5000);
+            writer.finish(pio);
+            CHECK(writer.samples() == 5000);
+            CHECK(pio.pin_listeners.empty());
+        }
+
+        PioSigrokCapture::Options options;
+        options.sm_clock_hz = 125e6;
+        options.start_clock = 1; // sample 0 is the level before the first tick
+        PioSigrokCapture capture(path, options);
+        CHECK(capture.sampleRate() == 125e6);
+        REQUIRE(capture.channels().size() == 2);
+        CHECK(capture.channels()[0] == "gpio0");
+        CHECK(capture.pins() == std::vector<int>{ 0, 7 });
+
+        std::vector<int8_t> levels = replay(capture, 0, 5001);
+        levels.erase(levels.begin());
+        CHECK(levels == expected);
+        CHECK(capture.samplesRead() == 5000);
+        CHECK(capture.nextEventClock() == -1);
+        std::remove(path);
+    }
+}
+
+TEST_CASE("CSV captures are resampled to SM clocks")
+{
+    const char* path = "test_sigrok.csv";
+    {
+        std::ofstream csv(path);
+        csv << "; CSV generated by libsigrok\n";
+        csv << "; Samplerate: 1 MHz\n";
+        csv << "Time [s],D0,D3\n";
+        csv << "0.000000,0,1\n0.000001,1,1\n0.000002,1,0\n0.000003,0,0\n0.000004,0,1\n";
+    }
+
+    SUBCASE("capture slower than the SM: one sample spans four clocks")
+    {
+        PioSigrokCapture::Options options;
+        options.sm_clock_hz = 4e6;
+        PioSigrokCapture capture(path, options);
+        CHECK(capture.sampleRate() == 1e6);
+        CHECK(capture.pins() == std::vector<int>{ 0, 3 });
+
+        std::vector<int> clocks;
+        PioStateMachine pio;
+        while (capture.nextEventClock() >= 0)
+        {
+            clocks.push_back(capture.nextEventClock());
+            pio.clock = capture.nextEventClock();
+            capture.apply(pio);
+        }
+        CHECK(clocks == std::vector<int>{ 0, 4, 8, 12, 16 });
+        PioSigrokCapture again(path, options);
+        CHECK(replay(again, 3, 20) == std::vector<int8_t>{ 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1 });
+    }
+
+    SUBCASE("capture faster than the SM: the last sample of a clock wins")
+    {
+        PioSigrokCapture::Options options;
+        options.sm_clock_hz = 0.5e6;
+        options.pins = { 10, 11 };
+        PioSigrokCapture capture(path, options);
+        // clock 0: samples 0 and 1, clock 1: samples 2 and 3, clock 2: sample 4
+        CHECK(replay(capture, 10, 3) == std::vector<int8_t>{ 1, 0, 0 });
+    }
+
+    SUBCASE("run() stops at every change")
+    {
+        PioSigrokCapture::Options options;
+        options.sm_clock_hz = 4e6;
+        options.start_clock = 100;
+        PioSigrokCapture capture(path, options);
+        PioStateMachine pio;
+        pio.instructionMemory[0] = 0x2083; // 0: wait 1 gpio, 3
+        pio.instructionMemory[1] = 0x2003; // 1: wait 0 gpio, 3
+        pio.instructionMemory[2] = 0xe021; // 2: set    x, 1
+        pio.settings.wrap_end = 2;
+        pio.input_sources.push_back(&capture);
+        pio.run(200);
+        CHECK(pio.gpio.external_data[3] == 1);
+        CHECK(pio.regs.x == 1); // saw the pin fall at 108
+    }
+    std::remove(path);
+}
+
+TEST_CASE("unusable captures")
+{
+    PioSigrokCapture::Options options;
+    CHECK_THROWS(PioSigrokCapture{ "does_not_exist.sr", options });
+
+    const char* path = "test_sigrok_bad.sr";
+    {
+        std::ofstream file(path);
+        file << "not a zip archive at all, not even close";
+    }
+    CHECK_THROWS(PioSigrokCapture{ path, options });
+
+    // A central directory entry that promises ZIP64 sizes in an extra field too short to hold them
+    {
+        std::vector<uint8_t> zip(30 + 46 + 8 + 4 + 22, 0);
+        auto put16 = [&](size_t at, uint32_t value) { zip[at] = value & 0xff; zip[at + 1] = (value >> 8) & 0xff; };
+        auto put32 = [&](size_t at, uint32_t value) { put16(at, value & 0xffff); put16(at + 2, value >> 16); };
+        put32(0, 0x04034b50);  // local header
+        put32(30, 0x02014b50); // central header
+        put32(30 + 20, 0xffffffff);
+        put32(30 + 24, 0xffffffff);
+        put16(30 + 28, 8);     // name length
+        put16(30 + 30, 4);     // extra length
+        std::copy_n("metadata", 8, zip.begin() + 30 + 46);
+        put16(30 + 46 + 8, 1); // ZIP64 extra field, no values
+        size_t end = 30 + 46 + 8 + 4;
+        put32(end, 0x06054b50);
+        put16(end + 10, 1);    // entries
+        put32(end + 16, 30);   // directory offset
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(zip.data()), static_cast<std::streamsize>(zip.size()));
+    }
+    CHECK_THROWS(PioSigrokCapture{ path, options });
+    std::remove(path);
+
+    // No sample rate anywhere
+    const char* csv = "test_sigrok_norate.csv";
+    {
+        std::ofstream file(csv);
+        file << "D0\n0\n1\n";
+    }
+    CHECK_THROWS(PioSigrokCapture{ csv, options });
+    options.sample_rate = 1e6;
+    PioSigrokCapture capture(csv, options);
+    CHECK(capture.channels().size() == 1);
+    std::remove(csv);
+}
@@ -0,0 +1,118 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <stdexcept>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioStateHash.h"
+#include "../../src/PioStimulus.h"
+
+// Blocks, delays and a stall on the TX FIFO, so run() takes every fast path
+void loadProgram(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0xe03f; // 0: set    x, 31
+    pio.instructionMemory[1] = 0xe301; // 1: set    pins, 1   [3]
+    pio.instructionMemory[2] = 0xe500; // 2: set    pins, 0   [5]
+    pio.instructionMemory[3] = 0x0041; // 3: jmp    x--, 1
+    pio.instructionMemory[4] = 0x80a0; // 4: pull   block
+    pio.instructionMemory[5] = 0x2085; // 5: wait   1 gpio, 5
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_end = 5;
+    pio.gpio.pindirs[0] = 0;
+}
+
+void runSession(PioStateMachine& pio, PioStateHash& hash, int poke_clock = -1)
+{
+    loadProgram(pio);
+    PioStimulus stimulus;
+    for (int clock = 50; clock < 20000; clock += 777)
+        stimulus.add(clock, 5, (clock / 777) & 1);
+    pio.input_sources.push_back(&stimulus);
+    pio.state_hash = &hash;
+
+    for (int i = 0; i < 40; i++)
+    {
+        if (pio.fifo.tx_fifo_count < 4)
+            pio.fifo.tx_fifo[pio.fifo.tx_fifo_count++] = i;
+        if (poke_clock >= 0 && pio.clock >= poke_clock)
+        {
+            pio.regs.y ^= 1; // a bug that shows up late
+            poke_clock = -1;
+        }
+        pio.run(500);
+    }
+    hash.finish(pio);
+    pio.state_hash = nullptr;
+    pio.input_sources.clear();
+}
+
+TEST_CASE("the marks don't depend on the execution engine")
+{
+    PioStateMachine fast, slow;
+    slow.cycle_accurate = true;
+    PioStateHash fast_hash(256), slow_hash(256);
+    runSession(fast, fast_hash);
+    runSession(slow, slow_hash);
+
+    CHECK(fast.clock == 20000);
+    REQUIRE(fast_hash.marks.size() == 20000 / 256);
+    CHECK(fast_hash.marks[0].clock == 256);
+    CHECK(fast_hash.marks.back().clock == 78 * 256);
+    CHECK_FALSE(PioStateHash::compare(fast_hash, slow_hash).found);
+    CHECK(fast_hash.current() == slow_hash.current());
+}
+
+TEST_CASE("first divergence")
+{
+    PioStateMachine a, b;
+    PioStateHash hash_a(256), hash_b(256);
+    runSession(a, hash_a);
+    runSession(b, hash_b, 12000);
+
+    PioStateHash::Divergence divergence = PioStateHash::compare(hash_a, hash_b);
+    REQUIRE(divergence.found);
+    CHECK(divergence.bad_clock == 12032); // the first mark after the poke at 12000
+    CHECK(divergence.good_clock == 11776);
+    CHECK(divergence.index == 46);
+
+    // Once apart, every later mark differs too (the hash is rolling)
+    CHECK(hash_a.marks.back().hash != hash_b.marks.back().hash);
+}
+
+TEST_CASE("state hash files")
+{
+    PioStateMachine pio;
+    PioStateHash hash(1000);
+    runSession(pio, hash);
+
+    const char* path = "test_state_hash.txt";
+    hash.save(path);
+    PioStateHash loaded;
+    loaded.load(path);
+    std::remove(path);
+
+    CHECK(loaded.interval == 1000);
+    CHECK(loaded.marks.size() == hash.marks.size());
+    CHECK_FALSE(PioStateHash::compare(hash, loaded).found);
+    CHECK(loaded.current() == hash.current());
+    CHECK(loaded.nextClock() == hash.nextClock());
+
+    PioStateHash other(500);
+    CHECK_THROWS(PioStateHash::compare(hash, other));
+    CHECK_THROWS(loaded.load("does_not_exist.txt"));
+}
+
+TEST_CASE("only the architectural state counts")
+{
+    PioStateMachine a, b;
+    loadProgram(a);
+    loadProgram(b);
+    CHECK(PioStateHash::stateHash(a) == PioStateHash::stateHash(b));
+
+    b.fifo.tx_fifo[3] = 0xdead; // past the count: not state
+    b.skip_delay = true;        // emulator bookkeeping
+    CHECK(PioStateHash::stateHash(a) == PioStateHash::stateHash(b));
+
+    b.fifo.tx_fifo_count = 4;
+    CHECK(PioStateHash::stateHash(a) != PioStateHash::stateHash(b));
+}
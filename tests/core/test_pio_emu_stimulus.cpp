@@ -0,0 +1,203 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <fstream>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioStimulus.h"
+
+void loadWaitProgram(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0x2083; //  0: wait   1 gpio, 3
+    pio.instructionMemory[1] = 0xe101; //  1: set    pins, 1 [1]
+    pio.instructionMemory[2] = 0x2003; //  2: wait   0 gpio, 3
+    pio.instructionMemory[3] = 0xe000; //  3: set    pins, 0
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 3;
+    pio.gpio.pindirs[0] = 0;
+}
+
+void loadStimulus(PioStimulus& stimulus)
+{
+    stimulus.add(37, 3, 1);
+    stimulus.add(120, 3, 0);
+    stimulus.add(121, 3, 1); // one clock pulse low
+    stimulus.add(500, 3, -1);
+}
+
+TEST_CASE("stimulus events are applied at their clock")
+{
+    PioStateMachine pio;
+    PioStimulus stimulus;
+    loadWaitProgram(pio);
+    loadStimulus(stimulus);
+    pio.input_sources.push_back(&stimulus);
+
+    CHECK(stimulus.nextEventClock() == 37);
+    for (int i = 0; i < 37; i++)
+        pio.tick();
+    CHECK(pio.regs.pc == 0);
+    CHECK(pio.gpio.external_data[3] == -1);
+
+    pio.tick(); // clock 37
+    CHECK(pio.gpio.external_data[3] == 1);
+    CHECK(stimulus.nextEventClock() == 120);
+}
+
+TEST_CASE("run() with stimulus matches tick()")
+{
+    for (int cycles = 0; cycles < 600; cycles += 7)
+    {
+        INFO("cycles: ", cycles);
+        PioStateMachine ticked, ran;
+        PioStimulus ticked_stimulus, ran_stimulus;
+        loadWaitProgram(ticked);
+        loadWaitProgram(ran);
+        loadStimulus(ticked_stimulus);
+        loadStimulus(ran_stimulus);
+        ticked.input_sources.push_back(&ticked_stimulus);
+        ran.input_sources.push_back(&ran_stimulus);
+
+        for (int i = 0; i < cycles; i++)
+            ticked.tick();
+        CHECK(ran.run(cycles) == cycles);
+
+        CHECK(ticked.clock == ran.clock);
+        CHECK(ticked.regs == ran.regs);
+        CHECK(ticked.gpio == ran.gpio);
+        CHECK(ticked.delay_delay == ran.delay_delay);
+        CHECK(ticked_stimulus.nextEventClock() == ran_stimulus.nextEventClock());
+    }
+}
+
+TEST_CASE("events at the same clock keep their order")
+{
+    PioStimulus stimulus;
+    stimulus.add(10, 1, 1);
+    stimulus.add(5, 2, 1);
+    stimulus.add(10, 1, 0);
+
+    const auto& events = stimulus.events();
+    REQUIRE(events.size() == 3);
+    CHECK(events[0].clock == 5);
+    CHECK(events[1].value == 1);
+    CHECK(events[2].value == 0);
+
+    PioStateMachine pio;
+    pio.clock = 10;
+    stimulus.apply(pio);
+    CHECK(pio.gpio.external_data[1] == 0);
+    CHECK(pio.gpio.external_data[2] == 1);
+    CHECK(stimulus.nextEventClock() == -1);
+
+    stimulus.rewind();
+    CHECK(stimulus.nextEventClock() == 5);
+}
+
+TEST_CASE("load stimulus files")
+{
+    SUBCASE("csv")
+    {
+        const char* path = "test_stimulus.csv";
+        {
+            std::ofstream file(path);
+            file << "clock,pin,value\n"
+                 << "# comment\n"
+                 << "100, 4, 1\n"
+                 << "20,4,0\n"
+                 << "300,4,z\n";
+        }
+
+        PioStimulus stimulus;
+        stimulus.loadCsv(path);
+        std::remove(path);
+
+        const auto& events = stimulus.events();
+        REQUIRE(events.size() == 3);
+        CHECK(events[0].clock == 20);
+        CHECK(events[0].value == 0);
+        CHECK(events[1].clock == 100);
+        CHECK(events[1].pin == 4);
+        CHECK(events[2].value == -1);
+    }
+
+    SUBCASE("vcd")
+    {
+        const char* path = "test_stimulus.vcd";
+        {
+            std::ofstream file(path);
+            file << "$timescale 1 us $end\n"
+                 << "$scope module top $end\n"
+                 << "$var wire 1 ! gpio3 $end\n"
+                 << "$var wire 1 \" clk $end\n"
+                 << "$var wire 8 # bus $end\n"
+                 << "$upscope $end\n"
+                 << "$enddefinitions $end\n"
+                 << "#0\n"
+                 << "$dumpvars 0! 0\" b0 # $end\n"
+                 << "#2\n"
+                 << "1!\n"
+                 << "1\"\n"
+                 << "#5\n"
+                 << "x!\n";
+        }
+
+        PioStimulus stimulus;
+        stimulus.loadVcd(path, 1e6); // 1 MHz, one sm clock per us
+        std::remove(path);
+
+        const auto& events = stimulus.events();
+        REQUIRE(events.size() == 3);
+        CHECK(events[0].clock == 0);
+        CHECK(events[0].pin == 3);
+        CHECK(events[0].value == 0);
+        CHECK(events[1].clock == 2);
+        CHECK(events[1].value == 1);
+        CHECK(events[2].clock == 5);
+        CHECK(events[2].value == -1);
+    }
+
+    SUBCASE("vcd comments, long names and far times")
+    {
+        const char* path = "test_stimulus.vcd";
+        {
+            std::ofstream file(path);
+            file << "$comment $var wire 1 ! gpio3 $end is not a signal $end\n"
+                 << "$var wire 1 ! gpio4 $end\n"
+                 << "$var wire 1 % data_20240101123456 $end\n"
+                 << "$enddefinitions $end\n"
+                 << "#1\n"
+                 << "1!\n"
+                 << "$comment 0! $end\n"
+                 << "1%\n"
+                 << "#3000000000\n" // 3 s at 1 GHz: past the int clock
+                 << "0!\n"
+                 << "#3000000001\n"
+                 << "1!\n";
+        }
+
+        PioStimulus stimulus;
+        stimulus.loadVcd(path, 1e9);
+        const auto& events = stimulus.events();
+        REQUIRE(events.size() == 1);
+        CHECK(events[0].clock == 1);
+        CHECK(events[0].pin == 4);
+        CHECK(events[0].value == 1);
+
+        {
+            std::ofstream file(path);
+            file << "$var wire 1 ! gpio4 $end\n"
+                 << "$enddefinitions $end\n"
+                 << "#99999999999999999999\n";
+        }
+        CHECK_THROWS(stimulus.loadVcd(path, 1e9));
+        std::remove(path);
+    }
+
+    SUBCASE("missing file throws")
+    {
+        PioStimulus stimulus;
+        CHECK_THROWS(stimulus.loadCsv("does_not_exist.csv"));
+    }
+}
@@ -0,0 +1,220 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <vector>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioTestbench.h"
+
+PioTask sleeper(PioTestbench& tb, int first, int second, std::vector<int>& log, int id)
+{
+    co_await tb.cycles(first);
+    log.push_back(id * 1000 + tb.pio.clock);
+    co_await tb.cycles(second);
+    log.push_back(id * 1000 + tb.pio.clock);
+}
+
+TEST_CASE("cycles() waits")
+{
+    PioStateMachine pio; // nops
+    PioTestbench tb(pio);
+    std::vector<int> log;
+
+    tb.spawn(sleeper(tb, 5, 10, log, 1));
+    tb.spawn(sleeper(tb, 5, 3, log, 2));
+    CHECK(tb.active() == 2);
+
+    CHECK(tb.run(100) == 15); // returns once both scripts are done
+    CHECK(tb.idle());
+    // Woken together: resumed in the order they went to sleep
+    CHECK(log == std::vector<int>{ 1005, 2005, 2008, 1015 });
+}
+
+TEST_CASE("reacting to the state machine")
+{
+    // Handshake: the sm answers on pin 1 what the script asks for on pin 0
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x2080; // 0: wait   1 gpio, 0
+    pio.instructionMemory[1] = 0xe001; // 1: set    pins, 1
+    pio.instructionMemory[2] = 0x2000; // 2: wait   0 gpio, 0
+    pio.instructionMemory[3] = 0xe000; // 3: set    pins, 0
+    pio.settings.set_base = 1;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_end = 3;
+    pio.gpio.pindirs[1] = 0;
+    pio.gpio.external_data[0] = 0;
+
+    PioTestbench tb(pio);
+    std::vector<int> clocks;
+    auto master = [&](PioTestbench& tb) -> PioTask {
+        for (int i = 0; i < 3; i++)
+        {
+            co_await tb.cycles(10);
+            tb.drive(0, 1);
+            co_await tb.rise(1);
+            clocks.push_back(tb.pio.clock);
+            tb.drive(0, 0);
+            co_await tb.fall(1);
+            clocks.push_back(tb.pio.clock);
+        }
+    };
+    tb.spawn(master(tb));
+    tb.run(1000);
+
+    CHECK(tb.idle());
+    REQUIRE(clocks.size() == 6);
+    CHECK(clocks[1] - clocks[0] == 2); // drive, wait passes, set
+    CHECK(clocks[2] - clocks[1] == 12);
+}
+
+TEST_CASE("FIFO waits")
+{
+    // Loopback: pull, copy, push
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0x80a0; // 0: pull   block
+    pio.instructionMemory[1] = 0xa0c7; // 1: mov    isr, osr
+    pio.instructionMemory[2] = 0x8020; // 2: push   block
+    pio.settings.wrap_end = 2;
+
+    PioTestbench tb(pio);
+    std::vector<uint32_t> received;
+    int drained_at = -1;
+    auto producer = [&](PioTestbench& tb) -> PioTask {
+        for (uint32_t word = 1; word <= 6; word++)
+        {
+            while (!tb.push(word * 0x11111111u))
+                co_await tb.cycles(1);
+        }
+        co_await tb.tx_empty();
+        drained_at = tb.pio.clock;
+    };
+    auto consumer = [&](PioTestbench& tb) -> PioTask {
+        while (received.size() < 6)
+        {
+            co_await tb.rx_not_empty();
+            uint32_t word;
+            while (tb.pop(word))
+                received.push_back(word);
+        }
+    };
+    tb.spawn(consumer(tb));
+    tb.spawn(producer(tb));
+    tb.run(1000);
+
+    CHECK(tb.idle());
+    CHECK(drained_at > 0);
+    REQUIRE(received.size() == 6);
+    for (uint32_t i = 0; i < 6; i++)
+        CHECK(received[i] == (i + 1) * 0x11111111u);
+}
+
+TEST_CASE("irq() and pc() waits")
+{
+    PioStateMachine pio;
+    pio.instructionMemory[0] = 0xa742; // 0: nop    [7]
+    pio.instructionMemory[1] = 0xc003; // 1: irq    set 3
+    pio.instructionMemory[2] = 0x0002; // 2: jmp    2
+
+    PioTestbench tb(pio);
+    int irq_clock = -1;
+    int pc_clock = -1;
+    int jmp_count = 0;
+    auto irq_script = [&](PioTestbench& tb) -> PioTask {
+        co_await tb.irq(3);
+        irq_clock = tb.pio.clock;
+        co_await tb.irq(3); // level: already set
+        tb.pio.irq_flags[3] = false;
+    };
+    auto pc_script = [&](PioTestbench& tb) -> PioTask {
+        co_await tb.pc(1);
+        pc_clock = tb.pio.clock;
+        for (int i = 0; i < 4; i++)
+        {
+            co_await tb.pc(2); // every tick that leaves the sm in the loop
+            jmp_count++;
+        }
+    };
+    tb.spawn(irq_script(tb));
+    tb.spawn(pc_script(tb));
+    tb.run(100);
+
+    CHECK(tb.idle());
+    CHECK(pc_clock == 1); // pc moves on when the nop issues, its delay runs at 1
+    CHECK(irq_clock == 9);
+    CHECK_FALSE(pio.irq_flags[3]);
+    CHECK(jmp_count == 4);
+    CHECK(pio.clock == 12);
+}
+
+TEST_CASE("script exceptions reach run()")
+{
+    PioStateMachine pio;
+    PioTestbench tb(pio);
+    auto failing = [](PioTestbench& tb) -> PioTask {
+        co_await tb.cycles(3);
+        throw std::runtime_error("expected 1, got 0");
+    };
+    tb.spawn(failing(tb));
+    CHECK_THROWS(tb.run(10));
+    CHECK(tb.idle());
+    CHECK(pio.clock == 3);
+}
+
+TEST_CASE("many concurrent scripts")
+{
+    PioStateMachine pio;
+    PioTestbench tb(pio);
+    int wakeups = 0;
+    auto worker = [&](PioTestbench& tb, int period) -> PioTask {
+        for (int i = 0; i < 10; i++)
+        {
+            co_await tb.cycles(period);
+            wakeups++;
+        }
+    };
+    for (int i = 0; i < 2000; i++)
+        tb.spawn(worker(tb, 1 + i % 50));
+    CHECK(tb.active() == 2000);
+
+    tb.run(1000);
+    CHECK(tb.idle());
+    CHECK(wakeups == 20000);
+    CHECK(pio.clock == 500);
+
+    // Edge waits on every pin: only the waiters of a pin that changed are looked at
+    std::array<int, 32> rises{}, falls{};
+    auto watcher = [&](PioTestbench& tb, int pin) -> PioTask {
+        co_await tb.rise(pin);
+        rises[pin]++;
+        co_await tb.fall(pin);
+        falls[pin]++;
+    };
+    auto driver = [&](PioTestbench& tb) -> PioTask {
+        for (int pin = 0; pin < 32; pin++)
+        {
+            co_await tb.cycles(3);
+            tb.drive(pin, 1);
+        }
+        co_await tb.cycles(3);
+        for (int pin = 0; pin < 32; pin++)
+            tb.drive(pin, 0);
+    };
+    for (int pin = 0; pin < 32; pin++)
+        pio.gpio.external_data[pin] = 0;
+    for (int i = 0; i < 2048; i++)
+        tb.spawn(watcher(tb, i % 32));
+    tb.spawn(driver(tb));
+    tb.run(1000);
+    CHECK(tb.idle());
+    CHECK(std::count(rises.begin(), rises.end(), 64) == 32); // 2048 scripts, 64 a pin
+    CHECK(falls == rises);
+
+    // Unfinished scripts are destroyed with the testbench
+    {
+        PioTestbench other(pio);
+        other.spawn(worker(other, 1000));
+        other.run(10);
+        CHECK(other.active() == 1);
+    }
+}
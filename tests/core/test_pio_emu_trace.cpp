@@ -0,0 +1,151 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdio>
+#include <vector>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioTrace.h"
+
+// Pin 0 toggles with delays, then the program stalls on the TX FIFO
+void loadProgram(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0xe027; // 0: set    x, 7
+    pio.instructionMemory[1] = 0xe101; // 1: set    pins, 1   [1]
+    pio.instructionMemory[2] = 0xe200; // 2: set    pins, 0   [2]
+    pio.instructionMemory[3] = 0x0041; // 3: jmp    x--, 1
+    pio.instructionMemory[4] = 0x80a0; // 4: pull   block
+    pio.settings.set_base = 0;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_end = 4;
+    pio.gpio.pindirs[0] = 0;
+}
+
+TEST_CASE("a traced run reads back cycle for cycle")
+{
+    const char* path = "test_trace.bin";
+    PioStateMachine pio, reference;
+    loadProgram(pio);
+    loadProgram(reference);
+
+    // The same machine stepped by hand, what the trace should hold
+    std::vector<PioTrace::Record> expected;
+    for (int i = 0; i < 300; i++)
+    {
+        reference.tick();
+        expected.push_back(PioTrace::capture(reference));
+    }
+
+    {
+        PioTrace::Writer writer(path, 64);
+        pio.tracer = &writer;
+        pio.run(300);
+        pio.tracer = nullptr;
+        CHECK(writer.records() == 300);
+    }
+
+    PioTrace::Reader reader(path);
+    CHECK(reader.recordCount() == 300);
+    CHECK(reader.chunks().size() == 5);
+    CHECK(reader.firstClock() == 0);
+    CHECK(reader.endClock() == 300);
+
+    // Random seeks land on the right cycle (the record is taken before the clock moves on)
+    for (int clock : { 0, 1, 63, 64, 65, 150, 299 })
+    {
+        const PioTrace::Record* record = reader.at(clock);
+        REQUIRE(record != nullptr);
+        CHECK(record->pins == expected[clock].pins);
+        CHECK(record->pc == expected[clock].pc);
+        CHECK(record->x == expected[clock].x);
+        CHECK(record->fifo == expected[clock].fifo);
+        CHECK(record->flags == expected[clock].flags);
+    }
+    CHECK(reader.at(300) == nullptr);
+    CHECK(reader.at(-1) == nullptr);
+
+    // Rising edges of pin 0 against the hand-stepped run
+    std::vector<int64_t> rises;
+    for (int clock = 1; clock < 300; clock++)
+        if ((expected[clock].pins & 1) && !(expected[clock - 1].pins & 1))
+            rises.push_back(clock);
+    PioTrace::Query query;
+    query.rise = 1;
+    CHECK(rises.size() == 8);
+    CHECK(reader.find(query) == rises);
+    CHECK(reader.find(query, 3) == std::vector<int64_t>(rises.begin(), rises.begin() + 3));
+
+    // pc and edge together, inside a window
+    query.pc = 2;
+    query.from = rises[2];
+    query.to = 200;
+    for (int64_t clock : reader.find(query))
+    {
+        CHECK(clock >= rises[2]);
+        CHECK(clock < 200);
+        CHECK(expected[clock].pc == 2);
+    }
+
+    // The loop is over before the last chunk: nothing there can match a pin 0 edge
+    query = {};
+    query.rise = 1;
+    CHECK_FALSE(reader.chunkMayMatch(reader.chunks().back(), query));
+    query = {};
+    query.pc = 4;
+    query.rise = 1;
+    CHECK(reader.find(query).empty());
+    std::remove(path);
+}
+
+TEST_CASE("clock gaps start a chunk, going back is skipped")
+{
+    const char* path = "test_trace_gaps.bin";
+    {
+        PioTrace::Writer writer(path, 16);
+        PioTrace::Record record{};
+        for (int clock = 0; clock < 10; clock++)
+        {
+            record.pins = clock & 1;
+            writer.append(clock, record);
+        }
+        writer.append(5, record); // a restored snapshot
+        for (int clock = 100; clock < 140; clock++)
+        {
+            record.pc = clock & 31;
+            writer.append(clock, record);
+        }
+        CHECK(writer.records() == 50);
+        CHECK(writer.skipped() == 1);
+    }
+
+    PioTrace::Reader reader(path);
+    REQUIRE(reader.chunks().size() == 4); // 10 | 16 + 16 + 8
+    CHECK(reader.chunks()[0].count == 10);
+    CHECK(reader.chunks()[1].first_clock == 100);
+    CHECK(reader.chunks()[3].count == 8);
+    CHECK(reader.at(50) == nullptr);
+    REQUIRE(reader.at(120) != nullptr);
+    CHECK(reader.at(120)->pc == (120 & 31));
+
+    // No edge across the gap, the cycle before 100 wasn't traced
+    PioTrace::Query query;
+    query.fall = 1;
+    CHECK(reader.find(query) == std::vector<int64_t>{ 2, 4, 6, 8 });
+    query = {};
+    query.pc = 5;
+    CHECK(reader.find(query) == std::vector<int64_t>{ 101, 133 });
+    std::remove(path);
+}
+
+TEST_CASE("unusable files")
+{
+    CHECK_THROWS(PioTrace::Reader{ "does_not_exist.bin" });
+
+    // Still open: no index yet
+    const char* path = "test_trace_open.bin";
+    PioTrace::Writer writer(path);
+    writer.append(0, PioTrace::Record{});
+    CHECK_THROWS(PioTrace::Reader{ path });
+    writer.close();
+    PioTrace::Reader reader(path);
+    CHECK(reader.recordCount() == 1);
+    std::remove(path);
+}
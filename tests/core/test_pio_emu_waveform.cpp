@@ -0,0 +1,124 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <cstdint>
+#include <random>
+#include <vector>
+#include "../../src/PioWaveform.h"
+
+// One sample per clock, pin 0 toggles every clock, pin 1 in bursts, pin 2 stays low, the rest random
+std::vector<uint32_t> makeSamples(int count)
+{
+    std::mt19937 random(7);
+    std::vector<uint32_t> samples;
+    uint32_t pins = 0;
+    for (int clock = 0; clock < count; clock++)
+    {
+        pins ^= 1;
+        if ((clock / 1000) % 3 == 0 && random() % 4 == 0)
+            pins ^= 2;
+        if (random() % 64 == 0)
+            pins ^= (random() & 0xf0);
+        samples.push_back(pins);
+    }
+    return samples;
+}
+
+// The view's buckets against the samples they stand for
+void checkView(const PioWaveform::View& view, const std::vector<uint32_t>& samples)
+{
+    REQUIRE_FALSE(view.buckets.empty());
+    for (size_t b = 0; b < view.buckets.size(); b++)
+    {
+        const PioWaveform::Bucket& bucket = view.buckets[b];
+        int64_t end = b + 1 < view.buckets.size() ? view.buckets[b + 1].clock : view.end_clock;
+        uint32_t min = ~0u, max = 0;
+        std::vector<uint32_t> edges(32);
+        for (int64_t clock = bucket.clock; clock < end; clock++)
+        {
+            min &= samples[clock];
+            max |= samples[clock];
+            uint32_t toggled = clock > 0 ? samples[clock] ^ samples[clock - 1] : 0;
+            if (clock == bucket.clock && b == 0)
+                continue; // the first bucket's edges depend on the level, see below
+            for (int pin = 0; pin < 32; pin++)
+                edges[pin] += (toggled >> pin) & 1;
+        }
+        CHECK(bucket.min == min);
+        CHECK(bucket.max == max);
+        if (b > 0)
+        {
+            for (int pin = 0; pin < 32; pin++)
+                CHECK(bucket.edges[pin] == edges[pin]);
+        }
+    }
+}
+
+TEST_CASE("levels follow the requested resolution")
+{
+    std::vector<uint32_t> samples = makeSamples(200000);
+    PioWaveform waveform;
+    for (int clock = 0; clock < static_cast<int>(samples.size()); clock++)
+        waveform.add(clock, samples[clock]);
+    CHECK(waveform.firstClock() == 0);
+    CHECK(waveform.endClock() == 200000);
+
+    // Zoomed out: the whole capture in a plot 1000 pixels wide
+    PioWaveform::View all = waveform.view(0, 200000, 1000);
+    CHECK(all.level > 0);
+    CHECK(all.buckets.size() <= 1000);
+    CHECK(all.end == 200000);
+    checkView(all, samples);
+
+    // Pin 0 toggled in every bucket, pin 2 never went high
+    for (const PioWaveform::Bucket& bucket : all.buckets)
+    {
+        CHECK((bucket.max & 1) == 1);
+        CHECK((bucket.min & 1) == 0);
+        CHECK((bucket.max & 4) == 0);
+    }
+
+    // A narrower plot takes a coarser level, never more buckets than pixels
+    PioWaveform::View narrow = waveform.view(0, 200000, 50);
+    CHECK(narrow.level > all.level);
+    CHECK(narrow.buckets.size() <= 50);
+    checkView(narrow, samples);
+
+    // Zoomed in: every change, exact
+    PioWaveform::View close = waveform.view(5000, 5040, 1000);
+    CHECK(close.level == 0);
+    CHECK(close.buckets.front().clock <= 5000);
+    CHECK(close.buckets.back().clock < 5040);
+    CHECK(close.end == 5040);
+    for (const PioWaveform::Bucket& bucket : close.buckets)
+        CHECK(bucket.min == samples[bucket.clock]);
+}
+
+TEST_CASE("only changes are kept, memory is bounded")
+{
+    PioWaveform waveform(1000);
+    for (int clock = 0; clock < 100; clock++)
+        waveform.add(clock, 0x10);
+    CHECK(waveform.changes() == 1);
+    CHECK(waveform.endClock() == 100);
+
+    PioWaveform::View flat = waveform.view(50, 60, 10);
+    REQUIRE(flat.buckets.size() == 1); // the level in effect at 50
+    CHECK(flat.buckets[0].clock == 0);
+    CHECK(flat.buckets[0].max == 0x10);
+
+    for (int clock = 100; clock < 10000; clock++)
+        waveform.add(clock, clock & 1);
+    CHECK(waveform.changes() <= 1000);
+    CHECK(waveform.changes() >= 500);
+    CHECK(waveform.firstClock() > 8000); // the oldest changes went
+    CHECK(waveform.endClock() == 10000);
+
+    // Going back is a reset
+    waveform.add(0, 3);
+    CHECK(waveform.changes() == 1);
+    CHECK(waveform.endClock() == 1);
+
+    waveform.clear();
+    CHECK(waveform.empty());
+    CHECK(waveform.view(0, 100, 10).buckets.empty());
+}
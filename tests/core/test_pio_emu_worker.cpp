@@ -0,0 +1,287 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#include <doctest/doctest.h>
+#include <thread>
+#include "../../src/PioStateMachine.h"
+#include "../../src/PioSnapshot.h"
+#include "../../src/PioWorker.h"
+#include "../../src/TripleBuffer.h"
+
+void loadBlink(PioStateMachine& pio)
+{
+    pio.instructionMemory[0] = 0xe701; //  0: set    pins, 1 [7]
+    pio.instructionMemory[1] = 0xe300; //  1: set    pins, 0 [3]
+    pio.instructionMemory[2] = 0xe03f; //  2: set    x, 31
+    pio.instructionMemory[3] = 0x0143; //  3: jmp    x--, 3 [1]
+    pio.instructionMemory[4] = 0x0200; //  4: jmp    0 [2]
+    pio.settings.set_base = 5;
+    pio.settings.set_count = 1;
+    pio.settings.wrap_start = 0;
+    pio.settings.wrap_end = 4;
+    pio.gpio.pindirs[5] = 0;
+}
+
+TEST_CASE("triple buffer hands over the newest value")
+{
+    TripleBuffer<int> buffer;
+    CHECK_FALSE(buffer.update());
+
+    buffer.back() = 1;
+    buffer.publish();
+    buffer.back() = 2;
+    buffer.publish();
+    CHECK(buffer.update());
+    CHECK(buffer.front() == 2); // 1 was never seen
+    CHECK_FALSE(buffer.update());
+    CHECK(buffer.front() == 2);
+
+    SUBCASE("concurrent writer")
+    {
+        TripleBuffer<std::array<int, 64>> values;
+        std::thread writer([&values] {
+            for (int i = 1; i <= 200000; i++)
+            {
+                values.back().fill(i);
+                values.publish();
+            }
+        });
+
+        // Every value read is consistent and never goes backwards
+        int last = 0;
+        bool ok = true;
+        while (last < 200000)
+        {
+            values.update();
+            const auto& front = values.front();
+            for (int v : front)
+                ok = ok && v == front[0];
+            ok = ok && front[0] >= last;
+            last = front[0];
+        }
+        writer.join();
+        CHECK(ok);
+    }
+}
+
+TEST_CASE("snapshot restores a machine")
+{
+    PioStateMachine pio;
+    loadBlink(pio);
+    pio.run(50);
+
+    PioSnapshot checkpoint;
+    checkpoint.capture(pio);
+    pio.run(123);
+    PioSnapshot later;
+    later.capture(pio);
+
+    checkpoint.restore(pio);
+    PioSnapshot restored;
+    restored.capture(pio);
+    CHECK(restored == checkpoint);
+
+    pio.run(123);
+    PioSnapshot again;
+    again.capture(pio);
+    CHECK(again == later);
+}
+
+TEST_CASE("worker runs jobs off the calling thread")
+{
+    PioStateMachine pio, reference;
+    loadBlink(pio);
+    loadBlink(reference);
+    PioWorker worker(pio);
+
+    SUBCASE("fixed number of cycles")
+    {
+        worker.record_pins = false;
+        REQUIRE(worker.start({ .max_cycles = 100000 }));
+        worker.wait();
+        reference.run(100000);
+
+        const auto& frame = worker.latest();
+        CHECK(frame.state == PioWorker::State::Idle);
+        CHECK(frame.stop_reason == PioWorker::StopReason::Completed);
+        CHECK(frame.job_cycles == 100000);
+        PioSnapshot expected;
+        expected.capture(reference);
+        CHECK(frame.machine == expected);
+    }
+
+    SUBCASE("breakpoint, then continue past it")
+    {
+        PioWorker::Job job;
+        job.max_cycles = 1000;
+        job.breakpoints.setPc(3);
+        REQUIRE(worker.start(job));
+        worker.wait();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::Breakpoint);
+        CHECK(worker.latest().stop_detail == "pc 3");
+        CHECK(pio.regs.pc == 3);
+        int stopped_at = pio.clock;
+
+        REQUIRE(worker.start(job));
+        worker.wait();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::Breakpoint);
+        CHECK(pio.regs.pc == 3);
+        CHECK(pio.clock > stopped_at);
+    }
+
+    SUBCASE("condition and watchpoint")
+    {
+        PioWorker::Job job;
+        job.max_cycles = 1000;
+        job.breakpoints.addCondition(pio, "pc == 4");
+        REQUIRE(worker.start(job));
+        worker.wait();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::Condition);
+        CHECK(pio.regs.pc == 4);
+
+        PioWorker::Job watch;
+        watch.max_cycles = 1000;
+        watch.breakpoints.addWatch(pio, "gpio5");
+        REQUIRE(worker.start(watch));
+        worker.wait();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::Watchpoint);
+        CHECK(worker.latest().stop_detail == "gpio5: 0 -> 1");
+    }
+
+    SUBCASE("pin history")
+    {
+        worker.pin_history_size = 16;
+        REQUIRE(worker.start({ .max_cycles = 40 }));
+        worker.wait();
+        const auto& pins = worker.latest().pins;
+        REQUIRE(pins.size() == 16);
+        CHECK(pins.front().clock == 25);
+        CHECK(pins.back().clock == 40);
+
+        // The waveform keeps what fell out of the ring
+        PioWaveform::View waveform = worker.waveform(0, 100, 100);
+        CHECK(waveform.first_clock == 1);
+        CHECK(waveform.end_clock == 41);
+        REQUIRE(waveform.buckets.size() == 2); // high from clock 1, low from 9
+        CHECK(waveform.buckets[1].clock == 9);
+        CHECK(waveform.buckets[1].edges[5] == 1);
+
+        pio.tick(); // the owner ticks while idle
+        worker.recordPins();
+        CHECK(worker.latest().pins.back().clock == 41);
+        CHECK(worker.waveform(0, 100, 100).end_clock == 42);
+
+        worker.clearPinHistory();
+        CHECK(worker.latest().pins.empty());
+        CHECK(worker.waveform(0, 100, 100).buckets.empty());
+    }
+
+    SUBCASE("pause, resume and cancel")
+    {
+        worker.record_pins = false;
+        REQUIRE(worker.start({ .max_cycles = UINT64_MAX }));
+        CHECK_FALSE(worker.start({ .max_cycles = 1 })); // busy
+
+        worker.pause();
+        CHECK(worker.state() == PioWorker::State::Paused);
+        int paused_clock = pio.clock; // safe to read while paused
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        CHECK(pio.clock == paused_clock);
+        CHECK(worker.latest().machine.clock == paused_clock);
+        CHECK(worker.latest().state == PioWorker::State::Paused);
+
+        worker.resume();
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        worker.cancel();
+        CHECK(worker.state() == PioWorker::State::Idle);
+        CHECK(pio.clock > paused_clock);
+
+        const auto& frame = worker.latest();
+        CHECK(frame.stop_reason == PioWorker::StopReason::Cancelled);
+        CHECK(frame.machine.clock == pio.clock);
+    }
+}
+
+TEST_CASE("free-running and real-time paced jobs")
+{
+    PioStateMachine pio;
+    loadBlink(pio);
+    PioWorker worker(pio);
+    worker.record_pins = false;
+
+    SUBCASE("free-run until cancelled, with a cycles/sec readout")
+    {
+        REQUIRE(worker.start({ .max_cycles = PioWorker::kForever }));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        const auto& running = worker.latest();
+        CHECK(running.state == PioWorker::State::Running);
+        CHECK(running.cycles_per_second > 0);
+        CHECK(running.target_cycles_per_second == 0);
+
+        worker.cancel();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::Cancelled);
+    }
+
+    SUBCASE("a stalled free-run ends at the clock limit")
+    {
+        // Fast-forwarded stall, reaches 2^31 - 1 in well under a second
+        pio.instructionMemory[0] = 0x80a0; // pull block, TX stays empty
+        pio.settings.wrap_end = 0;
+        REQUIRE(worker.start({ .max_cycles = PioWorker::kForever }));
+        worker.wait();
+        const auto& frame = worker.latest();
+        CHECK(frame.stop_reason == PioWorker::StopReason::ClockLimit);
+        CHECK(pio.clock == PioStateMachine::kMaxClock);
+        CHECK(frame.job_cycles == static_cast<uint64_t>(PioStateMachine::kMaxClock));
+
+        // Nothing left to run, run() doesn't wrap the clock either
+        REQUIRE(worker.start({ .max_cycles = PioWorker::kForever }));
+        worker.wait();
+        CHECK(worker.latest().stop_reason == PioWorker::StopReason::ClockLimit);
+        CHECK(worker.latest().job_cycles == 0);
+        CHECK(pio.run(1000) == 0);
+        CHECK(pio.clock == PioStateMachine::kMaxClock);
+    }
+
+    SUBCASE("real time at the divided clock")
+    {
+        PioWorker::Job job;
+        job.max_cycles = 2000;
+        job.pacing = PioWorker::Pacing::RealTime;
+        job.system_clock_hz = 40'000;
+        job.time_scale = 0.5; // 2000 cycles at 20 kHz: 100 ms
+        pio.settings.clkdiv_int = 1;
+
+        auto begin = std::chrono::steady_clock::now();
+        REQUIRE(worker.start(job));
+        worker.wait();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+        const auto& frame = worker.latest();
+        CHECK(frame.stop_reason == PioWorker::StopReason::Completed);
+        CHECK(frame.target_cycles_per_second == doctest::Approx(20'000));
+        CHECK(seconds >= 0.095);
+        CHECK(seconds < 1.0);
+
+        // Halving the SM clock doubles the target period
+        pio.settings.clkdiv_int = 2;
+        REQUIRE(worker.start(job));
+        worker.wait();
+        CHECK(worker.latest().target_cycles_per_second == doctest::Approx(10'000));
+    }
+
+    SUBCASE("a slow real-time job still pauses and cancels promptly")
+    {
+        PioWorker::Job job;
+        job.max_cycles = PioWorker::kForever;
+        job.pacing = PioWorker::Pacing::RealTime;
+        job.system_clock_hz = 2; // one cycle every 500 ms
+        REQUIRE(worker.start(job));
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+        auto begin = std::chrono::steady_clock::now();
+        worker.pause();
+        worker.resume();
+        worker.cancel();
+        CHECK(std::chrono::steady_clock::now() - begin < std::chrono::milliseconds(200));
+        CHECK(worker.state() == PioWorker::State::Idle);
+    }
+}
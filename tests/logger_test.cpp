@@ -13,6 +13,11 @@ int main() {
     // file logging (disable by default, this will enable it)
     // logger.setLogFile("application.log");
 
+    // Records are formatted and written by a background thread, tune when the file is flushed
+    // and what happens when the queue is full (default: flush every batch, block)
+    logger.setFlushPolicy(Logger::FlushPolicy::Periodic, std::chrono::milliseconds(50));
+    logger.setOverflowPolicy(Logger::OverflowPolicy::Block);
+
     // Different log level
     LOG_DEBUG("This is a debug message");
     LOG_INFO("Application started successfully");
@@ -28,5 +33,15 @@ int main() {
     int itemCount = 42;
     LOG_INFO_FMT("User {} has {} items in cart", username, itemCount);
 
+    // Safe from several threads
+    std::thread worker([] {
+        for (int i = 0; i < 3; i++)
+            LOG_INFO_FMT("Message {} from a worker thread", i);
+    });
+    worker.join();
+
+    // Wait until everything above is written
+    logger.flush();
+
     return 0;
 }
\ No newline at end of file
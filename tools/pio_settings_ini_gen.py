@@ -102,6 +102,8 @@ def generate_ini(wrap_target, wrap_end, instructions):
    ini_content += "autopull_enable = false\n"
    ini_content += "autopush_enable = false\n"
    ini_content += "status_sel = false\n"
+   ini_content += "clkdiv_int = 1 ; 0 means 65536\n"
+   ini_content += "clkdiv_frac = 0 ; 1/256ths\n"
    ini_content += "pindir = ffffffff ; hex value, without any prefix. lsb is pin0, 0=out, 1=in \n"
    ini_content += "\n"
    